@@ -0,0 +1,558 @@
+#include "ast.h"
+#include "lexer.h"
+#include "parser.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ---- arena ---- */
+
+#define AST_BLOCK_BYTES (64 * 1024)
+
+struct AstBlock {
+    AstBlock *next;
+    size_t    used;
+    size_t    cap;
+    _Alignas(16) char data[];
+};
+
+static void *arenaAlloc(astArena ar, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    AstBlock *blk = ar->blocks;
+    if (blk == NULL || blk->used + size > blk->cap) {
+        size_t cap = (size > AST_BLOCK_BYTES) ? size : AST_BLOCK_BYTES;
+        blk = (AstBlock *)malloc(sizeof(AstBlock) + cap);
+        blk->next  = ar->blocks;
+        blk->used  = 0;
+        blk->cap   = cap;
+        ar->blocks = blk;
+    }
+    void *p = blk->data + blk->used;
+    blk->used += size;
+    ar->bytes += size;
+    return p;
+}
+
+static AstNode *newNode(astArena ar, AST_KIND kind, int line) {
+    AstNode *n = (AstNode *)arenaAlloc(ar, sizeof(AstNode));
+    memset(n, 0, sizeof(AstNode));
+    n->kind   = kind;
+    n->line   = line;
+    n->offset = -1;
+    n->typeId = -1;
+    ar->nodes++;
+    return n;
+}
+
+static char *keepText(astArena ar, const char *s) {
+    size_t len = strlen(s) + 1;
+    char  *p   = (char *)arenaAlloc(ar, len);
+    memcpy(p, s, len);
+    return p;
+}
+
+void freeAstArena(astArena ar) {
+    if (ar == NULL)
+        return;
+    while (ar->blocks != NULL) {
+        AstBlock *nx = ar->blocks->next;
+        free(ar->blocks);
+        ar->blocks = nx;
+    }
+    free(ar);
+}
+
+/* ---- builder ---- */
+
+/*
+ * Semantic value of one grammar symbol.  A matched token carries its
+ * type, line and (for names and literals) its text; a non-terminal
+ * carries a node, or a list as head .. tail, or just a token type for
+ * things like operators and types that end up inside a parent node.
+ */
+typedef struct {
+    AstNode    *node;
+    AstNode    *tail;
+    char       *text;
+    TOKEN_TYPE  tok;
+    int         line;
+} AstVal;
+
+/* A non-terminal being expanded; its body's values start at vals[base] */
+typedef struct {
+    NON_TERMINAL nt;
+    int          rule;
+    int          base;
+} AstFrame;
+
+typedef struct {
+    const Grammar *g;
+    astArena       arena;
+    AstVal        *vals;
+    int            nVals;
+    int            capVals;
+    AstFrame      *frames;
+    int            nFrames;
+    int            capFrames;
+    bool           broken;  /* a rule body lost a symbol to error recovery */
+} AstBuilder;
+
+static void pushVal(AstBuilder *b, AstVal v) {
+    if (b->nVals == b->capVals) {
+        b->capVals *= 2;
+        b->vals = (AstVal *)realloc(b->vals, b->capVals * sizeof(AstVal));
+    }
+    b->vals[b->nVals++] = v;
+}
+
+/* Tokens whose text is kept in the tree */
+static bool keepsText(TOKEN_TYPE t) {
+    switch (t) {
+    case TK_ID: case TK_FIELDID: case TK_FUNID: case TK_RUID:
+    case TK_NUM: case TK_RNUM: case TK_MAIN:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static AstVal single(AstNode *n) {
+    AstVal v = { n, n, NULL, NULL_TOKEN, n->line };
+    return v;
+}
+
+/* Prepend 'head' (a single node, or NULL) to the list in 'rest' */
+static AstVal cons(AstNode *head, AstVal rest) {
+    if (head == NULL)
+        return rest;
+    head->next = rest.node;
+    AstVal v = { head, rest.node ? rest.tail : head, NULL, NULL_TOKEN, head->line };
+    return v;
+}
+
+/* Append list 'part' to list 'acc' in place */
+static void append(AstVal *acc, AstVal part) {
+    if (part.node == NULL)
+        return;
+    if (acc->node == NULL)
+        *acc = part;
+    else {
+        acc->tail->next = part.node;
+        acc->tail       = part.tail;
+    }
+}
+
+/*
+ * 'ops' is a chain of binary nodes (or record accesses) whose left
+ * operand is still open, in source order; fold them onto 'first' so
+ * that the result is left-associative.
+ */
+static AstNode *foldLeft(AstNode *first, AstNode *ops) {
+    AstNode *acc = first;
+    while (ops != NULL) {
+        AstNode *nx = ops->next;
+        ops->next = NULL;
+        ops->a    = acc;
+        acc       = ops;
+        ops       = nx;
+    }
+    return acc;
+}
+
+/* Copy a type value (primitive or constructed) into a node */
+static void setType(AstNode *n, AstVal type) {
+    n->op  = type.tok;
+    n->aux = type.text;
+}
+
+/* ------------------------------------------------------------------
+ * reduce — the construction action of every rule
+ *
+ * v[k] is the value of rhs[k].  Single-symbol rules pass their value
+ * up unchanged (so chains like <factor> → <var> → <singleOrRecId>
+ * never make nodes); ε-rules yield an empty value.
+ * ------------------------------------------------------------------ */
+static AstVal reduce(AstBuilder *b, NON_TERMINAL nt, int len, AstVal *v) {
+    astArena ar = b->arena;
+    AstVal   r  = { NULL, NULL, NULL, NULL_TOKEN, 0 };
+    AstNode *n;
+
+    if (len == 0)
+        return r;
+
+    if (len == 1) {
+        /* literals are the one place a lone token becomes a node */
+        if (nt == NT_VAR && (v[0].tok == TK_NUM || v[0].tok == TK_RNUM)) {
+            n = newNode(ar, v[0].tok == TK_NUM ? AST_NUM : AST_RNUM, v[0].line);
+            n->name = v[0].text;
+            return single(n);
+        }
+        if (nt == NT_ELSEPART)
+            return r;   /* bare TK_ENDIF */
+        return v[0];
+    }
+
+    switch (nt) {
+    case NT_PROGRAM:
+        n = newNode(ar, AST_PROGRAM, 1);
+        n->a = v[0].node;
+        n->b = v[1].node;
+        return single(n);
+
+    case NT_MAINFUNCTION:
+        n = newNode(ar, AST_FUNCTION, v[0].line);
+        n->name = v[0].text;
+        n->c    = v[1].node;
+        return single(n);
+
+    case NT_FUNCTION:
+        n = newNode(ar, AST_FUNCTION, v[0].line);
+        n->name = v[0].text;
+        n->a    = v[1].node;
+        n->b    = v[2].node;
+        n->c    = v[4].node;
+        return single(n);
+
+    case NT_INPUT_PAR:
+    case NT_OUTPUT_PAR:
+        return v[4];
+
+    case NT_PARAMETER_LIST:
+        n = newNode(ar, AST_PARAM, v[1].line);
+        n->name = v[1].text;
+        setType(n, v[0]);
+        return cons(n, v[2]);
+
+    case NT_CONSTRUCTEDDATATYPE:
+        r.tok  = v[0].tok;
+        r.text = v[1].text;
+        r.line = v[0].line;
+        return r;
+
+    case NT_STMTS:
+        r = v[0];
+        append(&r, v[1]);
+        append(&r, v[2]);
+        append(&r, v[3]);
+        return r;
+
+    case NT_TYPEDEFINITION:
+        n = newNode(ar, AST_TYPEDEF, v[0].line);
+        n->op   = v[0].tok;
+        n->name = v[1].text;
+        n->a    = v[2].node;
+        return single(n);
+
+    case NT_FIELDDEFINITIONS:
+        return cons(v[0].node, cons(v[1].node, v[2]));
+
+    case NT_FIELDDEFINITION:
+        n = newNode(ar, AST_FIELD, v[3].line);
+        n->name = v[3].text;
+        setType(n, v[1]);
+        return single(n);
+
+    case NT_DECLATRATION:
+        n = newNode(ar, AST_DECL, v[3].line);
+        n->name = v[3].text;
+        setType(n, v[1]);
+        if (v[4].tok == TK_GLOBAL)
+            n->flags |= AST_GLOBAL;
+        return single(n);
+
+    case NT_GLOBAL_OR_NOT:
+        return v[1];
+
+    case NT_ASSIGNMENTSTMT:
+        n = newNode(ar, AST_ASSIGN, v[1].line);
+        n->a = v[0].node;
+        n->b = v[2].node;
+        return single(n);
+
+    case NT_SINGLEORRECID:
+        n = newNode(ar, AST_ID, v[0].line);
+        n->name = v[0].text;
+        return single(foldLeft(n, v[1].node));
+
+    case NT_ONEEXPANSION:
+        n = newNode(ar, AST_RECORD_ACCESS, v[1].line);
+        n->name = v[1].text;
+        return single(n);
+
+    case NT_FUNCALLSTMT:
+        n = newNode(ar, AST_CALL, v[2].line);
+        n->name = v[2].text;
+        n->a    = v[0].node;
+        n->b    = v[5].node;
+        return single(n);
+
+    case NT_OUTPUTPARAMETERS:
+    case NT_INPUTPARAMETERS:
+    case NT_OPTIONALRETURN:
+    case NT_FACTOR:             /* ( <arithmeticExpression> ) */
+        return v[1];
+
+    case NT_ITERATIVESTMT:
+        n = newNode(ar, AST_WHILE, v[0].line);
+        n->a = v[2].node;
+        n->b = cons(v[4].node, v[5]).node;
+        return single(n);
+
+    case NT_CONDITIONALSTMT:
+        n = newNode(ar, AST_IF, v[0].line);
+        n->a = v[2].node;
+        n->b = cons(v[5].node, v[6]).node;
+        n->c = v[7].node;
+        return single(n);
+
+    case NT_ELSEPART:
+        return cons(v[1].node, v[2]);
+
+    case NT_IOSTMT:
+        n = newNode(ar, v[0].tok == TK_READ ? AST_READ : AST_WRITE, v[0].line);
+        n->a = v[2].node;
+        return single(n);
+
+    case NT_ARITHMETICEXPRESSION:
+    case NT_TERM:
+        return single(foldLeft(v[0].node, v[1].node));
+
+    case NT_EXPPRIME:
+    case NT_TERMPRIME:
+        /* operator with its right operand; the left one comes from foldLeft */
+        n = newNode(ar, AST_BINOP, v[0].line);
+        n->op = v[0].tok;
+        n->b  = v[1].node;
+        return cons(n, v[2]);
+
+    case NT_BOOLEANEXPRESSION:
+        if (v[0].tok == TK_NOT) {
+            n = newNode(ar, AST_NOT, v[0].line);
+            n->a = v[2].node;
+        } else if (len == 3) {
+            /* <var> <relationalOp> <var> */
+            n = newNode(ar, AST_BINOP, v[1].line);
+            n->op = v[1].tok;
+            n->a  = v[0].node;
+            n->b  = v[2].node;
+        } else {
+            /* ( <booleanExpression> ) <logicalOp> ( <booleanExpression> ) */
+            n = newNode(ar, AST_BINOP, v[3].line);
+            n->op = v[3].tok;
+            n->a  = v[1].node;
+            n->b  = v[5].node;
+        }
+        return single(n);
+
+    case NT_RETURNSTMT:
+        n = newNode(ar, AST_RETURN, v[0].line);
+        n->a = v[1].node;
+        return single(n);
+
+    case NT_IDLIST:
+        n = newNode(ar, AST_ID, v[0].line);
+        n->name = v[0].text;
+        return cons(n, v[1]);
+
+    case NT_DEFINETYPESTMT:
+        n = newNode(ar, AST_DEFINETYPE, v[0].line);
+        n->op   = v[1].tok;
+        n->aux  = v[2].text;
+        n->name = v[4].text;
+        return single(n);
+
+    /* Right-recursive lists: <x> ===> <item> <x> */
+    case NT_OTHERFUNCTIONS:
+    case NT_TYPEDEFINITIONS:
+    case NT_MOREFIELDS:
+    case NT_DECLATRATIONS:
+    case NT_OTHERSTMTS:
+    case NT_MOREEXPANSIONS:
+    case NT_OPTION_SINGLE_CONSTRUCTED:
+        return cons(v[0].node, v[1]);
+
+    case NT_REMAINING_LIST:
+    case NT_MORE_IDS:
+        return v[1];
+
+    default:
+        return r;
+    }
+}
+
+static void astEnter(NON_TERMINAL nt, int ruleIdx, void *user) {
+    AstBuilder *b = (AstBuilder *)user;
+    if (b->nFrames == b->capFrames) {
+        b->capFrames *= 2;
+        b->frames = (AstFrame *)realloc(b->frames, b->capFrames * sizeof(AstFrame));
+    }
+    b->frames[b->nFrames++] = (AstFrame){ nt, ruleIdx, b->nVals };
+}
+
+static void astMatch(tokenInfo tok, void *user) {
+    AstBuilder *b = (AstBuilder *)user;
+    AstVal v = { NULL, NULL, NULL, tok->type, tok->line };
+    if (keepsText(tok->type) && tok->lexeme != NULL)
+        v.text = keepText(b->arena, tok->lexeme);
+    pushVal(b, v);
+}
+
+static void astExit(NON_TERMINAL nt, void *user) {
+    AstBuilder *b  = (AstBuilder *)user;
+    AstFrame    fr = b->frames[--b->nFrames];
+
+    const Grammar *g   = b->g;
+    int            len = (g->has_eps[nt] && fr.rule == g->prod_count[nt])
+                             ? 0 : g->prods[nt][fr.rule].rhs_len;
+
+    /* Error recovery dropped part of this body: stop building */
+    if (b->nVals - fr.base != len)
+        b->broken = true;
+
+    AstVal r = { NULL, NULL, NULL, NULL_TOKEN, 0 };
+    if (!b->broken)
+        r = reduce(b, nt, len, &b->vals[fr.base]);
+    b->nVals = fr.base;
+    pushVal(b, r);
+}
+
+/* ------------------------------------------------------------------
+ * parseSourceAST
+ * ------------------------------------------------------------------ */
+AstNode *parseSourceAST(const ParseTable *pt, const Grammar *g, FILE *src,
+                        astArena *arena, diagBuffer diag) {
+    AstBuilder b;
+    b.g         = g;
+    b.arena     = (astArena)calloc(1, sizeof(AST_ARENA));
+    b.capVals   = 64;
+    b.nVals     = 0;
+    b.vals      = (AstVal *)malloc(b.capVals * sizeof(AstVal));
+    b.capFrames = 64;
+    b.nFrames   = 0;
+    b.frames    = (AstFrame *)malloc(b.capFrames * sizeof(AstFrame));
+    b.broken    = false;
+
+    ParseEvents ev = { astEnter, astMatch, astExit, &b };
+    bool ok = parseSourceEvents(pt, g, src, &ev, diag);
+
+    AstNode *root = NULL;
+    if (ok && !b.broken && b.nVals == 1)
+        root = b.vals[0].node;
+
+    free(b.vals);
+    free(b.frames);
+
+    if (root == NULL) {
+        freeAstArena(b.arena);
+        *arena = NULL;
+    } else {
+        *arena = b.arena;
+    }
+    return root;
+}
+
+/* ---- listing ---- */
+
+static const char *AST_KIND_NAMES[] = {
+    "Program", "Function", "Param", "TypeDef", "Field", "DefineType", "Decl",
+    "Assign", "Call", "While", "If", "Read", "Write", "Return", "BinOp", "Not",
+    "Id", "RecordAccess", "Num", "RNum",
+};
+
+/* Labels printed above the a / b / c children (NULL = no label) */
+static const char *SLOT_LABELS[][3] = {
+    [AST_FUNCTION] = { "input", "output", "body" },
+    [AST_CALL]     = { "output", "input", NULL },
+    [AST_WHILE]    = { NULL, "do", NULL },
+    [AST_IF]       = { NULL, "then", "else" },
+    [AST_TYPEDEF]  = { NULL, NULL, NULL },
+};
+
+static const char *opText(TOKEN_TYPE op) {
+    switch (op) {
+    case TK_PLUS:   return "+";
+    case TK_MINUS:  return "-";
+    case TK_MUL:    return "*";
+    case TK_DIV:    return "/";
+    case TK_AND:    return "&&&";
+    case TK_OR:     return "@@@";
+    case TK_LT:     return "<";
+    case TK_LE:     return "<=";
+    case TK_EQ:     return "==";
+    case TK_GT:     return ">";
+    case TK_GE:     return ">=";
+    case TK_NE:     return "!=";
+    case TK_INT:    return "int";
+    case TK_REAL:   return "real";
+    case TK_RECORD: return "record";
+    case TK_UNION:  return "union";
+    default:        return "";
+    }
+}
+
+static void printType(const AstNode *n, FILE *out) {
+    if (n->op == TK_RUID)
+        fprintf(out, " : %s", n->aux ? n->aux : "?");
+    else if (n->aux != NULL)
+        fprintf(out, " : %s %s", opText(n->op), n->aux);
+    else
+        fprintf(out, " : %s", opText(n->op));
+}
+
+static void printNodes(const AstNode *n, int depth, FILE *out) {
+    for (; n != NULL; n = n->next) {
+        fprintf(out, "%*s%s", depth * 2, "", AST_KIND_NAMES[n->kind]);
+
+        switch (n->kind) {
+        case AST_PARAM:
+        case AST_FIELD:
+        case AST_DECL:
+            fprintf(out, " %s", n->name);
+            printType(n, out);
+            if (n->flags & AST_GLOBAL)
+                fprintf(out, " global");
+            break;
+        case AST_TYPEDEF:
+            fprintf(out, " %s %s", opText(n->op), n->name);
+            break;
+        case AST_DEFINETYPE:
+            fprintf(out, " %s %s as %s", opText(n->op), n->aux, n->name);
+            break;
+        case AST_BINOP:
+            fprintf(out, " %s", opText(n->op));
+            break;
+        case AST_RECORD_ACCESS:
+            fprintf(out, " %s", n->name);
+            if (n->offset >= 0)
+                fprintf(out, " +%d", n->offset);
+            break;
+        case AST_FUNCTION:
+        case AST_CALL:
+        case AST_ID:
+        case AST_NUM:
+        case AST_RNUM:
+            fprintf(out, " %s", n->name);
+            break;
+        default:
+            break;
+        }
+        fprintf(out, "  (line %d)\n", n->line);
+
+        const AstNode *kids[3] = { n->a, n->b, n->c };
+        for (int k = 0; k < 3; k++) {
+            if (kids[k] == NULL)
+                continue;
+            const char *label = (n->kind < (int)(sizeof(SLOT_LABELS) / sizeof(SLOT_LABELS[0])))
+                                    ? SLOT_LABELS[n->kind][k] : NULL;
+            if (label != NULL) {
+                fprintf(out, "%*s%s:\n", (depth + 1) * 2, "", label);
+                printNodes(kids[k], depth + 2, out);
+            } else {
+                printNodes(kids[k], depth + 1, out);
+            }
+        }
+    }
+}
+
+void printAst(const AstNode *root, FILE *out) {
+    printNodes(root, 0, out);
+}
@@ -0,0 +1,92 @@
+#ifndef AST_H
+#define AST_H
+
+#include "diag.h"
+#include "parserDef.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Abstract syntax tree built directly from the parser's event stream.
+ * Punctuation, ε-rules and single-child chains never become nodes; each
+ * grammar rule has a small action that turns the values of its body
+ * into (at most) one node.
+ */
+typedef enum AST_KIND {
+    AST_PROGRAM,        /* a = other functions, b = main function */
+    AST_FUNCTION,       /* name; a = input params, b = output params, c = body */
+    AST_PARAM,          /* name; type in op/aux */
+    AST_TYPEDEF,        /* op = TK_RECORD/TK_UNION, name = #type; a = fields */
+    AST_FIELD,          /* name; type in op/aux */
+    AST_DEFINETYPE,     /* op = TK_RECORD/TK_UNION; aux = #type, name = #alias */
+    AST_DECL,           /* name; type in op/aux; flags & AST_GLOBAL */
+    AST_ASSIGN,         /* a = target, b = value */
+    AST_CALL,           /* name = function; a = outputs, b = inputs */
+    AST_WHILE,          /* a = condition, b = body */
+    AST_IF,             /* a = condition, b = then-part, c = else-part */
+    AST_READ,           /* a = variable */
+    AST_WRITE,          /* a = variable */
+    AST_RETURN,         /* a = returned ids */
+    AST_BINOP,          /* op = operator token; a, b = operands */
+    AST_NOT,            /* a = operand */
+    AST_ID,             /* name */
+    AST_RECORD_ACCESS,  /* a = record expression, name = field */
+    AST_NUM,            /* name = literal text */
+    AST_RNUM,           /* name = literal text */
+} AST_KIND;
+
+/* AST_DECL flag: declared with ': global' */
+#define AST_GLOBAL 1
+
+/*
+ * One AST node.  Types are stored as op = TK_INT / TK_REAL / TK_RECORD
+ * / TK_UNION / TK_RUID with aux = the type name for the last three.
+ * Sequences (functions, parameters, statements, fields, id lists) are
+ * chained through 'next'.
+ */
+typedef struct AstNode AstNode;
+
+struct AstNode {
+    AST_KIND    kind;
+    int         line;
+    TOKEN_TYPE  op;
+    int         flags;
+    char       *name;
+    char       *aux;
+    uint32_t    nameId;     /* interned 'name', set by buildSymbolTable */
+    int32_t     offset;     /* AST_RECORD_ACCESS: bytes from the start of the base */
+    int32_t     typeId;     /*   variable, and the field's type; -1 until layoutAccesses */
+    AstNode    *a;
+    AstNode    *b;
+    AstNode    *c;
+    AstNode    *next;
+};
+
+/* Bump allocator that owns every node and string of one AST */
+typedef struct AstBlock AstBlock;
+
+typedef struct AST_ARENA {
+    AstBlock *blocks;
+    long      nodes;    /* nodes allocated */
+    size_t    bytes;    /* bytes handed out (nodes and strings) */
+} AST_ARENA;
+
+typedef AST_ARENA *astArena;
+
+/*
+ * Parse 'src' into an AST.  Lexical and syntax errors are written to
+ * 'diag' (stdout if NULL) as in the other parse modes, but no verdict,
+ * since checking may still follow; if there are any, NULL is returned
+ * and nothing is kept.  Otherwise *arena receives the arena the tree
+ * lives in.
+ */
+AstNode *parseSourceAST(const ParseTable *pt, const Grammar *g, FILE *src,
+                        astArena *arena, diagBuffer diag);
+
+/* Indented listing of the tree, one node per line */
+void printAst(const AstNode *root, FILE *out);
+
+void freeAstArena(astArena arena);
+
+#endif /* AST_H */
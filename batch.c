@@ -0,0 +1,256 @@
+#include "batch.h"
+#include "bench.h"
+#include "compilerCtx.h"
+#include "lexer.h"
+#include "pool.h"
+#include <dirent.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/* ---- source lists ---- */
+
+typedef struct {
+    char **paths;
+    int    count;
+    int    cap;
+} PathList;
+
+static void addPath(PathList *pl, char *path) {
+    if (pl->count == pl->cap) {
+        pl->cap   = pl->cap ? pl->cap * 2 : 64;
+        pl->paths = (char **)realloc(pl->paths, pl->cap * sizeof(char *));
+    }
+    pl->paths[pl->count++] = path;
+}
+
+static int cmpPath(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static bool listDirectory(const char *dir, PathList *pl) {
+    DIR *d = opendir(dir);
+    if (d == NULL)
+        return false;
+
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.')
+            continue;
+        size_t len  = strlen(dir) + strlen(e->d_name) + 2;
+        char  *path = (char *)malloc(len);
+        snprintf(path, len, "%s/%s", dir, e->d_name);
+
+        struct stat st;
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode))
+            addPath(pl, path);
+        else
+            free(path);
+    }
+    closedir(d);
+
+    qsort(pl->paths, pl->count, sizeof(char *), cmpPath);
+    return true;
+}
+
+static bool readListFile(const char *file, PathList *pl) {
+    FILE *fp = fopen(file, "r");
+    if (fp == NULL)
+        return false;
+
+    char   *line = NULL;
+    size_t  cap  = 0;
+    ssize_t len;
+    while ((len = getline(&line, &cap, fp)) != -1) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' ||
+                           line[len - 1] == ' '  || line[len - 1] == '\t'))
+            line[--len] = '\0';
+        char *p = line;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '\0' || *p == '#')
+            continue;
+        addPath(pl, strdup(p));
+    }
+    free(line);
+    fclose(fp);
+    return true;
+}
+
+char **collectSources(const char *arg, int *count) {
+    PathList    pl = { NULL, 0, 0 };
+    struct stat st;
+
+    if (stat(arg, &st) != 0)
+        return NULL;
+    bool ok = S_ISDIR(st.st_mode) ? listDirectory(arg, &pl) : readListFile(arg, &pl);
+    if (!ok) {
+        freeSources(pl.paths, pl.count);
+        return NULL;
+    }
+    if (pl.paths == NULL)
+        pl.paths = (char **)malloc(sizeof(char *));
+    *count = pl.count;
+    return pl.paths;
+}
+
+void freeSources(char **paths, int count) {
+    if (paths == NULL)
+        return;
+    for (int i = 0; i < count; i++)
+        free(paths[i]);
+    free(paths);
+}
+
+/* ---- workers ---- */
+
+/* Outcome of one file, filled in by whichever worker parsed it */
+typedef struct {
+    bool   opened;
+    bool   ok;          /* no lexical or syntax errors */
+    size_t bytes;
+    long   tokens;
+} BatchResult;
+
+typedef struct {
+    const ParseTable *pt;
+    const Grammar    *g;
+    char            **paths;
+    const char       *outDir;
+    parseCache        cache;
+    BatchResult      *results;
+} BatchShared;
+
+static const char *baseName(const char *path) {
+    const char *base = strrchr(path, '/');
+    return base ? base + 1 : path;
+}
+
+static int cmpBaseName(const void *a, const void *b) {
+    return strcmp(baseName(*(char *const *)a), baseName(*(char *const *)b));
+}
+
+/* Report every pair of paths with one base name, which would share output files; the count */
+static int reportClashes(char **paths, int n, FILE *summary) {
+    char **sorted  = (char **)malloc((n > 0 ? n : 1) * sizeof(char *));
+    int    clashes = 0;
+    memcpy(sorted, paths, n * sizeof(char *));
+    qsort(sorted, n, sizeof(char *), cmpBaseName);
+    for (int k = 1; k < n; k++)
+        if (strcmp(baseName(sorted[k - 1]), baseName(sorted[k])) == 0) {
+            fprintf(summary, "FAILED %s: same output name as %s\n", sorted[k], sorted[k - 1]);
+            clashes++;
+        }
+    free(sorted);
+    return clashes;
+}
+
+/* outDir/<basename of src><suffix> */
+static char *outputPath(const char *outDir, const char *src, const char *suffix) {
+    const char *base = baseName(src);
+    size_t      len  = strlen(outDir) + strlen(base) + strlen(suffix) + 2;
+    char  *path = (char *)malloc(len);
+    snprintf(path, len, "%s/%s%s", outDir, base, suffix);
+    return path;
+}
+
+static void compileFileTask(int k, void *arg) {
+    BatchShared *sh  = (BatchShared *)arg;
+    BatchResult *res = &sh->results[k];
+    const char  *src = sh->paths[k];
+
+    FILE *srcFP = fopen(src, "r");
+    if (srcFP == NULL)
+        return;
+    res->opened = true;
+    fseek(srcFP, 0, SEEK_END);
+    res->bytes = (size_t)ftell(srcFP);
+    rewind(srcFP);
+
+    /* A context of our own: tokens, tree and diagnostics stay per file */
+    compilerCtx ctx = createCompilerCtx(sh->g, sh->pt, NULL);
+    ctx->cache = sh->cache;
+    compileSource(ctx, srcFP);
+    fclose(srcFP);
+    res->tokens = ctx->tokens->count - 1;
+    res->ok     = !ctx->hadError;
+
+    char *treePath = outputPath(sh->outDir, src, ".tree");
+    ctx->out = fopen(treePath, "w");
+    if (ctx->out != NULL) {
+        compileWriteTree(ctx);
+        fclose(ctx->out);
+    } else {
+        res->ok = false;
+    }
+    free(treePath);
+
+    if (ctx->diag->len > 0) {
+        char *logPath = outputPath(sh->outDir, src, ".log");
+        FILE *logFP   = fopen(logPath, "w");
+        if (logFP != NULL) {
+            diagFlush(ctx->diag, logFP);
+            fclose(logFP);
+        }
+        free(logPath);
+    }
+
+    freeCompilerCtx(ctx);
+}
+
+/* ------------------------------------------------------------------
+ * compileBatch
+ * ------------------------------------------------------------------ */
+int compileBatch(const ParseTable *pt, const Grammar *g, char **paths, int n,
+                 const char *outDir, int nThreads, parseCache cache, FILE *summary) {
+    /* a list may name p.txt in two directories; one would overwrite the other's results */
+    if (reportClashes(paths, n, summary) > 0) {
+        fprintf(summary, "%d file(s): none parsed, output names must be unique\n", n);
+        return n;
+    }
+    if (mkdir(outDir, 0777) != 0 && errno != EEXIST) {
+        perror(outDir);
+        return n;
+    }
+
+    BatchShared sh = { pt, g, paths, outDir, cache,
+                       (BatchResult *)calloc(n > 0 ? n : 1, sizeof(BatchResult)) };
+
+    uint64_t t0 = benchNow();
+    if (n > 0)
+        runPool(n, nThreads, compileFileTask, &sh);
+    uint64_t t1 = benchNow();
+
+    int    failed = 0;
+    size_t bytes  = 0;
+    long   tokens = 0;
+    for (int k = 0; k < n; k++) {
+        BatchResult *r = &sh.results[k];
+        bytes  += r->bytes;
+        tokens += r->tokens;
+        if (!r->opened) {
+            failed++;
+            fprintf(summary, "FAILED %s: cannot open\n", paths[k]);
+        } else if (!r->ok) {
+            failed++;
+            fprintf(summary, "FAILED %s\n", paths[k]);
+        }
+    }
+
+    double secs = (double)(t1 - t0) / 1e9;
+    fprintf(summary, "%d file(s): %d ok, %d failed, %d thread(s)\n",
+            n, n - failed, failed, nThreads);
+    fprintf(summary, "%zu bytes, %ld tokens in %.3f s", bytes, tokens, secs);
+    if (secs > 0)
+        fprintf(summary, " — %.0f files/s, %.1f MB/s, %.0f tokens/s",
+                n / secs, bytes / secs / 1e6, tokens / secs);
+    fprintf(summary, "\n");
+    if (cache != NULL)
+        fprintf(summary, "cache: %ld hit(s), %ld miss(es)\n",
+                (long)atomic_load(&cache->hits), (long)atomic_load(&cache->misses));
+
+    free(sh.results);
+    return failed;
+}
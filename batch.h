@@ -0,0 +1,38 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "cache.h"
+#include "parserDef.h"
+#include <stdio.h>
+
+/*
+ * Batch compilation: parse many source files concurrently against one
+ * shared, read-only grammar and parse table.  Every file is lexed and
+ * parsed by a single worker in its own compiler context, so files never
+ * share mutable state.
+ */
+
+/*
+ * Expand 'arg' into a list of source paths.  A directory yields its
+ * regular files (hidden ones skipped), sorted by name; any other file
+ * is read as a list with one path per line ('#' starts a comment).
+ * Returns a malloc'd array of malloc'd strings, or NULL on error.
+ */
+char **collectSources(const char *arg, int *count);
+
+void freeSources(char **paths, int count);
+
+/*
+ * Parse paths[0..n) on nThreads workers.  For each file 'name' the
+ * parse tree goes to outDir/name.tree and its lexical and syntax errors,
+ * if any, to outDir/name.log.  outDir is created if it does not exist.
+ * Failed files and aggregate throughput are written to 'summary'.
+ * With a 'cache' (may be NULL) unchanged files skip lexing and parsing.
+ * Two paths with the same file name would write the same outputs, so
+ * such a list is refused: the clashes go to 'summary' and nothing is
+ * parsed.  Returns the number of files that failed (all of them then).
+ */
+int compileBatch(const ParseTable *pt, const Grammar *g, char **paths, int n,
+                 const char *outDir, int nThreads, parseCache cache, FILE *summary);
+
+#endif /* BATCH_H */
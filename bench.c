@@ -0,0 +1,172 @@
+#include "bench.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+uint64_t benchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+benchReport createBenchReport(const char *source, int runs) {
+    benchReport r = (benchReport)calloc(1, sizeof(BENCH_REPORT));
+    r->source = source;
+    r->runs   = runs;
+    return r;
+}
+
+int benchPhase(benchReport r, const char *name) {
+    for (int i = 0; i < r->nPhases; i++)
+        if (strcmp(r->phases[i].name, name) == 0)
+            return i;
+    if (r->nPhases == BENCH_MAX_PHASES)
+        return -1;
+    BenchPhase *p = &r->phases[r->nPhases];
+    p->name    = name;
+    p->samples = (uint64_t *)malloc((r->runs > 0 ? r->runs : 1) * sizeof(uint64_t));
+    p->count   = 0;
+    return r->nPhases++;
+}
+
+void benchRecord(benchReport r, int phase, uint64_t ns) {
+    if (phase < 0 || phase >= r->nPhases)
+        return;
+    BenchPhase *p = &r->phases[phase];
+    if (p->count < r->runs)
+        p->samples[p->count++] = ns;
+}
+
+/* ---- statistics ---- */
+
+typedef struct {
+    uint64_t min;
+    uint64_t median;
+    uint64_t p99;
+    uint64_t max;
+} PhaseStats;
+
+static int cmpU64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of a sorted sample */
+static uint64_t percentile(const uint64_t *s, int n, int pct) {
+    int rank = (pct * n + 99) / 100;
+    if (rank < 1)
+        rank = 1;
+    return s[rank - 1];
+}
+
+static PhaseStats phaseStats(const BenchPhase *p) {
+    PhaseStats st = { 0, 0, 0, 0 };
+    if (p->count == 0)
+        return st;
+    uint64_t *s = (uint64_t *)malloc(p->count * sizeof(uint64_t));
+    memcpy(s, p->samples, p->count * sizeof(uint64_t));
+    qsort(s, p->count, sizeof(uint64_t), cmpU64);
+    st.min    = s[0];
+    st.median = percentile(s, p->count, 50);
+    st.p99    = percentile(s, p->count, 99);
+    st.max    = s[p->count - 1];
+    free(s);
+    return st;
+}
+
+uint64_t benchMedian(benchReport r, int phase) {
+    if (phase < 0 || phase >= r->nPhases)
+        return 0;
+    return phaseStats(&r->phases[phase]).median;
+}
+
+/* Units per second at the median time (0 if it is too short to measure) */
+static double perSecond(double units, uint64_t ns) {
+    return (ns > 0) ? units * 1e9 / (double)ns : 0.0;
+}
+
+static void printJsonString(const char *s, FILE *out) {
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(out, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(out, "\\u%04x", (unsigned char)*s);
+        else
+            fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+void printBenchReport(benchReport r, bool json, FILE *out) {
+    if (json) {
+        fprintf(out, "{\"source\": ");
+        printJsonString(r->source, out);
+        fprintf(out, ", \"bytes\": %zu, \"tokens\": %ld, \"runs\": %d, \"phases\": [",
+                r->bytes, r->tokens, r->runs);
+        for (int i = 0; i < r->nPhases; i++) {
+            PhaseStats st = phaseStats(&r->phases[i]);
+            fprintf(out, "%s\n  {\"name\": ", i ? "," : "");
+            printJsonString(r->phases[i].name, out);
+            fprintf(out, ", \"min_ns\": %llu, \"median_ns\": %llu, \"p99_ns\": %llu, "
+                         "\"bytes_per_sec\": %.0f, \"tokens_per_sec\": %.0f}",
+                    (unsigned long long)st.min, (unsigned long long)st.median,
+                    (unsigned long long)st.p99,
+                    perSecond((double)r->bytes, st.median),
+                    perSecond((double)r->tokens, st.median));
+        }
+        fprintf(out, "\n]}\n");
+        return;
+    }
+
+    fprintf(out, "%s: %zu bytes, %ld tokens, %d run(s)\n",
+            r->source, r->bytes, r->tokens, r->runs);
+    fprintf(out, "%-10s %12s %12s %12s %10s %12s\n",
+            "phase", "min ms", "median ms", "p99 ms", "MB/s", "tokens/s");
+    for (int i = 0; i < r->nPhases; i++) {
+        PhaseStats st = phaseStats(&r->phases[i]);
+        fprintf(out, "%-10s %12.3f %12.3f %12.3f %10.1f %12.0f\n",
+                r->phases[i].name,
+                st.min / 1e6, st.median / 1e6, st.p99 / 1e6,
+                perSecond((double)r->bytes, st.median) / 1e6,
+                perSecond((double)r->tokens, st.median));
+    }
+}
+
+void printLatencyReport(benchReport r, bool json, FILE *out) {
+    if (json) {
+        fprintf(out, "{\"source\": ");
+        printJsonString(r->source, out);
+        fprintf(out, ", \"phases\": [");
+        for (int i = 0; i < r->nPhases; i++) {
+            PhaseStats st = phaseStats(&r->phases[i]);
+            fprintf(out, "%s\n  {\"name\": ", i ? "," : "");
+            printJsonString(r->phases[i].name, out);
+            fprintf(out, ", \"count\": %d, \"min_ns\": %llu, \"median_ns\": %llu, "
+                         "\"p99_ns\": %llu, \"max_ns\": %llu}",
+                    r->phases[i].count, (unsigned long long)st.min,
+                    (unsigned long long)st.median, (unsigned long long)st.p99,
+                    (unsigned long long)st.max);
+        }
+        fprintf(out, "\n]}\n");
+        return;
+    }
+
+    fprintf(out, "%s: latency\n", r->source);
+    fprintf(out, "%-10s %8s %12s %12s %12s %12s\n",
+            "phase", "count", "min ms", "median ms", "p99 ms", "max ms");
+    for (int i = 0; i < r->nPhases; i++) {
+        PhaseStats st = phaseStats(&r->phases[i]);
+        fprintf(out, "%-10s %8d %12.3f %12.3f %12.3f %12.3f\n",
+                r->phases[i].name, r->phases[i].count,
+                st.min / 1e6, st.median / 1e6, st.p99 / 1e6, st.max / 1e6);
+    }
+}
+
+void freeBenchReport(benchReport r) {
+    if (r == NULL)
+        return;
+    for (int i = 0; i < r->nPhases; i++)
+        free(r->phases[i].samples);
+    free(r);
+}
@@ -0,0 +1,60 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Per-phase timing over repeated runs.  Each phase keeps one sample
+ * per run; the report gives min / median / p99 and throughput, the
+ * latter from the median against the input's size and token count.
+ */
+#define BENCH_MAX_PHASES 8
+
+typedef struct {
+    const char *name;
+    uint64_t   *samples;    /* nanoseconds, one per run */
+    int         count;
+} BenchPhase;
+
+typedef struct BENCH_REPORT {
+    const char *source;
+    size_t      bytes;      /* input size */
+    long        tokens;     /* tokens in the input, DOLLAR excluded */
+    int         runs;
+    int         nPhases;
+    BenchPhase  phases[BENCH_MAX_PHASES];
+} BENCH_REPORT;
+
+typedef BENCH_REPORT *benchReport;
+
+/* Monotonic clock in nanoseconds */
+uint64_t benchNow(void);
+
+/* Empty report for 'runs' repetitions over 'source' */
+benchReport createBenchReport(const char *source, int runs);
+
+/* Index of phase 'name', added on first use (in report order) */
+int benchPhase(benchReport r, const char *name);
+
+/* Record one run of a phase */
+void benchRecord(benchReport r, int phase, uint64_t ns);
+
+/* Median of a phase's samples in nanoseconds (0 if it has none) */
+uint64_t benchMedian(benchReport r, int phase);
+
+/* Table of every phase, or one JSON object when 'json' is set */
+void printBenchReport(benchReport r, bool json, FILE *out);
+
+/*
+ * The same for samples that are latencies of separate events rather
+ * than runs over one input: count and min / median / p99 / max per
+ * phase, with no size or throughput.
+ */
+void printLatencyReport(benchReport r, bool json, FILE *out);
+
+void freeBenchReport(benchReport r);
+
+#endif /* BENCH_H */
@@ -0,0 +1,298 @@
+/*
+ * benchsuite — throughput check on generated corpora (`make bench`).
+ *
+ *     ./benchsuite [--sizes=64K,1M,16M] [--runs=N] [--errors=RATE]
+ *                  [--threshold=PCT] [--baseline=FILE] [--dir=DIR] [--update]
+ *
+ * For every size a valid program is generated with srcgen's generator,
+ * and for the largest size a second one with errors injected at RATE
+ * (default 0.002) so that recovery is measured too.  Each corpus is
+ * lexed, parsed and printed (to /dev/null) N times (default 5) with the
+ * tables loaded once; the median of each phase gives its MB/s.
+ *
+ * Results go to DIR/results.json (default bench_corpus/, which also
+ * holds the corpora).  They are compared with the baseline (default
+ * bench_baseline.json): any phase more than PCT percent (default 10)
+ * slower is flagged and the exit status is 1.  If there is no baseline,
+ * or with --update, the results become the new baseline.
+ */
+#include "bench.h"
+#include "compilerCtx.h"
+#include "grammarTable.h"
+#include "progGen.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define MAX_CORPORA  16
+#define MAX_RESULTS  (MAX_CORPORA * 3)
+
+typedef struct {
+    char     name[64];
+    uint64_t size;
+    double   errorRate;
+} Corpus;
+
+typedef struct {
+    char     corpus[64];
+    char     phase[16];
+    uint64_t bytes;
+    uint64_t medianNs;
+    double   mbPerSec;
+} BenchResult;
+
+static const char *const phaseNames[3] = { "lex", "parse", "print" };
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [--sizes=LIST] [--runs=N] [--errors=RATE] [--threshold=PCT]\n"
+                    "       %*s [--baseline=FILE] [--dir=DIR] [--update]\n",
+            prog, (int)strlen(prog), "");
+}
+
+static bool writeCorpus(const Grammar *g, const Corpus *c, const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) { perror(path); return false; }
+    GenOptions opt = { .size = c->size, .seed = 1, .errorRate = c->errorRate, .maxDepth = 0 };
+    generateProgram(g, &opt, fp);
+    bool ok = !ferror(fp);
+    return fclose(fp) == 0 && ok;
+}
+
+/* Time lex / parse / print of one corpus; appends three results */
+static bool runCorpus(const grammarTables T, const Corpus *c, const char *path, int runs,
+                      BenchResult *out, int *nOut) {
+    FILE *src  = fopen(path, "r");
+    FILE *sink = fopen("/dev/null", "w");
+    if (src == NULL || sink == NULL) {
+        perror(src == NULL ? path : "/dev/null");
+        if (src)  fclose(src);
+        if (sink) fclose(sink);
+        return false;
+    }
+
+    benchReport r = createBenchReport(c->name, runs);
+    fseek(src, 0, SEEK_END);
+    r->bytes = (size_t)ftell(src);
+    int ph[3];
+    for (int i = 0; i < 3; i++)
+        ph[i] = benchPhase(r, phaseNames[i]);
+
+    compilerCtx ctx = createCompilerCtx(T->g, T->pt, sink);
+    for (int run = 0; run < runs; run++) {
+        rewind(src);
+        resetCompilerCtx(ctx);
+
+        uint64_t t0 = benchNow();
+        compileTokenize(ctx, src);
+        uint64_t t1 = benchNow();
+        compileParse(ctx);
+        uint64_t t2 = benchNow();
+        compileWriteTree(ctx);
+        fflush(sink);
+        uint64_t t3 = benchNow();
+
+        benchRecord(r, ph[0], t1 - t0);
+        benchRecord(r, ph[1], t2 - t1);
+        benchRecord(r, ph[2], t3 - t2);
+    }
+    freeCompilerCtx(ctx);
+
+    for (int i = 0; i < 3; i++) {
+        BenchResult *b = &out[(*nOut)++];
+        snprintf(b->corpus, sizeof b->corpus, "%s", c->name);
+        snprintf(b->phase, sizeof b->phase, "%s", phaseNames[i]);
+        b->bytes    = r->bytes;
+        b->medianNs = benchMedian(r, ph[i]);
+        b->mbPerSec = b->medianNs ? (double)r->bytes * 1e3 / (double)b->medianNs : 0.0;
+    }
+
+    freeBenchReport(r);
+    fclose(sink);
+    fclose(src);
+    return true;
+}
+
+static bool writeResults(const char *path, const BenchResult *res, int n, double threshold) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) { perror(path); return false; }
+    fprintf(fp, "{\n  \"threshold_pct\": %.1f,\n  \"results\": [\n", threshold);
+    for (int i = 0; i < n; i++)
+        fprintf(fp, "    { \"corpus\": \"%s\", \"phase\": \"%s\", \"bytes\": %llu, "
+                    "\"median_ns\": %llu, \"mb_per_s\": %.3f }%s\n",
+                res[i].corpus, res[i].phase, (unsigned long long)res[i].bytes,
+                (unsigned long long)res[i].medianNs, res[i].mbPerSec, i + 1 < n ? "," : "");
+    fprintf(fp, "  ]\n}\n");
+    return fclose(fp) == 0;
+}
+
+/*
+ * Read a file written by writeResults (one result per line).  Returns
+ * the number of results, or -1 if the file does not exist.
+ */
+static int readResults(const char *path, BenchResult *res, int cap) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return -1;
+    char line[512];
+    int  n = 0;
+    while (n < cap && fgets(line, sizeof line, fp)) {
+        BenchResult      *b = &res[n];
+        unsigned long long bytes, ns;
+        if (sscanf(line, " { \"corpus\": \"%63[^\"]\", \"phase\": \"%15[^\"]\", \"bytes\": %llu, "
+                         "\"median_ns\": %llu, \"mb_per_s\": %lf",
+                   b->corpus, b->phase, &bytes, &ns, &b->mbPerSec) == 5) {
+            b->bytes    = bytes;
+            b->medianNs = ns;
+            n++;
+        }
+    }
+    fclose(fp);
+    return n;
+}
+
+/* Print current against baseline; returns the number of regressions */
+static int compareResults(const BenchResult *cur, int n, const BenchResult *base, int nBase,
+                          double threshold) {
+    int regressions = 0;
+    printf("%-16s %-6s %14s %14s %9s\n", "corpus", "phase", "baseline MB/s", "current MB/s",
+           "change");
+    for (int i = 0; i < n; i++) {
+        const BenchResult *b = NULL;
+        for (int j = 0; j < nBase && b == NULL; j++)
+            if (strcmp(base[j].corpus, cur[i].corpus) == 0 &&
+                strcmp(base[j].phase, cur[i].phase) == 0)
+                b = &base[j];
+
+        if (b == NULL || b->mbPerSec <= 0) {
+            printf("%-16s %-6s %14s %14.1f %9s\n", cur[i].corpus, cur[i].phase, "-",
+                   cur[i].mbPerSec, "new");
+            continue;
+        }
+        double change = (cur[i].mbPerSec - b->mbPerSec) * 100.0 / b->mbPerSec;
+        bool   slower = change < -threshold;
+        printf("%-16s %-6s %14.1f %14.1f %+8.1f%%%s\n", cur[i].corpus, cur[i].phase,
+               b->mbPerSec, cur[i].mbPerSec, change, slower ? "  REGRESSION" : "");
+        regressions += slower;
+    }
+    return regressions;
+}
+
+int main(int argc, char *argv[]) {
+    const char *sizes     = "64K,1M,16M";
+    const char *baseline  = "bench_baseline.json";
+    const char *dir       = "bench_corpus";
+    double      errorRate = 0.002;
+    double      threshold = 10.0;
+    int         runs      = 5;
+    bool        update    = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a   = argv[i];
+        char       *end = NULL;
+        if (strncmp(a, "--sizes=", 8) == 0)
+            sizes = a + 8;
+        else if (strncmp(a, "--baseline=", 11) == 0)
+            baseline = a + 11;
+        else if (strncmp(a, "--dir=", 6) == 0)
+            dir = a + 6;
+        else if (strcmp(a, "--update") == 0)
+            update = true;
+        else if (strncmp(a, "--runs=", 7) == 0 &&
+                 (runs = (int)strtol(a + 7, &end, 10)) >= 1 && *end == '\0')
+            ;
+        else if (strncmp(a, "--errors=", 9) == 0 &&
+                 (errorRate = strtod(a + 9, &end)) >= 0 && errorRate <= 1 && *end == '\0')
+            ;
+        else if (strncmp(a, "--threshold=", 12) == 0 &&
+                 (threshold = strtod(a + 12, &end)) >= 0 && *end == '\0')
+            ;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    /* ---- corpora ---- */
+    Corpus   corpora[MAX_CORPORA];
+    int      nCorpora = 0;
+    uint64_t largest  = 0;
+    char    *largestName = NULL;
+    char     list[256];
+    snprintf(list, sizeof list, "%s", sizes);
+    for (char *tok = strtok(list, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        uint64_t size = parseSize(tok);
+        if (size == 0 || nCorpora == MAX_CORPORA - 1) {
+            fprintf(stderr, "%s: bad size list '%s'\n", argv[0], sizes);
+            return 1;
+        }
+        Corpus *c = &corpora[nCorpora++];
+        snprintf(c->name, sizeof c->name, "valid-%s", tok);
+        c->size      = size;
+        c->errorRate = 0;
+        if (size > largest) {
+            largest     = size;
+            largestName = tok;
+        }
+    }
+    if (nCorpora == 0) { usage(argv[0]); return 1; }
+    if (errorRate > 0) {
+        Corpus *c = &corpora[nCorpora++];
+        snprintf(c->name, sizeof c->name, "errors-%s", largestName);
+        c->size      = largest;
+        c->errorRate = errorRate;
+    }
+
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        perror(dir);
+        return 1;
+    }
+
+    diagBuffer    gdiag = createDiagBuffer();
+    grammarTables T     = loadGrammarTables(GRAMMAR_FILE, GRAMMAR_BLOB, gdiag);
+    diagFlush(gdiag, stderr);
+    freeDiagBuffer(gdiag);
+    if (T == NULL)
+        return 1;
+
+    /* ---- measure ---- */
+    BenchResult results[MAX_RESULTS];
+    int         nResults = 0;
+    int         status   = 0;
+    for (int i = 0; i < nCorpora && status == 0; i++) {
+        Corpus *c = &corpora[i];
+        char    path[512];
+        snprintf(path, sizeof path, "%s/%s.txt", dir, c->name);
+        fprintf(stderr, "%s ...\n", c->name);
+        if (!writeCorpus(T->g, c, path) || !runCorpus(T, c, path, runs, results, &nResults))
+            status = 1;
+    }
+    freeGrammarTables(T);
+    if (status != 0)
+        return status;
+
+    char resultsPath[512];
+    snprintf(resultsPath, sizeof resultsPath, "%s/results.json", dir);
+    if (!writeResults(resultsPath, results, nResults, threshold))
+        return 1;
+
+    /* ---- compare ---- */
+    BenchResult base[MAX_RESULTS];
+    int         nBase = update ? -1 : readResults(baseline, base, MAX_RESULTS);
+    if (nBase < 0) {
+        compareResults(results, nResults, NULL, 0, threshold);
+        if (!writeResults(baseline, results, nResults, threshold))
+            return 1;
+        printf("Baseline recorded in %s\n", baseline);
+        return 0;
+    }
+
+    int regressions = compareResults(results, nResults, base, nBase, threshold);
+    if (regressions > 0) {
+        printf("%d phase(s) more than %.1f%% slower than %s\n", regressions, threshold,
+               baseline);
+        return 1;
+    }
+    printf("No regressions beyond %.1f%% (baseline %s)\n", threshold, baseline);
+    return 0;
+}
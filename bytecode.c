@@ -0,0 +1,979 @@
+#include "bytecode.h"
+#include "fileIO.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char *BC_OP_NAMES[BC_OP_COUNT] = {
+    [BC_LOADK] = "loadk",     [BC_MOV] = "mov",
+    [BC_ADDI] = "addi",       [BC_SUBI] = "subi",       [BC_MULI] = "muli",
+    [BC_DIVI] = "divi",       [BC_ADDR] = "addr",       [BC_SUBR] = "subr",
+    [BC_MULR] = "mulr",       [BC_DIVR] = "divr",
+    [BC_LTI] = "lti",         [BC_LEI] = "lei",         [BC_EQI] = "eqi",
+    [BC_GTI] = "gti",         [BC_GEI] = "gei",         [BC_NEI] = "nei",
+    [BC_LTR] = "ltr",         [BC_LER] = "ler",         [BC_EQR] = "eqr",
+    [BC_GTR] = "gtr",         [BC_GER] = "ger",         [BC_NER] = "ner",
+    [BC_AND] = "and",         [BC_OR] = "or",           [BC_NOT] = "not",
+    [BC_ITOR] = "itor",       [BC_RTOI] = "rtoi",
+    [BC_GLOADI] = "gloadi",   [BC_GLOADR] = "gloadr",
+    [BC_GSTOREI] = "gstorei", [BC_GSTORER] = "gstorer",
+    [BC_READI] = "readi",     [BC_READR] = "readr",
+    [BC_WRITEI] = "writei",   [BC_WRITER] = "writer",
+    [BC_JMP] = "jmp",         [BC_JT] = "jt",           [BC_JF] = "jf",
+    [BC_CALL] = "call",       [BC_RET] = "ret",
+};
+
+/* Operand words of the fixed-length opcodes (CALL and RET count theirs) */
+static const uint8_t BC_OPERANDS[BC_OP_COUNT] = {
+    [BC_LOADK] = 2,   [BC_MOV] = 2,
+    [BC_ADDI] = 3,    [BC_SUBI] = 3,    [BC_MULI] = 3,    [BC_DIVI] = 3,
+    [BC_ADDR] = 3,    [BC_SUBR] = 3,    [BC_MULR] = 3,    [BC_DIVR] = 3,
+    [BC_LTI] = 3,     [BC_LEI] = 3,     [BC_EQI] = 3,     [BC_GTI] = 3,
+    [BC_GEI] = 3,     [BC_NEI] = 3,     [BC_LTR] = 3,     [BC_LER] = 3,
+    [BC_EQR] = 3,     [BC_GTR] = 3,     [BC_GER] = 3,     [BC_NER] = 3,
+    [BC_AND] = 3,     [BC_OR] = 3,      [BC_NOT] = 2,
+    [BC_ITOR] = 2,    [BC_RTOI] = 2,
+    [BC_GLOADI] = 2,  [BC_GLOADR] = 2,  [BC_GSTOREI] = 2, [BC_GSTORER] = 2,
+    [BC_READI] = 1,   [BC_READR] = 1,   [BC_WRITEI] = 1,  [BC_WRITER] = 1,
+    [BC_JMP] = 1,     [BC_JT] = 2,      [BC_JF] = 2,
+};
+
+const char *bcOpName(BC_OP op) {
+    return (op < BC_OP_COUNT) ? BC_OP_NAMES[op] : "?";
+}
+
+uint32_t bcInstLength(const uint32_t *code, uint32_t pc) {
+    switch (code[pc]) {
+    case BC_CALL: {
+        uint32_t n = code[pc + 2];
+        return 4 + n + code[pc + 3 + n];
+    }
+    case BC_RET:
+        return 2 + code[pc + 1];
+    default:
+        return 1 + BC_OPERANDS[code[pc]];
+    }
+}
+
+int bcLineAt(const BC_MODULE *b, uint32_t pc) {
+    uint32_t lo = 0, hi = b->nLines;    /* first entry past pc */
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (b->lines[mid].offset <= pc)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo > 0 ? b->lines[lo - 1].line : 0;
+}
+
+void freeBcModule(bcModule b) {
+    if (b == NULL)
+        return;
+    if (b->map != NULL) {
+        munmap(b->map, b->mapLen);
+    } else {
+        free(b->code);
+        free(b->consts);
+        free(b->funcs);
+        free(b->lines);
+        free(b->records);
+        free(b->fields);
+        free(b->names);
+    }
+    free(b);
+}
+
+size_t bcModuleBytes(const BC_MODULE *b) {
+    return sizeof(BC_MODULE) + (size_t)b->nCode * sizeof(uint32_t) +
+           (size_t)b->nConsts * sizeof(BC_VALUE) + (size_t)b->nFuncs * sizeof(BC_FUNC) +
+           (size_t)b->nLines * sizeof(BC_LINE) + (size_t)b->nRecords * sizeof(BC_RECORD) +
+           (size_t)b->nFields * sizeof(BC_FIELD) + b->namesLen;
+}
+
+/* ---- compiling ---- */
+
+/* A jump operand to fill in once blocks have offsets: a block, or stub -1 - i */
+typedef struct {
+    uint32_t at;
+    int32_t  target;
+} Fixup;
+
+/* An edge out of a conditional branch that needs phi copies of its own */
+typedef struct {
+    int32_t from;
+    int32_t to;
+    int32_t at;
+} Stub;
+
+typedef struct {
+    bcModule         b;
+    const IR_MODULE *m;
+    uint32_t         capCode;
+    uint32_t         capConsts;
+    uint32_t         capLines;
+    uint32_t         capNames;
+    uint32_t        *constSlots;    /* pool index + 1 by hash of the bits, 0 if empty */
+    uint32_t         constMask;
+
+    /* per function */
+    int32_t *reg;           /* per instruction */
+    int32_t *results;       /* first IR_RESULT of a call, then next result of the same call */
+    int32_t *nextResult;
+    int      capInsts;
+    int32_t *blockAt;       /* per block: code offset */
+    int32_t *order;
+    int32_t *stack;
+    uint8_t *placed;
+    int      capBlocks;
+    Fixup   *fixups;
+    int      nFixups;
+    int      capFixups;
+    Stub    *stubs;
+    int      nStubs;
+    int      capStubs;
+    int32_t *dst;           /* a parallel copy */
+    int32_t *src;
+    int      capCopies;
+    int      temp;          /* registers for breaking copy cycles and for unread results */
+    int      discard;
+} Compiler;
+
+static void emit(Compiler *c, uint32_t w) {
+    bcModule b = c->b;
+    if (b->nCode == c->capCode) {
+        c->capCode = c->capCode ? 2 * c->capCode : 1024;
+        b->code    = (uint32_t *)realloc(b->code, c->capCode * sizeof(uint32_t));
+    }
+    b->code[b->nCode++] = w;
+}
+
+static void emit2(Compiler *c, BC_OP op, uint32_t x) {
+    emit(c, op);
+    emit(c, x);
+}
+
+static void emit3(Compiler *c, BC_OP op, uint32_t x, uint32_t y) {
+    emit2(c, op, x);
+    emit(c, y);
+}
+
+static void emit4(Compiler *c, BC_OP op, uint32_t x, uint32_t y, uint32_t z) {
+    emit3(c, op, x, y);
+    emit(c, z);
+}
+
+static void markLine(Compiler *c, int line) {
+    bcModule b = c->b;
+    if (b->nLines > 0 && b->lines[b->nLines - 1].line == line)
+        return;
+    if (b->nLines > 0 && b->lines[b->nLines - 1].offset == b->nCode) {
+        b->lines[b->nLines - 1].line = line;    /* nothing emitted under the last one */
+        return;
+    }
+    if (b->nLines == c->capLines) {
+        c->capLines = c->capLines ? 2 * c->capLines : 256;
+        b->lines    = (BC_LINE *)realloc(b->lines, c->capLines * sizeof(BC_LINE));
+    }
+    b->lines[b->nLines++] = (BC_LINE){ b->nCode, line };
+}
+
+static uint32_t hashBits(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return (uint32_t)x;
+}
+
+/* Pool index of a constant, added on first use (equal bits, one entry) */
+static uint32_t constIndex(Compiler *c, BC_VALUE v) {
+    bcModule b = c->b;
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof bits);
+
+    if (2 * (b->nConsts + 1) > c->constMask) {
+        uint32_t  mask  = c->constMask ? 2 * c->constMask + 1 : 255;
+        uint32_t *slots = (uint32_t *)calloc(mask + 1, sizeof(uint32_t));
+        for (uint32_t k = 0; k < b->nConsts; k++) {
+            uint64_t kb;
+            memcpy(&kb, &b->consts[k], sizeof kb);
+            uint32_t h = hashBits(kb) & mask;
+            while (slots[h] != 0)
+                h = (h + 1) & mask;
+            slots[h] = k + 1;
+        }
+        free(c->constSlots);
+        c->constSlots = slots;
+        c->constMask  = mask;
+    }
+    uint32_t h = hashBits(bits) & c->constMask;
+    for (; c->constSlots[h] != 0; h = (h + 1) & c->constMask) {
+        uint64_t kb;
+        memcpy(&kb, &b->consts[c->constSlots[h] - 1], sizeof kb);
+        if (kb == bits)
+            return c->constSlots[h] - 1;
+    }
+    if (b->nConsts == c->capConsts) {
+        c->capConsts = c->capConsts ? 2 * c->capConsts : 64;
+        b->consts    = (BC_VALUE *)realloc(b->consts, c->capConsts * sizeof(BC_VALUE));
+    }
+    b->consts[b->nConsts] = v;
+    c->constSlots[h]      = b->nConsts + 1;
+    return b->nConsts++;
+}
+
+static void addFixup(Compiler *c, int32_t target) {
+    if (c->nFixups == c->capFixups) {
+        c->capFixups = c->capFixups ? 2 * c->capFixups : 64;
+        c->fixups    = (Fixup *)realloc(c->fixups, c->capFixups * sizeof(Fixup));
+    }
+    c->fixups[c->nFixups++] = (Fixup){ c->b->nCode, target };
+    emit(c, 0);
+}
+
+static void emitJump(Compiler *c, BC_OP op, int cond, int32_t target) {
+    emit(c, op);
+    if (op != BC_JMP)
+        emit(c, (uint32_t)c->reg[cond]);
+    addFixup(c, target);
+}
+
+/* Copies the phis of 's' need on the edge from 'p'; those to themselves left out */
+static int edgeCopies(Compiler *c, const IR_FUNC *f, int p, int s) {
+    const IR_BLOCK *sb   = &f->blocks[s];
+    int             slot = (sb->pred[0] == p) ? 0 : 1;
+    int             n    = 0;
+
+    for (int v = sb->first; v >= 0; v = f->insts[v].next) {
+        const IR_INST *in = &f->insts[v];
+        if (in->op == IR_CONST || in->op == IR_UNDEF || in->op == IR_NOP)
+            continue;
+        if (in->op != IR_PHI)
+            break;
+        int from = c->reg[slot ? in->b : in->a];
+        if (from == c->reg[v])
+            continue;
+        if (n == c->capCopies) {
+            c->capCopies = c->capCopies ? 2 * c->capCopies : 16;
+            c->dst       = (int32_t *)realloc(c->dst, c->capCopies * sizeof(int32_t));
+            c->src       = (int32_t *)realloc(c->src, c->capCopies * sizeof(int32_t));
+        }
+        c->dst[n]   = c->reg[v];
+        c->src[n++] = from;
+    }
+    return n;
+}
+
+/* The n copies in dst / src as moves that give the same result as doing them all at once */
+static void emitCopies(Compiler *c, int n) {
+    while (n > 0) {
+        bool moved = false;
+        for (int i = 0; i < n; i++) {
+            bool read = false;
+            for (int j = 0; j < n && !read; j++)
+                read = (j != i && c->src[j] == c->dst[i]);
+            if (read)
+                continue;
+            emit3(c, BC_MOV, c->dst[i], c->src[i]);
+            c->dst[i] = c->dst[--n];
+            c->src[i] = c->src[n];
+            moved     = true;
+            i--;
+        }
+        if (moved || n == 0)
+            continue;
+        /* a cycle: keep one destination's old value aside */
+        emit3(c, BC_MOV, c->temp, c->dst[0]);
+        for (int j = 0; j < n; j++)
+            if (c->src[j] == c->dst[0])
+                c->src[j] = c->temp;
+    }
+}
+
+/* Jump target for edge p -> s: the block, or a stub when the edge carries copies */
+static int32_t edgeTarget(Compiler *c, const IR_FUNC *f, int p, int s) {
+    if (edgeCopies(c, f, p, s) == 0)
+        return s;
+    if (c->nStubs == c->capStubs) {
+        c->capStubs = c->capStubs ? 2 * c->capStubs : 16;
+        c->stubs    = (Stub *)realloc(c->stubs, c->capStubs * sizeof(Stub));
+    }
+    c->stubs[c->nStubs] = (Stub){ p, s, -1 };
+    return -1 - c->nStubs++;
+}
+
+static void reserveFunc(Compiler *c, const IR_FUNC *f) {
+    if (f->nInsts > c->capInsts) {
+        c->capInsts   = 2 * f->nInsts;
+        c->reg        = (int32_t *)realloc(c->reg, c->capInsts * sizeof(int32_t));
+        c->results    = (int32_t *)realloc(c->results, c->capInsts * sizeof(int32_t));
+        c->nextResult = (int32_t *)realloc(c->nextResult, c->capInsts * sizeof(int32_t));
+    }
+    if (f->nBlocks > c->capBlocks) {
+        c->capBlocks = 2 * f->nBlocks;
+        c->blockAt   = (int32_t *)realloc(c->blockAt, c->capBlocks * sizeof(int32_t));
+        c->order     = (int32_t *)realloc(c->order, c->capBlocks * sizeof(int32_t));
+        c->stack     = (int32_t *)realloc(c->stack, 2 * c->capBlocks * sizeof(int32_t));
+        c->placed    = (uint8_t *)realloc(c->placed, c->capBlocks);
+    }
+}
+
+/* Registers: input leaves first, then one per value, then the two scratch ones */
+static int assignRegisters(Compiler *c, const IR_FUNC *f) {
+    int n = f->nParams;
+    for (int v = 0; v < f->nInsts; v++) {
+        const IR_INST *in = &f->insts[v];
+        c->results[v]     = -1;
+        if (in->op == IR_PARAM)
+            c->reg[v] = (int32_t)in->imm.i;
+        else if (in->op != IR_NOP && in->type != IR_VOID)
+            c->reg[v] = n++;
+        else
+            c->reg[v] = -1;
+    }
+    for (int v = f->nInsts - 1; v >= 0; v--) {
+        if (f->insts[v].op == IR_RESULT) {
+            c->nextResult[v]          = c->results[f->insts[v].a];
+            c->results[f->insts[v].a] = v;
+        }
+    }
+    c->temp    = n++;
+    c->discard = n++;
+    return n;
+}
+
+/* Reachable blocks, each conditional's first successor right after it where possible */
+static int layoutBlocks(Compiler *c, const IR_FUNC *f) {
+    int n = 0, sp = 0;
+    memset(c->placed, 0, f->nBlocks);
+    c->stack[sp++] = 0;
+    while (sp > 0) {
+        int b = c->stack[--sp];
+        if (c->placed[b])
+            continue;
+        c->placed[b]  = 1;
+        c->order[n++] = b;
+        const IR_BLOCK *bb = &f->blocks[b];
+        for (int i = bb->nSuccs - 1; i >= 0; i--)
+            if (!c->placed[bb->succ[i]])
+                c->stack[sp++] = bb->succ[i];
+    }
+    return n;
+}
+
+static void compileInst(Compiler *c, const IR_FUNC *f, int v, int next) {
+    const IR_INST  *in = &f->insts[v];
+    const IR_BLOCK *bb = &f->blocks[in->block];
+    int             d  = c->reg[v];
+    bool            real;
+
+    switch (in->op) {
+    case IR_CONST: {
+        BC_VALUE k;
+        if (in->type == IR_REAL)
+            k.r = in->imm.r;
+        else
+            k.i = in->imm.i;
+        emit3(c, BC_LOADK, d, constIndex(c, k));
+        break;
+    }
+    case IR_UNDEF:
+        emit3(c, BC_LOADK, d, constIndex(c, (BC_VALUE){ .i = 0 }));
+        break;
+    case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV:
+        emit4(c, (BC_OP)((in->type == IR_REAL ? BC_ADDR : BC_ADDI) + (in->op - IR_ADD)), d,
+              c->reg[in->a], c->reg[in->b]);
+        break;
+    case IR_LT: case IR_LE: case IR_EQ: case IR_GT: case IR_GE: case IR_NE:
+        real = f->insts[in->a].type == IR_REAL;
+        emit4(c, (BC_OP)((real ? BC_LTR : BC_LTI) + (in->op - IR_LT)), d, c->reg[in->a],
+              c->reg[in->b]);
+        break;
+    case IR_AND:
+        emit4(c, BC_AND, d, c->reg[in->a], c->reg[in->b]);
+        break;
+    case IR_OR:
+        emit4(c, BC_OR, d, c->reg[in->a], c->reg[in->b]);
+        break;
+    case IR_NOT:
+        emit3(c, BC_NOT, d, c->reg[in->a]);
+        break;
+    case IR_ITOR:
+        emit3(c, BC_ITOR, d, c->reg[in->a]);
+        break;
+    case IR_RTOI:
+        emit3(c, BC_RTOI, d, c->reg[in->a]);
+        break;
+    case IR_GLOAD:
+        emit3(c, in->type == IR_REAL ? BC_GLOADR : BC_GLOADI, d, (uint32_t)in->imm.i);
+        break;
+    case IR_GSTORE:
+        real = f->insts[in->a].type == IR_REAL;
+        emit3(c, real ? BC_GSTORER : BC_GSTOREI, c->reg[in->a], (uint32_t)in->imm.i);
+        break;
+    case IR_READ:
+        emit2(c, in->type == IR_REAL ? BC_READR : BC_READI, d);
+        break;
+    case IR_WRITE:
+        real = f->insts[in->a].type == IR_REAL;
+        emit2(c, real ? BC_WRITER : BC_WRITEI, c->reg[in->a]);
+        break;
+    case IR_CALL: {
+        int m = c->m->funcs[in->imm.i].nResults;
+        emit3(c, BC_CALL, (uint32_t)in->imm.i, in->b);
+        for (int i = 0; i < in->b; i++)
+            emit(c, c->reg[f->args[in->a + i]]);
+        emit(c, m);
+        for (int i = 0; i < m; i++) {
+            int r = c->results[v];
+            while (r >= 0 && f->insts[r].imm.i != i)
+                r = c->nextResult[r];
+            emit(c, r >= 0 ? c->reg[r] : c->discard);
+        }
+        break;
+    }
+    case IR_RET:
+        emit2(c, BC_RET, in->b);
+        for (int i = 0; i < in->b; i++)
+            emit(c, c->reg[f->args[in->a + i]]);
+        break;
+    case IR_BR:
+        emitCopies(c, edgeCopies(c, f, in->block, bb->succ[0]));
+        if (bb->succ[0] != next)
+            emitJump(c, BC_JMP, -1, bb->succ[0]);
+        break;
+    case IR_CBR: {
+        int32_t yes = edgeTarget(c, f, in->block, bb->succ[0]);
+        int32_t no  = edgeTarget(c, f, in->block, bb->succ[1]);
+        if (no == next) {
+            emitJump(c, BC_JT, in->a, yes);
+        } else if (yes == next) {
+            emitJump(c, BC_JF, in->a, no);
+        } else {
+            emitJump(c, BC_JT, in->a, yes);
+            emitJump(c, BC_JMP, -1, no);
+        }
+        break;
+    }
+    default:    /* phis are copies on the way in; params and results arrive in place */
+        break;
+    }
+}
+
+static void compileFunc(Compiler *c, const IR_FUNC *f, BC_FUNC *bf) {
+    bf->entry   = c->b->nCode;
+    bf->nRegs   = 0;
+    bf->codeLen = 0;
+    if (f->nBlocks == 0)
+        return;
+    reserveFunc(c, f);
+    bf->nRegs   = (uint32_t)assignRegisters(c, f);
+    c->nFixups  = 0;
+    c->nStubs   = 0;
+
+    int n = layoutBlocks(c, f);
+    for (int i = 0; i < n; i++) {
+        int b         = c->order[i];
+        int next      = (i + 1 < n) ? c->order[i + 1] : INT32_MAX;  /* never a target */
+        c->blockAt[b] = (int32_t)c->b->nCode;
+        for (int v = f->blocks[b].first; v >= 0; v = f->insts[v].next) {
+            markLine(c, f->insts[v].line);
+            compileInst(c, f, v, next);
+        }
+    }
+    for (int i = 0; i < c->nStubs; i++) {
+        Stub *s = &c->stubs[i];
+        s->at   = (int32_t)c->b->nCode;
+        emitCopies(c, edgeCopies(c, f, s->from, s->to));
+        emitJump(c, BC_JMP, -1, s->to);
+    }
+    for (int i = 0; i < c->nFixups; i++) {
+        int32_t t = c->fixups[i].target;
+        c->b->code[c->fixups[i].at] = (uint32_t)(t >= 0 ? c->blockAt[t] : c->stubs[-1 - t].at);
+    }
+    bf->codeLen = c->b->nCode - bf->entry;
+}
+
+static uint32_t addName(Compiler *c, const char *s) {
+    bcModule b   = c->b;
+    uint32_t len = (uint32_t)strlen(s) + 1;
+    if (b->namesLen + len > c->capNames) {
+        c->capNames = 2 * (b->namesLen + len) + 256;
+        b->names    = (char *)realloc(b->names, c->capNames);
+    }
+    memcpy(b->names + b->namesLen, s, len);
+    b->namesLen += len;
+    return b->namesLen - len;
+}
+
+/* Every record and union of the program, in type id order */
+static void addRecords(Compiler *c) {
+    const SYMBOL_TABLE *st = c->m->st;
+    bcModule            b  = c->b;
+    int                 n  = st->nTypes > 2 ? st->nTypes - 2 : 0;
+
+    b->records = (BC_RECORD *)calloc(n > 0 ? n : 1, sizeof(BC_RECORD));
+    b->fields  = (BC_FIELD *)calloc(st->nFields > 0 ? st->nFields : 1, sizeof(BC_FIELD));
+    for (int k = 0; k < n; k++) {
+        const TYPE_INFO *t = &st->types[k + 2];
+        BC_RECORD       *r = &b->records[b->nRecords++];
+        r->name       = addName(c, internText(st->names, t->name));
+        r->isUnion    = t->kind == TYPE_UNION;
+        r->size       = (uint32_t)t->size;
+        r->align      = (uint32_t)t->align;
+        r->firstField = b->nFields;
+        r->nFields    = (uint32_t)(t->nFields > 0 ? t->nFields : 0);
+        for (uint32_t i = 0; i < r->nFields; i++) {
+            const FIELD_INFO *fi = &st->fields[t->firstField + i];
+            b->fields[b->nFields++] = (BC_FIELD){ addName(c, internText(st->names, fi->name)),
+                                                  fi->type, (uint32_t)fi->offset };
+        }
+    }
+}
+
+/* ------------------------------------------------------------------
+ * compileBytecode
+ * ------------------------------------------------------------------ */
+bcModule compileBytecode(const IR_MODULE *m) {
+    Compiler c;
+    memset(&c, 0, sizeof c);
+    c.m = m;
+    c.b = (bcModule)calloc(1, sizeof(BC_MODULE));
+    c.b->nFuncs      = (uint32_t)m->nFuncs;
+    c.b->funcs       = (BC_FUNC *)calloc(m->nFuncs > 0 ? m->nFuncs : 1, sizeof(BC_FUNC));
+    c.b->globalBytes = (uint32_t)m->globalBytes;
+
+    for (int k = 0; k < m->nFuncs; k++) {
+        const IR_FUNC *f  = &m->funcs[k];
+        BC_FUNC       *bf = &c.b->funcs[k];
+        bf->name     = addName(&c, internText(m->st->names, f->name));
+        bf->nParams  = (uint32_t)f->nParams;
+        bf->nResults = (uint32_t)f->nResults;
+        compileFunc(&c, f, bf);
+    }
+    addRecords(&c);
+
+    free(c.constSlots);
+    free(c.reg);
+    free(c.results);
+    free(c.nextResult);
+    free(c.blockAt);
+    free(c.order);
+    free(c.stack);
+    free(c.placed);
+    free(c.fixups);
+    free(c.stubs);
+    free(c.dst);
+    free(c.src);
+    return c.b;
+}
+
+/* ---- listing ---- */
+
+static void printInst(const BC_MODULE *b, uint32_t pc, FILE *out) {
+    const uint32_t *w  = b->code + pc;
+    BC_OP           op = (BC_OP)w[0];
+
+    fprintf(out, "  %6u  %-8s", pc, bcOpName(op));
+    switch (op) {
+    case BC_LOADK: {
+        /* the pool keeps no types; an int is sign-extended, which a real's bits seldom are */
+        BC_VALUE k = b->consts[w[2]];
+        if (k.i == (int32_t)k.i)
+            fprintf(out, "r%u, k%u  (%lld)", w[1], w[2], (long long)k.i);
+        else
+            fprintf(out, "r%u, k%u  (%g)", w[1], w[2], k.r);
+        break;
+    }
+    case BC_GLOADI: case BC_GLOADR:
+        fprintf(out, "r%u, @%u", w[1], w[2]);
+        break;
+    case BC_GSTOREI: case BC_GSTORER:
+        fprintf(out, "@%u, r%u", w[2], w[1]);
+        break;
+    case BC_JMP:
+        fprintf(out, "%u", w[1]);
+        break;
+    case BC_JT: case BC_JF:
+        fprintf(out, "r%u, %u", w[1], w[2]);
+        break;
+    case BC_CALL: {
+        uint32_t n = w[2], m = w[3 + n];
+        fprintf(out, "%s (", b->names + b->funcs[w[1]].name);
+        for (uint32_t i = 0; i < n; i++)
+            fprintf(out, "%sr%u", i ? ", " : "", w[3 + i]);
+        fprintf(out, ") -> (");
+        for (uint32_t i = 0; i < m; i++)
+            fprintf(out, "%sr%u", i ? ", " : "", w[4 + n + i]);
+        fprintf(out, ")");
+        break;
+    }
+    case BC_RET:
+        for (uint32_t i = 0; i < w[1]; i++)
+            fprintf(out, "%sr%u", i ? ", " : "", w[2 + i]);
+        break;
+    default:
+        for (int i = 1; i <= BC_OPERANDS[op]; i++)
+            fprintf(out, "%sr%u", i > 1 ? ", " : "", w[i]);
+        break;
+    }
+    fprintf(out, "\n");
+}
+
+static const char *typeName(const BC_MODULE *b, int32_t type) {
+    if (type == TYPE_INT)
+        return "int";
+    if (type == TYPE_REAL)
+        return "real";
+    if (type >= 2 && (uint32_t)(type - 2) < b->nRecords)
+        return b->names + b->records[type - 2].name;
+    return "?";
+}
+
+void printBytecode(const BC_MODULE *b, FILE *out) {
+    fprintf(out, "code: %u words, %u constants, globals: %u bytes\n", b->nCode, b->nConsts,
+            b->globalBytes);
+    for (uint32_t k = 0; k < b->nRecords; k++) {
+        const BC_RECORD *r = &b->records[k];
+        fprintf(out, "%s %s  (%u bytes, align %u)\n", r->isUnion ? "union" : "record",
+                b->names + r->name, r->size, r->align);
+        for (uint32_t i = 0; i < r->nFields; i++) {
+            const BC_FIELD *fi = &b->fields[r->firstField + i];
+            fprintf(out, "  %6u  %s : %s\n", fi->offset, b->names + fi->name,
+                    typeName(b, fi->type));
+        }
+    }
+    for (uint32_t k = 0; k < b->nFuncs; k++) {
+        const BC_FUNC *f = &b->funcs[k];
+        fprintf(out, "function %s  (%u in, %u out, %u registers)\n", b->names + f->name,
+                f->nParams, f->nResults, f->nRegs);
+        for (uint32_t pc = f->entry; pc < f->entry + f->codeLen; pc += bcInstLength(b->code, pc))
+            printInst(b, pc, out);
+    }
+}
+
+/* ---- image ---- */
+
+static const char IMAGE_MAGIC[8] = { 'S', 'T', 'G', '1', 'C', 'O', 'D', 'E' };
+
+/* Largest register window a mapped function may ask the VM for */
+#define IMAGE_MAX_REGS (1u << 24)
+
+/* Bytes per element of each section */
+static const size_t SECTION_ELEM[BC_SEC_COUNT] = {
+    [BC_SEC_CODE]    = sizeof(uint32_t),
+    [BC_SEC_CONSTS]  = sizeof(BC_VALUE),
+    [BC_SEC_FUNCS]   = sizeof(BC_FUNC),
+    [BC_SEC_LINES]   = sizeof(BC_LINE),
+    [BC_SEC_RECORDS] = sizeof(BC_RECORD),
+    [BC_SEC_FIELDS]  = sizeof(BC_FIELD),
+    [BC_SEC_NAMES]   = 1,
+};
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/*
+ * Covers the opcode numbering (by name), the size of every struct in
+ * an image and, through the bytes of a known word, the byte order.
+ */
+uint64_t bcImageLayoutHash(void) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int op = 0; op < BC_OP_COUNT; op++)
+        h = fnv1a(h, BC_OP_NAMES[op], strlen(BC_OP_NAMES[op]) + 1);
+
+    uint64_t layout[] = { BC_IMAGE_VERSION, BC_OP_COUNT, sizeof(BC_IMAGE_HEADER), sizeof(BC_VALUE),
+                          sizeof(BC_FUNC), sizeof(BC_LINE), sizeof(BC_RECORD), sizeof(BC_FIELD),
+                          0x0102030405060708ULL };
+    return fnv1a(h, layout, sizeof(layout));
+}
+
+static uint64_t alignUp(uint64_t n) {
+    return (n + 63) & ~(uint64_t)63;
+}
+
+bool writeBcImage(const char *path, const BC_MODULE *b) {
+    const void *data[BC_SEC_COUNT] = {
+        [BC_SEC_CODE] = b->code,       [BC_SEC_CONSTS] = b->consts, [BC_SEC_FUNCS] = b->funcs,
+        [BC_SEC_LINES] = b->lines,     [BC_SEC_RECORDS] = b->records,
+        [BC_SEC_FIELDS] = b->fields,   [BC_SEC_NAMES] = b->names,
+    };
+    const uint64_t count[BC_SEC_COUNT] = {
+        [BC_SEC_CODE] = b->nCode,      [BC_SEC_CONSTS] = b->nConsts, [BC_SEC_FUNCS] = b->nFuncs,
+        [BC_SEC_LINES] = b->nLines,    [BC_SEC_RECORDS] = b->nRecords,
+        [BC_SEC_FIELDS] = b->nFields,  [BC_SEC_NAMES] = b->namesLen,
+    };
+
+    BC_IMAGE_HEADER hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, IMAGE_MAGIC, sizeof(hdr.magic));
+    hdr.version     = BC_IMAGE_VERSION;
+    hdr.headerSize  = sizeof(hdr);
+    hdr.layoutHash  = bcImageLayoutHash();
+    hdr.globalBytes = b->globalBytes;
+    hdr.nSections   = BC_SEC_COUNT;
+    uint64_t total  = alignUp(sizeof(hdr));
+    for (int k = 0; k < BC_SEC_COUNT; k++) {
+        hdr.sections[k] = (BC_SECTION){ total, count[k] };
+        total           = alignUp(total + count[k] * SECTION_ELEM[k]);
+    }
+
+    char *buf = (char *)calloc(1, total);
+    memcpy(buf, &hdr, sizeof(hdr));
+    for (int k = 0; k < BC_SEC_COUNT; k++)
+        if (count[k] > 0)
+            memcpy(buf + hdr.sections[k].offset, data[k], count[k] * SECTION_ELEM[k]);
+
+    /* Readers only ever see a complete image */
+    bool ok = writeFileAtomic(path, buf, total);
+    free(buf);
+    return ok;
+}
+
+bool isBcImage(const char *path) {
+    char  magic[sizeof(IMAGE_MAGIC)];
+    FILE *f  = fopen(path, "rb");
+    bool  ok = f != NULL && fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+              memcmp(magic, IMAGE_MAGIC, sizeof(magic)) == 0;
+    if (f != NULL)
+        fclose(f);
+    return ok;
+}
+
+/* The tables the VM indexes without checking: every name, entry and field run in bounds */
+static bool tablesValid(const BC_MODULE *b) {
+    if (b->namesLen > 0 && b->names[b->namesLen - 1] != '\0')
+        return false;
+    for (uint32_t k = 0; k < b->nFuncs; k++) {
+        const BC_FUNC *f = &b->funcs[k];
+        if (f->name >= b->namesLen || f->entry > b->nCode || f->codeLen > b->nCode - f->entry)
+            return false;
+    }
+    for (uint32_t k = 0; k < b->nRecords; k++) {
+        const BC_RECORD *r = &b->records[k];
+        if (r->name >= b->namesLen || r->firstField > b->nFields ||
+            r->nFields > b->nFields - r->firstField)
+            return false;
+    }
+    for (uint32_t i = 0; i < b->nFields; i++)
+        if (b->fields[i].name >= b->namesLen)
+            return false;
+    return true;
+}
+
+static bool globalValid(const BC_MODULE *b, uint32_t offset, uint32_t width) {
+    return offset <= b->globalBytes && width <= b->globalBytes - offset;
+}
+
+/*
+ * Decode the instructions of 'f': each must be a known opcode lying
+ * wholly inside the function, and the last one must not fall through
+ * (JMP or RET).  Instruction starts are marked in 'start'.
+ */
+static bool decodeValid(const BC_MODULE *b, const BC_FUNC *f, uint8_t *start) {
+    const uint32_t *code = b->code;
+    uint32_t        end  = f->entry + f->codeLen;
+    uint32_t        last = f->entry;
+    for (uint32_t pc = f->entry; pc < end; pc += bcInstLength(code, pc)) {
+        uint32_t left = end - pc;   /* words from the opcode to the end of 'f' */
+        if (code[pc] >= BC_OP_COUNT)
+            return false;
+        if (code[pc] == BC_CALL) {
+            uint32_t n = (left >= 4) ? code[pc + 2] : 0;
+            if (left < 4 || n > left - 4 || code[pc + 3 + n] > left - 4 - n)
+                return false;
+        } else if (code[pc] == BC_RET) {
+            if (left < 2 || code[pc + 1] > left - 2)
+                return false;
+        } else if (BC_OPERANDS[code[pc]] >= left) {
+            return false;
+        }
+        start[pc] = 1;
+        last      = pc;
+    }
+    return code[last] == BC_JMP || code[last] == BC_RET;
+}
+
+/*
+ * Check the operands of the decoded function 'f': registers inside its
+ * window, constants and callees inside their tables, global accesses
+ * inside the globals and jumps onto an instruction of the function.
+ */
+static bool operandsValid(const BC_MODULE *b, const BC_FUNC *f, const uint8_t *start) {
+    const uint32_t *code = b->code;
+    uint32_t        end  = f->entry + f->codeLen;
+    for (uint32_t pc = f->entry; pc < end; pc += bcInstLength(code, pc)) {
+        const uint32_t *w  = code + pc;
+        uint32_t        op = w[0];
+        bool            ok = true;
+#define REG(r)    ((r) < f->nRegs)
+#define TARGET(t) ((t) >= f->entry && (t) < end && start[t])
+        switch (op) {
+        case BC_LOADK:
+            ok = REG(w[1]) && w[2] < b->nConsts;
+            break;
+        case BC_GLOADI: case BC_GSTOREI:
+            ok = REG(w[1]) && globalValid(b, w[2], sizeof(int32_t));
+            break;
+        case BC_GLOADR: case BC_GSTORER:
+            ok = REG(w[1]) && globalValid(b, w[2], sizeof(double));
+            break;
+        case BC_JMP:
+            ok = TARGET(w[1]);
+            break;
+        case BC_JT: case BC_JF:
+            ok = REG(w[1]) && TARGET(w[2]);
+            break;
+        case BC_CALL: {
+            uint32_t n = w[2], m = w[3 + n];
+            ok = w[1] < b->nFuncs;
+            /* the arguments land in registers 0 .. n of the callee's window */
+            if (ok && b->funcs[w[1]].codeLen > 0)
+                ok = n <= b->funcs[w[1]].nRegs;
+            for (uint32_t i = 0; ok && i < n; i++)
+                ok = REG(w[3 + i]);
+            for (uint32_t i = 0; ok && i < m; i++)
+                ok = REG(w[4 + n + i]);
+            break;
+        }
+        case BC_RET:
+            for (uint32_t i = 0; ok && i < w[1]; i++)
+                ok = REG(w[2 + i]);
+            break;
+        default:
+            for (int i = 1; ok && i <= BC_OPERANDS[op]; i++)
+                ok = REG(w[i]);
+            break;
+        }
+#undef REG
+#undef TARGET
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+/*
+ * The VM trusts its code, so a mapped image is checked once, function
+ * by function, before anything runs it.
+ */
+static bool codeValid(const BC_MODULE *b) {
+    uint8_t *start = (uint8_t *)calloc(b->nCode > 0 ? b->nCode : 1, 1);
+    bool     ok    = true;
+    for (uint32_t k = 0; ok && k < b->nFuncs; k++) {
+        const BC_FUNC *f = &b->funcs[k];
+        if (f->codeLen > 0)
+            ok = f->nRegs <= IMAGE_MAX_REGS && decodeValid(b, f, start) &&
+                 operandsValid(b, f, start);
+    }
+    free(start);
+    return ok;
+}
+
+static const char *const IMAGE_STATUS_TEXT[] = {
+    "ok",
+    "cannot be read",
+    "truncated: the file ends inside its header or one of its sections",
+    "not a bytecode image",
+    "written by another build (version or layout differs); rebuild it with --image",
+    "damaged: a section is misaligned or has more elements than fit",
+    "damaged: a function, record or field points outside its table",
+    "damaged: an instruction does not decode or an operand is out of range",
+};
+
+const char *bcImageStatusText(BC_IMAGE_STATUS status) {
+    return (status <= BC_IMAGE_BAD_CODE) ? IMAGE_STATUS_TEXT[status] : "?";
+}
+
+/* The header's verdict on an image 'len' bytes long */
+static BC_IMAGE_STATUS headerStatus(const BC_IMAGE_HEADER *hdr, size_t len) {
+    if (memcmp(hdr->magic, IMAGE_MAGIC, sizeof(hdr->magic)) != 0)
+        return BC_IMAGE_NOT_IMAGE;
+    if (hdr->version != BC_IMAGE_VERSION || hdr->headerSize != sizeof(BC_IMAGE_HEADER) ||
+        hdr->layoutHash != bcImageLayoutHash() || hdr->nSections != BC_SEC_COUNT)
+        return BC_IMAGE_FOREIGN;
+    for (int k = 0; k < BC_SEC_COUNT; k++) {
+        const BC_SECTION *sec = &hdr->sections[k];
+        if (sec->offset % 64 != 0 || sec->count > UINT32_MAX)
+            return BC_IMAGE_BAD_SECTIONS;
+        if (sec->offset > len || sec->count > (len - sec->offset) / SECTION_ELEM[k])
+            return BC_IMAGE_TRUNCATED;
+    }
+    return BC_IMAGE_OK;
+}
+
+/* ------------------------------------------------------------------
+ * mapBcImage
+ * ------------------------------------------------------------------ */
+bcModule mapBcImage(const char *path, BC_IMAGE_STATUS *status) {
+    BC_IMAGE_STATUS dummy;
+    if (status == NULL)
+        status = &dummy;
+
+    *status = BC_IMAGE_UNREADABLE;
+    int fd  = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    if ((size_t)st.st_size < sizeof(BC_IMAGE_HEADER)) {
+        *status = BC_IMAGE_TRUNCATED;
+        close(fd);
+        return NULL;
+    }
+    size_t len = (size_t)st.st_size;
+    void  *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    const char            *base = (const char *)map;
+    const BC_IMAGE_HEADER *hdr  = (const BC_IMAGE_HEADER *)map;
+    *status = headerStatus(hdr, len);
+    if (*status != BC_IMAGE_OK) {
+        munmap(map, len);
+        return NULL;
+    }
+
+    /* the arrays are read-only views of the mapping; nothing writes through them */
+    bcModule b = (bcModule)calloc(1, sizeof(BC_MODULE));
+    b->code        = (uint32_t *)(base + hdr->sections[BC_SEC_CODE].offset);
+    b->nCode       = (uint32_t)hdr->sections[BC_SEC_CODE].count;
+    b->consts      = (BC_VALUE *)(base + hdr->sections[BC_SEC_CONSTS].offset);
+    b->nConsts     = (uint32_t)hdr->sections[BC_SEC_CONSTS].count;
+    b->funcs       = (BC_FUNC *)(base + hdr->sections[BC_SEC_FUNCS].offset);
+    b->nFuncs      = (uint32_t)hdr->sections[BC_SEC_FUNCS].count;
+    b->lines       = (BC_LINE *)(base + hdr->sections[BC_SEC_LINES].offset);
+    b->nLines      = (uint32_t)hdr->sections[BC_SEC_LINES].count;
+    b->records     = (BC_RECORD *)(base + hdr->sections[BC_SEC_RECORDS].offset);
+    b->nRecords    = (uint32_t)hdr->sections[BC_SEC_RECORDS].count;
+    b->fields      = (BC_FIELD *)(base + hdr->sections[BC_SEC_FIELDS].offset);
+    b->nFields     = (uint32_t)hdr->sections[BC_SEC_FIELDS].count;
+    b->names       = (char *)(base + hdr->sections[BC_SEC_NAMES].offset);
+    b->namesLen    = (uint32_t)hdr->sections[BC_SEC_NAMES].count;
+    b->globalBytes = hdr->globalBytes;
+    b->map         = map;
+    b->mapLen      = len;
+    if (!tablesValid(b))
+        *status = BC_IMAGE_BAD_TABLES;
+    else if (!codeValid(b))
+        *status = BC_IMAGE_BAD_CODE;
+    if (*status != BC_IMAGE_OK) {
+        freeBcModule(b);
+        return NULL;
+    }
+    return b;
+}
@@ -0,0 +1,218 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "ir.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Register bytecode, lowered from the SSA IR for the VM (vm.h).
+ *
+ * Code is one array of 32-bit words for the whole module: an opcode
+ * word followed by its operands, each a register of the current frame,
+ * a constant pool index, a global byte offset, a function index or a
+ * code offset (jump targets are word offsets from the start of the
+ * array, so nothing in it is a pointer).  Every SSA value has its own
+ * register; a function's input leaves arrive in registers 0 .. nParams.
+ * Phis become copies on the edges into their block, on a stub of their
+ * own where the edge leaves a conditional branch.
+ *
+ * Operands, by opcode (d: destination register, a / b: source
+ * registers, t: code offset):
+ *
+ *   LOADK d, k          constant k of the pool
+ *   MOV d, a
+ *   ADDI .. DIVI d, a, b    int, wrapping to 32 bits
+ *   ADDR .. DIVR d, a, b    real
+ *   LTI .. NEI d, a, b      int compare, d = 0 / 1
+ *   LTR .. NER d, a, b      real compare
+ *   AND / OR d, a, b;  NOT d, a;  ITOR d, a;  RTOI d, a
+ *   GLOADI / GLOADR d, offset;  GSTOREI / GSTORER a, offset
+ *   READI / READR d;  WRITEI / WRITER a
+ *   JMP t;  JT a, t;  JF a, t
+ *   CALL f, n, a1 .. an, m, d1 .. dm      m results land in d1 .. dm
+ *   RET n, a1 .. an
+ */
+typedef enum {
+    BC_LOADK,
+    BC_MOV,
+    BC_ADDI, BC_SUBI, BC_MULI, BC_DIVI,
+    BC_ADDR, BC_SUBR, BC_MULR, BC_DIVR,
+    BC_LTI, BC_LEI, BC_EQI, BC_GTI, BC_GEI, BC_NEI,
+    BC_LTR, BC_LER, BC_EQR, BC_GTR, BC_GER, BC_NER,
+    BC_AND, BC_OR, BC_NOT,
+    BC_ITOR, BC_RTOI,
+    BC_GLOADI, BC_GLOADR, BC_GSTOREI, BC_GSTORER,
+    BC_READI, BC_READR, BC_WRITEI, BC_WRITER,
+    BC_JMP, BC_JT, BC_JF,
+    BC_CALL,
+    BC_RET,
+    BC_OP_COUNT
+} BC_OP;
+
+/* A register or constant: int (32-bit, kept sign-extended) or real */
+typedef union {
+    int64_t i;
+    double  r;
+} BC_VALUE;
+
+typedef struct {
+    uint32_t name;      /* offset of its NUL-terminated name in 'names' */
+    uint32_t entry;     /* code offset of its first instruction */
+    uint32_t codeLen;   /* 0 for a function with no body (never lowered or inlined away) */
+    uint32_t nRegs;
+    uint32_t nParams;
+    uint32_t nResults;
+} BC_FUNC;
+
+/*
+ * Layout of a record or union: records[k] is type id k + 2 of the
+ * program (0 and 1 are int and real), its fields are
+ * fields[firstField .. + nFields) with the type ids of their own.
+ */
+typedef struct {
+    uint32_t name;
+    uint32_t isUnion;
+    uint32_t size;
+    uint32_t align;
+    uint32_t firstField;
+    uint32_t nFields;
+} BC_RECORD;
+
+typedef struct {
+    uint32_t name;
+    int32_t  type;
+    uint32_t offset;
+} BC_FIELD;
+
+/* Source line of the code from 'offset' on, up to the next entry */
+typedef struct {
+    uint32_t offset;
+    int32_t  line;
+} BC_LINE;
+
+typedef struct BC_MODULE {
+    uint32_t  *code;
+    uint32_t   nCode;
+    BC_VALUE  *consts;
+    uint32_t   nConsts;
+    BC_FUNC   *funcs;   /* funcs[k] is function k of the IR module; main is last */
+    uint32_t   nFuncs;
+    BC_LINE   *lines;   /* ascending offsets */
+    uint32_t   nLines;
+    BC_RECORD *records;
+    uint32_t   nRecords;
+    BC_FIELD  *fields;
+    uint32_t   nFields;
+    char      *names;
+    uint32_t   namesLen;
+    uint32_t   globalBytes;
+    void      *map;     /* the arrays point into this mapped image, or NULL if they are owned */
+    size_t     mapLen;
+} BC_MODULE;
+
+typedef BC_MODULE *bcModule;
+
+/* Bytecode for every function of 'm', with the layout of every record type */
+bcModule compileBytecode(const IR_MODULE *m);
+
+/* Frees the arrays, or unmaps the image they point into */
+void freeBcModule(bcModule b);
+
+/* Words of the instruction at code[pc], operands included */
+uint32_t bcInstLength(const uint32_t *code, uint32_t pc);
+
+/* Source line of the instruction at code offset 'pc', 0 if unknown */
+int bcLineAt(const BC_MODULE *b, uint32_t pc);
+
+/* Bytes held by the module's arrays (mapped or not) */
+size_t bcModuleBytes(const BC_MODULE *b);
+
+/* Listing of every function */
+void printBytecode(const BC_MODULE *b, FILE *out);
+
+const char *bcOpName(BC_OP op);
+
+/*
+ * Bytecode image: a module saved so that it runs straight from an mmap
+ * of the file.  A header is followed by one section per array of
+ * BC_MODULE (code, constant pool, function table, line table, record
+ * layouts, fields, names), each at a 64-byte aligned offset from the
+ * start of the file.  Nothing in a section is a pointer (operands are
+ * indices and code offsets), so mapping the file at any address and
+ * pointing a BC_MODULE at its sections is all that loading takes.
+ *
+ * The header records the format version and a hash of the struct
+ * layouts and byte order; an image from another build or machine is
+ * refused rather than converted.  Opening checks the sections' bounds,
+ * the function and record tables and the names, then decodes each
+ * function (known opcodes, no instruction past its end, JMP or RET
+ * last) and checks every operand: registers against its window,
+ * constants, callees and globals against their tables, and jumps
+ * against its own instruction starts.  The VM can then run the code
+ * without checks of its own.  vmbench --images exercises this on good
+ * and damaged images.
+ */
+#define BC_IMAGE_VERSION 1
+
+enum {
+    BC_SEC_CODE,
+    BC_SEC_CONSTS,
+    BC_SEC_FUNCS,
+    BC_SEC_LINES,
+    BC_SEC_RECORDS,
+    BC_SEC_FIELDS,
+    BC_SEC_NAMES,
+    BC_SEC_COUNT
+};
+
+typedef struct {
+    uint64_t offset;
+    uint64_t count;         /* elements */
+} BC_SECTION;
+
+typedef struct {
+    char       magic[8];    /* "STG1CODE" */
+    uint32_t   version;
+    uint32_t   headerSize;
+    uint64_t   layoutHash;  /* see bcImageLayoutHash() */
+    uint32_t   globalBytes;
+    uint32_t   nSections;
+    BC_SECTION sections[BC_SEC_COUNT];
+} BC_IMAGE_HEADER;
+
+/* Hash of the version, the struct layouts and the byte order of this build */
+uint64_t bcImageLayoutHash(void);
+
+/* Write 'b' to 'path' (aside, then renamed over it); false on an I/O error */
+bool writeBcImage(const char *path, const BC_MODULE *b);
+
+/* Whether 'path' starts like an image (of any version) */
+bool isBcImage(const char *path);
+
+/* Why mapBcImage refused an image */
+typedef enum {
+    BC_IMAGE_OK,
+    BC_IMAGE_UNREADABLE,    /* cannot be opened or mapped; errno says why */
+    BC_IMAGE_TRUNCATED,     /* the file ends inside the header or a section */
+    BC_IMAGE_NOT_IMAGE,     /* no image magic */
+    BC_IMAGE_FOREIGN,       /* another format version, struct layout or byte order */
+    BC_IMAGE_BAD_SECTIONS,  /* a section is misaligned or has more elements than fit */
+    BC_IMAGE_BAD_TABLES,    /* a function, record or field points outside its table */
+    BC_IMAGE_BAD_CODE,      /* an instruction does not decode or an operand is out of range */
+} BC_IMAGE_STATUS;
+
+/*
+ * Map an image read-only; NULL if it cannot be opened or is not one this
+ * build can run, with the reason in *status (if not NULL).  Its tables
+ * and every instruction are checked first (opcodes, registers,
+ * constants, globals, callees, jump targets), so a damaged image is
+ * refused instead of being run.
+ */
+bcModule mapBcImage(const char *path, BC_IMAGE_STATUS *status);
+
+const char *bcImageStatusText(BC_IMAGE_STATUS status);
+
+#endif /* BYTECODE_H */
@@ -0,0 +1,664 @@
+#include "cache.h"
+#include "compilerCtx.h"
+#include "fileIO.h"
+#include "lexer.h"
+#include "memTrack.h"
+#include "parser.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ---- entry layout ---- */
+
+static const char CACHE_MAGIC[8] = { 'P', 'R', 'S', 'C', 'A', 'C', 'H', 'E' };
+
+#define NO_LEXEME      UINT32_MAX
+#define MAX_POOL_BYTES ((uint64_t)UINT32_MAX)
+
+/* Abandoned temporaries older than this are removed during eviction */
+#define STALE_TMP_SECS 600
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t stamp;
+    uint64_t key;
+    uint64_t srcLen;
+    uint64_t fileSize;
+    uint64_t bodyHash;      /* hashSource of everything after the header */
+    uint32_t hadError;
+    uint32_t nTokens;
+    uint32_t nNodes;
+    uint32_t diagLen;
+    uint64_t tokOff;
+    uint64_t nodeOff;
+    uint64_t strOff;
+    uint64_t strLen;
+    uint64_t diagOff;
+} CacheHeader;
+
+typedef struct {
+    uint32_t type;
+    int32_t  line;
+    uint32_t lexOff;        /* into the string pool, NO_LEXEME for NULL */
+    int32_t  lexSize;
+} CacheToken;
+
+/* Parse tree in preorder; each node is followed by its children's subtrees */
+enum { NODE_NT, NODE_TERMINAL, NODE_ABSENT };
+
+typedef struct {
+    uint16_t sym;
+    uint8_t  kind;
+    uint8_t  childCount;
+    int32_t  line;
+    uint32_t lexOff;
+    int32_t  lexSize;
+} CacheNode;
+
+/* ---- hashing ---- */
+
+static uint64_t mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/*
+ * hashSource — eight bytes per step: xor in a word, multiply, rotate.
+ * Not cryptographic; entries also record the source length.
+ */
+uint64_t hashSource(const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t             h = 0x9e3779b97f4a7c15ULL ^ len;
+
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h ^= w * 0x87c37b91114253d5ULL;
+        h  = ((h << 31) | (h >> 33)) * 0x4cf5ad432745937fULL;
+    }
+    uint64_t w = 0;
+    memcpy(&w, p, len);
+    h ^= w * 0x87c37b91114253d5ULL;
+    return mix64(h);
+}
+
+static uint64_t hashWord(uint64_t h, uint64_t w) {
+    return mix64(h ^ w) + 0x9e3779b97f4a7c15ULL;
+}
+
+/*
+ * Everything the cached results depend on besides the source: the
+ * rules and table (hashed field by field, since struct padding is not
+ * reproducible), the lexer version and the layouts written to disk.
+ */
+static uint64_t resultStamp(const Grammar *g, const ParseTable *pt) {
+    uint64_t h = hashWord(0, CACHE_FORMAT_VERSION);
+    h = hashWord(h, LEXER_VERSION);
+    h = hashWord(h, NUM_TOKENS);
+    h = hashWord(h, NON_TERMINAL_COUNT);
+    h = hashWord(h, sizeof(CacheHeader));
+
+    for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++) {
+        h = hashWord(h, ((uint64_t)g->prod_count[nt] << 1) | g->has_eps[nt]);
+        for (int r = 0; r < g->prod_count[nt] && r < MAX_RHS_LEN; r++) {
+            const ProductionRule *rule = &g->prods[nt][r];
+            h = hashWord(h, (uint64_t)rule->rhs_len);
+            for (int k = 0; k < rule->rhs_len && k < MAX_RHS_LEN; k++)
+                h = hashWord(h, ((uint64_t)rule->rhs[k].isTerminal << 32) |
+                                (uint32_t)(rule->rhs[k].isTerminal ? (int)rule->rhs[k].sym.t
+                                                                   : (int)rule->rhs[k].sym.nt));
+        }
+        for (int t = 0; t < NUM_TOKENS; t++)
+            h = hashWord(h, (uint64_t)(uint32_t)pt->cell[nt][t]);
+        h = hashWord(h, pt->start[nt]);
+        h = hashWord(h, pt->recover[nt]);
+    }
+    return h;
+}
+
+/* <dir>/<16 hex digits>.pc */
+static void entryPath(parseCache c, uint64_t key, size_t srcLen, char *buf, size_t cap) {
+    uint64_t name = mix64(key ^ hashWord(c->stamp, srcLen));
+    snprintf(buf, cap, "%s/%016llx.pc", c->dir, (unsigned long long)name);
+}
+
+/* ---- directory ---- */
+
+typedef struct {
+    char           *path;
+    uint64_t        size;
+    struct timespec mtime;
+} EntryInfo;
+
+static int cmpEntryAge(const void *a, const void *b) {
+    const struct timespec *x = &((const EntryInfo *)a)->mtime;
+    const struct timespec *y = &((const EntryInfo *)b)->mtime;
+    if (x->tv_sec != y->tv_sec)
+        return x->tv_sec < y->tv_sec ? -1 : 1;
+    return (x->tv_nsec > y->tv_nsec) - (x->tv_nsec < y->tv_nsec);
+}
+
+static bool hasSuffix(const char *s, const char *suffix) {
+    size_t n = strlen(s), k = strlen(suffix);
+    return n >= k && strcmp(s + n - k, suffix) == 0;
+}
+
+/*
+ * List the entries of the directory, oldest first, removing abandoned
+ * temporaries on the way.  Returns their total size.
+ */
+static uint64_t scanEntries(parseCache c, EntryInfo **out, int *count) {
+    DIR *d = opendir(c->dir);
+    *out   = NULL;
+    *count = 0;
+    if (d == NULL)
+        return 0;
+
+    EntryInfo *list  = NULL;
+    int        n     = 0;
+    int        cap   = 0;
+    uint64_t   total = 0;
+    time_t     now   = time(NULL);
+
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        bool entry = e->d_name[0] != '.' && hasSuffix(e->d_name, ".pc");
+        bool tmp   = strncmp(e->d_name, ".tmp-", 5) == 0;
+        if (!entry && !tmp)
+            continue;
+
+        size_t len  = strlen(c->dir) + strlen(e->d_name) + 2;
+        char  *path = (char *)malloc(len);
+        snprintf(path, len, "%s/%s", c->dir, e->d_name);
+
+        struct stat st;
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            free(path);
+            continue;
+        }
+        if (tmp) {
+            if (now - st.st_mtim.tv_sec > STALE_TMP_SECS)
+                unlink(path);
+            free(path);
+            continue;
+        }
+
+        if (n == cap) {
+            cap  = cap ? cap * 2 : 64;
+            list = (EntryInfo *)realloc(list, cap * sizeof(EntryInfo));
+        }
+        list[n].path  = path;
+        list[n].size  = (uint64_t)st.st_size;
+        list[n].mtime = st.st_mtim;
+        total += list[n].size;
+        n++;
+    }
+    closedir(d);
+
+    if (n > 0)
+        qsort(list, n, sizeof(EntryInfo), cmpEntryAge);
+    *out   = list;
+    *count = n;
+    return total;
+}
+
+static void freeEntries(EntryInfo *list, int n) {
+    for (int i = 0; i < n; i++)
+        free(list[i].path);
+    free(list);
+}
+
+/*
+ * Remove least recently used entries until the directory is at 90% of
+ * its limit.  One thread at a time per cache; other processes sharing
+ * the directory may evict concurrently, which at worst removes a few
+ * more entries than needed.
+ */
+static void evictEntries(parseCache c) {
+    if (atomic_flag_test_and_set(&c->evicting))
+        return;
+
+    EntryInfo *list;
+    int        n;
+    uint64_t   total  = scanEntries(c, &list, &n);
+    uint64_t   target = c->maxBytes / 10 * 9;
+
+    for (int i = 0; i < n && total > target; i++)
+        if (unlink(list[i].path) == 0 || errno == ENOENT)
+            total -= list[i].size;
+    freeEntries(list, n);
+
+    atomic_store(&c->approxBytes, (long long)total);
+    atomic_flag_clear(&c->evicting);
+}
+
+/* ------------------------------------------------------------------
+ * openParseCache / closeParseCache
+ * ------------------------------------------------------------------ */
+parseCache openParseCache(const char *dir, uint64_t maxBytes, const Grammar *g,
+                          const ParseTable *pt) {
+    struct stat st;
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST)
+        return NULL;
+    if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        errno = ENOTDIR;
+        return NULL;
+    }
+
+    parseCache c = (parseCache)calloc(1, sizeof(PARSE_CACHE));
+    c->dir      = strdup(dir);
+    c->stamp    = resultStamp(g, pt);
+    c->maxBytes = maxBytes;
+    atomic_init(&c->hits, 0);
+    atomic_init(&c->misses, 0);
+    atomic_flag_clear(&c->evicting);
+
+    EntryInfo *list;
+    int        n;
+    atomic_init(&c->approxBytes, (long long)scanEntries(c, &list, &n));
+    freeEntries(list, n);
+    if ((uint64_t)atomic_load(&c->approxBytes) > c->maxBytes)
+        evictEntries(c);
+    return c;
+}
+
+void closeParseCache(parseCache c) {
+    if (c == NULL)
+        return;
+    free(c->dir);
+    free(c);
+}
+
+/* ------------------------------------------------------------------
+ * cacheLoad
+ *
+ * Map an entry and rebuild the context from it.  Lexemes point into
+ * the mapping; tokens and tree nodes are allocated as the lexer and
+ * parser would, so the usual reset frees them.  Anything malformed is
+ * a miss.
+ * ------------------------------------------------------------------ */
+static bool validHeader(const CacheHeader *h, parseCache c, uint64_t key, size_t srcLen,
+                        size_t len) {
+    if (memcmp(h->magic, CACHE_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != CACHE_FORMAT_VERSION || h->headerSize != sizeof(CacheHeader) ||
+        h->stamp != c->stamp || h->key != key || h->srcLen != srcLen ||
+        h->fileSize != len || h->nTokens == 0)
+        return false;
+
+    return h->tokOff % 4 == 0 && h->nodeOff % 4 == 0 &&
+           h->tokOff  <= len && (len - h->tokOff)  / sizeof(CacheToken) >= h->nTokens &&
+           h->nodeOff <= len && (len - h->nodeOff) / sizeof(CacheNode)  >= h->nNodes &&
+           h->strOff  <= len && len - h->strOff >= h->strLen &&
+           h->diagOff <= len && len - h->diagOff > h->diagLen;
+}
+
+static bool lexemeAt(const char *pool, uint64_t poolLen, uint32_t off, char **out) {
+    if (off == NO_LEXEME) {
+        *out = NULL;
+        return true;
+    }
+    if (off >= poolLen)
+        return false;
+    *out = (char *)(pool + off);
+    return true;
+}
+
+/* Rebuild the tree from its preorder image; NULL in *root if malformed */
+static bool loadTree(const CacheNode *nodes, uint32_t n, const char *pool, uint64_t poolLen,
+                     ParseTreeNode **root) {
+    typedef struct { ParseTreeNode *node; int next; } Frame;
+
+    *root = NULL;
+    if (n == 0)
+        return true;
+
+    Frame   *stack = (Frame *)malloc(n * sizeof(Frame));
+    int      top   = -1;
+    uint32_t i     = 0;
+    bool     ok    = true;
+
+    while (ok && i < n) {
+        const CacheNode *cn  = &nodes[i++];
+        ParseTreeNode   *par = NULL;
+        int              slot = 0;
+
+        /* find the parent still waiting for a child */
+        while (top >= 0 && stack[top].next == stack[top].node->child_count)
+            top--;
+        if (top >= 0) {
+            par  = stack[top].node;
+            slot = stack[top].next++;
+        } else if (*root != NULL) {
+            ok = false;
+            break;
+        }
+
+        if (cn->kind == NODE_ABSENT) {
+            ok = par != NULL && cn->childCount == 0;
+            continue;
+        }
+        if (cn->kind > NODE_TERMINAL || cn->childCount > MAX_RHS_LEN ||
+            cn->sym >= (cn->kind == NODE_TERMINAL ? NUM_TOKENS : NON_TERMINAL_COUNT)) {
+            ok = false;
+            break;
+        }
+
+        ParseTreeNode *nd = (ParseTreeNode *)memAlloc(MEM_TREE, sizeof(ParseTreeNode));
+        nd->data.sym.isTerminal = cn->kind == NODE_TERMINAL;
+        if (nd->data.sym.isTerminal)
+            nd->data.sym.sym.t = (TOKEN_TYPE)cn->sym;
+        else
+            nd->data.sym.sym.nt = (NON_TERMINAL)cn->sym;
+        nd->data.line       = cn->line;
+        nd->data.lexemeSize = cn->lexSize;
+        nd->parent          = par;
+        nd->child_count     = cn->childCount;
+        memset(nd->children, 0, sizeof(nd->children));
+        ok = lexemeAt(pool, poolLen, cn->lexOff, &nd->data.lexeme);
+
+        if (par != NULL)
+            par->children[slot] = nd;
+        else
+            *root = nd;
+        stack[++top] = (Frame){ nd, 0 };
+    }
+
+    /* every promised child must have been read */
+    for (; ok && top >= 0; top--)
+        ok = stack[top].next == stack[top].node->child_count;
+    free(stack);
+
+    if (!ok) {
+        freeParseTree(*root);
+        *root = NULL;
+    }
+    return ok;
+}
+
+bool cacheLoad(parseCache c, uint64_t key, size_t srcLen, compilerCtx ctx) {
+    char path[4096];
+    entryPath(c, key, srcLen, path, sizeof path);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        atomic_fetch_add_explicit(&c->misses, 1, memory_order_relaxed);
+        return false;
+    }
+
+    struct stat st;
+    void       *map = MAP_FAILED;
+    size_t      len = 0;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(CacheHeader)) {
+        len = (size_t)st.st_size;
+        map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (map != MAP_FAILED)
+        futimens(fd, NULL);     /* recently used */
+    close(fd);
+
+    const CacheHeader *h  = (const CacheHeader *)map;
+    bool               ok = map != MAP_FAILED && validHeader(h, c, key, srcLen, len);
+
+    const char *base = (const char *)map;
+    ok = ok && hashSource(base + sizeof(CacheHeader), len - sizeof(CacheHeader)) == h->bodyHash;
+    const char *pool = ok ? base + h->strOff : NULL;
+    ok = ok && (h->strLen == 0 || pool[h->strLen - 1] == '\0') && base[h->diagOff + h->diagLen] == '\0';
+
+    tokenStream ts = NULL;
+    if (ok) {
+        const CacheToken *ct = (const CacheToken *)(base + h->tokOff);
+        ts        = (tokenStream)memAlloc(MEM_BUFFER, sizeof(TOKEN_STREAM));
+        ts->count = (int)h->nTokens;
+        ts->cap   = (int)h->nTokens;
+        ts->toks  = (TOKEN *)memAlloc(MEM_BUFFER, h->nTokens * sizeof(TOKEN));
+        for (uint32_t i = 0; ok && i < h->nTokens; i++) {
+            TOKEN *t = &ts->toks[i];
+            ok = ct[i].type < NUM_TOKENS && lexemeAt(pool, h->strLen, ct[i].lexOff, &t->lexeme);
+            t->type       = (TOKEN_TYPE)ct[i].type;
+            t->line       = ct[i].line;
+            t->lexemeSize = ct[i].lexSize;
+        }
+        ok = ok && ts->toks[ts->count - 1].type == DOLLAR;
+    }
+
+    ParseTreeNode *tree = NULL;
+    ok = ok && loadTree((const CacheNode *)(base + h->nodeOff), h->nNodes, pool, h->strLen, &tree);
+
+    if (!ok) {
+        freeTokenStream(ts);
+        if (map != MAP_FAILED)
+            munmap(map, len);
+        atomic_fetch_add_explicit(&c->misses, 1, memory_order_relaxed);
+        return false;
+    }
+
+    ctx->tokens   = ts;
+    ctx->tree     = tree;
+    ctx->hadError = h->hadError != 0;
+    ctx->cacheMap = map;
+    ctx->cacheLen = len;
+    if (h->diagLen > 0)
+        diagPrintf(ctx->diag, "%s", base + h->diagOff);
+    atomic_fetch_add_explicit(&c->hits, 1, memory_order_relaxed);
+    return true;
+}
+
+/* ---- cacheStore ---- */
+
+/*
+ * Lexemes are written once each: tree leaves share their token's
+ * lexeme, so the pool is keyed by pointer.
+ */
+typedef struct {
+    const char **keys;
+    uint32_t    *offs;
+    size_t       mask;
+    size_t       used;
+    char        *text;
+    uint64_t     len;
+    uint64_t     cap;
+} StringPool;
+
+static void poolGrow(StringPool *sp) {
+    size_t       slots = (sp->mask + 1) * 2;
+    const char **keys  = (const char **)calloc(slots, sizeof(char *));
+    uint32_t    *offs  = (uint32_t *)malloc(slots * sizeof(uint32_t));
+    for (size_t j = 0; j <= sp->mask; j++) {
+        if (sp->keys[j] == NULL)
+            continue;
+        size_t i = (size_t)mix64((uint64_t)(uintptr_t)sp->keys[j]) & (slots - 1);
+        while (keys[i] != NULL)
+            i = (i + 1) & (slots - 1);
+        keys[i] = sp->keys[j];
+        offs[i] = sp->offs[j];
+    }
+    free(sp->keys);
+    free(sp->offs);
+    sp->keys = keys;
+    sp->offs = offs;
+    sp->mask = slots - 1;
+}
+
+static uint32_t poolAdd(StringPool *sp, const char *s) {
+    if (s == NULL)
+        return NO_LEXEME;
+    if (2 * (sp->used + 1) > sp->mask + 1)
+        poolGrow(sp);
+
+    size_t i = (size_t)mix64((uint64_t)(uintptr_t)s) & sp->mask;
+    while (sp->keys[i] != NULL) {
+        if (sp->keys[i] == s)
+            return sp->offs[i];
+        i = (i + 1) & sp->mask;
+    }
+
+    size_t n = strlen(s) + 1;
+    if (sp->len + n > MAX_POOL_BYTES)
+        return NO_LEXEME;       /* caller gives up on this entry */
+    while (sp->len + n > sp->cap) {
+        sp->cap  = sp->cap ? sp->cap * 2 : 4096;
+        sp->text = (char *)realloc(sp->text, sp->cap);
+    }
+    memcpy(sp->text + sp->len, s, n);
+
+    sp->keys[i] = s;
+    sp->offs[i] = (uint32_t)sp->len;
+    sp->len    += n;
+    sp->used++;
+    return sp->offs[i];
+}
+
+/* Lexeme offset, or false if the pool overflowed */
+static bool poolRef(StringPool *sp, const char *s, uint32_t *off) {
+    *off = poolAdd(sp, s);
+    return s == NULL || *off != NO_LEXEME;
+}
+
+typedef struct {
+    CacheNode *nodes;
+    uint32_t   n;
+    uint32_t   cap;
+} NodeList;
+
+static CacheNode *pushNode(NodeList *nl) {
+    if (nl->n == nl->cap) {
+        nl->cap   = nl->cap ? nl->cap * 2 : 1024;
+        nl->nodes = (CacheNode *)realloc(nl->nodes, nl->cap * sizeof(CacheNode));
+    }
+    CacheNode *cn = &nl->nodes[nl->n++];
+    memset(cn, 0, sizeof(*cn));
+    return cn;
+}
+
+/* Preorder image of the tree, without recursion (the function chain is deep) */
+static bool flattenTree(const ParseTreeNode *root, StringPool *sp, NodeList *nl) {
+    if (root == NULL)
+        return true;
+
+    size_t                cap   = 256;
+    size_t                top   = 0;
+    const ParseTreeNode **stack = (const ParseTreeNode **)malloc(cap * sizeof(*stack));
+    bool                  ok    = true;
+    stack[top++] = root;
+
+    while (ok && top > 0) {
+        const ParseTreeNode *nd = stack[--top];
+        CacheNode           *cn = pushNode(nl);
+        if (nd == NULL) {
+            cn->kind   = NODE_ABSENT;
+            cn->lexOff = NO_LEXEME;
+            continue;
+        }
+
+        cn->kind       = nd->data.sym.isTerminal ? NODE_TERMINAL : NODE_NT;
+        cn->sym        = (uint16_t)(nd->data.sym.isTerminal ? (int)nd->data.sym.sym.t
+                                                            : (int)nd->data.sym.sym.nt);
+        cn->childCount = (uint8_t)nd->child_count;
+        cn->line       = nd->data.line;
+        cn->lexSize    = nd->data.lexemeSize;
+        ok = poolRef(sp, nd->data.lexeme, &cn->lexOff);
+
+        if (top + nd->child_count > cap) {
+            cap   = (top + nd->child_count) * 2;
+            stack = (const ParseTreeNode **)realloc(stack, cap * sizeof(*stack));
+        }
+        for (int k = nd->child_count - 1; k >= 0; k--)
+            stack[top++] = nd->children[k];
+    }
+    free(stack);
+    return ok;
+}
+
+static uint64_t align8(uint64_t n) {
+    return (n + 7) & ~(uint64_t)7;
+}
+
+void cacheStore(parseCache c, uint64_t key, size_t srcLen, const COMPILER_CTX *ctx) {
+    const TOKEN_STREAM *ts = ctx->tokens;
+    if (c == NULL || ts == NULL || ts->count <= 0)
+        return;
+
+    StringPool sp = { 0 };
+    size_t     slots = 64;
+    while (slots < (size_t)ts->count * 2)
+        slots *= 2;
+    sp.keys = (const char **)calloc(slots, sizeof(char *));
+    sp.offs = (uint32_t *)malloc(slots * sizeof(uint32_t));
+    sp.mask = slots - 1;
+
+    CacheToken *toks = (CacheToken *)malloc(ts->count * sizeof(CacheToken));
+    NodeList    nl   = { 0 };
+    bool        ok   = true;
+    for (int i = 0; ok && i < ts->count; i++) {
+        toks[i].type    = (uint32_t)ts->toks[i].type;
+        toks[i].line    = ts->toks[i].line;
+        toks[i].lexSize = ts->toks[i].lexemeSize;
+        ok = poolRef(&sp, ts->toks[i].lexeme, &toks[i].lexOff);
+    }
+    ok = ok && flattenTree(ctx->tree, &sp, &nl);
+
+    char  *buf   = NULL;
+    size_t total = 0;
+    if (ok) {
+        CacheHeader hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, CACHE_MAGIC, sizeof(hdr.magic));
+        hdr.version    = CACHE_FORMAT_VERSION;
+        hdr.headerSize = sizeof(hdr);
+        hdr.stamp      = c->stamp;
+        hdr.key        = key;
+        hdr.srcLen     = srcLen;
+        hdr.hadError   = ctx->hadError;
+        hdr.nTokens    = (uint32_t)ts->count;
+        hdr.nNodes     = nl.n;
+        hdr.diagLen    = (uint32_t)ctx->diag->len;
+        hdr.tokOff     = align8(sizeof(hdr));
+        hdr.nodeOff    = align8(hdr.tokOff + hdr.nTokens * sizeof(CacheToken));
+        hdr.strOff     = align8(hdr.nodeOff + hdr.nNodes * sizeof(CacheNode));
+        hdr.strLen     = sp.len;
+        hdr.diagOff    = hdr.strOff + hdr.strLen;
+        hdr.fileSize   = hdr.diagOff + hdr.diagLen + 1;
+
+        total = hdr.fileSize;
+        buf   = (char *)calloc(1, total);
+        memcpy(buf, &hdr, sizeof(hdr));
+        memcpy(buf + hdr.tokOff, toks, hdr.nTokens * sizeof(CacheToken));
+        if (nl.n > 0)
+            memcpy(buf + hdr.nodeOff, nl.nodes, hdr.nNodes * sizeof(CacheNode));
+        if (sp.len > 0)
+            memcpy(buf + hdr.strOff, sp.text, sp.len);
+        memcpy(buf + hdr.diagOff, ctx->diag->text, hdr.diagLen);
+
+        hdr.bodyHash = hashSource(buf + sizeof(hdr), total - sizeof(hdr));
+        memcpy(buf, &hdr, sizeof(hdr));
+    }
+    free(toks);
+    free(nl.nodes);
+    free(sp.keys);
+    free(sp.offs);
+    free(sp.text);
+    /* an entry that would fill the cache on its own is not worth keeping */
+    if (!ok || total > c->maxBytes) {
+        free(buf);
+        return;
+    }
+
+    char path[4096];
+    entryPath(c, key, srcLen, path, sizeof path);
+    if (writeFileAtomic(path, buf, total) &&
+        (uint64_t)atomic_fetch_add(&c->approxBytes, (long long)total) + total > c->maxBytes)
+        evictEntries(c);
+    free(buf);
+}
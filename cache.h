@@ -0,0 +1,64 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "parserDef.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * On-disk cache of front-end results.  An entry holds everything a
+ * compilation of one source text produces: the token array, the parse
+ * tree (flattened to 16-byte nodes in preorder), the diagnostics and
+ * the error flag.  It is keyed by a hash of the source bytes and their
+ * length, combined with a stamp of the grammar, parse table, lexer
+ * version and entry layout, so a change to any of them simply misses.
+ *
+ * Entries are written to a temporary file and renamed into place, and
+ * read through a read-only mapping, so any number of threads and
+ * processes can share one directory.  Each hit refreshes the entry's
+ * mtime; once the directory grows past its size limit the least
+ * recently used entries are removed.
+ */
+
+/* Bump whenever the entry layout below changes */
+#define CACHE_FORMAT_VERSION 1
+
+struct COMPILER_CTX;
+
+typedef struct PARSE_CACHE {
+    char           *dir;
+    uint64_t        stamp;
+    uint64_t        maxBytes;
+    atomic_llong    approxBytes;    /* entry bytes, refreshed on eviction */
+    atomic_long     hits;
+    atomic_long     misses;
+    atomic_flag     evicting;
+} PARSE_CACHE;
+
+typedef PARSE_CACHE *parseCache;
+
+/* Fast 64-bit hash of a source text */
+uint64_t hashSource(const void *data, size_t len);
+
+/*
+ * Use (and create if needed) 'dir' for results of 'g' and 'pt', keeping
+ * it under 'maxBytes'.  NULL if the directory cannot be created.
+ */
+parseCache openParseCache(const char *dir, uint64_t maxBytes, const Grammar *g,
+                          const ParseTable *pt);
+
+void closeParseCache(parseCache c);
+
+/*
+ * Look up the source with hash 'key' and length 'srcLen'.  On a hit the
+ * entry is mapped and ctx's tokens, tree, diagnostics and error flag
+ * are filled from it (ctx must have been reset; the mapping is released
+ * by resetCompilerCtx).  Returns false on a miss.
+ */
+bool cacheLoad(parseCache c, uint64_t key, size_t srcLen, struct COMPILER_CTX *ctx);
+
+/* Save ctx's results for the source; failures are silent */
+void cacheStore(parseCache c, uint64_t key, size_t srcLen, const struct COMPILER_CTX *ctx);
+
+#endif /* CACHE_H */
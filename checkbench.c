@@ -0,0 +1,113 @@
+/*
+ * checkbench — scaling of the per-function type checker with threads.
+ *
+ *     ./checkbench [--size=N[K|M|G]] [--seed=N] [--runs=N] [--threads=N] [source_file]
+ *
+ * Without a file a program of --size bytes (default 16M) is generated
+ * as srcgen would.  The program is parsed and its symbol table built
+ * once; then checkProgram runs N times (default 5) on 1, 2, 4, ...
+ * threads up to --threads (default one per CPU).  Reports the median
+ * time, speedup over one thread and efficiency of each thread count.
+ * The diagnostics of every run must equal those of the one-thread run
+ * byte for byte, or it exits with status 1.
+ */
+#include "ast.h"
+#include "bench.h"
+#include "grammarTable.h"
+#include "pool.h"
+#include "progGen.h"
+#include "symbolTable.h"
+#include "typeChecker.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [--size=N[K|M|G]] [--seed=N] [--runs=N] [--threads=N] "
+                    "[source_file]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    GenOptions  opt      = { .size = 16 << 20, .seed = 1, .errorRate = 0, .maxDepth = 0 };
+    const char *srcPath  = NULL;
+    int         runs     = 5;
+    int         maxThreads = poolDefaultThreads();
+
+    for (int i = 1; i < argc; i++) {
+        const char *a   = argv[i];
+        char       *end = NULL;
+        if (strncmp(a, "--size=", 7) == 0 && (opt.size = parseSize(a + 7)) != 0)
+            ;
+        else if (strncmp(a, "--seed=", 7) == 0 &&
+                 ((opt.seed = strtoull(a + 7, &end, 10)), *end == '\0'))
+            ;
+        else if (strncmp(a, "--runs=", 7) == 0 &&
+                 (runs = (int)strtol(a + 7, &end, 10)) >= 1 && *end == '\0')
+            ;
+        else if (strncmp(a, "--threads=", 10) == 0 &&
+                 (maxThreads = (int)strtol(a + 10, &end, 10)) >= 1 && maxThreads <= 1024 &&
+                 *end == '\0')
+            ;
+        else if (a[0] != '-' && srcPath == NULL)
+            srcPath = a;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    BenchProgram prog;
+    if (!loadBenchProgram(srcPath, &opt, &prog))
+        return 1;
+
+    diagBuffer  tableDiag = createDiagBuffer();
+    symbolTable st        = buildSymbolTable(prog.ast, tableDiag);
+
+    /* 1, 2, 4, ... threads, and the maximum itself */
+    int counts[BENCH_MAX_PHASES], nCounts = 0;
+    for (int t = 1; t < maxThreads && nCounts < BENCH_MAX_PHASES - 1; t *= 2)
+        counts[nCounts++] = t;
+    counts[nCounts++] = maxThreads;
+
+    static char names[BENCH_MAX_PHASES][24];
+    benchReport r        = createBenchReport(srcPath ? srcPath : "generated", runs);
+    diagBuffer  expected = createDiagBuffer();
+    diagBuffer  got      = createDiagBuffer();
+    int         errors   = 0;
+    for (int i = 0; i < nCounts; i++) {
+        snprintf(names[i], sizeof names[i], "%d thread%s", counts[i], counts[i] == 1 ? "" : "s");
+        int ph = benchPhase(r, names[i]);
+        for (int run = 0; run < runs; run++) {
+            diagBuffer out = (i == 0 && run == 0) ? expected : got;
+            out->len = 0;
+            uint64_t t0 = benchNow();
+            errors = checkProgram(st, prog.ast, counts[i], out);
+            benchRecord(r, ph, benchNow() - t0);
+            if (out == got && (got->len != expected->len ||
+                               memcmp(got->text, expected->text, got->len) != 0)) {
+                fprintf(stderr, "%s: diagnostics on %d threads differ from one thread's\n",
+                        argv[0], counts[i]);
+                return 1;
+            }
+        }
+    }
+
+    printf("%s: %ld bytes, %d functions, %d symbols, %d semantic errors\n", r->source, prog.bytes,
+           st->nFuncs, st->nSyms, errors);
+    printf("%-12s %12s %10s %10s\n", "threads", "median ms", "speedup", "efficiency");
+    uint64_t base = benchMedian(r, 0);
+    for (int p = 0; p < r->nPhases; p++) {
+        uint64_t ns      = benchMedian(r, p);
+        double   speedup = ns > 0 ? (double)base / ns : 0.0;
+        printf("%-12s %12.3f %9.2fx %9.0f%%\n", r->phases[p].name, ns / 1e6, speedup,
+               100.0 * speedup / counts[p]);
+    }
+
+    freeDiagBuffer(expected);
+    freeDiagBuffer(got);
+    freeDiagBuffer(tableDiag);
+    freeSymbolTable(st);
+    freeBenchReport(r);
+    freeAstArena(prog.arena);
+    freeGrammarTables(prog.T);
+    return 0;
+}
@@ -0,0 +1,229 @@
+/*
+ * stage1client — thin client for the compile server (stage1exe --serve).
+ *
+ *     ./stage1client SOCKET lex|parse|check FILE [--inline]
+ *     ./stage1client SOCKET lex|parse|check FILE [--inline] --bench=N [--json]
+ *                    [--exe=PATH]
+ *     ./stage1client SOCKET quit
+ *
+ * The first form sends one request (the file name, or with --inline the
+ * file's contents) and prints the diagnostics and output; the exit
+ * status is 0 for "ok", 1 otherwise.  --bench=N instead times N
+ * requests end to end (connect, send, full response) and N cold runs
+ * of the compiler binary (default ./stage1exe) doing the same work, and
+ * reports both side by side.
+ */
+#include "bench.h"
+#include "protocol.h"
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+typedef struct {
+    char   status[8];
+    char  *diag;
+    size_t diagLen;
+    char  *out;
+    size_t outLen;
+} Response;
+
+static int connectServer(const char *sockPath) {
+    struct sockaddr_un addr;
+    if (strlen(sockPath) >= sizeof addr.sun_path)
+        return -1;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, sockPath);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof addr) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Read a whole response; the caller frees diag and out */
+static bool readResponse(int fd, Response *r) {
+    char head[PROTO_MAX_HEADER];
+    if (!readHeader(fd, head, sizeof head) ||
+        sscanf(head, "%7s %zu %zu", r->status, &r->diagLen, &r->outLen) != 3 ||
+        r->diagLen > PROTO_MAX_PAYLOAD || r->outLen > PROTO_MAX_PAYLOAD)
+        return false;
+
+    r->diag = (char *)malloc(r->diagLen + 1);
+    r->out  = (char *)malloc(r->outLen + 1);
+    if (!readFull(fd, r->diag, r->diagLen) || !readFull(fd, r->out, r->outLen)) {
+        free(r->diag);
+        free(r->out);
+        return false;
+    }
+    r->diag[r->diagLen] = '\0';
+    r->out[r->outLen]   = '\0';
+    return true;
+}
+
+/* One request on a fresh connection */
+static bool request(const char *sockPath, const char *cmd, const char *kind,
+                    const char *payload, size_t len, Response *r) {
+    int fd = connectServer(sockPath);
+    if (fd < 0)
+        return false;
+
+    char head[PROTO_MAX_HEADER];
+    int  n  = snprintf(head, sizeof head, "%s %s %zu\n", cmd, kind, len);
+    bool ok = writeFull(fd, head, (size_t)n) && writeFull(fd, payload, len) &&
+              readResponse(fd, r);
+    close(fd);
+    return ok;
+}
+
+static char *readFile(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return NULL;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    char *buf = (char *)malloc(size > 0 ? (size_t)size : 1);
+    *len = fread(buf, 1, (size_t)size, fp);
+    fclose(fp);
+    return buf;
+}
+
+/* One cold compiler run with its output discarded */
+static bool coldRun(const char *exe, const char *mode, const char *file) {
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_addopen(&fa, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+    char *argv[] = { (char *)exe, (char *)mode, (char *)file, (char *)"/dev/null", NULL };
+    pid_t pid;
+    int   rc = posix_spawn(&pid, exe, &fa, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    if (rc != 0)
+        return false;
+
+    int status;
+    return waitpid(pid, &status, 0) == pid && WIFEXITED(status);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s SOCKET lex|parse|check FILE [--inline] [--bench=N [--json] [--exe=PATH]]\n"
+            "       %s SOCKET quit\n", prog, prog);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 3 && strcmp(argv[2], "quit") == 0) {
+        Response r;
+        if (!request(argv[1], "quit", "path", "", 0, &r)) {
+            perror(argv[1]);
+            return 1;
+        }
+        free(r.diag);
+        free(r.out);
+        return 0;
+    }
+    if (argc < 4) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const char *sockPath = argv[1];
+    const char *cmd      = argv[2];
+    const char *file     = argv[3];
+    const char *exe      = "./stage1exe";
+    bool        inlineSrc = false, json = false;
+    int         runs     = 0;
+
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "--inline") == 0)
+            inlineSrc = true;
+        else if (strcmp(argv[i], "--json") == 0)
+            json = true;
+        else if (strncmp(argv[i], "--bench=", 8) == 0)
+            runs = atoi(argv[i] + 8);
+        else if (strncmp(argv[i], "--exe=", 6) == 0)
+            exe = argv[i] + 6;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (strcmp(cmd, "lex") != 0 && strcmp(cmd, "parse") != 0 && strcmp(cmd, "check") != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    size_t srcLen = 0;
+    char  *src    = readFile(file, &srcLen);
+    if (src == NULL) { perror(file); return 1; }
+
+    const char *kind       = inlineSrc ? "source" : "path";
+    const char *payload    = inlineSrc ? src : file;
+    size_t      payloadLen = inlineSrc ? srcLen : strlen(file);
+
+    if (runs <= 0) {
+        Response r;
+        if (!request(sockPath, cmd, kind, payload, payloadLen, &r)) {
+            perror(sockPath);
+            free(src);
+            return 1;
+        }
+        fputs(r.diag, stdout);
+        fputs(r.out, stdout);
+        int status = strcmp(r.status, "ok") == 0 ? 0 : 1;
+        free(r.diag);
+        free(r.out);
+        free(src);
+        return status;
+    }
+
+    /* ---- latency: warm server vs cold process ---- */
+    benchReport rep    = createBenchReport(file, runs);
+    int         phWarm = benchPhase(rep, "server");
+    int         phCold = benchPhase(rep, "cold");
+    const char *mode   = strcmp(cmd, "lex") == 0 ? "--tokens" : "--tree";
+    rep->bytes = srcLen;
+
+    int status = 0;
+    for (int i = 0; i < runs && status == 0; i++) {
+        Response r;
+        uint64_t t0 = benchNow();
+        if (!request(sockPath, cmd, kind, payload, payloadLen, &r)) {
+            perror(sockPath);
+            status = 1;
+            break;
+        }
+        uint64_t t1 = benchNow();
+        free(r.diag);
+        free(r.out);
+
+        if (!coldRun(exe, mode, file)) {
+            fprintf(stderr, "%s: could not run\n", exe);
+            status = 1;
+            break;
+        }
+        uint64_t t2 = benchNow();
+
+        benchRecord(rep, phWarm, t1 - t0);
+        benchRecord(rep, phCold, t2 - t1);
+    }
+
+    if (status == 0)
+        printBenchReport(rep, json, stdout);
+    freeBenchReport(rep);
+    free(src);
+    return status;
+}
@@ -0,0 +1,113 @@
+#include "compilerCtx.h"
+#include "cache.h"
+#include "lexer.h"
+#include "memTrack.h"
+#include "parser.h"
+#include <stdlib.h>
+#include <sys/mman.h>
+
+compilerCtx createCompilerCtx(const Grammar *g, const ParseTable *pt, FILE *out) {
+    compilerCtx ctx = (compilerCtx)calloc(1, sizeof(COMPILER_CTX));
+    ctx->g        = g;
+    ctx->pt       = pt;
+    ctx->keywords = keywordTable();
+    ctx->diag     = createDiagBuffer();
+    ctx->out      = out;
+    return ctx;
+}
+
+void resetCompilerCtx(compilerCtx ctx) {
+    freeParseTree(ctx->tree);
+    ctx->tree = NULL;
+
+    if (ctx->tokens != NULL) {
+        /* after a cache hit the lexemes live in the mapped entry */
+        if (ctx->cacheMap == NULL)
+            for (int i = 0; i < ctx->tokens->count; i++)
+                memFree(ctx->tokens->toks[i].lexeme);
+        freeTokenStream(ctx->tokens);
+        ctx->tokens = NULL;
+    }
+    if (ctx->cacheMap != NULL) {
+        munmap(ctx->cacheMap, ctx->cacheLen);
+        ctx->cacheMap = NULL;
+        ctx->cacheLen = 0;
+    }
+
+    ctx->diag->len     = 0;
+    ctx->diag->text[0] = '\0';
+    ctx->hadError      = false;
+}
+
+void freeCompilerCtx(compilerCtx ctx) {
+    if (ctx == NULL)
+        return;
+    resetCompilerCtx(ctx);
+    freeDiagBuffer(ctx->diag);
+    free(ctx);
+}
+
+void compileTokenize(compilerCtx ctx, FILE *src) {
+    resetCompilerCtx(ctx);
+    ctx->tokens = tokenizeWith(src, ctx->keywords, ctx->diag);
+    if (ctx->diag->len > 0)
+        ctx->hadError = true;
+}
+
+ParseTreeNode *compileParse(compilerCtx ctx) {
+    bool hadError;
+    freeParseTree(ctx->tree);
+    ctx->tree = parseTokenStream(ctx->pt, ctx->g, ctx->tokens, ctx->diag, &hadError);
+    ctx->hadError = ctx->hadError || hadError;
+    return ctx->tree;
+}
+
+/* The rest of 'src' in one malloc'd buffer */
+static char *readAll(FILE *src, size_t *len) {
+    size_t cap = 1 << 16;
+    size_t n   = 0;
+    char  *buf = (char *)malloc(cap);
+    for (;;) {
+        n += fread(buf + n, 1, cap - n, src);
+        if (n < cap)
+            break;
+        cap *= 2;
+        buf = (char *)realloc(buf, cap);
+    }
+    *len = n;
+    return buf;
+}
+
+ParseTreeNode *compileSource(compilerCtx ctx, FILE *src) {
+    if (ctx->cache == NULL) {
+        compileTokenize(ctx, src);
+        return compileParse(ctx);
+    }
+
+    size_t   len;
+    char    *text = readAll(src, &len);
+    uint64_t key  = hashSource(text, len);
+
+    resetCompilerCtx(ctx);
+    if (!cacheLoad(ctx->cache, key, len, ctx)) {
+        /* fmemopen may refuse an empty buffer */
+        FILE *mem = len > 0 ? fmemopen(text, len, "r") : fopen("/dev/null", "r");
+        if (mem != NULL) {
+            compileTokenize(ctx, mem);
+            fclose(mem);
+            compileParse(ctx);
+            cacheStore(ctx->cache, key, len, ctx);
+        } else {
+            rewind(src);
+            compileTokenize(ctx, src);
+            compileParse(ctx);
+        }
+    }
+    free(text);
+    return ctx->tree;
+}
+
+void compileWriteTree(compilerCtx ctx) {
+    if (ctx->out != NULL)
+        printParseTree(ctx->tree, ctx->out);
+}
@@ -0,0 +1,62 @@
+#ifndef COMPILER_CTX_H
+#define COMPILER_CTX_H
+
+#include "diag.h"
+#include "lexerDef.h"
+#include "parserDef.h"
+#include "trie.h"
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Everything one compilation touches.  The grammar, parse table and
+ * keyword trie are shared and read-only; the token stream, tree and
+ * diagnostics belong to this context alone.  Nothing below reads
+ * process-wide or thread-local state, so any number of contexts can be
+ * used at once, one thread each.
+ *
+ * There is no allocator per context: tokens, lexemes and tree nodes come
+ * from memTrack's tagged layer, which is plain malloc (thread-safe) or,
+ * with MEM_ACCOUNTING, atomic counters that are meant to be process-wide.
+ * A context frees every block it caused in resetCompilerCtx.
+ */
+typedef struct COMPILER_CTX {
+    const Grammar    *g;
+    const ParseTable *pt;
+    trie              keywords;
+    diagBuffer        diag;     /* lexical and syntax errors, in source order */
+    FILE             *out;      /* listing sink; NULL discards listings */
+    tokenStream       tokens;   /* owned, lexemes included */
+    ParseTreeNode    *tree;     /* owned */
+    bool              hadError;
+    struct PARSE_CACHE *cache;  /* optional, shared; see cache.h */
+    void             *cacheMap; /* entry the lexemes point into after a hit */
+    size_t            cacheLen;
+} COMPILER_CTX;
+
+typedef COMPILER_CTX *compilerCtx;
+
+compilerCtx createCompilerCtx(const Grammar *g, const ParseTable *pt, FILE *out);
+
+/* Drop the previous file's tokens, tree and diagnostics */
+void resetCompilerCtx(compilerCtx ctx);
+
+void freeCompilerCtx(compilerCtx ctx);
+
+/* Lex 'src' into ctx->tokens (after a reset); lexical errors go to ctx->diag */
+void compileTokenize(compilerCtx ctx, FILE *src);
+
+/* Parse ctx->tokens into ctx->tree; sets ctx->hadError */
+ParseTreeNode *compileParse(compilerCtx ctx);
+
+/*
+ * compileTokenize + compileParse.  With ctx->cache set the whole source
+ * is read first and the results come from the cache when its bytes have
+ * been compiled before; otherwise they are stored there afterwards.
+ */
+ParseTreeNode *compileSource(compilerCtx ctx, FILE *src);
+
+/* Write ctx->tree to ctx->out */
+void compileWriteTree(compilerCtx ctx);
+
+#endif /* COMPILER_CTX_H */
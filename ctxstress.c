@@ -0,0 +1,135 @@
+/*
+ * ctxstress — compiler contexts on many threads at once.
+ *
+ *     ./ctxstress [--threads=N] [--files=N] [--rounds=N] [--seed=N]
+ *
+ * Generates --files programs (default 8), every other one with injected
+ * lexical and syntax errors, and compiles each once in one context to
+ * get its reference parse tree and diagnostics.  Then --threads workers
+ * (default 4), each with a context of its own, compile all the programs
+ * --rounds times (default 4), every worker starting at a different one,
+ * and compare each tree and diagnostic text byte for byte with the
+ * reference.  Exits 1 if any of them differs.
+ *
+ * `make tsan-stress` builds it with -fsanitize=thread and runs it; any
+ * data race between the contexts is then reported as well.
+ */
+#include "compilerCtx.h"
+#include "grammarTable.h"
+#include "pool.h"
+#include "progGen.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char  *src;
+    size_t srcLen;
+    char  *tree;        /* reference tree listing and diagnostic text */
+    size_t treeLen;
+    char  *diag;
+} Input;
+
+typedef struct {
+    grammarTables T;
+    Input        *inputs;
+    int           nInputs;
+    int           rounds;
+    atomic_int    mismatches;
+} Stress;
+
+static bool intOption(const char *a, const char *name, long lo, long hi, long *v) {
+    size_t n = strlen(name);
+    if (strncmp(a, name, n) != 0)
+        return false;
+    char *end;
+    *v = strtol(a + n, &end, 10);
+    return end != a + n && *end == '\0' && *v >= lo && *v <= hi;
+}
+
+/* Compile one input in 'ctx'; its tree listing (malloc'd) in *tree */
+static void compileInput(compilerCtx ctx, const Input *in, char **tree, size_t *treeLen) {
+    FILE *src = fmemopen(in->src, in->srcLen, "r");
+    compileSource(ctx, src);
+    fclose(src);
+    ctx->out = open_memstream(tree, treeLen);
+    compileWriteTree(ctx);
+    fclose(ctx->out);
+    ctx->out = NULL;
+}
+
+static void stressTask(int k, void *arg) {
+    Stress     *s   = (Stress *)arg;
+    compilerCtx ctx = createCompilerCtx(s->T->g, s->T->pt, NULL);
+
+    for (int r = 0; r < s->rounds; r++)
+        for (int i = 0; i < s->nInputs; i++) {
+            const Input *in = &s->inputs[(k + i) % s->nInputs];
+            char        *tree;
+            size_t       treeLen;
+            compileInput(ctx, in, &tree, &treeLen);
+            if (treeLen != in->treeLen || memcmp(tree, in->tree, treeLen) != 0 ||
+                strcmp(ctx->diag->text, in->diag) != 0) {
+                fprintf(stderr, "thread %d: input %d differs from the sequential run\n", k,
+                        (int)(in - s->inputs));
+                atomic_fetch_add(&s->mismatches, 1);
+            }
+            free(tree);
+        }
+    freeCompilerCtx(ctx);
+}
+
+int main(int argc, char *argv[]) {
+    long threads = 4, files = 8, rounds = 4, seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        if (!intOption(a, "--threads=", 1, 256, &threads) &&
+            !intOption(a, "--files=", 1, 1024, &files) &&
+            !intOption(a, "--rounds=", 1, 1000, &rounds) &&
+            !intOption(a, "--seed=", 0, 1L << 62, &seed)) {
+            fprintf(stderr, "Usage: %s [--threads=N] [--files=N] [--rounds=N] [--seed=N]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    diagBuffer    gdiag = createDiagBuffer();
+    grammarTables T     = loadGrammarTables(GRAMMAR_FILE, GRAMMAR_BLOB, gdiag);
+    diagFlush(gdiag, stderr);
+    freeDiagBuffer(gdiag);
+    if (T == NULL)
+        return 1;
+
+    /* the references, one context, one thread */
+    Stress      s       = { T, (Input *)calloc(files, sizeof(Input)), (int)files, (int)rounds,
+                            0 };
+    compilerCtx ctx     = createCompilerCtx(T->g, T->pt, NULL);
+    int         withErr = 0;
+    for (int i = 0; i < files; i++) {
+        Input     *in  = &s.inputs[i];
+        GenOptions opt = { .size = 16 << 10, .seed = (uint64_t)seed + i,
+                           .errorRate = (i % 2) ? 0.002 : 0.0 };
+        FILE      *out = open_memstream(&in->src, &in->srcLen);
+        generateProgram(T->g, &opt, out);
+        fclose(out);
+        compileInput(ctx, in, &in->tree, &in->treeLen);
+        in->diag = strdup(ctx->diag->text);
+        withErr += in->diag[0] != '\0';
+    }
+    freeCompilerCtx(ctx);
+
+    runPool((int)threads, (int)threads, stressTask, &s);
+    int mismatches = atomic_load(&s.mismatches);
+    printf("%ld thread(s) x %ld round(s) x %ld file(s), %d with errors: %d mismatch(es)\n",
+           threads, rounds, files, withErr, mismatches);
+
+    for (int i = 0; i < files; i++) {
+        free(s.inputs[i].src);
+        free(s.inputs[i].tree);
+        free(s.inputs[i].diag);
+    }
+    free(s.inputs);
+    freeGrammarTables(T);
+    return mismatches > 0;
+}
@@ -0,0 +1,69 @@
+#include "diag.h"
+#include <stdarg.h>
+#include <stdlib.h>
+
+/*
+ * createDiagBuffer — start with a small buffer; it doubles on demand.
+ */
+diagBuffer createDiagBuffer(void) {
+    diagBuffer d = (diagBuffer)malloc(sizeof(DIAG_BUFFER));
+    d->cap     = 256;
+    d->len     = 0;
+    d->text    = (char *)malloc(d->cap);
+    d->text[0] = '\0';
+    return d;
+}
+
+/*
+ * diagVPrintf — format straight into the free space; only text that
+ * does not fit is formatted a second time, after the buffer has grown.
+ * With d == NULL this is plain vprintf.
+ */
+void diagVPrintf(diagBuffer d, const char *fmt, va_list ap) {
+    va_list again;
+
+    if (d == NULL) {
+        vprintf(fmt, ap);
+        return;
+    }
+
+    va_copy(again, ap);
+    int need = vsnprintf(d->text + d->len, d->cap - d->len, fmt, ap);
+    if (need >= 0 && d->len + need + 1 > d->cap) {
+        while (d->len + need + 1 > d->cap)
+            d->cap *= 2;
+        d->text = (char *)realloc(d->text, d->cap);
+        vsnprintf(d->text + d->len, d->cap - d->len, fmt, again);
+    }
+    va_end(again);
+    if (need < 0) {
+        d->text[d->len] = '\0';
+        return;
+    }
+    d->len += need;
+}
+
+void diagPrintf(diagBuffer d, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    diagVPrintf(d, fmt, ap);
+    va_end(ap);
+}
+
+/*
+ * diagFlush — emit everything collected so far.
+ */
+void diagFlush(diagBuffer d, FILE *out) {
+    if (d == NULL || d->len == 0)
+        return;
+    fwrite(d->text, 1, d->len, out);
+    d->len     = 0;
+    d->text[0] = '\0';
+}
+
+void freeDiagBuffer(diagBuffer d) {
+    if (d == NULL)
+        return;
+    free(d->text);
+    free(d);
+}
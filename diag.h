@@ -0,0 +1,34 @@
+#ifndef DIAG_H
+#define DIAG_H
+
+#include <stdarg.h>
+#include <stdio.h>
+
+/*
+ * Growable text buffer that collects diagnostics so they can be emitted
+ * later in a fixed order (e.g. after parallel work has finished).
+ */
+typedef struct DIAG_BUFFER {
+    char *text;
+    int   len;
+    int   cap;
+} DIAG_BUFFER;
+
+typedef DIAG_BUFFER *diagBuffer;
+
+/* Allocate an empty buffer */
+diagBuffer createDiagBuffer(void);
+
+/* Append formatted text; a NULL buffer writes straight to stdout */
+void diagPrintf(diagBuffer d, const char *fmt, ...);
+
+/* The same with a va_list, for callers that wrap their own prefix around a message */
+void diagVPrintf(diagBuffer d, const char *fmt, va_list ap);
+
+/* Write the collected text to 'out' and empty the buffer */
+void diagFlush(diagBuffer d, FILE *out);
+
+/* Release the buffer and its text */
+void freeDiagBuffer(diagBuffer d);
+
+#endif /* DIAG_H */
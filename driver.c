@@ -1,8 +1,54 @@
+#include "ast.h"
+#include "batch.h"
+#include "bench.h"
+#include "bytecode.h"
+#include "cache.h"
+#include "compilerCtx.h"
+#include "grammarTable.h"
+#include "ir.h"
+#include "irOpt.h"
 #include "lexer.h"
+#include "lsp.h"
+#include "memTrack.h"
 #include "parser.h"
 #include "parserDef.h"
+#include "pool.h"
+#include "rdRuntime.h"
+#include "server.h"
+#include "stats.h"
+#include "symbolTable.h"
+#include "typeChecker.h"
+#include "typeLayout.h"
 #include "utils.h"
-#include <time.h>
+#include "vm.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Running totals gathered from the event-streaming parser (option 5) */
+typedef struct {
+    long rulesExpanded;
+    long tokensMatched;
+    int  depth;
+    int  maxDepth;
+} ValidateStats;
+
+static void onEnter(NON_TERMINAL nt, int ruleIdx, void *user) {
+    ValidateStats *vs = (ValidateStats *)user;
+    (void)nt; (void)ruleIdx;
+    vs->rulesExpanded++;
+    if (++vs->depth > vs->maxDepth)
+        vs->maxDepth = vs->depth;
+}
+
+static void onMatch(tokenInfo tok, void *user) {
+    (void)tok;
+    ((ValidateStats *)user)->tokensMatched++;
+}
+
+static void onExit(NON_TERMINAL nt, void *user) {
+    (void)nt;
+    ((ValidateStats *)user)->depth--;
+}
 
 static const char *MENU_TEXT =
     "\nWhat would you like to do?\n"
@@ -11,19 +57,375 @@ static const char *MENU_TEXT =
     "  2) Print Token Stream\n"
     "  3) Parse Source Code and Print Parse Tree\n"
     "  4) Parse Source Code and Report Time Taken\n"
+    "  5) Validate Syntax Only (event stream, no parse tree)\n"
+    "  6) Parse Functions in Parallel and Print Parse Tree\n"
+    "  7) Parse with Generated Recursive-Descent Parser and Print Parse Tree\n"
+    "  8) Parse with Pipelined Lexer Thread and Print Parse Tree\n"
+    "  9) Build Abstract Syntax Tree and Compare with Parse Tree\n"
     "==> ";
 
-int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <source_file> <output_file>\n", argv[0]);
+/* ------------------------------------------------------------------
+ * Command-line modes
+ * ------------------------------------------------------------------ */
+
+typedef enum {
+    CLI_MENU,
+    CLI_TOKENS,
+    CLI_STRIP,
+    CLI_TREE,
+    CLI_AST,
+    CLI_SYMBOLS,
+    CLI_CHECK,
+    CLI_IR,
+    CLI_BYTECODE,
+    CLI_IMAGE,
+    CLI_RUN,
+    CLI_BENCH,
+    CLI_BATCH,
+    CLI_SERVE,
+    CLI_LSP,
+} CLI_MODE;
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s <source_file> <output_file>\n"
+            "       %s MODE [--json] [--stats=FILE] <source_file> [output_file]\n"
+            "       %s --batch [--jobs=N] [--cache=DIR] <directory|list_file> <output_dir>\n"
+            "       %s --serve <socket_path>\n"
+            "       %s --lsp [--record=FILE]\n"
+            "Modes:\n"
+            "  --tokens    print the token stream\n"
+            "  --strip     print the source without comments\n"
+            "  --tree      parse and write the parse tree (stdout if no output file)\n"
+            "  --ast       build the AST and write its listing (same)\n"
+            "  --symbols   build the AST and the symbol table and list the table\n"
+            "  --check     build the symbol table and type check every function,\n"
+            "              --jobs=N functions at a time (default: one per CPU); a\n"
+            "              clean program's AST goes to output_file with field offsets\n"
+            "  --ir        check the program and list its SSA intermediate code\n"
+            "  --bytecode  check and lower the program, or take an image, and list its\n"
+            "              VM bytecode\n"
+            "  --image     compile the program to a bytecode image in output_file\n"
+            "  --run       compile the program to bytecode and run it on the VM: read\n"
+            "              from stdin, write to output_file (stdout if none); an image\n"
+            "              from --image runs as it is, with no tables, parse or compile\n"
+            "  --profile   with --run: instructions executed per opcode (stderr)\n"
+            "  -ON         with --ir, --bytecode, --image or --run: optimise first, N = 0\n"
+            "              (none, the default), 1 (fold, dce), 2 (fold, gvn, fold, dce) or\n"
+            "              3 (inline, then 2 with licm and iv after the first gvn)\n"
+            "  --passes=L  with --ir, --bytecode, --image or --run: run the comma list L\n"
+            "              of fold, gvn, dce, licm, iv and inline instead of an -O level\n"
+            "  --time-passes  with --ir, --bytecode, --image or --run: time each pass and\n"
+            "              count its removals and inlined calls; with --run also the time\n"
+            "              to the first instruction and the instructions executed (stderr)\n"
+            "  --bench=N   run tables / lex / parse / output N times and report\n"
+            "              min, median and p99 per phase with throughput\n"
+            "  --json      print the --bench report as JSON\n"
+            "  --stats=F   with --tokens, --tree, --ast, --bench or --batch: write the\n"
+            "              front-end counters of all threads to F as JSON (needs make STATS=1)\n"
+            "  --batch     parse every file of a directory (or listed in a file)\n"
+            "              on a worker pool; trees and error logs go to output_dir\n"
+            "  --jobs=N    worker threads for --batch or --check (default: one per CPU)\n"
+            "  --cache=D   with --tree or --batch: keep token streams and trees in\n"
+            "              directory D and reuse them for unchanged sources\n"
+            "  --cache-size=MB  limit for D, oldest entries go first (default 256)\n"
+            "  --serve     keep the tables loaded and answer lex / parse / check\n"
+            "              requests on a Unix socket (see stage1client)\n"
+            "  --lsp       language server on stdin / stdout; edits re-lex and\n"
+            "              re-parse only the functions they touch\n"
+            "  --record=F  with --lsp: append every message received to F, one\n"
+            "              JSON object per line (see lspreplay)\n"
+            "Without a mode the interactive menu is shown.\n",
+            prog, prog, prog, prog, prog);
+}
+
+/* Load the tables as at startup, reporting grammar problems on stderr */
+static grammarTables loadTables(void) {
+    diagBuffer    gdiag = createDiagBuffer();
+    grammarTables T     = loadGrammarTables(GRAMMAR_FILE, GRAMMAR_BLOB, gdiag);
+    diagFlush(gdiag, stderr);
+    freeDiagBuffer(gdiag);
+    return T;
+}
+
+/*
+ * --bench=N: every run repeats the whole pipeline — load the tables,
+ * lex the file into a token stream, parse it, write the tree (to the
+ * output file, or /dev/null) — and times each phase on the monotonic
+ * clock.  Diagnostics stay in the run's compiler context and are
+ * dropped, so that only the report is printed.
+ */
+static int runBench(const char *srcPath, const char *outPath, int runs, bool json) {
+    FILE *srcFP = fopen(srcPath, "r");
+    if (!srcFP) { perror(srcPath); return 1; }
+
+    benchReport r = createBenchReport(srcPath, runs);
+    fseek(srcFP, 0, SEEK_END);
+    r->bytes = (size_t)ftell(srcFP);
+
+    int phTables = benchPhase(r, "tables");
+    int phLex    = benchPhase(r, "lex");
+    int phParse  = benchPhase(r, "parse");
+    int phOutput = benchPhase(r, "output");
+    int phTotal  = benchPhase(r, "total");
+
+    int status = 0;
+    for (int run = 0; run < runs && status == 0; run++) {
+        rewind(srcFP);
+        FILE *outFP = fopen(outPath ? outPath : "/dev/null", "w");
+        if (!outFP) { perror(outPath ? outPath : "/dev/null"); status = 1; break; }
+        diagBuffer quiet = createDiagBuffer();
+
+        uint64_t t0 = benchNow();
+        grammarTables T = loadGrammarTables(GRAMMAR_FILE, GRAMMAR_BLOB, quiet);
+        uint64_t t1 = benchNow();
+
+        if (T == NULL) {
+            diagFlush(quiet, stderr);
+            status = 1;
+        } else {
+            compilerCtx ctx = createCompilerCtx(T->g, T->pt, outFP);
+            compileTokenize(ctx, srcFP);
+            uint64_t t2 = benchNow();
+
+            compileParse(ctx);
+            uint64_t t3 = benchNow();
+
+            compileWriteTree(ctx);
+            fflush(outFP);
+            uint64_t t4 = benchNow();
+
+            benchRecord(r, phTables, t1 - t0);
+            benchRecord(r, phLex,    t2 - t1);
+            benchRecord(r, phParse,  t3 - t2);
+            benchRecord(r, phOutput, t4 - t3);
+            benchRecord(r, phTotal,  t4 - t0);
+            r->tokens = ctx->tokens->count - 1;
+
+            freeCompilerCtx(ctx);
+            freeGrammarTables(T);
+        }
+
+        freeDiagBuffer(quiet);
+        fclose(outFP);
+    }
+
+    if (status == 0)
+        printBenchReport(r, json, stdout);
+
+    freeBenchReport(r);
+    fclose(srcFP);
+    return status;
+}
+
+/* --cache=DIR: NULL (and a message) if the directory cannot be used */
+static parseCache openCache(const char *dir, uint64_t maxBytes, grammarTables T) {
+    parseCache c = openParseCache(dir, maxBytes, T->g, T->pt);
+    if (c == NULL)
+        perror(dir);
+    return c;
+}
+
+/* The last line of the compile messages, once every phase has run */
+static void printVerdict(bool ok) {
+    printf(ok ? "COMPILATION SUCCESS!\n" : "COMPILATION FAILED\n");
+}
+
+/*
+ * --tree through a parse cache: the whole file is lexed before parsing,
+ * so lexical errors are listed ahead of syntax errors.
+ */
+static void runCachedTree(grammarTables T, parseCache cache, FILE *srcFP, FILE *outFP) {
+    compilerCtx ctx = createCompilerCtx(T->g, T->pt, outFP);
+    ctx->cache = cache;
+    compileSource(ctx, srcFP);
+    diagFlush(ctx->diag, stdout);
+    printVerdict(!ctx->hadError);
+    fflush(stdout);
+    compileWriteTree(ctx);
+    freeCompilerCtx(ctx);
+}
+
+/* --run: 'start' is when the driver began, for the time to the first instruction */
+static int runBytecode(const BC_MODULE *bc, FILE *outFP, uint64_t start, bool timePasses,
+                       bool profile) {
+    VM_RUN run = { .in = stdin, .out = outFP };
+    if (timePasses)
+        fprintf(stderr, "first instruction after %.3f ms\n", (benchNow() - start) / 1e6);
+    VM_STATUS vs = vmRun(bc, &run);
+    if (vs != VM_OK)
+        fprintf(stderr, "Run error at line %d: %s\n", run.line, vmStatusText(vs));
+    if (timePasses)
+        fprintf(stderr, "executed: %llu instructions\n", (unsigned long long)run.steps);
+    if (profile)
+        vmPrintCounts(&run, stderr);
+    return vs != VM_OK;
+}
+
+/* --run / --bytecode of an image: mapped and used as it is */
+static int runImage(CLI_MODE mode, const char *imagePath, const char *outPath, uint64_t start,
+                    bool timePasses, bool profile) {
+    BC_IMAGE_STATUS why;
+    bcModule        bc = mapBcImage(imagePath, &why);
+    if (bc == NULL) {
+        if (why == BC_IMAGE_UNREADABLE)
+            perror(imagePath);
+        else
+            fprintf(stderr, "%s: %s\n", imagePath, bcImageStatusText(why));
         return 1;
     }
+    FILE *outFP = outPath ? fopen(outPath, "w") : stdout;
+    if (!outFP) { perror(outPath); freeBcModule(bc); return 1; }
+
+    int status = 0;
+    if (mode == CLI_BYTECODE)
+        printBytecode(bc, outFP);
+    else
+        status = runBytecode(bc, outFP, start, timePasses, profile);
+
+    if (outFP != stdout)
+        fclose(outFP);
+    freeBcModule(bc);
+    return status;
+}
+
+/*
+ * --tree / --ast / --symbols / --check / --ir / --bytecode / --image / --run:
+ * one parse, listing to 'outPath' or stdout
+ */
+static int runParse(CLI_MODE mode, const char *srcPath, const char *outPath,
+                    const char *cacheDir, uint64_t cacheBytes, int jobs,
+                    const IR_PIPELINE *pipeline, uint64_t start, bool timePasses, bool profile) {
+    FILE *srcFP = fopen(srcPath, "r");
+    if (!srcFP) { perror(srcPath); return 1; }
+    /* an image is written aside and renamed over outPath */
+    FILE *outFP = (outPath && mode != CLI_IMAGE) ? fopen(outPath, "w") : stdout;
+    if (!outFP) { perror(outPath); fclose(srcFP); return 1; }
+
+    grammarTables T = loadTables();
+    int status = 1;
+    if (T != NULL) {
+        if (mode == CLI_TREE && cacheDir != NULL) {
+            parseCache cache = openCache(cacheDir, cacheBytes, T);
+            if (cache != NULL) {
+                runCachedTree(T, cache, srcFP, outFP);
+                closeParseCache(cache);
+                status = 0;
+            }
+        } else if (mode == CLI_TREE) {
+            ParseTreeNode *root = parseSourceCode(T->pt, T->g, srcFP);
+            printParseTree(root, outFP);
+            freeParseTree(root);
+            status = 0;
+        } else {
+            astArena arena;
+            AstNode *ast = parseSourceAST(T->pt, T->g, srcFP, &arena, NULL);
+            if (ast == NULL)
+                printVerdict(false);
+            if (ast != NULL && mode == CLI_SYMBOLS) {
+                diagBuffer  diag = createDiagBuffer();
+                symbolTable st   = buildSymbolTable(ast, diag);
+                status = diag->len > 0;
+                diagFlush(diag, stdout);
+                printVerdict(status == 0);
+                printSymbolTable(st, outFP);
+                freeSymbolTable(st);
+                freeDiagBuffer(diag);
+                freeAstArena(arena);
+            } else if (ast != NULL && (mode == CLI_CHECK || mode == CLI_IR ||
+                                       mode == CLI_BYTECODE || mode == CLI_IMAGE ||
+                                       mode == CLI_RUN)) {
+                /* table errors first, then each function's in source order */
+                diagBuffer  diag = createDiagBuffer();
+                symbolTable st   = buildSymbolTable(ast, diag);
+                checkProgram(st, ast, jobs > 0 ? jobs : poolDefaultThreads(), diag);
+                status = diag->len > 0;
+                diagFlush(diag, stdout);
+                printVerdict(status == 0);
+                if (status == 0 && mode != CLI_CHECK) {
+                    irModule      ir = lowerProgram(st, ast);
+                    IR_PASS_STATS stats[IR_MAX_PIPELINE];
+                    irOptimize(ir, pipeline, timePasses ? stats : NULL);
+                    if (timePasses)
+                        irPrintPassStats(pipeline, stats, stderr);
+                    if (mode == CLI_IR) {
+                        printIr(ir, outFP);
+                    } else {
+                        bcModule bc = compileBytecode(ir);
+                        if (mode == CLI_BYTECODE) {
+                            printBytecode(bc, outFP);
+                        } else if (mode == CLI_IMAGE) {
+                            if (!writeBcImage(outPath, bc)) {
+                                perror(outPath);
+                                status = 1;
+                            }
+                        } else {
+                            status = runBytecode(bc, outFP, start, timePasses, profile);
+                        }
+                        freeBcModule(bc);
+                    }
+                    freeIrModule(ir);
+                } else if (status == 0 && outPath != NULL) {
+                    /* a clean program: list it with each field access as one offset */
+                    layoutAccesses(st, ast);
+                    printAst(ast, outFP);
+                }
+                freeSymbolTable(st);
+                freeDiagBuffer(diag);
+                freeAstArena(arena);
+            } else if (ast != NULL) {
+                printVerdict(true);
+                printAst(ast, outFP);
+                freeAstArena(arena);
+                status = 0;
+            }
+        }
+        freeGrammarTables(T);
+    }
 
-    /* Build parser infrastructure once at startup */
-    Grammar     G  = initializeGrammar();
-    FirstFollow ff = computeFirstFollow(G);
-    ParseTable  PT;
-    buildParseTable(ff, &PT);
+    if (outFP != stdout)
+        fclose(outFP);
+    fclose(srcFP);
+    return status;
+}
+
+/* --stats=FILE: what this thread, and any workers it joined, lexed and parsed */
+static int writeStats(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) { perror(path); return 1; }
+    printStatsJson(frontendStats(), fp);
+    fclose(fp);
+    return 0;
+}
+
+/* --batch: tables are loaded once and shared by every worker */
+static int runBatch(const char *listPath, const char *outDir, int nThreads,
+                    const char *cacheDir, uint64_t cacheBytes) {
+    int    n;
+    char **paths = collectSources(listPath, &n);
+    if (paths == NULL) { perror(listPath); return 1; }
+
+    grammarTables T = loadTables();
+    int failed = 1;
+    parseCache    cache = (T != NULL && cacheDir != NULL) ? openCache(cacheDir, cacheBytes, T)
+                                                            : NULL;
+    if (T != NULL && (cache != NULL || cacheDir == NULL))
+        failed = compileBatch(T->pt, T->g, paths, n, outDir,
+                              nThreads > 0 ? nThreads : poolDefaultThreads(), cache, stdout);
+    closeParseCache(cache);
+    freeGrammarTables(T);
+    freeSources(paths, n);
+    return failed > 0;
+}
+
+/* ------------------------------------------------------------------
+ * Interactive menu (no mode given)
+ * ------------------------------------------------------------------ */
+static int runMenu(char *srcPath, char *outPath) {
+    /* Map the LL(1) tables (regenerated if grammar.bnf has changed) */
+    grammarTables T = loadTables();
+    if (T == NULL)
+        return 1;
 
     int choice;
     for (;;) {
@@ -32,18 +434,19 @@ int main(int argc, char *argv[]) {
 
         switch (choice) {
         case 0:
+            freeGrammarTables(T);
             return 0;
 
         case 1: {
             printf("---- Cleaned Source (no comments) ----\n");
-            removeComments(argv[1]);
+            removeComments(srcPath);
             printf("--------------------------------------\n\n");
             break;
         }
 
         case 2: {
-            FILE *srcFP = fopen(argv[1], "r");
-            if (!srcFP) { perror(argv[1]); break; }
+            FILE *srcFP = fopen(srcPath, "r");
+            if (!srcFP) { perror(srcPath); break; }
             printf("---- Token Stream ----\n");
             getStream(srcFP);
             fclose(srcFP);
@@ -52,15 +455,15 @@ int main(int argc, char *argv[]) {
         }
 
         case 3: {
-            FILE *srcFP = fopen(argv[1], "r");
-            FILE *outFP = fopen(argv[2], "w");
-            if (!srcFP) { perror(argv[1]); break; }
-            if (!outFP) { perror(argv[2]); fclose(srcFP); break; }
+            FILE *srcFP = fopen(srcPath, "r");
+            FILE *outFP = fopen(outPath, "w");
+            if (!srcFP) { perror(srcPath); break; }
+            if (!outFP) { perror(outPath); fclose(srcFP); break; }
 
             printf("Parsing...\n");
-            ParseTreeNode *root = parseSourceCode(PT, ff, G, srcFP);
+            ParseTreeNode *root = parseSourceCode(T->pt, T->g, srcFP);
             printParseTree(root, outFP);
-            printf("Parse tree written to: %s\n\n", argv[2]);
+            printf("Parse tree written to: %s\n\n", outPath);
 
             fclose(srcFP);
             fclose(outFP);
@@ -68,29 +471,351 @@ int main(int argc, char *argv[]) {
         }
 
         case 4: {
-            FILE *srcFP = fopen(argv[1], "r");
-            if (!srcFP) { perror(argv[1]); break; }
+            FILE *srcFP = fopen(srcPath, "r");
+            if (!srcFP) { perror(srcPath); break; }
 
             printf("Parsing...\n");
-            clock_t t_start = clock();
-            ParseTreeNode *pt = parseSourceCode(PT, ff, G, srcFP);
-            clock_t t_end   = clock();
+            uint64_t t_start = benchNow();
+            ParseTreeNode *pt = parseSourceCode(T->pt, T->g, srcFP);
+            uint64_t t_end   = benchNow();
             (void)pt;   /* result not printed in this mode */
 
-            double elapsed = (double)(t_end - t_start) / CLOCKS_PER_SEC;
             printf("Parsing complete.\n");
-            printf("Clock ticks : %ld\n",  (long)(t_end - t_start));
-            printf("Time (sec)  : %.6f\n\n", elapsed);
+            printf("Time (sec)  : %.6f\n", (double)(t_end - t_start) / 1e9);
+            printf("(--bench=N times each phase separately over N runs)\n\n");
+
+            fclose(srcFP);
+            break;
+        }
+
+        case 5: {
+            FILE *srcFP = fopen(srcPath, "r");
+            if (!srcFP) { perror(srcPath); break; }
+
+            ValidateStats vs = { 0, 0, 0, 0 };
+            ParseEvents   ev = { onEnter, onMatch, onExit, &vs };
+
+            printf("Validating...\n");
+            printVerdict(parseSourceEvents(T->pt, T->g, srcFP, &ev, NULL));
+            printf("Rules expanded : %ld\n", vs.rulesExpanded);
+            printf("Tokens matched : %ld\n", vs.tokensMatched);
+            printf("Max nesting    : %d\n\n", vs.maxDepth);
+
+            fclose(srcFP);
+            break;
+        }
+
+        case 6: {
+            FILE *srcFP = fopen(srcPath, "r");
+            FILE *outFP = fopen(outPath, "w");
+            if (!srcFP) { perror(srcPath); break; }
+            if (!outFP) { perror(outPath); fclose(srcFP); break; }
+
+            int nThreads = poolDefaultThreads();
+            printf("Parsing on %d thread(s)...\n", nThreads);
+            ParseTreeNode *root = parseSourceParallel(T->pt, T->g, srcFP, nThreads);
+            printParseTree(root, outFP);
+            printf("Parse tree written to: %s\n\n", outPath);
+
+            fclose(srcFP);
+            fclose(outFP);
+            break;
+        }
+
+        case 7: {
+            FILE *srcFP = fopen(srcPath, "r");
+            FILE *outFP = fopen(outPath, "w");
+            if (!srcFP) { perror(srcPath); break; }
+            if (!outFP) { perror(outPath); fclose(srcFP); break; }
+
+            printf("Parsing...\n");
+            ParseTreeNode *root = parseSourceRD(srcFP);
+            printParseTree(root, outFP);
+            printf("Parse tree written to: %s\n\n", outPath);
+
+            fclose(srcFP);
+            fclose(outFP);
+            break;
+        }
+
+        case 8: {
+            FILE *srcFP = fopen(srcPath, "r");
+            FILE *outFP = fopen(outPath, "w");
+            if (!srcFP) { perror(srcPath); break; }
+            if (!outFP) { perror(outPath); fclose(srcFP); break; }
+
+            printf("Parsing...\n");
+            ParseTreeNode *root = parseSourcePipelined(T->pt, T->g, srcFP);
+            printParseTree(root, outFP);
+            printf("Parse tree written to: %s\n\n", outPath);
 
             fclose(srcFP);
+            fclose(outFP);
+            break;
+        }
+
+        case 9: {
+            FILE *srcFP = fopen(srcPath, "r");
+            FILE *outFP = fopen(outPath, "w");
+            if (!srcFP) { perror(srcPath); break; }
+            if (!outFP) { perror(outPath); fclose(srcFP); break; }
+
+            printf("Building AST...\n");
+            astArena arena;
+            AstNode *ast = parseSourceAST(T->pt, T->g, srcFP, &arena, NULL);
+            printVerdict(ast != NULL);
+            if (ast != NULL) {
+                printAst(ast, outFP);
+                printf("AST written to: %s\n", outPath);
+
+                /* Parse tree of the same input, built quietly for comparison */
+                rewind(srcFP);
+                compilerCtx ctx = createCompilerCtx(T->g, T->pt, NULL);
+                compileSource(ctx, srcFP);
+
+                long   treeNodes = 0;
+                size_t treeBytes = 0;
+                parseTreeStats(ctx->tree, &treeNodes, &treeBytes);
+                printf("%-12s %10s %12s\n", "", "nodes", "bytes");
+                printf("%-12s %10ld %12zu\n", "Parse tree", treeNodes, treeBytes);
+                printf("%-12s %10ld %12zu\n", "AST", arena->nodes, arena->bytes);
+                printf("%-12s %9.1fx %11.1fx\n\n", "Reduction",
+                       (double)treeNodes / (double)arena->nodes,
+                       (double)treeBytes / (double)arena->bytes);
+
+                freeCompilerCtx(ctx);
+                freeAstArena(arena);
+            } else {
+                printf("No AST built (syntax errors)\n\n");
+            }
+
+            fclose(srcFP);
+            fclose(outFP);
             break;
         }
 
         default:
-            printf("Invalid choice. Please enter 0–4.\n");
+            printf("Invalid choice. Please enter 0–9.\n");
             break;
         }
     }
 
+    freeGrammarTables(T);
     return 0;
 }
+
+int main(int argc, char *argv[]) {
+    uint64_t    start = benchNow();
+    CLI_MODE    mode  = CLI_MENU;
+    bool        json  = false;
+    const char *statsPath = NULL;
+    const char *cacheDir  = NULL;
+    const char *recordPath = NULL;
+    uint64_t    cacheMB   = 256;
+    int         runs  = 0;
+    int         jobs  = 0;
+    IR_PIPELINE pipeline;
+    bool        optSet     = false;
+    bool        timePasses = false;
+    bool        profile    = false;
+    char       *files[2];
+    int         nFiles = 0;
+
+#ifdef MEM_ACCOUNTING
+    /* per-subsystem totals on stderr; live bytes at exit were never freed */
+    atexit(memReportAtExit);
+#endif
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        CLI_MODE    m = CLI_MENU;
+
+        if (strcmp(a, "--tokens") == 0)
+            m = CLI_TOKENS;
+        else if (strcmp(a, "--strip") == 0)
+            m = CLI_STRIP;
+        else if (strcmp(a, "--tree") == 0)
+            m = CLI_TREE;
+        else if (strcmp(a, "--ast") == 0)
+            m = CLI_AST;
+        else if (strcmp(a, "--symbols") == 0)
+            m = CLI_SYMBOLS;
+        else if (strcmp(a, "--check") == 0)
+            m = CLI_CHECK;
+        else if (strcmp(a, "--ir") == 0)
+            m = CLI_IR;
+        else if (strcmp(a, "--bytecode") == 0)
+            m = CLI_BYTECODE;
+        else if (strcmp(a, "--image") == 0)
+            m = CLI_IMAGE;
+        else if (strcmp(a, "--run") == 0)
+            m = CLI_RUN;
+        else if (strncmp(a, "--bench=", 8) == 0) {
+            char *end;
+            long  n = strtol(a + 8, &end, 10);
+            if (*end != '\0' || n < 1 || n > 1000000) {
+                fprintf(stderr, "%s: bad run count in '%s'\n", argv[0], a);
+                return 1;
+            }
+            runs = (int)n;
+            m    = CLI_BENCH;
+        } else if (strcmp(a, "--batch") == 0)
+            m = CLI_BATCH;
+        else if (strcmp(a, "--serve") == 0)
+            m = CLI_SERVE;
+        else if (strcmp(a, "--lsp") == 0)
+            m = CLI_LSP;
+        else if (strncmp(a, "--jobs=", 7) == 0) {
+            char *end;
+            long  n = strtol(a + 7, &end, 10);
+            if (*end != '\0' || n < 1 || n > 1024) {
+                fprintf(stderr, "%s: bad thread count in '%s'\n", argv[0], a);
+                return 1;
+            }
+            jobs = (int)n;
+            continue;
+        } else if (a[0] == '-' && a[1] == 'O') {
+            char *end;
+            long  n = strtol(a + 2, &end, 10);
+            if (optSet || a[2] == '\0' || *end != '\0' || !irPipelineForLevel((int)n, &pipeline)) {
+                fprintf(stderr, "%s: bad optimisation level in '%s'\n", argv[0], a);
+                return 1;
+            }
+            optSet = true;
+            continue;
+        } else if (strncmp(a, "--passes=", 9) == 0) {
+            if (optSet || !irParsePipeline(a + 9, &pipeline)) {
+                fprintf(stderr, "%s: bad pass list in '%s'\n", argv[0], a);
+                return 1;
+            }
+            optSet = true;
+            continue;
+        } else if (strcmp(a, "--time-passes") == 0) {
+            timePasses = true;
+            continue;
+        } else if (strcmp(a, "--profile") == 0) {
+            profile = true;
+            continue;
+        } else if (strcmp(a, "--json") == 0) {
+            json = true;
+            continue;
+        } else if (strncmp(a, "--stats=", 8) == 0 && a[8] != '\0') {
+            statsPath = a + 8;
+            continue;
+        } else if (strncmp(a, "--record=", 9) == 0 && a[9] != '\0') {
+            recordPath = a + 9;
+            continue;
+        } else if (strncmp(a, "--cache=", 8) == 0 && a[8] != '\0') {
+            cacheDir = a + 8;
+            continue;
+        } else if (strncmp(a, "--cache-size=", 13) == 0) {
+            char *end;
+            long  n = strtol(a + 13, &end, 10);
+            if (*end != '\0' || n < 1 || n > 1 << 20) {
+                fprintf(stderr, "%s: bad cache size in '%s'\n", argv[0], a);
+                return 1;
+            }
+            cacheMB = (uint64_t)n;
+            continue;
+        } else if (a[0] == '-' && a[1] != '\0') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            if (nFiles == 2) { usage(argv[0]); return 1; }
+            files[nFiles++] = argv[i];
+            continue;
+        }
+
+        if (mode != CLI_MENU) { usage(argv[0]); return 1; }
+        mode = m;
+    }
+
+    char *srcPath = (nFiles > 0) ? files[0] : NULL;
+    char *outPath = (nFiles > 1) ? files[1] : NULL;
+
+    if ((mode == CLI_LSP) != (srcPath == NULL) || (recordPath && mode != CLI_LSP) ||
+        ((mode == CLI_MENU || mode == CLI_BATCH || mode == CLI_IMAGE) && outPath == NULL) ||
+        (json && mode != CLI_BENCH) ||
+        (jobs > 0 && mode != CLI_BATCH && mode != CLI_CHECK && mode != CLI_IR &&
+         mode != CLI_BYTECODE && mode != CLI_IMAGE && mode != CLI_RUN) ||
+        ((optSet || timePasses) && mode != CLI_IR && mode != CLI_BYTECODE && mode != CLI_IMAGE &&
+         mode != CLI_RUN) ||
+        (profile && mode != CLI_RUN) ||
+        (cacheDir && mode != CLI_TREE && mode != CLI_BATCH) ||
+        (statsPath && mode != CLI_TOKENS && mode != CLI_TREE && mode != CLI_AST &&
+         mode != CLI_BENCH && mode != CLI_BATCH)) {
+        usage(argv[0]);
+        return 1;
+    }
+#ifndef FRONTEND_STATS
+    if (statsPath)
+        fprintf(stderr, "%s: built without counters (make STATS=1); %s will be all zero\n",
+                argv[0], statsPath);
+#endif
+    resetFrontendStats();
+
+    switch (mode) {
+    case CLI_MENU:
+        return runMenu(srcPath, outPath);
+
+    case CLI_TOKENS: {
+        FILE *srcFP = fopen(srcPath, "r");
+        if (!srcFP) { perror(srcPath); return 1; }
+        getStream(srcFP);
+        fclose(srcFP);
+        return statsPath ? writeStats(statsPath) : 0;
+    }
+
+    case CLI_STRIP:
+        removeComments(srcPath);
+        return 0;
+
+    case CLI_TREE:
+    case CLI_AST:
+    case CLI_SYMBOLS:
+    case CLI_CHECK:
+    case CLI_IR:
+    case CLI_BYTECODE:
+    case CLI_IMAGE:
+    case CLI_RUN: {
+        if ((mode == CLI_BYTECODE || mode == CLI_RUN) && isBcImage(srcPath))
+            return runImage(mode, srcPath, outPath, start, timePasses, profile);
+        if (!optSet)
+            irPipelineForLevel(0, &pipeline);
+        int status = runParse(mode, srcPath, outPath, cacheDir, cacheMB << 20, jobs, &pipeline,
+                              start, timePasses, profile);
+        return (statsPath && writeStats(statsPath)) ? 1 : status;
+    }
+
+    case CLI_BENCH: {
+        /* counters are summed over all N runs */
+        int status = runBench(srcPath, outPath, runs, json);
+        return (statsPath && writeStats(statsPath)) ? 1 : status;
+    }
+
+    case CLI_BATCH: {
+        /* the pool adds its workers' counters to this thread's */
+        int status = runBatch(srcPath, outPath, jobs, cacheDir, cacheMB << 20);
+        return (statsPath && writeStats(statsPath)) ? 1 : status;
+    }
+
+    case CLI_SERVE: {
+        grammarTables T = loadTables();
+        if (T == NULL)
+            return 1;
+        int status = runServer(srcPath, T->g, T->pt);
+        freeGrammarTables(T);
+        return status;
+    }
+
+    case CLI_LSP: {
+        grammarTables T = loadTables();
+        if (T == NULL)
+            return 1;
+        int status = runLanguageServer(stdin, stdout, T->g, T->pt, recordPath);
+        freeGrammarTables(T);
+        return status;
+    }
+    }
+    return 1;
+}
@@ -0,0 +1,59 @@
+#include "fileIO.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool writeFull(int fd, const void *buf, size_t len) {
+    const char *p = (const char *)buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p   += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+bool readFull(int fd, void *buf, size_t len) {
+    char *p = (char *)buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p   += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+bool writeFileAtomic(const char *path, const void *buf, size_t len) {
+    static const char TEMPLATE[] = ".tmp-XXXXXX";
+    const char *slash = strrchr(path, '/');
+    size_t      dlen  = slash ? (size_t)(slash - path) + 1 : 0;
+    char       *tmp   = (char *)malloc(dlen + sizeof TEMPLATE);
+    memcpy(tmp, path, dlen);
+    memcpy(tmp + dlen, TEMPLATE, sizeof TEMPLATE);
+
+    bool ok = false;
+    int  fd = mkstemp(tmp);
+    if (fd >= 0) {
+        fchmod(fd, 0644);   /* mkstemp creates it private */
+        bool wrote = writeFull(fd, buf, len);
+        ok = (close(fd) == 0) && wrote && rename(tmp, path) == 0;
+        if (!ok) {
+            int err = errno;
+            unlink(tmp);
+            errno = err;
+        }
+    }
+    free(tmp);
+    return ok;
+}
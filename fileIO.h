@@ -0,0 +1,19 @@
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Write / read exactly 'len' bytes, retrying on EINTR; false on error or early EOF */
+bool writeFull(int fd, const void *buf, size_t len);
+bool readFull(int fd, void *buf, size_t len);
+
+/*
+ * Replace the file 'path' with 'len' bytes from 'buf' so that readers
+ * see either the old file or the whole new one: the bytes go to a
+ * ".tmp-XXXXXX" file in the same directory, which is then renamed over
+ * 'path'.  False, with errno set and the temporary removed, on failure.
+ */
+bool writeFileAtomic(const char *path, const void *buf, size_t len);
+
+#endif /* FILE_IO_H */
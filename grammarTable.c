@@ -0,0 +1,621 @@
+#include "grammarTable.h"
+#include "fileIO.h"
+#include "lexer.h"
+#include "parser.h"
+#include "utils.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Grammar and table built in memory rather than mapped from a blob */
+typedef struct {
+    Grammar    g;
+    ParseTable pt;
+} OwnedTables;
+
+/* Most words one line of the grammar file may hold */
+#define MAX_LINE_WORDS 64
+
+/* ---- reading the grammar file ---- */
+
+typedef struct {
+    const char *s;
+    int         len;
+} Word;
+
+static bool wordIs(Word w, const char *lit) {
+    return (int)strlen(lit) == w.len && strncmp(w.s, lit, w.len) == 0;
+}
+
+static int findNonTerminal(Word w) {
+    for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++)
+        if (wordIs(w, getNonTerminal((NON_TERMINAL)nt)))
+            return nt;
+    return -1;
+}
+
+static int findTerminal(Word w) {
+    for (int t = 0; t < NULL_TOKEN; t++)
+        if (wordIs(w, getTokenName((TOKEN_TYPE)t)))
+            return t;
+    return -1;
+}
+
+/* The alternative currently being read */
+typedef struct {
+    int           nt;           /* -1 before the first rule header */
+    int           line;
+    bool          eps;
+    bool          bad;          /* an error was already reported for it */
+    int           len;
+    GrammarSymbol rhs[MAX_RHS_LEN];
+} Alternative;
+
+/* Append the finished alternative to its non-terminal */
+static bool closeAlternative(Alternative *alt, Grammar *g, diagBuffer diag) {
+    if (alt->nt < 0 || alt->bad)
+        return !alt->bad;
+
+    const char *name = getNonTerminal((NON_TERMINAL)alt->nt);
+    if (alt->eps && alt->len > 0) {
+        diagPrintf(diag, "Line %02d: 'eps' must be the only symbol of a rule for <%s>\n",
+                   alt->line, name);
+        return false;
+    }
+    if (alt->eps) {
+        if (g->has_eps[alt->nt]) {
+            diagPrintf(diag, "Line %02d: <%s> has more than one 'eps' rule\n", alt->line, name);
+            return false;
+        }
+        g->has_eps[alt->nt] = true;
+        return true;
+    }
+    if (alt->len == 0) {
+        diagPrintf(diag, "Line %02d: empty rule for <%s> (write 'eps')\n", alt->line, name);
+        return false;
+    }
+    if (g->prod_count[alt->nt] == MAX_RHS_LEN) {
+        diagPrintf(diag, "Line %02d: <%s> has more than %d rules\n",
+                   alt->line, name, MAX_RHS_LEN);
+        return false;
+    }
+
+    ProductionRule *r = &g->prods[alt->nt][g->prod_count[alt->nt]++];
+    r->rhs_len = alt->len;
+    memcpy(r->rhs, alt->rhs, alt->len * sizeof(GrammarSymbol));
+    return true;
+}
+
+static void openAlternative(Alternative *alt, int nt, int line) {
+    alt->nt   = nt;
+    alt->line = line;
+    alt->eps  = false;
+    alt->bad  = false;
+    alt->len  = 0;
+}
+
+/* ------------------------------------------------------------------
+ * readGrammarFile
+ *
+ * Line-oriented: a line starting "<name> ===>" opens the rules for
+ * <name>; '|' starts another alternative, on the same line or the
+ * next.  Reading carries on after an error so that every problem in
+ * the file is reported in one pass.
+ * ------------------------------------------------------------------ */
+bool readGrammarFile(const char *text, size_t len, Grammar *g, diagBuffer diag) {
+    bool defined[NON_TERMINAL_COUNT] = { false };
+    bool ok = true;
+
+    for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++) {
+        g->prod_count[nt] = 0;
+        g->has_eps[nt]    = false;
+    }
+
+    Alternative alt;
+    openAlternative(&alt, -1, 0);
+
+    size_t pos  = 0;
+    int    line = 0;
+    while (pos < len) {
+        /* ---- split one line into words, dropping any comment ---- */
+        Word words[MAX_LINE_WORDS];
+        int  n = 0;
+        bool tooLong = false;
+        line++;
+
+        while (pos < len && text[pos] != '\n') {
+            char c = text[pos];
+            if (c == '#') {
+                while (pos < len && text[pos] != '\n')
+                    pos++;
+                break;
+            }
+            if (c == ' ' || c == '\t' || c == '\r') {
+                pos++;
+                continue;
+            }
+            size_t start = pos;
+            while (pos < len && text[pos] != '\n' && text[pos] != ' ' &&
+                   text[pos] != '\t' && text[pos] != '\r' && text[pos] != '#')
+                pos++;
+            if (n == MAX_LINE_WORDS)
+                tooLong = true;
+            else
+                words[n++] = (Word){ text + start, (int)(pos - start) };
+        }
+        pos++;  /* the newline */
+
+        if (tooLong) {
+            diagPrintf(diag, "Line %02d: more than %d symbols on one line\n",
+                       line, MAX_LINE_WORDS);
+            ok = false;
+            alt.bad = true;
+            continue;
+        }
+
+        int k = 0;
+        if (n >= 2 && wordIs(words[1], "===>")) {
+            /* ---- rule header ---- */
+            ok &= closeAlternative(&alt, g, diag);
+
+            Word w  = words[0];
+            int  nt = -1;
+            if (w.len > 2 && w.s[0] == '<' && w.s[w.len - 1] == '>')
+                nt = findNonTerminal((Word){ w.s + 1, w.len - 2 });
+            if (nt < 0) {
+                diagPrintf(diag, "Line %02d: unknown non-terminal %.*s\n", line, w.len, w.s);
+                ok = false;
+                openAlternative(&alt, -1, line);
+                alt.bad = true;
+                continue;
+            }
+            if (defined[nt]) {
+                diagPrintf(diag, "Line %02d: rules for <%s> are defined twice\n",
+                           line, getNonTerminal((NON_TERMINAL)nt));
+                ok = false;
+            }
+            defined[nt] = true;
+            openAlternative(&alt, nt, line);
+            k = 2;
+        }
+
+        for (; k < n; k++) {
+            Word w = words[k];
+
+            if (wordIs(w, "|")) {
+                int nt = alt.nt;
+                bool skip = (nt < 0 && alt.bad);
+                ok &= closeAlternative(&alt, g, diag);
+                openAlternative(&alt, nt, line);
+                alt.bad = skip;
+                continue;
+            }
+            if (alt.nt < 0) {
+                if (!alt.bad) {
+                    diagPrintf(diag, "Line %02d: symbols before the first rule header\n", line);
+                    ok = false;
+                    alt.bad = true;
+                }
+                continue;
+            }
+            if (wordIs(w, "eps")) {
+                alt.eps = true;
+                continue;
+            }
+
+            GrammarSymbol sym;
+            if (w.len > 2 && w.s[0] == '<' && w.s[w.len - 1] == '>') {
+                int nt = findNonTerminal((Word){ w.s + 1, w.len - 2 });
+                if (nt < 0) {
+                    diagPrintf(diag, "Line %02d: unknown non-terminal %.*s\n", line, w.len, w.s);
+                    ok = false;
+                    alt.bad = true;
+                    continue;
+                }
+                sym = (GrammarSymbol){ .isTerminal = false, .sym.nt = (NON_TERMINAL)nt };
+            } else {
+                int t = findTerminal(w);
+                if (t < 0) {
+                    diagPrintf(diag, "Line %02d: unknown token %.*s\n", line, w.len, w.s);
+                    ok = false;
+                    alt.bad = true;
+                    continue;
+                }
+                sym = (GrammarSymbol){ .isTerminal = true, .sym.t = (TOKEN_TYPE)t };
+            }
+
+            if (alt.len == MAX_RHS_LEN) {
+                if (!alt.bad)
+                    diagPrintf(diag, "Line %02d: rule for <%s> is longer than %d symbols\n",
+                               line, getNonTerminal((NON_TERMINAL)alt.nt), MAX_RHS_LEN);
+                ok = false;
+                alt.bad = true;
+                continue;
+            }
+            alt.rhs[alt.len++] = sym;
+        }
+    }
+    ok &= closeAlternative(&alt, g, diag);
+
+    /* ---- every non-terminal needs rules, and room for its ε slot ---- */
+    for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++) {
+        const char *name = getNonTerminal((NON_TERMINAL)nt);
+        if (g->prod_count[nt] == 0 && !g->has_eps[nt]) {
+            diagPrintf(diag, "Grammar: no rules for <%s>\n", name);
+            ok = false;
+        } else if (g->has_eps[nt]) {
+            if (g->prod_count[nt] == MAX_RHS_LEN) {
+                diagPrintf(diag, "Grammar: <%s> has more than %d rules\n", name, MAX_RHS_LEN);
+                ok = false;
+            } else {
+                g->prods[nt][g->prod_count[nt]].rhs_len = 0;
+            }
+        }
+    }
+
+    return ok;
+}
+
+/* ---- LL(1) analysis ---- */
+
+/*
+ * FIRST of rhs[from ..] as a token set; *nullable tells whether that
+ * suffix can derive ε.
+ */
+static uint64_t firstOfSuffix(const ProductionRule *r, int from, const uint64_t *first,
+                              const bool *nullableNT, bool *nullable) {
+    uint64_t set = 0;
+    for (int k = from; k < r->rhs_len; k++) {
+        GrammarSymbol s = r->rhs[k];
+        if (s.isTerminal) {
+            *nullable = false;
+            return set | TOKEN_BIT(s.sym.t);
+        }
+        set |= first[s.sym.nt];
+        if (!nullableNT[s.sym.nt]) {
+            *nullable = false;
+            return set;
+        }
+    }
+    *nullable = true;
+    return set;
+}
+
+/* Number of rules for 'nt', counting the ε-rule (stored at prod_count) */
+static int ruleCount(const Grammar *g, int nt) {
+    return g->prod_count[nt] + (g->has_eps[nt] ? 1 : 0);
+}
+
+static void printRule(diagBuffer diag, const Grammar *g, int nt, int r) {
+    diagPrintf(diag, "    rule %d: <%s> ===>", r, getNonTerminal((NON_TERMINAL)nt));
+    if (g->has_eps[nt] && r == g->prod_count[nt]) {
+        diagPrintf(diag, " eps\n");
+        return;
+    }
+    const ProductionRule *rule = &g->prods[nt][r];
+    for (int k = 0; k < rule->rhs_len; k++) {
+        GrammarSymbol s = rule->rhs[k];
+        if (s.isTerminal)
+            diagPrintf(diag, " %s", getTokenName(s.sym.t));
+        else
+            diagPrintf(diag, " <%s>", getNonTerminal(s.sym.nt));
+    }
+    diagPrintf(diag, "\n");
+}
+
+/* ------------------------------------------------------------------
+ * buildLL1Table
+ *
+ * FIRST, nullable and FOLLOW are computed as 64-bit token sets by
+ * fixed-point iteration.  Rule r of A predicts FIRST(r), plus
+ * FOLLOW(A) if r can derive ε; two rules predicting the same token is
+ * a conflict.  The first rule keeps the cell either way.
+ * ------------------------------------------------------------------ */
+int buildLL1Table(const Grammar *g, ParseTable *pt, diagBuffer diag) {
+    uint64_t first[NON_TERMINAL_COUNT]  = { 0 };
+    uint64_t follow[NON_TERMINAL_COUNT] = { 0 };
+    bool     nullableNT[NON_TERMINAL_COUNT] = { false };
+
+    /* ---- FIRST and nullable ---- */
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++) {
+            if (g->has_eps[nt] && !nullableNT[nt]) {
+                nullableNT[nt] = true;
+                changed = true;
+            }
+            for (int r = 0; r < g->prod_count[nt]; r++) {
+                bool     nullable;
+                uint64_t set = firstOfSuffix(&g->prods[nt][r], 0, first, nullableNT, &nullable);
+                if ((first[nt] | set) != first[nt]) {
+                    first[nt] |= set;
+                    changed = true;
+                }
+                if (nullable && !nullableNT[nt]) {
+                    nullableNT[nt] = true;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    /* ---- FOLLOW ---- */
+    follow[NT_PROGRAM] = TOKEN_BIT(DOLLAR);
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++) {
+            for (int r = 0; r < g->prod_count[nt]; r++) {
+                const ProductionRule *rule = &g->prods[nt][r];
+                for (int k = 0; k < rule->rhs_len; k++) {
+                    if (rule->rhs[k].isTerminal)
+                        continue;
+                    int      b = rule->rhs[k].sym.nt;
+                    bool     restNullable;
+                    uint64_t set = firstOfSuffix(rule, k + 1, first, nullableNT, &restNullable);
+                    if (restNullable)
+                        set |= follow[nt];
+                    if ((follow[b] | set) != follow[b]) {
+                        follow[b] |= set;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    /* ---- table and conflicts ---- */
+    int conflicts = 0;
+    for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++) {
+        for (int col = 0; col < NUM_TOKENS; col++)
+            pt->cell[nt][col] = -1;
+
+        for (int r = 0; r < ruleCount(g, nt); r++) {
+            uint64_t predict;
+            bool     nullable = true;
+            if (r < g->prod_count[nt])
+                predict = firstOfSuffix(&g->prods[nt][r], 0, first, nullableNT, &nullable);
+            else
+                predict = 0;    /* the ε-rule */
+            if (nullable)
+                predict |= follow[nt];
+
+            for (int col = 0; col < NUM_TOKENS; col++) {
+                if (!(predict & TOKEN_BIT(col)))
+                    continue;
+                int prev = pt->cell[nt][col];
+                if (prev < 0) {
+                    pt->cell[nt][col] = r;
+                    continue;
+                }
+                conflicts++;
+                diagPrintf(diag, "LL(1) conflict: <%s> on %s\n",
+                           getNonTerminal((NON_TERMINAL)nt), getTokenName((TOKEN_TYPE)col));
+                printRule(diag, g, nt, prev);
+                printRule(diag, g, nt, r);
+            }
+        }
+
+        /* FOLLOW tokens no rule predicts are synchronisation points */
+        for (int col = 0; col < NUM_TOKENS; col++)
+            if ((follow[nt] & TOKEN_BIT(col)) && pt->cell[nt][col] == -1)
+                pt->cell[nt][col] = -2;
+    }
+
+    computeRecoverySets(pt, follow);
+    return conflicts;
+}
+
+/* ---- binary blob ---- */
+
+static const char BLOB_MAGIC[8] = { 'L', 'L', '1', 'T', 'A', 'B', 'L', 'E' };
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/*
+ * Covers the grammar text, the names it is resolved against (token and
+ * non-terminal numbering) and the layout of the structs in the blob.
+ */
+uint64_t hashGrammarSource(const char *text, size_t len) {
+    uint64_t h = fnv1a(0xcbf29ce484222325ULL, text, len);
+
+    for (int t = 0; t < NUM_TOKENS; t++) {
+        const char *name = getTokenName((TOKEN_TYPE)t);
+        h = fnv1a(h, name, strlen(name) + 1);
+    }
+    for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++) {
+        const char *name = getNonTerminal((NON_TERMINAL)nt);
+        h = fnv1a(h, name, strlen(name) + 1);
+    }
+
+    uint64_t layout[] = { GRAMMAR_BLOB_VERSION, NUM_TOKENS, NON_TERMINAL_COUNT, MAX_RHS_LEN,
+                          sizeof(Grammar), sizeof(ParseTable), sizeof(GrammarSymbol) };
+    return fnv1a(h, layout, sizeof(layout));
+}
+
+static uint64_t alignUp(uint64_t n) {
+    return (n + 63) & ~(uint64_t)63;
+}
+
+bool writeGrammarBlob(const char *path, const Grammar *g, const ParseTable *pt,
+                      uint64_t hash) {
+    GrammarBlobHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, BLOB_MAGIC, sizeof(hdr.magic));
+    hdr.version       = GRAMMAR_BLOB_VERSION;
+    hdr.headerSize    = sizeof(hdr);
+    hdr.grammarHash   = hash;
+    hdr.grammarOffset = alignUp(sizeof(hdr));
+    hdr.grammarSize   = sizeof(Grammar);
+    hdr.tableOffset   = alignUp(hdr.grammarOffset + sizeof(Grammar));
+    hdr.tableSize     = sizeof(ParseTable);
+
+    size_t total = hdr.tableOffset + hdr.tableSize;
+    char  *buf   = (char *)calloc(1, total);
+    memcpy(buf, &hdr, sizeof(hdr));
+    memcpy(buf + hdr.grammarOffset, g, sizeof(Grammar));
+    memcpy(buf + hdr.tableOffset, pt, sizeof(ParseTable));
+
+    /* Readers only ever see a complete blob */
+    bool ok = writeFileAtomic(path, buf, total);
+    free(buf);
+    return ok;
+}
+
+/* Map 'path' if it is a well-formed blob for 'hash' */
+static bool mapGrammarBlob(const char *path, uint64_t hash, grammarTables gt) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(GrammarBlobHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t len = (size_t)st.st_size;
+    void  *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    const GrammarBlobHeader *hdr = (const GrammarBlobHeader *)map;
+    bool ok = memcmp(hdr->magic, BLOB_MAGIC, sizeof(hdr->magic)) == 0 &&
+              hdr->version     == GRAMMAR_BLOB_VERSION &&
+              hdr->headerSize  == sizeof(GrammarBlobHeader) &&
+              hdr->grammarHash == hash &&
+              hdr->grammarSize == sizeof(Grammar) &&
+              hdr->tableSize   == sizeof(ParseTable) &&
+              hdr->grammarOffset % 64 == 0 && hdr->tableOffset % 64 == 0 &&
+              hdr->grammarOffset + hdr->grammarSize <= len &&
+              hdr->tableOffset + hdr->tableSize <= len;
+    if (!ok) {
+        munmap(map, len);
+        return false;
+    }
+
+    gt->map    = map;
+    gt->mapLen = len;
+    gt->g      = (const Grammar *)((const char *)map + hdr->grammarOffset);
+    gt->pt     = (const ParseTable *)((const char *)map + hdr->tableOffset);
+    return true;
+}
+
+char *readGrammarText(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+
+    size_t cap = 4096, n = 0;
+    char  *buf = (char *)malloc(cap);
+    size_t got;
+    while ((got = fread(buf + n, 1, cap - n, f)) > 0) {
+        n += got;
+        if (n == cap) {
+            cap *= 2;
+            buf  = (char *)realloc(buf, cap);
+        }
+    }
+    fclose(f);
+
+    *len = n;
+    return buf;
+}
+
+/* ------------------------------------------------------------------
+ * loadGrammarTables
+ * ------------------------------------------------------------------ */
+grammarTables loadGrammarTables(const char *bnfPath, const char *blobPath,
+                                diagBuffer diag) {
+    grammarTables gt = (grammarTables)calloc(1, sizeof(GRAMMAR_TABLES));
+
+    size_t len;
+    char  *text = readGrammarText(bnfPath, &len);
+    if (text == NULL) {
+        /* No grammar file — use the grammar compiled into the binary */
+        OwnedTables *own = (OwnedTables *)malloc(sizeof(OwnedTables));
+        own->g = initializeGrammar();
+        FirstFollow ff = computeFirstFollow(own->g);
+        buildParseTable(ff, &own->pt);
+        gt->owned = own;
+        gt->g     = &own->g;
+        gt->pt    = &own->pt;
+        return gt;
+    }
+
+    uint64_t hash = hashGrammarSource(text, len);
+    if (blobPath != NULL && mapGrammarBlob(blobPath, hash, gt)) {
+        free(text);
+        return gt;
+    }
+
+    /* Missing or stale blob: regenerate from the grammar file */
+    OwnedTables *own = (OwnedTables *)calloc(1, sizeof(OwnedTables));
+    gt->owned = own;
+    gt->g     = &own->g;
+    gt->pt    = &own->pt;
+
+    bool ok = readGrammarFile(text, len, &own->g, diag);
+    free(text);
+    if (!ok || buildLL1Table(&own->g, &own->pt, diag) > 0) {
+        diagPrintf(diag, "%s: grammar rejected\n", bnfPath);
+        freeGrammarTables(gt);
+        return NULL;
+    }
+
+    if (blobPath != NULL && !writeGrammarBlob(blobPath, &own->g, &own->pt, hash))
+        diagPrintf(diag, "Warning: could not write %s; tables are rebuilt on every run\n",
+                   blobPath);
+    return gt;
+}
+
+void freeGrammarTables(grammarTables gt) {
+    if (gt == NULL)
+        return;
+    if (gt->map != NULL)
+        munmap(gt->map, gt->mapLen);
+    free(gt->owned);
+    free(gt);
+}
+
+/* ------------------------------------------------------------------
+ * printGrammarFile
+ * ------------------------------------------------------------------ */
+void printGrammarFile(const Grammar *g, FILE *out) {
+    for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++) {
+        const char *name = getNonTerminal((NON_TERMINAL)nt);
+        int         pad  = (int)strlen(name) + 3;
+
+        if (nt > 0)
+            fprintf(out, "\n");
+        for (int r = 0; r < ruleCount(g, nt); r++) {
+            if (r == 0)
+                fprintf(out, "<%s> ===>", name);
+            else
+                fprintf(out, "%*s|", pad + 3, "");
+
+            if (r == g->prod_count[nt]) {
+                fprintf(out, " eps\n");
+                continue;
+            }
+            const ProductionRule *rule = &g->prods[nt][r];
+            for (int k = 0; k < rule->rhs_len; k++) {
+                GrammarSymbol s = rule->rhs[k];
+                if (s.isTerminal)
+                    fprintf(out, " %s", getTokenName(s.sym.t));
+                else
+                    fprintf(out, " <%s>", getNonTerminal(s.sym.nt));
+            }
+            fprintf(out, "\n");
+        }
+    }
+}
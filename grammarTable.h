@@ -0,0 +1,104 @@
+#ifndef GRAMMAR_TABLE_H
+#define GRAMMAR_TABLE_H
+
+#include "diag.h"
+#include "parserDef.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Grammar description file and precomputed LL(1) tables.
+ *
+ * The grammar lives in a BNF file (grammar.bnf):
+ *
+ *     # comment
+ *     <otherFunctions> ===> <function> <otherFunctions>
+ *                         | eps
+ *
+ * Non-terminals are written <name> with the names getNonTerminal()
+ * returns, terminals by their TK_ names, and 'eps' is the empty rule.
+ * The other rules for one non-terminal keep the order they have in the
+ * file; that order fixes the rule indices stored in the parse table.
+ * The 'eps' rule, wherever it is written, always comes last: its index
+ * is prod_count[nt], one past the non-empty rules, and has_eps[nt] says
+ * whether it exists.
+ *
+ * The generated Grammar and ParseTable are saved as a binary blob
+ * (grammar.ll1) that is mmap'd read-only at startup.  The blob records a
+ * hash of the grammar file, the symbol names and the struct layout;
+ * when any of them change it is rebuilt from the grammar file.
+ */
+
+/* Default file names, relative to the working directory */
+#define GRAMMAR_FILE      "grammar.bnf"
+#define GRAMMAR_BLOB      "grammar.ll1"
+
+/* Bump whenever the blob layout or its header changes */
+#define GRAMMAR_BLOB_VERSION 1
+
+/* Start of every blob; both payloads follow at the given offsets */
+typedef struct {
+    char     magic[8];          /* "LL1TABLE" */
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t grammarHash;       /* see hashGrammarSource() */
+    uint64_t grammarOffset;
+    uint64_t grammarSize;       /* sizeof(Grammar) */
+    uint64_t tableOffset;
+    uint64_t tableSize;         /* sizeof(ParseTable) */
+} GrammarBlobHeader;
+
+/*
+ * The grammar and parse table in use.  Both point either into a mapped
+ * blob or into 'owned' (built in memory when no blob could be used).
+ */
+typedef struct GRAMMAR_TABLES {
+    const Grammar    *g;
+    const ParseTable *pt;
+    void             *map;      /* mmap'd blob, or NULL */
+    size_t            mapLen;
+    void             *owned;    /* heap copy, or NULL */
+} GRAMMAR_TABLES;
+
+typedef GRAMMAR_TABLES *grammarTables;
+
+/* Read a whole grammar file (malloc'd, not NUL-terminated); NULL on error */
+char *readGrammarText(const char *path, size_t *len);
+
+/*
+ * Parse the text of a grammar file into 'g'.  Problems (unknown symbols,
+ * rules that are too long, non-terminals without rules, ...) are
+ * reported to 'diag' with line numbers; returns false if there were any.
+ */
+bool readGrammarFile(const char *text, size_t len, Grammar *g, diagBuffer diag);
+
+/*
+ * Compute FIRST/FOLLOW and fill the LL(1) table for 'g'.  Every cell
+ * claimed by two rules is reported with both rules and the token.
+ * Returns the number of conflicts; the table is only usable at zero.
+ */
+int buildLL1Table(const Grammar *g, ParseTable *pt, diagBuffer diag);
+
+/* Hash of the grammar text plus everything else the blob depends on */
+uint64_t hashGrammarSource(const char *text, size_t len);
+
+/* Write a blob atomically (temporary file, then rename) */
+bool writeGrammarBlob(const char *path, const Grammar *g, const ParseTable *pt,
+                      uint64_t hash);
+
+/*
+ * Get the tables for 'bnfPath': map 'blobPath' if it is current,
+ * otherwise regenerate and rewrite it (blobPath may be NULL to skip the
+ * cache).  If the grammar file does not exist, the built-in grammar from
+ * initializeGrammar() is used.  Returns NULL, with the reasons in
+ * 'diag', if the grammar file is malformed or not LL(1).
+ */
+grammarTables loadGrammarTables(const char *bnfPath, const char *blobPath,
+                                diagBuffer diag);
+
+void freeGrammarTables(grammarTables gt);
+
+/* Write 'g' out in the grammar-file format */
+void printGrammarFile(const Grammar *g, FILE *out);
+
+#endif /* GRAMMAR_TABLE_H */
@@ -0,0 +1,118 @@
+#include "intern.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERN_BLOCK_BYTES (64 * 1024)
+
+/* FNV-1a; names are a few bytes long, so anything heavier does not pay */
+static uint32_t hashName(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+internPool createInternPool(void) {
+    internPool p = (internPool)calloc(1, sizeof(INTERN_POOL));
+    p->mask   = 255;
+    p->slots  = (uint32_t *)calloc(p->mask + 1, sizeof(uint32_t));
+    p->cap    = 128;
+    p->hashes = (uint32_t *)malloc(p->cap * sizeof(uint32_t));
+    p->text   = (const char **)malloc(p->cap * sizeof(char *));
+    p->lens   = (uint32_t *)malloc(p->cap * sizeof(uint32_t));
+    p->text[INTERN_NONE] = "";
+    p->lens[INTERN_NONE] = 0;
+    p->bytes  = sizeof(INTERN_POOL) + (p->mask + 1) * sizeof(uint32_t) +
+                p->cap * (2 * sizeof(uint32_t) + sizeof(char *));
+    return p;
+}
+
+static uint32_t probe(const INTERN_POOL *p, uint32_t h, const char *s, size_t len) {
+    uint32_t i = h & p->mask;
+    for (;;) {
+        uint32_t id = p->slots[i];
+        if (id == INTERN_NONE ||
+            (p->hashes[id] == h && p->lens[id] == len && memcmp(p->text[id], s, len) == 0))
+            return i;
+        i = (i + 1) & p->mask;
+    }
+}
+
+uint32_t findInterned(const INTERN_POOL *p, const char *s, size_t len) {
+    return p->slots[probe(p, hashName(s, len), s, len)];
+}
+
+/* Twice the slots, kept at most half full */
+static void growSlots(internPool p) {
+    uint32_t  n     = (p->mask + 1) * 2;
+    uint32_t *slots = (uint32_t *)calloc(n, sizeof(uint32_t));
+    for (uint32_t id = 1; id <= p->count; id++) {
+        uint32_t i = p->hashes[id] & (n - 1);
+        while (slots[i] != INTERN_NONE)
+            i = (i + 1) & (n - 1);
+        slots[i] = id;
+    }
+    p->bytes += (n - (p->mask + 1)) * sizeof(uint32_t);
+    free(p->slots);
+    p->slots = slots;
+    p->mask  = n - 1;
+}
+
+static char *keepText(internPool p, const char *s, size_t len) {
+    if (p->block == NULL || p->blockUsed + len + 1 > p->blockCap) {
+        size_t cap   = len + 1 + sizeof(void *) > INTERN_BLOCK_BYTES
+                           ? len + 1 + sizeof(void *) : INTERN_BLOCK_BYTES;
+        char  *block = (char *)malloc(cap);
+        memcpy(block, &p->blocks, sizeof(void *));
+        p->blocks    = block;
+        p->block     = block;
+        p->blockUsed = sizeof(void *);
+        p->blockCap  = cap;
+        p->bytes    += cap;
+    }
+    char *t = p->block + p->blockUsed;
+    memcpy(t, s, len);
+    t[len] = '\0';
+    p->blockUsed += len + 1;
+    return t;
+}
+
+uint32_t internString(internPool p, const char *s, size_t len) {
+    uint32_t h = hashName(s, len);
+    uint32_t i = probe(p, h, s, len);
+    if (p->slots[i] != INTERN_NONE)
+        return p->slots[i];
+
+    uint32_t id = ++p->count;
+    if (id == p->cap) {
+        p->bytes += p->cap * (2 * sizeof(uint32_t) + sizeof(char *));
+        p->cap   *= 2;
+        p->hashes = (uint32_t *)realloc(p->hashes, p->cap * sizeof(uint32_t));
+        p->text   = (const char **)realloc(p->text, p->cap * sizeof(char *));
+        p->lens   = (uint32_t *)realloc(p->lens, p->cap * sizeof(uint32_t));
+    }
+    p->hashes[id] = h;
+    p->text[id]   = keepText(p, s, len);
+    p->lens[id]   = (uint32_t)len;
+    p->slots[i]   = id;
+
+    if (2 * p->count > p->mask)
+        growSlots(p);
+    return id;
+}
+
+void freeInternPool(internPool p) {
+    if (p == NULL)
+        return;
+    while (p->blocks != NULL) {
+        void *next;
+        memcpy(&next, p->blocks, sizeof(void *));
+        free(p->blocks);
+        p->blocks = next;
+    }
+    free(p->slots);
+    free(p->hashes);
+    free(p->text);
+    free(p->lens);
+    free(p);
+}
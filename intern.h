@@ -0,0 +1,47 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Interned names.  Every distinct string gets a small dense id (from 1;
+ * 0 is never a name), so later tables can key on a 32-bit integer and
+ * compare names with ==.  The text lives in large blocks owned by the
+ * pool and never moves.  Lookups (findInterned, internText) only read
+ * the pool and may run concurrently; interning may not.
+ */
+#define INTERN_NONE 0u
+
+typedef struct INTERN_POOL {
+    uint32_t    *slots;     /* open addressing: id, or INTERN_NONE if empty */
+    uint32_t     mask;
+    uint32_t    *hashes;    /* hashes[id], to grow without rehashing text */
+    const char **text;      /* text[id], NUL-terminated */
+    uint32_t    *lens;
+    uint32_t     count;     /* ids handed out, so the next is count + 1 */
+    uint32_t     cap;       /* room in hashes / text / lens */
+    char        *block;     /* current text block */
+    size_t       blockUsed;
+    size_t       blockCap;
+    void        *blocks;    /* every block, chained through their first word */
+    size_t       bytes;     /* memory held, for reports */
+} INTERN_POOL;
+
+typedef INTERN_POOL *internPool;
+
+internPool createInternPool(void);
+
+/* The id of s[0 .. len), added if it is new */
+uint32_t internString(internPool p, const char *s, size_t len);
+
+/* The id of s[0 .. len), or INTERN_NONE if it was never interned */
+uint32_t findInterned(const INTERN_POOL *p, const char *s, size_t len);
+
+static inline const char *internText(const INTERN_POOL *p, uint32_t id) {
+    return p->text[id];
+}
+
+void freeInternPool(internPool p);
+
+#endif /* INTERN_H */
@@ -0,0 +1,219 @@
+#include "ir.h"
+#include <stdlib.h>
+
+static const char *IR_OP_NAMES[IR_OP_COUNT] = {
+    [IR_NOP] = "nop",       [IR_UNDEF] = "undef",   [IR_CONST] = "const",
+    [IR_PARAM] = "param",   [IR_PHI] = "phi",       [IR_ADD] = "add",
+    [IR_SUB] = "sub",       [IR_MUL] = "mul",       [IR_DIV] = "div",
+    [IR_LT] = "lt",         [IR_LE] = "le",         [IR_EQ] = "eq",
+    [IR_GT] = "gt",         [IR_GE] = "ge",         [IR_NE] = "ne",
+    [IR_AND] = "and",       [IR_OR] = "or",         [IR_NOT] = "not",
+    [IR_ITOR] = "itor",     [IR_RTOI] = "rtoi",     [IR_GLOAD] = "gload",
+    [IR_GSTORE] = "gstore", [IR_READ] = "read",     [IR_WRITE] = "write",
+    [IR_CALL] = "call",     [IR_RESULT] = "result", [IR_BR] = "br",
+    [IR_CBR] = "cbr",       [IR_RET] = "ret",
+};
+
+static const char *IR_TYPE_NAMES[] = { "void", "int", "real", "bool" };
+
+const char *irOpName(IR_OP op) {
+    return (op < IR_OP_COUNT) ? IR_OP_NAMES[op] : "?";
+}
+
+void freeIrModule(irModule m) {
+    if (m == NULL)
+        return;
+    for (int k = 0; k < m->nFuncs; k++) {
+        free(m->funcs[k].insts);
+        free(m->funcs[k].blocks);
+        free(m->funcs[k].args);
+    }
+    free(m->funcs);
+    free(m->leafFirst);
+    free(m->leafCount);
+    free(m->leaves);
+    free(m->globalSyms);
+    free(m->globalAt);
+    free(m);
+}
+
+size_t irModuleBytes(const IR_MODULE *m) {
+    size_t n = sizeof(IR_MODULE) + (size_t)m->nFuncs * sizeof(IR_FUNC) +
+               2 * (size_t)m->st->nTypes * sizeof(int32_t) +
+               (size_t)m->nLeaves * sizeof(IR_LEAF) + 2 * (size_t)m->nGlobals * sizeof(int32_t);
+    for (int k = 0; k < m->nFuncs; k++) {
+        const IR_FUNC *f = &m->funcs[k];
+        n += (size_t)f->capInsts * sizeof(IR_INST) + (size_t)f->capBlocks * sizeof(IR_BLOCK) +
+             (size_t)f->capArgs * sizeof(int32_t);
+    }
+    return n;
+}
+
+/* ---- editing ---- */
+
+int irAddInst(IR_FUNC *f, int block, IR_OP op, IR_TYPE type, int a, int b, int line) {
+    if (f->nInsts == f->capInsts) {
+        f->capInsts = f->capInsts ? f->capInsts * 2 : 64;
+        f->insts    = (IR_INST *)realloc(f->insts, f->capInsts * sizeof(IR_INST));
+    }
+    f->insts[f->nInsts] = (IR_INST){ .op = (uint8_t)op, .type = (uint8_t)type, .block = block,
+                                     .a = a, .b = b, .next = -1, .line = line, .imm.i = 0 };
+    return f->nInsts++;
+}
+
+void irLinkAfter(IR_FUNC *f, int block, int prev, int v) {
+    IR_BLOCK *bb = &f->blocks[block];
+    if (prev < 0) {
+        f->insts[v].next = bb->first;
+        bb->first        = v;
+    } else {
+        f->insts[v].next    = f->insts[prev].next;
+        f->insts[prev].next = v;
+    }
+    if (bb->last == prev)
+        bb->last = v;
+    f->insts[v].block = block;
+}
+
+int irAddBlock(IR_FUNC *f) {
+    if (f->nBlocks == f->capBlocks) {
+        f->capBlocks = f->capBlocks ? f->capBlocks * 2 : 16;
+        f->blocks    = (IR_BLOCK *)realloc(f->blocks, f->capBlocks * sizeof(IR_BLOCK));
+    }
+    f->blocks[f->nBlocks] = (IR_BLOCK){ .first = -1, .last = -1, .pred = { -1, -1 },
+                                        .succ = { -1, -1 }, .nPreds = 0, .nSuccs = 0,
+                                        .sealed = 0 };
+    return f->nBlocks++;
+}
+
+void irAddEdge(IR_FUNC *f, int from, int to) {
+    IR_BLOCK *a = &f->blocks[from], *b = &f->blocks[to];
+    a->succ[a->nSuccs++] = to;
+    b->pred[b->nPreds++] = from;
+}
+
+int irAddArg(IR_FUNC *f, int v) {
+    if (f->nArgs == f->capArgs) {
+        f->capArgs = f->capArgs ? f->capArgs * 2 : 64;
+        f->args    = (int32_t *)realloc(f->args, f->capArgs * sizeof(int32_t));
+    }
+    f->args[f->nArgs] = v;
+    return f->nArgs++;
+}
+
+/* ---- replacing values ---- */
+
+int irFindValue(int32_t *repl, int v) {
+    while (repl[v] != v) {
+        repl[v] = repl[repl[v]];
+        v       = repl[v];
+    }
+    return v;
+}
+
+void irReplaceOperands(IR_FUNC *f, int32_t *repl) {
+    for (int v = 0; v < f->nInsts; v++) {
+        IR_INST *in = &f->insts[v];
+        if (in->op == IR_NOP)
+            continue;
+        int n = irValueOperands((IR_OP)in->op);
+        if (n >= 1)
+            in->a = irFindValue(repl, in->a);
+        if (n >= 2)
+            in->b = irFindValue(repl, in->b);
+    }
+    for (int i = 0; i < f->nArgs; i++)
+        f->args[i] = irFindValue(repl, f->args[i]);
+}
+
+/* ---- listing ---- */
+
+static void printArgs(const IR_FUNC *f, const IR_INST *in, FILE *out) {
+    for (int i = 0; i < in->b; i++)
+        fprintf(out, "%sv%d", i ? ", " : " ", f->args[in->a + i]);
+}
+
+static void printInst(const IR_MODULE *m, const IR_FUNC *f, int v, FILE *out) {
+    const IR_INST  *in = &f->insts[v];
+    const IR_BLOCK *bb = &f->blocks[in->block];
+
+    fprintf(out, "    ");
+    if (in->type != IR_VOID || in->op == IR_CALL)    /* results name their call */
+        fprintf(out, "v%d = ", v);
+    fprintf(out, "%s", irOpName((IR_OP)in->op));
+
+    switch (in->op) {
+    case IR_CONST:
+        if (in->type == IR_REAL)
+            fprintf(out, " %.2f", in->imm.r);
+        else
+            fprintf(out, " %lld", (long long)in->imm.i);
+        break;
+    case IR_PARAM:
+        fprintf(out, " %lld", (long long)in->imm.i);
+        break;
+    case IR_PHI:
+        fprintf(out, " [b%d: v%d] [b%d: v%d]", bb->pred[0], in->a, bb->pred[1], in->b);
+        break;
+    case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV:
+    case IR_LT: case IR_LE: case IR_EQ: case IR_GT: case IR_GE: case IR_NE:
+    case IR_AND: case IR_OR:
+        fprintf(out, " v%d, v%d", in->a, in->b);
+        break;
+    case IR_NOT: case IR_ITOR: case IR_RTOI: case IR_WRITE:
+        fprintf(out, " v%d", in->a);
+        break;
+    case IR_GLOAD:
+        fprintf(out, " @%lld", (long long)in->imm.i);
+        break;
+    case IR_GSTORE:
+        fprintf(out, " @%lld, v%d", (long long)in->imm.i, in->a);
+        break;
+    case IR_CALL:
+        fprintf(out, " %s", internText(m->st->names, m->funcs[in->imm.i].name));
+        printArgs(f, in, out);
+        break;
+    case IR_RESULT:
+        fprintf(out, " v%d.%lld", in->a, (long long)in->imm.i);
+        break;
+    case IR_BR:
+        fprintf(out, " b%d", bb->succ[0]);
+        break;
+    case IR_CBR:
+        fprintf(out, " v%d, b%d, b%d", in->a, bb->succ[0], bb->succ[1]);
+        break;
+    case IR_RET:
+        printArgs(f, in, out);
+        break;
+    default:
+        break;
+    }
+    if (in->type != IR_VOID)
+        fprintf(out, " : %s", IR_TYPE_NAMES[in->type]);
+    fprintf(out, "\n");
+}
+
+void printIr(const IR_MODULE *m, FILE *out) {
+    if (m->nGlobals > 0)
+        fprintf(out, "globals: %d bytes\n", m->globalBytes);
+    for (int k = 0; k < m->nFuncs; k++) {
+        const IR_FUNC *f = &m->funcs[k];
+        fprintf(out, "function %s  (%d in, %d out)\n", internText(m->st->names, f->name),
+                f->nParams, f->nResults);
+        for (int b = 0; b < f->nBlocks; b++) {
+            const IR_BLOCK *bb = &f->blocks[b];
+            if (b > 0 && bb->nPreds == 0 && bb->first < 0)
+                continue;   /* emptied as unreachable */
+            fprintf(out, "  b%d:", b);
+            if (bb->nPreds > 0) {
+                fprintf(out, "  <-");
+                for (int p = 0; p < bb->nPreds; p++)
+                    fprintf(out, " b%d", bb->pred[p]);
+            }
+            fprintf(out, "\n");
+            for (int v = bb->first; v >= 0; v = f->insts[v].next)
+                if (f->insts[v].op != IR_NOP)
+                    printInst(m, f, v, out);
+        }
+    }
+}
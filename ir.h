@@ -0,0 +1,190 @@
+#ifndef IR_H
+#define IR_H
+
+#include "ast.h"
+#include "symbolTable.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Three-address intermediate representation in SSA form.
+ *
+ * A function is three flat arrays: instructions, basic blocks, and the
+ * operand lists of the few instructions that take more than two
+ * operands (calls and returns).  Every instruction defines at most one
+ * value, whose id is the instruction's index, and operands are such
+ * ids; nothing points at anything.  A block's instructions are chained
+ * through 'next' so phis can go in front of code already emitted.
+ *
+ * Control flow comes only from while / if / else, so no block has more
+ * than two predecessors and a phi's operands fit in a and b (one per
+ * predecessor, in pred[] order).
+ *
+ * Values are scalars.  A record or union variable is split into one
+ * SSA variable per leaf: each int / real at a distinct offset of its
+ * layout (union fields of one type at one offset share a leaf).
+ * Record assignment, arithmetic, parameters and results move leaf by
+ * leaf.  Globals stay in memory and are read and written with
+ * IR_GLOAD / IR_GSTORE at byte offsets into the global area.
+ */
+typedef enum {
+    IR_VOID,
+    IR_INT,
+    IR_REAL,
+    IR_BOOL,
+} IR_TYPE;
+
+typedef enum {
+    IR_NOP,         /* removed */
+    IR_UNDEF,       /* a variable read before any assignment */
+    IR_CONST,       /* imm */
+    IR_PARAM,       /* imm.i = index among the flattened input leaves */
+    IR_PHI,         /* a, b = values from pred[0], pred[1] */
+    IR_ADD,         /* a op b, in 'type' */
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_LT,          /* a op b compared as int / real (the operands' type); IR_BOOL */
+    IR_LE,
+    IR_EQ,
+    IR_GT,
+    IR_GE,
+    IR_NE,
+    IR_AND,         /* IR_BOOL */
+    IR_OR,
+    IR_NOT,         /* a */
+    IR_ITOR,        /* int a as real */
+    IR_RTOI,        /* real a truncated to int */
+    IR_GLOAD,       /* global at byte offset imm.i */
+    IR_GSTORE,      /* a to the global at byte offset imm.i */
+    IR_READ,        /* read intrinsic: a value of 'type' from input */
+    IR_WRITE,       /* write intrinsic: a to output */
+    IR_CALL,        /* function imm.i; inputs are args[a .. a + b) */
+    IR_RESULT,      /* output leaf imm.i of call a */
+    IR_BR,          /* to succ[0] */
+    IR_CBR,         /* a ? succ[0] : succ[1] */
+    IR_RET,         /* returns args[a .. a + b) */
+    IR_OP_COUNT
+} IR_OP;
+
+/* Immediate of a const (by type), param, call, result or global access */
+typedef union {
+    int64_t i;
+    double  r;
+} IR_IMM;
+
+typedef struct {
+    uint8_t op;         /* IR_OP */
+    uint8_t type;       /* IR_TYPE of the value defined, IR_VOID if none */
+    int32_t block;
+    int32_t a;
+    int32_t b;
+    int32_t next;       /* next instruction of the block, -1 at its end */
+    int32_t line;
+    IR_IMM  imm;
+} IR_INST;
+
+typedef struct {
+    int32_t first;      /* instruction list, -1 if empty */
+    int32_t last;
+    int32_t pred[2];
+    int32_t succ[2];    /* -1 if absent */
+    int8_t  nPreds;
+    int8_t  nSuccs;
+    uint8_t sealed;     /* every predecessor known (construction only) */
+} IR_BLOCK;
+
+typedef struct {
+    uint32_t  name;     /* in the symbol table's pool */
+    int       nParams;  /* flattened input leaves */
+    int       nResults; /* flattened output leaves */
+    IR_INST  *insts;
+    int       nInsts;
+    int       capInsts;
+    IR_BLOCK *blocks;   /* block 0 is the entry */
+    int       nBlocks;
+    int       capBlocks;
+    int32_t  *args;
+    int       nArgs;
+    int       capArgs;
+} IR_FUNC;
+
+/* How many of a, b are value operands (calls and returns keep theirs in args) */
+static inline int irValueOperands(IR_OP op) {
+    switch (op) {
+    case IR_PHI:
+    case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV:
+    case IR_LT: case IR_LE: case IR_EQ: case IR_GT: case IR_GE: case IR_NE:
+    case IR_AND: case IR_OR:
+        return 2;
+    case IR_NOT: case IR_ITOR: case IR_RTOI: case IR_GSTORE: case IR_WRITE:
+    case IR_RESULT: case IR_CBR:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* A scalar inside a type: byte offset and IR_INT / IR_REAL */
+typedef struct {
+    int32_t offset;
+    int32_t type;
+} IR_LEAF;
+
+typedef struct IR_MODULE {
+    const SYMBOL_TABLE *st;
+    IR_FUNC            *funcs;      /* funcs[k] is function k of the table */
+    int                 nFuncs;
+    int32_t            *leafFirst;  /* by type id: its leaves are leaves[leafFirst .. + leafCount) */
+    int32_t            *leafCount;
+    IR_LEAF            *leaves;
+    int                 nLeaves;
+    int32_t            *globalSyms; /* global variables, ascending symbol index */
+    int32_t            *globalAt;   /* and their byte offsets in the global area */
+    int                 nGlobals;
+    int32_t             globalBytes;
+} IR_MODULE;
+
+typedef IR_MODULE *irModule;
+
+/*
+ * Lower every function of 'program' (laying out its record accesses
+ * first).  Meant for programs the type checker passed; anything that
+ * does not resolve becomes IR_UNDEF rather than an error.
+ */
+irModule lowerProgram(const SYMBOL_TABLE *st, AstNode *program);
+
+void freeIrModule(irModule m);
+
+/*
+ * New instruction in 'block' of 'f', not yet in the block's chain (the
+ * insts array may move).  irLinkAfter puts v into the chain of 'block'
+ * after 'prev', or in front with prev = -1.
+ */
+int irAddInst(IR_FUNC *f, int block, IR_OP op, IR_TYPE type, int a, int b, int line);
+void irLinkAfter(IR_FUNC *f, int block, int prev, int v);
+
+/* Empty block; an edge (the successor's next pred slot); an operand list entry */
+int irAddBlock(IR_FUNC *f);
+void irAddEdge(IR_FUNC *f, int from, int to);
+int irAddArg(IR_FUNC *f, int v);
+
+/*
+ * Replacement maps: repl[v] is v, or a value v was found equal to.
+ * irFindValue follows a chain to its end (shortening it on the way);
+ * irReplaceOperands renames every operand of 'f' through the map.
+ */
+int irFindValue(int32_t *repl, int v);
+void irReplaceOperands(IR_FUNC *f, int32_t *repl);
+
+/* Bytes held by the module's arrays */
+size_t irModuleBytes(const IR_MODULE *m);
+
+/* Listing of every function, block by block */
+void printIr(const IR_MODULE *m, FILE *out);
+
+/* Mnemonic of an opcode */
+const char *irOpName(IR_OP op);
+
+#endif /* IR_H */
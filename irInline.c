@@ -0,0 +1,383 @@
+#include "irInline.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ---- call graph ---- */
+
+/* Tarjan's components without recursion: 'frames' is the DFS path, 'cursor' each node's next edge */
+static void findComponents(irCallGraph g) {
+    int      n       = g->nFuncs;
+    int32_t *index   = (int32_t *)malloc(n * sizeof(int32_t));
+    int32_t *low     = (int32_t *)malloc(n * sizeof(int32_t));
+    int32_t *cursor  = (int32_t *)malloc(n * sizeof(int32_t));
+    int32_t *stack   = (int32_t *)malloc(n * sizeof(int32_t));
+    int32_t *frames  = (int32_t *)malloc(n * sizeof(int32_t));
+    uint8_t *onStack = (uint8_t *)calloc(n, 1);
+    int      next = 0, sp = 0, nOrder = 0;
+
+    for (int k = 0; k < n; k++)
+        index[k] = -1;
+    for (int r = 0; r < n; r++) {
+        if (index[r] >= 0)
+            continue;
+        int fp = 0;
+        index[r] = low[r] = next++;
+        cursor[r]    = g->first[r];
+        stack[sp++]  = r;
+        onStack[r]   = 1;
+        frames[fp++] = r;
+        while (fp > 0) {
+            int k = frames[fp - 1];
+            if (cursor[k] < g->first[k + 1]) {
+                int j = g->callee[cursor[k]++];
+                if (index[j] < 0) {
+                    index[j] = low[j] = next++;
+                    cursor[j]    = g->first[j];
+                    stack[sp++]  = j;
+                    onStack[j]   = 1;
+                    frames[fp++] = j;
+                } else if (onStack[j] && index[j] < low[k]) {
+                    low[k] = index[j];
+                }
+                continue;
+            }
+            if (--fp > 0 && low[k] < low[frames[fp - 1]])
+                low[frames[fp - 1]] = low[k];
+            if (low[k] != index[k])
+                continue;
+            int size = 0, x;
+            do {
+                x          = stack[--sp];
+                onStack[x] = 0;
+                g->scc[x]  = g->nSccs;
+                g->order[nOrder++] = x;
+                size++;
+            } while (x != k);
+            for (int i = nOrder - size; size > 1 && i < nOrder; i++)
+                g->recursive[g->order[i]] = 1;
+            g->nSccs++;
+        }
+    }
+    free(index);
+    free(low);
+    free(cursor);
+    free(stack);
+    free(frames);
+    free(onStack);
+}
+
+irCallGraph buildCallGraph(const IR_MODULE *m) {
+    irCallGraph g = (irCallGraph)calloc(1, sizeof(IR_CALL_GRAPH));
+    int         n = m->nFuncs, nEdges = 0, cap = 64;
+
+    g->nFuncs    = n;
+    g->first     = (int32_t *)malloc((n + 1) * sizeof(int32_t));
+    g->callee    = (int32_t *)malloc(cap * sizeof(int32_t));
+    g->sites     = (int32_t *)calloc(n > 0 ? n : 1, sizeof(int32_t));
+    g->scc       = (int32_t *)malloc((n > 0 ? n : 1) * sizeof(int32_t));
+    g->order     = (int32_t *)malloc((n > 0 ? n : 1) * sizeof(int32_t));
+    g->recursive = (uint8_t *)calloc(n > 0 ? n : 1, 1);
+
+    /* seen[j] == k: edge k -> j already listed */
+    int32_t *seen = (int32_t *)malloc((n > 0 ? n : 1) * sizeof(int32_t));
+    for (int j = 0; j < n; j++)
+        seen[j] = -1;
+    for (int k = 0; k < n; k++) {
+        const IR_FUNC *f = &m->funcs[k];
+        g->first[k] = nEdges;
+        for (int v = 0; v < f->nInsts; v++) {
+            if (f->insts[v].op != IR_CALL)
+                continue;
+            int j = (int)f->insts[v].imm.i;
+            g->sites[j]++;
+            if (seen[j] == k)
+                continue;
+            seen[j] = k;
+            if (nEdges == cap) {
+                cap *= 2;
+                g->callee = (int32_t *)realloc(g->callee, cap * sizeof(int32_t));
+            }
+            g->callee[nEdges++] = j;
+            if (j == k)
+                g->recursive[k] = 1;
+        }
+    }
+    g->first[n] = nEdges;
+    free(seen);
+    findComponents(g);
+    return g;
+}
+
+void freeCallGraph(irCallGraph g) {
+    if (g == NULL)
+        return;
+    free(g->first);
+    free(g->callee);
+    free(g->sites);
+    free(g->scc);
+    free(g->order);
+    free(g->recursive);
+    free(g);
+}
+
+/* ---- inlining ---- */
+
+typedef struct {
+    int32_t *map;       /* callee value -> caller value, -1 if not copied */
+    int      capMap;
+    int32_t *calls;     /* the caller's call instructions */
+    int32_t *results;   /* per caller instruction: first IR_RESULT of a call, or next of a result */
+    int32_t *nextResult;
+    int      capCalls;
+    int32_t *from;      /* a result and the value it became */
+    int32_t *to;
+    int      nPairs;
+    int      capPairs;
+    int32_t *repl;
+    int      capRepl;
+    int32_t *remaining; /* per function: call instructions still naming it */
+    int32_t *size;      /* per function: live instructions, once its own inlining is done */
+} Inliner;
+
+static int liveSize(const IR_FUNC *f) {
+    int n = 0;
+    for (int v = 0; v < f->nInsts; v++)
+        n += f->insts[v].op != IR_NOP;
+    return n;
+}
+
+/* The one return of 'g', or -1 if it has none or several */
+static int soleReturn(const IR_FUNC *g) {
+    int ret = -1;
+    for (int b = 0; b < g->nBlocks; b++) {
+        int v = g->blocks[b].last;
+        if (v < 0 || g->insts[v].op != IR_RET)
+            continue;
+        if (ret >= 0)
+            return -1;
+        ret = v;
+    }
+    return ret;
+}
+
+/* Move what follows call 'c' to a new block, which takes over the call block's successors */
+static int splitAfter(IR_FUNC *f, int c) {
+    int       B    = f->insts[c].block;
+    int       cont = irAddBlock(f);
+    IR_BLOCK *bb = &f->blocks[B], *cb = &f->blocks[cont];
+
+    cb->first = f->insts[c].next;
+    cb->last  = (cb->first >= 0) ? bb->last : -1;
+    for (int v = cb->first; v >= 0; v = f->insts[v].next)
+        f->insts[v].block = cont;
+    f->insts[c].next = -1;
+    bb->last         = c;
+
+    cb->nSuccs = bb->nSuccs;
+    for (int i = 0; i < bb->nSuccs; i++) {
+        IR_BLOCK *sb = &f->blocks[bb->succ[i]];
+        cb->succ[i]  = bb->succ[i];
+        for (int p = 0; p < sb->nPreds; p++)
+            if (sb->pred[p] == B)
+                sb->pred[p] = cont;
+    }
+    bb->nSuccs  = 0;
+    bb->succ[0] = bb->succ[1] = -1;
+    return cont;
+}
+
+static void addPair(Inliner *s, int from, int to) {
+    if (s->nPairs == s->capPairs) {
+        s->capPairs = s->capPairs ? 2 * s->capPairs : 64;
+        s->from     = (int32_t *)realloc(s->from, s->capPairs * sizeof(int32_t));
+        s->to       = (int32_t *)realloc(s->to, s->capPairs * sizeof(int32_t));
+    }
+    s->from[s->nPairs] = from;
+    s->to[s->nPairs++] = to;
+}
+
+/* Replace call 'c' of 'f' by a copy of 'g', whose return is 'ret' */
+static void inlineCall(Inliner *s, IR_FUNC *f, int c, const IR_FUNC *g, int ret) {
+    int B    = f->insts[c].block;
+    int cont = splitAfter(f, c);
+    int base = f->nBlocks;
+    int args = f->insts[c].a;
+
+    for (int j = 0; j < g->nBlocks; j++) {
+        int             n  = irAddBlock(f);
+        const IR_BLOCK *gb = &g->blocks[j];
+        IR_BLOCK       *nb = &f->blocks[n];
+        nb->nPreds = gb->nPreds;
+        nb->nSuccs = gb->nSuccs;
+        for (int i = 0; i < 2; i++) {
+            nb->pred[i] = (gb->pred[i] >= 0) ? base + gb->pred[i] : -1;
+            nb->succ[i] = (gb->succ[i] >= 0) ? base + gb->succ[i] : -1;
+        }
+    }
+    if (g->nInsts > s->capMap) {
+        s->capMap = 2 * g->nInsts;
+        s->map    = (int32_t *)realloc(s->map, s->capMap * sizeof(int32_t));
+    }
+
+    /* the copies first, so operands may name values defined further on */
+    for (int j = 0; j < g->nBlocks; j++) {
+        for (int v = g->blocks[j].first; v >= 0; v = g->insts[v].next) {
+            const IR_INST *in = &g->insts[v];
+            s->map[v]         = -1;
+            if (in->op == IR_NOP)
+                continue;
+            if (in->op == IR_PARAM) {
+                s->map[v] = f->args[args + in->imm.i];
+                continue;
+            }
+            IR_OP op = (v == ret) ? IR_BR : (IR_OP)in->op;
+            int   w  = irAddInst(f, base + j, op, (IR_TYPE)in->type, -1, -1, in->line);
+            f->insts[w].imm = in->imm;
+            irLinkAfter(f, base + j, f->blocks[base + j].last, w);
+            s->map[v] = w;
+        }
+    }
+    for (int j = 0; j < g->nBlocks; j++) {
+        for (int v = g->blocks[j].first; v >= 0; v = g->insts[v].next) {
+            const IR_INST *in = &g->insts[v];
+            if (in->op == IR_NOP || in->op == IR_PARAM || v == ret)
+                continue;
+            int w = s->map[v], n = irValueOperands((IR_OP)in->op);
+            if (n >= 1)
+                f->insts[w].a = s->map[in->a];
+            if (n >= 2)
+                f->insts[w].b = s->map[in->b];
+            if (in->op == IR_CALL) {
+                f->insts[w].a = f->nArgs;
+                for (int i = 0; i < in->b; i++)
+                    irAddArg(f, s->map[g->args[in->a + i]]);
+                s->remaining[in->imm.i]++;
+            }
+        }
+    }
+
+    /* the return block goes on to what followed the call, and the call block into the copy */
+    int retBlock = base + g->insts[ret].block;
+    irAddEdge(f, retBlock, cont);
+    f->insts[c] = (IR_INST){ .op = IR_BR, .type = IR_VOID, .block = B, .a = -1, .b = -1,
+                             .next = -1, .line = f->insts[c].line, .imm.i = 0 };
+    irAddEdge(f, B, base);
+
+    for (int r = s->results[c]; r >= 0; r = s->nextResult[r]) {
+        addPair(s, r, s->map[g->args[g->insts[ret].a + f->insts[r].imm.i]]);
+        f->insts[r].op = IR_NOP;
+    }
+}
+
+/* Inline what the cost model allows into function k */
+static void inlineInto(Inliner *s, irModule m, const IR_CALL_GRAPH *cg, int k,
+                       IR_INLINE_STATS *st) {
+    IR_FUNC *f     = &m->funcs[k];
+    int      nOrig = f->nInsts, nCalls = 0;
+
+    if (f->nBlocks == 0)
+        return;
+    if (nOrig > s->capCalls) {
+        s->capCalls   = 2 * nOrig;
+        s->calls      = (int32_t *)realloc(s->calls, s->capCalls * sizeof(int32_t));
+        s->results    = (int32_t *)realloc(s->results, s->capCalls * sizeof(int32_t));
+        s->nextResult = (int32_t *)realloc(s->nextResult, s->capCalls * sizeof(int32_t));
+    }
+    for (int v = 0; v < nOrig; v++)
+        s->results[v] = -1;
+    for (int v = nOrig - 1; v >= 0; v--) {
+        const IR_INST *in = &f->insts[v];
+        if (in->op == IR_RESULT) {
+            s->nextResult[v]  = s->results[in->a];
+            s->results[in->a] = v;
+        }
+    }
+    for (int v = 0; v < nOrig; v++)
+        if (f->insts[v].op == IR_CALL)
+            s->calls[nCalls++] = v;
+
+    int size = liveSize(f), limit = size + (size > IR_INLINE_GROWTH ? size : IR_INLINE_GROWTH);
+    s->nPairs = 0;
+    for (int i = 0; i < nCalls; i++) {
+        int            c = s->calls[i], j = (int)f->insts[c].imm.i;
+        const IR_FUNC *g = &m->funcs[j];
+        st->calls++;
+        if (cg->scc[j] == cg->scc[k]) {
+            st->recursive++;
+            continue;
+        }
+        if (g->nBlocks == 0 || g->blocks[0].nPreds > 0)
+            continue;
+        bool small = s->size[j] <= IR_INLINE_SMALL;
+        bool once  = s->remaining[j] == 1 && s->size[j] <= IR_INLINE_ONCE;
+        if (!(small || once) || size + s->size[j] > limit)
+            continue;
+        int ret = soleReturn(g);
+        if (ret < 0)
+            continue;
+        inlineCall(s, f, c, g, ret);
+        s->remaining[j]--;
+        size += s->size[j];
+        st->inlined++;
+    }
+
+    if (s->nPairs > 0) {
+        if (f->nInsts > s->capRepl) {
+            s->capRepl = 2 * f->nInsts;
+            s->repl    = (int32_t *)realloc(s->repl, s->capRepl * sizeof(int32_t));
+        }
+        for (int v = 0; v < f->nInsts; v++)
+            s->repl[v] = v;
+        for (int i = 0; i < s->nPairs; i++)
+            s->repl[s->from[i]] = s->to[i];
+        irReplaceOperands(f, s->repl);
+    }
+}
+
+/* ------------------------------------------------------------------
+ * irInline
+ * ------------------------------------------------------------------ */
+void irInline(irModule m, IR_INLINE_STATS *stats) {
+    IR_INLINE_STATS st;
+    memset(&st, 0, sizeof st);
+    for (int k = 0; k < m->nFuncs; k++)
+        st.before += liveSize(&m->funcs[k]);
+
+    irCallGraph cg = buildCallGraph(m);
+    Inliner     s;
+    memset(&s, 0, sizeof s);
+    s.remaining = (int32_t *)malloc((m->nFuncs > 0 ? m->nFuncs : 1) * sizeof(int32_t));
+    s.size      = (int32_t *)malloc((m->nFuncs > 0 ? m->nFuncs : 1) * sizeof(int32_t));
+    memcpy(s.remaining, cg->sites, m->nFuncs * sizeof(int32_t));
+
+    for (int i = 0; i < m->nFuncs; i++) {
+        int k = cg->order[i];
+        inlineInto(&s, m, cg, k, &st);
+        s.size[k] = liveSize(&m->funcs[k]);
+    }
+
+    /* main (the last function) is the only one needed without callers */
+    for (int k = 0; k + 1 < m->nFuncs; k++) {
+        IR_FUNC *f = &m->funcs[k];
+        if (cg->sites[k] > 0 && s.remaining[k] == 0 && f->nBlocks > 0) {
+            f->nInsts = f->nBlocks = f->nArgs = 0;
+            st.emptied++;
+        }
+    }
+    for (int k = 0; k < m->nFuncs; k++)
+        st.after += liveSize(&m->funcs[k]);
+    if (stats)
+        *stats = st;
+
+    free(s.map);
+    free(s.calls);
+    free(s.results);
+    free(s.nextResult);
+    free(s.from);
+    free(s.to);
+    free(s.repl);
+    free(s.remaining);
+    free(s.size);
+    freeCallGraph(cg);
+}
@@ -0,0 +1,56 @@
+#ifndef IR_INLINE_H
+#define IR_INLINE_H
+
+#include "ir.h"
+#include <stdint.h>
+
+/*
+ * Call graph of a module: an edge k -> j for every function j that k
+ * calls, however many times, with the strongly connected components
+ * (Tarjan's) that recursion forms.  Functions are defined before they
+ * are used, so only direct self calls make cycles today; nothing here
+ * relies on that.
+ */
+typedef struct {
+    int      nFuncs;
+    int32_t *first;     /* callees of k are callee[first[k] .. first[k + 1]) */
+    int32_t *callee;
+    int32_t *sites;     /* per function: call instructions naming it */
+    int32_t *scc;       /* per function: its component */
+    int      nSccs;
+    int32_t *order;     /* every function, components in callees-first order */
+    uint8_t *recursive; /* per function: on a cycle, a self call included */
+} IR_CALL_GRAPH;
+
+typedef IR_CALL_GRAPH *irCallGraph;
+
+irCallGraph buildCallGraph(const IR_MODULE *m);
+
+void freeCallGraph(irCallGraph g);
+
+/*
+ * Inlining, callees first so what a callee inlined comes along.  A
+ * call is replaced by a copy of its callee's body when the callee is
+ * not in the caller's component, has one return, and is small
+ * (IR_INLINE_SMALL instructions) or called from just this site
+ * (IR_INLINE_ONCE); a caller stops taking callees once it has grown by
+ * its own size or IR_INLINE_GROWTH instructions, whichever is more.
+ * Functions other than main whose every call was inlined are emptied.
+ */
+#define IR_INLINE_SMALL  32
+#define IR_INLINE_ONCE   400
+#define IR_INLINE_GROWTH 256
+
+typedef struct {
+    int  calls;         /* call instructions seen */
+    int  inlined;       /* of those, replaced by the callee's body */
+    int  recursive;     /* left alone as calls within a component */
+    int  emptied;       /* functions left with no caller */
+    long before;        /* live instructions over the module */
+    long after;
+} IR_INLINE_STATS;
+
+/* 'stats' may be NULL */
+void irInline(irModule m, IR_INLINE_STATS *stats);
+
+#endif /* IR_INLINE_H */
@@ -0,0 +1,325 @@
+#include "irInterp.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *STATUS_TEXT[] = {
+    [IR_RUN_OK]         = "ok",
+    [IR_RUN_NO_MAIN]    = "no main function",
+    [IR_RUN_DIV_ZERO]   = "division by zero",
+    [IR_RUN_STEP_LIMIT] = "step limit reached",
+    [IR_RUN_DEPTH]      = "calls nested too deeply",
+};
+
+const char *irRunStatusText(IR_RUN_STATUS status) {
+    return (status <= IR_RUN_DEPTH) ? STATUS_TEXT[status] : "?";
+}
+
+/*
+ * The value stack holds one frame per active call: the values of the
+ * function's instructions, then one slot per result of the largest
+ * callee so IR_RESULT can read what the last call returned.  A call's
+ * arguments are pushed just above the caller's frame.
+ */
+typedef struct {
+    const IR_MODULE *m;
+    IR_RUN          *run;
+    IR_IMM          *stack;
+    size_t           sp;
+    size_t           cap;
+    IR_IMM          *phis;      /* a block's incoming values, so its phis take them at once */
+    int              capPhis;
+    uint8_t         *globals;
+    int              maxResults;
+    int              depth;
+    uint64_t         rng;
+} Interp;
+
+static int64_t wrapInt(int64_t x) {
+    return (int64_t)(int32_t)(uint32_t)x;
+}
+
+static void reserveStack(Interp *I, size_t n) {
+    if (I->sp + n <= I->cap)
+        return;
+    while (I->sp + n > I->cap)
+        I->cap = I->cap ? 2 * I->cap : 4096;
+    I->stack = (IR_IMM *)realloc(I->stack, I->cap * sizeof(IR_IMM));
+}
+
+static IR_IMM readValue(Interp *I, IR_TYPE type) {
+    IR_IMM x = { .i = 0 };
+    if (I->run->in != NULL) {
+        double    r;
+        long long i;
+        if (type == IR_REAL && fscanf(I->run->in, "%lf", &r) == 1)
+            x.r = r;
+        else if (type != IR_REAL && fscanf(I->run->in, "%lld", &i) == 1)
+            x.i = wrapInt(i);
+        return x;
+    }
+    I->rng = I->rng * 6364136223846793005ull + 1442695040888963407ull;
+    uint32_t r = (uint32_t)(I->rng >> 33);
+    if (type == IR_REAL)
+        x.r = (r % 10000) / 100.0;
+    else
+        x.i = r % 100;
+    return x;
+}
+
+static void writeValue(Interp *I, IR_TYPE type, IR_IMM x) {
+    IR_RUN  *run  = I->run;
+    uint64_t bits = (uint64_t)x.i;
+    if (type == IR_REAL)
+        memcpy(&bits, &x.r, sizeof bits);
+    run->checksum = (run->checksum ^ bits) * 0x100000001B3ull;
+    run->writes++;
+    if (run->out == NULL)
+        return;
+    if (type == IR_REAL)
+        fprintf(run->out, "%.2f\n", x.r);
+    else
+        fprintf(run->out, "%lld\n", (long long)x.i);
+}
+
+static int64_t realToInt(double r) {
+    if (r != r)
+        return 0;
+    if (r >= 2147483647.0)
+        return INT32_MAX;
+    if (r <= -2147483648.0)
+        return INT32_MIN;
+    return (int64_t)r;
+}
+
+static bool compare(IR_OP op, bool real, IR_IMM x, IR_IMM y) {
+    if (real) {
+        switch (op) {
+        case IR_LT: return x.r < y.r;
+        case IR_LE: return x.r <= y.r;
+        case IR_EQ: return x.r == y.r;
+        case IR_GT: return x.r > y.r;
+        case IR_GE: return x.r >= y.r;
+        default:    return x.r != y.r;
+        }
+    }
+    switch (op) {
+    case IR_LT: return x.i < y.i;
+    case IR_LE: return x.i <= y.i;
+    case IR_EQ: return x.i == y.i;
+    case IR_GT: return x.i > y.i;
+    case IR_GE: return x.i >= y.i;
+    default:    return x.i != y.i;
+    }
+}
+
+/* Phis take their values from the predecessor 'from' all at once */
+static void enterBlock(Interp *I, const IR_FUNC *f, IR_IMM *V, int b, int from) {
+    const IR_BLOCK *bb   = &f->blocks[b];
+    int             slot = (bb->pred[0] == from) ? 0 : 1;
+    int             n    = 0;
+
+    /* phis lead the block, among constants that folding left in their place and removed ones */
+    for (int v = bb->first; v >= 0; v = f->insts[v].next) {
+        const IR_INST *in = &f->insts[v];
+        if (in->op == IR_PHI)
+            I->phis[n++] = V[slot ? in->b : in->a];
+        else if (in->op != IR_CONST && in->op != IR_UNDEF && in->op != IR_NOP)
+            break;
+    }
+    n = 0;
+    for (int v = bb->first; v >= 0; v = f->insts[v].next) {
+        const IR_INST *in = &f->insts[v];
+        if (in->op == IR_PHI)
+            V[v] = I->phis[n++];
+        else if (in->op != IR_CONST && in->op != IR_UNDEF && in->op != IR_NOP)
+            break;
+    }
+}
+
+/* Run function k with its arguments at stack[argBase] and its results to stack[retBase] */
+static IR_RUN_STATUS runFunc(Interp *I, int k, size_t argBase, size_t retBase) {
+    const IR_FUNC *f   = &I->m->funcs[k];
+    IR_RUN        *run = I->run;
+
+    if (f->nBlocks == 0) {
+        for (int i = 0; i < f->nResults; i++)
+            I->stack[retBase + i].i = 0;
+        return IR_RUN_OK;
+    }
+    if (++I->depth > IR_MAX_CALL_DEPTH)
+        return IR_RUN_DEPTH;
+    if (f->nInsts > I->capPhis) {
+        I->capPhis = f->nInsts;
+        I->phis    = (IR_IMM *)realloc(I->phis, I->capPhis * sizeof(IR_IMM));
+    }
+    size_t base = I->sp;
+    reserveStack(I, (size_t)f->nInsts + I->maxResults);
+    I->sp += (size_t)f->nInsts + I->maxResults;
+    IR_IMM *V = I->stack + base;
+    memset(V, 0, ((size_t)f->nInsts + I->maxResults) * sizeof(IR_IMM));
+
+    IR_RUN_STATUS status = IR_RUN_OK;
+    int           b = 0, from = -1;
+    for (;;) {
+        if (from >= 0)
+            enterBlock(I, f, V, b, from);
+        int jump = -1;
+        for (int v = f->blocks[b].first; v >= 0; v = f->insts[v].next) {
+            const IR_INST *in = &f->insts[v];
+            run->steps++;
+            switch (in->op) {
+            case IR_CONST:
+                V[v] = in->imm;
+                break;
+            case IR_UNDEF:
+                V[v].i = 0;
+                break;
+            case IR_PARAM:
+                V[v] = I->stack[argBase + in->imm.i];
+                break;
+            case IR_ADD:
+                if (in->type == IR_INT)
+                    V[v].i = wrapInt(V[in->a].i + V[in->b].i);
+                else
+                    V[v].r = V[in->a].r + V[in->b].r;
+                break;
+            case IR_SUB:
+                if (in->type == IR_INT)
+                    V[v].i = wrapInt(V[in->a].i - V[in->b].i);
+                else
+                    V[v].r = V[in->a].r - V[in->b].r;
+                break;
+            case IR_MUL:
+                if (in->type == IR_INT)
+                    V[v].i = wrapInt(V[in->a].i * V[in->b].i);
+                else
+                    V[v].r = V[in->a].r * V[in->b].r;
+                break;
+            case IR_DIV:
+                if (in->type != IR_INT) {
+                    V[v].r = V[in->a].r / V[in->b].r;
+                } else if (V[in->b].i == 0) {
+                    run->line = in->line;
+                    status    = IR_RUN_DIV_ZERO;
+                    goto done;
+                } else {
+                    V[v].i = wrapInt(V[in->a].i / V[in->b].i);
+                }
+                break;
+            case IR_LT: case IR_LE: case IR_EQ: case IR_GT: case IR_GE: case IR_NE:
+                V[v].i = compare((IR_OP)in->op, f->insts[in->a].type == IR_REAL, V[in->a],
+                                 V[in->b]);
+                break;
+            case IR_AND:
+                V[v].i = V[in->a].i && V[in->b].i;
+                break;
+            case IR_OR:
+                V[v].i = V[in->a].i || V[in->b].i;
+                break;
+            case IR_NOT:
+                V[v].i = !V[in->a].i;
+                break;
+            case IR_ITOR:
+                V[v].r = (double)V[in->a].i;
+                break;
+            case IR_RTOI:
+                V[v].i = realToInt(V[in->a].r);
+                break;
+            case IR_GLOAD:
+                if (in->type == IR_REAL) {
+                    memcpy(&V[v].r, I->globals + in->imm.i, sizeof(double));
+                } else {
+                    int32_t x;
+                    memcpy(&x, I->globals + in->imm.i, sizeof x);
+                    V[v].i = x;
+                }
+                break;
+            case IR_GSTORE:
+                if (f->insts[in->a].type == IR_REAL) {
+                    memcpy(I->globals + in->imm.i, &V[in->a].r, sizeof(double));
+                } else {
+                    int32_t x = (int32_t)V[in->a].i;
+                    memcpy(I->globals + in->imm.i, &x, sizeof x);
+                }
+                break;
+            case IR_READ:
+                V[v] = readValue(I, (IR_TYPE)in->type);
+                break;
+            case IR_WRITE:
+                writeValue(I, (IR_TYPE)f->insts[in->a].type, V[in->a]);
+                break;
+            case IR_CALL: {
+                size_t args = I->sp;
+                reserveStack(I, in->b);
+                V = I->stack + base;
+                for (int i = 0; i < in->b; i++)
+                    I->stack[args + i] = V[f->args[in->a + i]];
+                I->sp += in->b;
+                status = runFunc(I, (int)in->imm.i, args, base + f->nInsts);
+                I->sp  = args;
+                V      = I->stack + base;
+                if (status != IR_RUN_OK)
+                    goto done;
+                break;
+            }
+            case IR_RESULT:
+                V[v] = V[f->nInsts + in->imm.i];
+                break;
+            case IR_BR:
+                jump = f->blocks[b].succ[0];
+                break;
+            case IR_CBR:
+                jump = f->blocks[b].succ[V[in->a].i ? 0 : 1];
+                break;
+            case IR_RET:
+                for (int i = 0; i < in->b; i++)
+                    I->stack[retBase + i] = V[f->args[in->a + i]];
+                goto done;
+            default:    /* phis were set on the way in */
+                break;
+            }
+        }
+        if (jump < 0)
+            break;
+        if (run->maxSteps != 0 && run->steps > run->maxSteps) {
+            run->line = f->insts[f->blocks[b].last].line;
+            status    = IR_RUN_STEP_LIMIT;
+            break;
+        }
+        from = b;
+        b    = jump;
+    }
+done:
+    I->sp = base;
+    I->depth--;
+    return status;
+}
+
+/* ------------------------------------------------------------------
+ * irRun
+ * ------------------------------------------------------------------ */
+IR_RUN_STATUS irRun(const IR_MODULE *m, IR_RUN *run) {
+    run->steps = run->writes = run->checksum = 0;
+    run->line  = 0;
+    if (m->nFuncs == 0 || m->funcs[m->nFuncs - 1].nBlocks == 0)
+        return IR_RUN_NO_MAIN;
+
+    Interp I;
+    memset(&I, 0, sizeof I);
+    I.m       = m;
+    I.run     = run;
+    I.rng     = run->seed;
+    I.globals = (uint8_t *)calloc(m->globalBytes > 0 ? m->globalBytes : 1, 1);
+    for (int k = 0; k < m->nFuncs; k++)
+        if (m->funcs[k].nResults > I.maxResults)
+            I.maxResults = m->funcs[k].nResults;
+    reserveStack(&I, (size_t)I.maxResults);
+    I.sp = (size_t)I.maxResults;     /* main's results, which nobody reads */
+
+    IR_RUN_STATUS status = runFunc(&I, m->nFuncs - 1, 0, 0);
+    free(I.stack);
+    free(I.phis);
+    free(I.globals);
+    return status;
+}
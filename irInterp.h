@@ -0,0 +1,48 @@
+#ifndef IR_INTERP_H
+#define IR_INTERP_H
+
+#include "ir.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Reference interpreter for the SSA IR: runs the main function of a
+ * module block by block.  It is how the optimisation passes are checked
+ * (a module must write the same values before and after them) and what
+ * the loop benchmark times.
+ *
+ * int is 32-bit with wraparound and real a double.  read takes values
+ * from 'in', or with in == NULL from a stream fixed by 'seed' (ints in
+ * [0, 100), reals with two decimals).  Every value written is folded
+ * into 'checksum' in order and, if 'out' is set, printed there.  A
+ * variable read before it is set is 0.
+ */
+typedef enum {
+    IR_RUN_OK,
+    IR_RUN_NO_MAIN,
+    IR_RUN_DIV_ZERO,    /* int division by zero */
+    IR_RUN_STEP_LIMIT,  /* more than maxSteps instructions */
+    IR_RUN_DEPTH,       /* calls nested deeper than IR_MAX_CALL_DEPTH */
+} IR_RUN_STATUS;
+
+#define IR_MAX_CALL_DEPTH 4096
+
+typedef struct {
+    FILE    *in;
+    FILE    *out;
+    uint64_t seed;
+    uint64_t maxSteps;      /* 0 = no limit */
+
+    /* results */
+    uint64_t steps;         /* instructions executed (phis included) */
+    uint64_t writes;
+    uint64_t checksum;
+    int      line;          /* of the instruction that stopped a failed run */
+} IR_RUN;
+
+/* Run main; the counters in 'run' are reset first */
+IR_RUN_STATUS irRun(const IR_MODULE *m, IR_RUN *run);
+
+const char *irRunStatusText(IR_RUN_STATUS status);
+
+#endif /* IR_INTERP_H */
@@ -0,0 +1,848 @@
+#include "ir.h"
+#include "typeLayout.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Expression type of a condition (one IR_BOOL value) */
+#define LOWER_BOOL (-2)
+
+/* ---- leaves and globals ---- */
+
+static int cmpLeaf(const void *pa, const void *pb) {
+    const IR_LEAF *a = (const IR_LEAF *)pa, *b = (const IR_LEAF *)pb;
+    if (a->offset != b->offset)
+        return a->offset < b->offset ? -1 : 1;
+    return a->type - b->type;
+}
+
+static void addLeaves(irModule m, const IR_LEAF *leaves, int n) {
+    m->leaves = (IR_LEAF *)realloc(m->leaves, (m->nLeaves + n) * sizeof(IR_LEAF));
+    memcpy(m->leaves + m->nLeaves, leaves, n * sizeof(IR_LEAF));
+    m->nLeaves += n;
+}
+
+/* Leaves of type t, nested records first; a record that contains itself gets none */
+static void typeLeaves(irModule m, int t, uint8_t *state) {
+    const SYMBOL_TABLE *st = m->st;
+    const TYPE_INFO    *ti = &st->types[t];
+
+    if (state[t] != 0)
+        return;
+    state[t] = 1;
+
+    int      n = 0, cap = 8;
+    IR_LEAF *tmp = (IR_LEAF *)malloc(cap * sizeof(IR_LEAF));
+    if (t == TYPE_INT || t == TYPE_REAL) {
+        tmp[n++] = (IR_LEAF){ 0, t == TYPE_INT ? IR_INT : IR_REAL };
+    } else if (ti->alias == TYPE_NONE) {
+        for (int f = ti->firstField; f < ti->firstField + ti->nFields; f++) {
+            int ft = st->fields[f].type;
+            if (ft == TYPE_NONE)
+                continue;
+            typeLeaves(m, ft, state);
+            for (int j = 0; j < m->leafCount[ft]; j++) {
+                if (n == cap)
+                    tmp = (IR_LEAF *)realloc(tmp, (cap *= 2) * sizeof(IR_LEAF));
+                IR_LEAF lf = m->leaves[m->leafFirst[ft] + j];
+                tmp[n++]   = (IR_LEAF){ st->fields[f].offset + lf.offset, lf.type };
+            }
+        }
+        /* union fields of one type at one offset are one leaf */
+        qsort(tmp, n, sizeof(IR_LEAF), cmpLeaf);
+        int kept = 0;
+        for (int j = 0; j < n; j++)
+            if (kept == 0 || cmpLeaf(&tmp[kept - 1], &tmp[j]) != 0)
+                tmp[kept++] = tmp[j];
+        n = kept;
+    }
+    m->leafFirst[t] = m->nLeaves;
+    m->leafCount[t] = n;
+    addLeaves(m, tmp, n);
+    free(tmp);
+    state[t] = 2;
+}
+
+static void buildLeaves(irModule m) {
+    const SYMBOL_TABLE *st    = m->st;
+    uint8_t            *state = (uint8_t *)calloc(st->nTypes, 1);
+
+    m->leafFirst = (int32_t *)calloc(st->nTypes, sizeof(int32_t));
+    m->leafCount = (int32_t *)calloc(st->nTypes, sizeof(int32_t));
+    for (int t = 0; t < st->nTypes; t++)
+        typeLeaves(m, t, state);
+    /* an alias has its target's leaves */
+    for (int t = TYPE_REAL + 1; t < st->nTypes; t++) {
+        int r = t;
+        for (int steps = 0; st->types[r].alias != TYPE_NONE && steps < st->nTypes; steps++)
+            r = st->types[r].alias;
+        m->leafFirst[t] = m->leafFirst[r];
+        m->leafCount[t] = m->leafCount[r];
+    }
+    free(state);
+}
+
+/* Index of the leaf at 'offset' of IR type 'type' within type t, or -1 */
+static int leafIndex(const IR_MODULE *m, int t, int32_t offset, int type) {
+    const IR_LEAF *lv = m->leaves + m->leafFirst[t];
+    IR_LEAF        key = { offset, type };
+    int            lo = 0, hi = m->leafCount[t] - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int c   = cmpLeaf(&lv[mid], &key);
+        if (c == 0)
+            return mid;
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return -1;
+}
+
+static void buildGlobals(irModule m) {
+    const SYMBOL_TABLE *st = m->st;
+    for (int s = 0; s < st->nSyms; s++) {
+        const SYMBOL *sym = &st->syms[s];
+        if (sym->kind != SYM_GLOBAL || sym->type == TYPE_NONE)
+            continue;
+        const TYPE_INFO *ti    = &st->types[sym->type];
+        int32_t          align = ti->align > 0 ? ti->align : 1;
+        m->globalSyms = (int32_t *)realloc(m->globalSyms, (m->nGlobals + 1) * sizeof(int32_t));
+        m->globalAt   = (int32_t *)realloc(m->globalAt, (m->nGlobals + 1) * sizeof(int32_t));
+        m->globalSyms[m->nGlobals] = s;
+        m->globalAt[m->nGlobals]   = (m->globalBytes + align - 1) / align * align;
+        m->globalBytes = m->globalAt[m->nGlobals++] + ti->size;
+    }
+}
+
+static int32_t globalOffset(const IR_MODULE *m, int sym) {
+    int lo = 0, hi = m->nGlobals - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (m->globalSyms[mid] == sym)
+            return m->globalAt[mid];
+        if (m->globalSyms[mid] < sym)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return -1;
+}
+
+/* ---- lowering state ---- */
+
+/* Current definition of SSA variable 'var' in a block; 'gen' tells old functions' entries apart */
+typedef struct {
+    uint64_t key;
+    int32_t  value;
+    uint32_t gen;
+} DefSlot;
+
+typedef struct {
+    int32_t block;
+    int32_t var;
+    int32_t phi;
+} PendingPhi;
+
+/* One per program; the buffers are reused from function to function */
+typedef struct {
+    irModule            m;
+    const SYMBOL_TABLE *st;
+    IR_FUNC            *f;
+    const FUNC_INFO    *fi;
+    int                 symLo;      /* symbols that may be this function's variables */
+    int                 symHi;
+    int32_t            *varBase;    /* by symbol - symLo: its first SSA variable, or -1 */
+    int                 capVarBase;
+    uint8_t            *varType;    /* IR type of each SSA variable */
+    int                 nVars;
+    int                 capVars;
+    DefSlot            *defs;
+    uint32_t            defMask;
+    uint32_t            defGen;
+    int                 nDefs;
+    PendingPhi         *pending;    /* phis of blocks not sealed yet */
+    int                 nPending;
+    int                 capPending;
+    int32_t            *vals;       /* leaf values of the expressions being lowered */
+    int                 nVals;
+    int                 capVals;
+    int                 cur;        /* block being filled, -1 after a return */
+} Lower;
+
+static uint32_t defHash(const Lower *L, uint64_t key) {
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 40) & L->defMask;
+}
+
+static void defPut(Lower *L, int block, int var, int value);
+
+static void growDefs(Lower *L) {
+    DefSlot *old = L->defs;
+    uint32_t n   = L->defMask + 1;
+    L->defMask   = 2 * n - 1;
+    L->defs      = (DefSlot *)calloc(2 * n, sizeof(DefSlot));
+    L->nDefs     = 0;
+    for (uint32_t i = 0; i < n; i++)
+        if (old[i].gen == L->defGen)
+            defPut(L, (int)(old[i].key >> 32), (int)(uint32_t)old[i].key, old[i].value);
+    free(old);
+}
+
+static void defPut(Lower *L, int block, int var, int value) {
+    if (2 * (uint32_t)(L->nDefs + 1) > L->defMask + 1)
+        growDefs(L);
+    uint64_t key = ((uint64_t)(uint32_t)block << 32) | (uint32_t)var;
+    uint32_t i   = defHash(L, key);
+    while (L->defs[i].gen == L->defGen && L->defs[i].key != key)
+        i = (i + 1) & L->defMask;
+    if (L->defs[i].gen != L->defGen)
+        L->nDefs++;
+    L->defs[i] = (DefSlot){ key, value, L->defGen };
+}
+
+static int defGet(const Lower *L, int block, int var) {
+    uint64_t key = ((uint64_t)(uint32_t)block << 32) | (uint32_t)var;
+    uint32_t i   = defHash(L, key);
+    while (L->defs[i].gen == L->defGen) {
+        if (L->defs[i].key == key)
+            return L->defs[i].value;
+        i = (i + 1) & L->defMask;
+    }
+    return -1;
+}
+
+static void pushVal(Lower *L, int v) {
+    if (L->nVals == L->capVals) {
+        L->capVals = L->capVals ? L->capVals * 2 : 64;
+        L->vals    = (int32_t *)realloc(L->vals, L->capVals * sizeof(int32_t));
+    }
+    L->vals[L->nVals++] = v;
+}
+
+/* ---- emitting ---- */
+
+/* Append to the end of a block */
+static int emit(Lower *L, IR_OP op, IR_TYPE type, int a, int b, int line) {
+    int v = irAddInst(L->f, L->cur, op, type, a, b, line);
+    irLinkAfter(L->f, L->cur, L->f->blocks[L->cur].last, v);
+    return v;
+}
+
+/* Put in front of a block's code: phis, and undefs in the entry block */
+static int emitFront(Lower *L, int block, IR_OP op, IR_TYPE type, int line) {
+    int v = irAddInst(L->f, block, op, type, -1, -1, line);
+    irLinkAfter(L->f, block, -1, v);
+    return v;
+}
+
+static int emitConst(Lower *L, const AstNode *n) {
+    int v = emit(L, IR_CONST, n->kind == AST_NUM ? IR_INT : IR_REAL, -1, -1, n->line);
+    if (n->kind == AST_NUM)
+        L->f->insts[v].imm.i = strtoll(n->name, NULL, 10);
+    else
+        L->f->insts[v].imm.r = strtod(n->name, NULL);
+    return v;
+}
+
+static void branch(Lower *L, int to, int line) {
+    emit(L, IR_BR, IR_VOID, -1, -1, line);
+    irAddEdge(L->f, L->cur, to);
+}
+
+static void condBranch(Lower *L, int cond, int yes, int no, int line) {
+    emit(L, IR_CBR, IR_VOID, cond, -1, line);
+    irAddEdge(L->f, L->cur, yes);
+    irAddEdge(L->f, L->cur, no);
+}
+
+/* ---- SSA construction (Braun et al., on the fly, sealed blocks) ---- */
+
+static int readVar(Lower *L, int var, int block);
+
+static void addPhiOperands(Lower *L, int var, int phi) {
+    int       block = L->f->insts[phi].block;
+    IR_BLOCK *bb    = &L->f->blocks[block];
+    int       p0 = bb->pred[0], p1 = bb->nPreds > 1 ? bb->pred[1] : bb->pred[0];
+    int       a  = readVar(L, var, p0);
+    int       b  = readVar(L, var, p1);
+    L->f->insts[phi].a = a;
+    L->f->insts[phi].b = b;
+}
+
+static int readVarSlow(Lower *L, int var, int block) {
+    IR_BLOCK *bb   = &L->f->blocks[block];
+    IR_TYPE   type = (IR_TYPE)L->varType[var];
+    int       val;
+
+    if (!bb->sealed) {
+        val = emitFront(L, block, IR_PHI, type, 0);
+        if (L->nPending == L->capPending) {
+            L->capPending = L->capPending ? L->capPending * 2 : 32;
+            L->pending = (PendingPhi *)realloc(L->pending, L->capPending * sizeof(PendingPhi));
+        }
+        L->pending[L->nPending++] = (PendingPhi){ block, var, val };
+    } else if (bb->nPreds == 0) {
+        val = emitFront(L, 0, IR_UNDEF, type, 0);
+    } else if (bb->nPreds == 1) {
+        val = readVar(L, var, bb->pred[0]);
+    } else {
+        /* defined as the phi first, so a loop back to this block finds it */
+        val = emitFront(L, block, IR_PHI, type, 0);
+        defPut(L, block, var, val);
+        addPhiOperands(L, var, val);
+    }
+    defPut(L, block, var, val);
+    return val;
+}
+
+static int readVar(Lower *L, int var, int block) {
+    int v = defGet(L, block, var);
+    return v >= 0 ? v : readVarSlow(L, var, block);
+}
+
+static void sealBlock(Lower *L, int block) {
+    int kept = 0;
+    for (int i = 0; i < L->nPending; i++) {
+        PendingPhi p = L->pending[i];
+        if (p.block == block)
+            addPhiOperands(L, p.var, p.phi);
+        else
+            L->pending[kept++] = p;
+    }
+    L->nPending = kept;
+    L->f->blocks[block].sealed = 1;
+}
+
+/*
+ * Phis whose operands are all one value (or the phi itself) stand for
+ * that value; remove them until none is left and rename their uses.
+ */
+static void removeTrivialPhis(IR_FUNC *f) {
+    int32_t *repl = (int32_t *)malloc((f->nInsts > 0 ? f->nInsts : 1) * sizeof(int32_t));
+    for (int v = 0; v < f->nInsts; v++)
+        repl[v] = v;
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int v = 0; v < f->nInsts; v++) {
+            IR_INST *in = &f->insts[v];
+            if (in->op != IR_PHI)
+                continue;
+            int a = irFindValue(repl, in->a), b = irFindValue(repl, in->b);
+            int same = (a == v) ? b : a;
+            if (b != v && b != same)
+                continue;
+            if (same == v) {
+                in->op = IR_UNDEF;  /* only ever defined by itself */
+            } else {
+                repl[v] = same;
+                in->op  = IR_NOP;
+            }
+            changed = true;
+        }
+    }
+
+    irReplaceOperands(f, repl);
+    free(repl);
+}
+
+/* ---- variables ---- */
+
+/* Where a (possibly dotted) variable lives */
+typedef struct {
+    int     symType;    /* type of the whole variable */
+    int     type;       /* type of the part named */
+    int32_t offset;     /* of that part within the variable */
+    int     var;        /* first SSA variable, or -1 for a global */
+    int32_t global;     /* byte offset of a global variable */
+} Loc;
+
+static const AstNode *baseOf(const AstNode *v) {
+    while (v->kind == AST_RECORD_ACCESS)
+        v = v->a;
+    return v;
+}
+
+static bool locate(Lower *L, const AstNode *v, Loc *loc) {
+    const SYMBOL_TABLE *st   = L->st;
+    const AstNode      *base = baseOf(v);
+    int                 sym  = lookupSymbol(st, L->fi->scope, base->nameId);
+
+    if (sym < 0 || st->syms[sym].kind == SYM_FUNCTION || st->syms[sym].kind == SYM_TYPE ||
+        st->syms[sym].type == TYPE_NONE)
+        return false;
+    loc->symType = st->syms[sym].type;
+    loc->type    = (v->kind == AST_RECORD_ACCESS) ? v->typeId : loc->symType;
+    loc->offset  = (v->kind == AST_RECORD_ACCESS) ? v->offset : 0;
+    if (loc->type < 0 || loc->offset < 0)
+        return false;
+
+    if (st->syms[sym].kind == SYM_GLOBAL) {
+        loc->var    = -1;
+        loc->global = globalOffset(L->m, sym);
+        return loc->global >= 0;
+    }
+    if (sym < L->symLo || sym >= L->symHi || L->varBase[sym - L->symLo] < 0)
+        return false;
+    loc->var = L->varBase[sym - L->symLo];
+    return true;
+}
+
+/* SSA variable of leaf j of the part 'loc' names, or -1 */
+static int leafVar(Lower *L, const Loc *loc, int j) {
+    IR_LEAF lf  = L->m->leaves[L->m->leafFirst[loc->type] + j];
+    int     idx = leafIndex(L->m, loc->symType, loc->offset + lf.offset, lf.type);
+    return idx < 0 ? -1 : loc->var + idx;
+}
+
+static int undef(Lower *L, IR_TYPE type) {
+    return emitFront(L, 0, IR_UNDEF, type, 0);
+}
+
+static void loadLoc(Lower *L, const Loc *loc, int line) {
+    for (int j = 0; j < L->m->leafCount[loc->type]; j++) {
+        IR_LEAF lf = L->m->leaves[L->m->leafFirst[loc->type] + j];
+        if (loc->var < 0) {
+            int v = emit(L, IR_GLOAD, (IR_TYPE)lf.type, -1, -1, line);
+            L->f->insts[v].imm.i = loc->global + loc->offset + lf.offset;
+            pushVal(L, v);
+        } else {
+            int var = leafVar(L, loc, j);
+            pushVal(L, var < 0 ? undef(L, (IR_TYPE)lf.type) : readVar(L, var, L->cur));
+        }
+    }
+}
+
+static void storeLeaf(Lower *L, const Loc *loc, int j, int value, int line) {
+    IR_LEAF lf = L->m->leaves[L->m->leafFirst[loc->type] + j];
+    if (loc->var < 0) {
+        int v = emit(L, IR_GSTORE, IR_VOID, value, -1, line);
+        L->f->insts[v].imm.i = loc->global + loc->offset + lf.offset;
+    } else {
+        int var = leafVar(L, loc, j);
+        if (var >= 0)
+            defPut(L, L->cur, var, value);
+    }
+}
+
+/* 'v' as a value of IR type 'type': converted, or undef if there is none */
+static int fit(Lower *L, int v, IR_TYPE type, int line) {
+    if (v < 0)
+        return undef(L, type);
+    IR_TYPE have = (IR_TYPE)L->f->insts[v].type;
+    if (have == type)
+        return v;
+    if (have == IR_INT && type == IR_REAL)
+        return emit(L, IR_ITOR, IR_REAL, v, -1, line);
+    if (have == IR_REAL && type == IR_INT)
+        return emit(L, IR_RTOI, IR_INT, v, -1, line);
+    return undef(L, type);
+}
+
+/* ---- expressions ---- */
+
+static IR_OP binOp(TOKEN_TYPE t) {
+    switch (t) {
+    case TK_PLUS:  return IR_ADD;
+    case TK_MINUS: return IR_SUB;
+    case TK_MUL:   return IR_MUL;
+    case TK_DIV:   return IR_DIV;
+    case TK_LT:    return IR_LT;
+    case TK_LE:    return IR_LE;
+    case TK_EQ:    return IR_EQ;
+    case TK_GT:    return IR_GT;
+    case TK_GE:    return IR_GE;
+    case TK_NE:    return IR_NE;
+    case TK_AND:   return IR_AND;
+    case TK_OR:    return IR_OR;
+    default:       return IR_NOP;
+    }
+}
+
+static int lowerExpr(Lower *L, const AstNode *e);
+
+/* Arithmetic on the leaves of two operands; see typeChecker.h for what is allowed */
+static int lowerArith(Lower *L, const AstNode *e) {
+    int base = L->nVals;
+    int lt   = lowerExpr(L, e->a);
+    int ln   = L->nVals - base;
+    int rt   = lowerExpr(L, e->b);
+    int rn   = L->nVals - base - ln;
+    int res  = TYPE_NONE, n = 0;
+    IR_OP op = binOp(e->op);
+
+    if (lt == TYPE_NONE || rt == TYPE_NONE || lt == LOWER_BOOL || rt == LOWER_BOOL)
+        ;
+    else if (lt <= TYPE_REAL && rt <= TYPE_REAL) {
+        IR_TYPE type = lt == TYPE_INT ? IR_INT : IR_REAL;
+        int     r    = fit(L, L->vals[base + 1], type, e->line);
+        pushVal(L, emit(L, op, type, L->vals[base], r, e->line));
+        res = lt, n = 1;
+    } else if (lt == rt && (op == IR_ADD || op == IR_SUB) && ln == rn) {
+        for (int j = 0; j < ln; j++) {
+            IR_TYPE type = (IR_TYPE)L->m->leaves[L->m->leafFirst[lt] + j].type;
+            pushVal(L, emit(L, op, type, L->vals[base + j], L->vals[base + ln + j], e->line));
+        }
+        res = lt, n = ln;
+    } else if (lt > TYPE_REAL && rt <= TYPE_REAL && (op == IR_MUL || op == IR_DIV)) {
+        for (int j = 0; j < ln; j++) {
+            IR_TYPE type = (IR_TYPE)L->m->leaves[L->m->leafFirst[lt] + j].type;
+            int     s    = fit(L, L->vals[base + ln], type, e->line);
+            pushVal(L, emit(L, op, type, L->vals[base + j], s, e->line));
+        }
+        res = lt, n = ln;
+    } else if (rt > TYPE_REAL && lt <= TYPE_REAL && op == IR_MUL) {
+        for (int j = 0; j < rn; j++) {
+            IR_TYPE type = (IR_TYPE)L->m->leaves[L->m->leafFirst[rt] + j].type;
+            int     s    = fit(L, L->vals[base], type, e->line);
+            pushVal(L, emit(L, op, type, s, L->vals[base + ln + j], e->line));
+        }
+        res = rt, n = rn;
+    }
+
+    if (n > 0)
+        memmove(L->vals + base, L->vals + L->nVals - n, n * sizeof(int32_t));
+    L->nVals = base + n;
+    return res;
+}
+
+/* One scalar operand of a comparison or logical operator, or -1 */
+static int lowerScalar(Lower *L, const AstNode *e, int *type) {
+    int base = L->nVals;
+    *type    = lowerExpr(L, e);
+    int v    = (L->nVals - base == 1) ? L->vals[base] : -1;
+    L->nVals = base;
+    return v;
+}
+
+static int lowerCondition(Lower *L, const AstNode *e) {
+    int lt, rt;
+    if (e->kind == AST_NOT) {
+        int a = lowerScalar(L, e->a, &lt);
+        return emit(L, IR_NOT, IR_BOOL, fit(L, a, IR_BOOL, e->line), -1, e->line);
+    }
+    int a = lowerScalar(L, e->a, &lt);
+    int b = lowerScalar(L, e->b, &rt);
+    IR_OP op = binOp(e->op);
+    if (op == IR_AND || op == IR_OR)
+        return emit(L, op, IR_BOOL, fit(L, a, IR_BOOL, e->line), fit(L, b, IR_BOOL, e->line),
+                    e->line);
+    IR_TYPE type = (lt == TYPE_REAL) ? IR_REAL : IR_INT;
+    return emit(L, op, IR_BOOL, fit(L, a, type, e->line), fit(L, b, type, e->line), e->line);
+}
+
+/* Push the leaf values of 'e'; returns its type id, LOWER_BOOL, or TYPE_NONE (nothing pushed) */
+static int lowerExpr(Lower *L, const AstNode *e) {
+    Loc loc;
+    switch (e->kind) {
+    case AST_NUM:
+        pushVal(L, emitConst(L, e));
+        return TYPE_INT;
+    case AST_RNUM:
+        pushVal(L, emitConst(L, e));
+        return TYPE_REAL;
+    case AST_ID:
+    case AST_RECORD_ACCESS:
+        if (!locate(L, e, &loc))
+            return TYPE_NONE;
+        loadLoc(L, &loc, e->line);
+        return loc.type;
+    case AST_BINOP:
+        if (e->op == TK_PLUS || e->op == TK_MINUS || e->op == TK_MUL || e->op == TK_DIV)
+            return lowerArith(L, e);
+        pushVal(L, lowerCondition(L, e));
+        return LOWER_BOOL;
+    case AST_NOT:
+        pushVal(L, lowerCondition(L, e));
+        return LOWER_BOOL;
+    default:
+        return TYPE_NONE;
+    }
+}
+
+/* ---- statements ---- */
+
+/* Store values vals[from ..) into the leaves of 'target', converting or padding with undef */
+static int storeTo(Lower *L, const AstNode *target, int from, int avail, int line) {
+    Loc loc;
+    if (!locate(L, target, &loc))
+        return 0;
+    int n = L->m->leafCount[loc.type];
+    for (int j = 0; j < n; j++) {
+        IR_TYPE type = (IR_TYPE)L->m->leaves[L->m->leafFirst[loc.type] + j].type;
+        int     v    = fit(L, j < avail ? L->vals[from + j] : -1, type, line);
+        storeLeaf(L, &loc, j, v, line);
+    }
+    return n;
+}
+
+/* IR types of the leaves of consecutive parameter symbols, pushed on the value stack */
+static int paramLeafTypes(Lower *L, int first, int n) {
+    int count = 0;
+    for (int p = first; p < first + n; p++) {
+        int t = L->st->syms[p].type;
+        if (t == TYPE_NONE)
+            continue;
+        for (int j = 0; j < L->m->leafCount[t]; j++, count++)
+            pushVal(L, L->m->leaves[L->m->leafFirst[t] + j].type);
+    }
+    return count;
+}
+
+static void lowerCall(Lower *L, const AstNode *s) {
+    const SYMBOL_TABLE *st = L->st;
+    int                 k  = lookupFunction(st, s->nameId);
+    int                 base = L->nVals;
+
+    if (k < 0) {
+        for (const AstNode *t = s->a; t != NULL; t = t->next)
+            storeTo(L, t, 0, 0, s->line);
+        return;
+    }
+    const FUNC_INFO *callee = &st->funcs[k];
+
+    /* actual leaves, then the callee's input leaf types, then the fitted arguments */
+    for (const AstNode *a = s->b; a != NULL; a = a->next)
+        lowerExpr(L, a);
+    int nActual = L->nVals - base;
+    int nIn     = paramLeafTypes(L, callee->firstParam, callee->nIn);
+    int first   = L->f->nArgs;
+    for (int i = 0; i < nIn; i++)
+        irAddArg(L->f, fit(L, i < nActual ? L->vals[base + i] : -1,
+                         (IR_TYPE)L->vals[base + nActual + i], s->line));
+    L->nVals = base;
+
+    int call = emit(L, IR_CALL, IR_VOID, first, nIn, s->line);
+    L->f->insts[call].imm.i = k;
+
+    int nOut = paramLeafTypes(L, callee->firstParam + callee->nIn, callee->nOut);
+    for (int i = 0; i < nOut; i++) {
+        int r = emit(L, IR_RESULT, (IR_TYPE)L->vals[base + i], call, -1, s->line);
+        L->f->insts[r].imm.i = i;
+        L->vals[base + i]    = r;
+    }
+    int used = 0;
+    for (const AstNode *t = s->a; t != NULL; t = t->next)
+        used += storeTo(L, t, base + used, nOut - used, s->line);
+    L->nVals = base;
+}
+
+/* return [ids], or without a list the output parameters as they stand */
+static void lowerReturn(Lower *L, const AstNode *ids, int line) {
+    const FUNC_INFO *fi   = L->fi;
+    int              base = L->nVals;
+
+    if (ids != NULL) {
+        for (const AstNode *a = ids; a != NULL; a = a->next)
+            lowerExpr(L, a);
+    } else {
+        for (int p = fi->firstParam + fi->nIn; p < fi->firstParam + fi->nIn + fi->nOut; p++) {
+            Loc loc = { L->st->syms[p].type, L->st->syms[p].type, 0, -1, -1 };
+            if (loc.type == TYPE_NONE || L->varBase[p - L->symLo] < 0)
+                continue;
+            loc.var = L->varBase[p - L->symLo];
+            loadLoc(L, &loc, line);
+        }
+    }
+    int nActual = L->nVals - base;
+    int nOut    = paramLeafTypes(L, fi->firstParam + fi->nIn, fi->nOut);
+    int first   = L->f->nArgs;
+    for (int i = 0; i < nOut; i++) {
+        int v = fit(L, i < nActual ? L->vals[base + i] : -1,
+                    (IR_TYPE)L->vals[base + nActual + i], line);
+        irAddArg(L->f, v);
+    }
+    L->nVals = base;
+    emit(L, IR_RET, IR_VOID, first, nOut, line);
+    L->cur = -1;
+}
+
+static void lowerStmts(Lower *L, const AstNode *s);
+
+static void lowerWhile(Lower *L, const AstNode *s) {
+    int header = irAddBlock(L->f);
+    branch(L, header, s->line);
+    L->cur = header;
+    int cond = lowerCondition(L, s->a);
+    int body = irAddBlock(L->f), exit = irAddBlock(L->f);
+    condBranch(L, cond, body, exit, s->line);
+    sealBlock(L, body);
+    sealBlock(L, exit);
+
+    L->cur = body;
+    lowerStmts(L, s->b);
+    if (L->cur >= 0)
+        branch(L, header, s->line);
+    sealBlock(L, header);
+    L->cur = exit;
+}
+
+static void lowerIf(Lower *L, const AstNode *s) {
+    int cond = lowerCondition(L, s->a);
+    int yes  = irAddBlock(L->f), no = (s->c != NULL) ? irAddBlock(L->f) : -1;
+    int join = irAddBlock(L->f);
+    condBranch(L, cond, yes, no >= 0 ? no : join, s->line);
+    sealBlock(L, yes);
+
+    L->cur = yes;
+    lowerStmts(L, s->b);
+    if (L->cur >= 0)
+        branch(L, join, s->line);
+    if (no >= 0) {
+        sealBlock(L, no);
+        L->cur = no;
+        lowerStmts(L, s->c);
+        if (L->cur >= 0)
+            branch(L, join, s->line);
+    }
+    sealBlock(L, join);
+    L->cur = join;
+}
+
+static void lowerStmts(Lower *L, const AstNode *s) {
+    Loc loc;
+    for (; s != NULL && L->cur >= 0; s = s->next) {
+        int base = L->nVals;
+        switch (s->kind) {
+        case AST_ASSIGN: {
+            int t = lowerExpr(L, s->b);
+            int n = L->nVals - base;
+            if (t == TYPE_NONE || t == LOWER_BOOL || !locate(L, s->a, &loc) ||
+                (t != loc.type && (t > TYPE_REAL || loc.type > TYPE_REAL)))
+                n = 0;      /* nothing sensible to store: the target becomes undef */
+            storeTo(L, s->a, base, n, s->line);
+            break;
+        }
+        case AST_READ:
+            if (locate(L, s->a, &loc))
+                for (int j = 0; j < L->m->leafCount[loc.type]; j++) {
+                    IR_LEAF lf = L->m->leaves[L->m->leafFirst[loc.type] + j];
+                    storeLeaf(L, &loc, j, emit(L, IR_READ, (IR_TYPE)lf.type, -1, -1, s->line),
+                              s->line);
+                }
+            break;
+        case AST_WRITE:
+            lowerExpr(L, s->a);
+            for (int i = base; i < L->nVals; i++)
+                emit(L, IR_WRITE, IR_VOID, L->vals[i], -1, s->line);
+            break;
+        case AST_CALL:
+            lowerCall(L, s);
+            break;
+        case AST_WHILE:
+            lowerWhile(L, s);
+            break;
+        case AST_IF:
+            lowerIf(L, s);
+            break;
+        case AST_RETURN:
+            lowerReturn(L, s->a, s->line);
+            break;
+        default:    /* declarations */
+            break;
+        }
+        L->nVals = base;
+    }
+}
+
+/* ---- functions ---- */
+
+static void lowerFunction(Lower *L, int k, const AstNode *fn) {
+    const SYMBOL_TABLE *st = L->st;
+    IR_FUNC            *f  = &L->m->funcs[k];
+
+    L->f  = f;
+    L->fi = &st->funcs[k];
+    f->name = L->fi->name;
+    L->defGen++;
+    L->nDefs    = 0;
+    L->nPending = 0;
+    L->nVals    = 0;
+
+    /* SSA variables: every leaf of every parameter and local of this function */
+    L->symLo = L->fi->firstParam;
+    L->symHi = (k + 1 < st->nFuncs) ? st->funcs[k + 1].firstParam : st->nSyms;
+    if (L->symHi < L->symLo)
+        L->symHi = L->symLo;
+    if (L->symHi - L->symLo > L->capVarBase) {
+        L->capVarBase = L->symHi - L->symLo;
+        L->varBase    = (int32_t *)realloc(L->varBase, L->capVarBase * sizeof(int32_t));
+    }
+    L->nVars = 0;
+    for (int s = L->symLo; s < L->symHi; s++) {
+        const SYMBOL *sym = &st->syms[s];
+        bool mine = (sym->kind == SYM_LOCAL || sym->kind == SYM_INPUT_PAR ||
+                     sym->kind == SYM_OUTPUT_PAR) && sym->type != TYPE_NONE;
+        L->varBase[s - L->symLo] = mine ? L->nVars : -1;
+        if (!mine)
+            continue;
+        int n = L->m->leafCount[sym->type];
+        if (L->nVars + n > L->capVars) {
+            L->capVars = 2 * (L->nVars + n);
+            L->varType = (uint8_t *)realloc(L->varType, L->capVars);
+        }
+        for (int j = 0; j < n; j++)
+            L->varType[L->nVars++] = (uint8_t)L->m->leaves[L->m->leafFirst[sym->type] + j].type;
+    }
+
+    L->cur = irAddBlock(L->f);
+    f->blocks[0].sealed = 1;
+    int leaf = 0;
+    for (int p = L->fi->firstParam; p < L->fi->firstParam + L->fi->nIn; p++) {
+        int t = st->syms[p].type;
+        if (t == TYPE_NONE)
+            continue;
+        for (int j = 0; j < L->m->leafCount[t]; j++, leaf++) {
+            IR_TYPE type = (IR_TYPE)L->m->leaves[L->m->leafFirst[t] + j].type;
+            int     v    = emit(L, IR_PARAM, type, -1, -1, fn->line);
+            f->insts[v].imm.i = leaf;
+            if (L->varBase[p - L->symLo] >= 0)
+                defPut(L, 0, L->varBase[p - L->symLo] + j, v);
+        }
+    }
+    f->nParams = leaf;
+    for (int p = L->fi->firstParam + L->fi->nIn;
+         p < L->fi->firstParam + L->fi->nIn + L->fi->nOut; p++)
+        if (st->syms[p].type != TYPE_NONE)
+            f->nResults += L->m->leafCount[st->syms[p].type];
+
+    lowerStmts(L, fn->c);
+    if (L->cur >= 0)
+        lowerReturn(L, NULL, fn->line);
+    removeTrivialPhis(f);
+}
+
+/* ------------------------------------------------------------------
+ * lowerProgram
+ * ------------------------------------------------------------------ */
+irModule lowerProgram(const SYMBOL_TABLE *st, AstNode *program) {
+    irModule m = (irModule)calloc(1, sizeof(IR_MODULE));
+    m->st     = st;
+    m->nFuncs = st->nFuncs;
+    m->funcs  = (IR_FUNC *)calloc(m->nFuncs > 0 ? m->nFuncs : 1, sizeof(IR_FUNC));
+    buildLeaves(m);
+    buildGlobals(m);
+    if (program == NULL)
+        return m;
+    layoutAccesses(st, program);
+
+    Lower L;
+    memset(&L, 0, sizeof L);
+    L.m       = m;
+    L.st      = st;
+    L.defMask = 255;
+    L.defs    = (DefSlot *)calloc(L.defMask + 1, sizeof(DefSlot));
+
+    int k = 0;
+    for (const AstNode *fn = program->a; fn != NULL && k < m->nFuncs; fn = fn->next)
+        lowerFunction(&L, k++, fn);
+    if (program->b != NULL && k < m->nFuncs)
+        lowerFunction(&L, k++, program->b);
+
+    free(L.varBase);
+    free(L.varType);
+    free(L.defs);
+    free(L.pending);
+    free(L.vals);
+    return m;
+}
@@ -0,0 +1,1128 @@
+#include "irOpt.h"
+#include "bench.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *PASS_NAMES[IR_PASS_COUNT] = {
+    [IR_PASS_FOLD]   = "fold",
+    [IR_PASS_GVN]    = "gvn",
+    [IR_PASS_DCE]    = "dce",
+    [IR_PASS_LICM]   = "licm",
+    [IR_PASS_IV]     = "iv",
+    [IR_PASS_INLINE] = "inline",
+};
+
+const char *irPassName(IR_PASS pass) {
+    return (pass < IR_PASS_COUNT) ? PASS_NAMES[pass] : "?";
+}
+
+/* ---- scratch space, reused from function to function ---- */
+
+/* Value-numbering table entry: the key and the value that has it */
+typedef struct {
+    uint64_t imm;
+    int32_t  a;
+    int32_t  b;
+    int32_t  value;     /* -1 if empty */
+    uint8_t  op;
+    uint8_t  type;
+} VnSlot;
+
+typedef struct {
+    int32_t *repl;      /* per instruction */
+    int32_t *work;
+    uint8_t *mark;
+    IR_IMM  *val;
+    int      capInsts;
+    uint8_t *flow;      /* per block */
+    int32_t *rpoNum;
+    int32_t *order;
+    int32_t *idom;
+    int32_t *pre;
+    int32_t *last;
+    int32_t *child;
+    int32_t *sibling;
+    int32_t *stack;
+    int      capBlocks;
+    VnSlot  *table;
+    uint32_t capTable;
+    int32_t *inLoop;    /* per block: stamp of the loop being worked on */
+    int      loopStamp;
+    struct BasicIv   *ivs;
+    int               capIvs;
+    struct ReducedIv *reduced;
+    int               capReduced;
+    int      nRepl;     /* repl[] entries set */
+} Opt;
+
+/* Room for every instruction of 'f', new ones included; those not seen yet map to themselves */
+static void growInsts(Opt *o, const IR_FUNC *f) {
+    if (f->nInsts > o->capInsts) {
+        o->capInsts = 2 * f->nInsts;
+        o->repl = (int32_t *)realloc(o->repl, o->capInsts * sizeof(int32_t));
+        o->work = (int32_t *)realloc(o->work, o->capInsts * sizeof(int32_t));
+        o->mark = (uint8_t *)realloc(o->mark, o->capInsts);
+        o->val  = (IR_IMM *)realloc(o->val, o->capInsts * sizeof(IR_IMM));
+    }
+    for (; o->nRepl < f->nInsts; o->nRepl++)
+        o->repl[o->nRepl] = o->nRepl;
+}
+
+static void reserve(Opt *o, const IR_FUNC *f) {
+    o->nRepl = 0;
+    growInsts(o, f);
+    if (f->nBlocks > o->capBlocks) {
+        o->capBlocks = 2 * f->nBlocks;
+        o->flow      = (uint8_t *)realloc(o->flow, o->capBlocks);
+        int32_t **arrays[] = { &o->rpoNum, &o->order,   &o->idom,  &o->pre,   &o->last,
+                               &o->child,  &o->sibling, &o->stack, &o->inLoop };
+        for (size_t i = 0; i < sizeof arrays / sizeof arrays[0]; i++)
+            *arrays[i] = (int32_t *)realloc(*arrays[i], o->capBlocks * sizeof(int32_t));
+    }
+}
+
+static void freeOpt(Opt *o) {
+    free(o->repl);
+    free(o->work);
+    free(o->mark);
+    free(o->val);
+    free(o->flow);
+    free(o->rpoNum);
+    free(o->order);
+    free(o->idom);
+    free(o->pre);
+    free(o->last);
+    free(o->child);
+    free(o->sibling);
+    free(o->stack);
+    free(o->table);
+    free(o->inLoop);
+    free(o->ivs);
+    free(o->reduced);
+}
+
+/* Drop removed instructions from the block chains */
+static void sweep(IR_FUNC *f) {
+    for (int b = 0; b < f->nBlocks; b++) {
+        IR_BLOCK *bb   = &f->blocks[b];
+        int       tail = -1;
+        int       v    = bb->first;
+        bb->first = -1;
+        for (; v >= 0; v = f->insts[v].next) {
+            if (f->insts[v].op == IR_NOP)
+                continue;
+            if (tail >= 0)
+                f->insts[tail].next = v;
+            else
+                bb->first = v;
+            tail = v;
+        }
+        if (tail >= 0)
+            f->insts[tail].next = -1;
+        bb->last = tail;
+    }
+}
+
+/* ---- control flow ---- */
+
+/* Take pred[slot] out of block 's': with one predecessor left its phis are copies */
+static void removePred(Opt *o, IR_FUNC *f, int s, int slot) {
+    IR_BLOCK *bb = &f->blocks[s];
+    for (int v = bb->first; v >= 0; v = f->insts[v].next) {
+        IR_INST *in = &f->insts[v];
+        if (in->op != IR_PHI)
+            continue;
+        int keep = irFindValue(o->repl, slot == 0 ? in->b : in->a);
+        if (keep == v) {
+            in->op = IR_UNDEF;
+        } else {
+            o->repl[v] = keep;
+            in->op     = IR_NOP;
+        }
+    }
+    if (slot == 0)
+        bb->pred[0] = bb->pred[1];
+    bb->pred[1] = -1;
+    bb->nPreds--;
+}
+
+/* Reverse postorder of the blocks reachable from the entry; rpoNum is -1 for the others */
+static int reversePostorder(Opt *o, const IR_FUNC *f) {
+    int32_t *next = o->idom;    /* successor cursor while walking */
+    int      n = 0, sp = 0;
+
+    for (int b = 0; b < f->nBlocks; b++) {
+        o->rpoNum[b] = -1;
+        next[b]      = 0;
+    }
+    o->rpoNum[0]  = 0;
+    o->stack[sp++] = 0;
+    while (sp > 0) {
+        int             b  = o->stack[sp - 1];
+        const IR_BLOCK *bb = &f->blocks[b];
+        if (next[b] < bb->nSuccs) {
+            int s = bb->succ[next[b]++];
+            if (o->rpoNum[s] < 0) {
+                o->rpoNum[s]   = 0;
+                o->stack[sp++] = s;
+            }
+        } else {
+            o->order[n++] = b;
+            sp--;
+        }
+    }
+    for (int i = 0; i < n / 2; i++) {
+        int t = o->order[i];
+        o->order[i]         = o->order[n - 1 - i];
+        o->order[n - 1 - i] = t;
+    }
+    for (int i = 0; i < n; i++)
+        o->rpoNum[o->order[i]] = i;
+    return n;
+}
+
+/* Empty every block the entry cannot reach and cut its edges into reachable ones */
+static void removeUnreachable(Opt *o, IR_FUNC *f) {
+    reversePostorder(o, f);
+    for (int u = 0; u < f->nBlocks; u++) {
+        IR_BLOCK *bb = &f->blocks[u];
+        if (o->rpoNum[u] >= 0 || (bb->first < 0 && bb->nSuccs == 0))
+            continue;
+        for (int i = 0; i < bb->nSuccs; i++) {
+            int s = bb->succ[i];
+            if (o->rpoNum[s] < 0)
+                continue;
+            for (int slot = f->blocks[s].nPreds - 1; slot >= 0; slot--)
+                if (f->blocks[s].pred[slot] == u)
+                    removePred(o, f, s, slot);
+        }
+        for (int v = bb->first; v >= 0; v = f->insts[v].next)
+            f->insts[v].op = IR_NOP;
+        *bb = (IR_BLOCK){ .first = -1, .last = -1, .pred = { -1, -1 }, .succ = { -1, -1 },
+                          .nPreds = 0, .nSuccs = 0, .sealed = 1 };
+    }
+}
+
+/*
+ * Dominator tree of the reachable blocks (Cooper, Harvey and Kennedy's
+ * iteration over reverse postorder), then numbered in preorder: block x
+ * dominates y when pre[x] <= pre[y] <= last[x].  order[] ends up as
+ * the preorder; the count is returned.
+ */
+static int dominators(Opt *o, const IR_FUNC *f) {
+    int n = reversePostorder(o, f);
+
+    for (int b = 0; b < f->nBlocks; b++)
+        o->idom[b] = -1;
+    o->idom[0] = 0;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int i = 1; i < n; i++) {
+            int             b  = o->order[i];
+            const IR_BLOCK *bb = &f->blocks[b];
+            int             d  = -1;
+            for (int j = 0; j < bb->nPreds; j++) {
+                int p = bb->pred[j];
+                if (o->idom[p] < 0)
+                    continue;
+                if (d < 0) {
+                    d = p;
+                    continue;
+                }
+                int x = p;
+                while (x != d) {
+                    while (o->rpoNum[x] > o->rpoNum[d])
+                        x = o->idom[x];
+                    while (o->rpoNum[d] > o->rpoNum[x])
+                        d = o->idom[d];
+                }
+            }
+            if (d != o->idom[b]) {
+                o->idom[b] = d;
+                changed    = true;
+            }
+        }
+    }
+
+    for (int b = 0; b < f->nBlocks; b++)
+        o->child[b] = -1;
+    for (int i = n - 1; i >= 1; i--) {
+        int b = o->order[i], p = o->idom[b];
+        o->sibling[b] = o->child[p];
+        o->child[p]   = b;
+    }
+    int np = 0, sp = 0;
+    o->stack[sp++] = 0;
+    while (sp > 0) {
+        int b = o->stack[--sp];
+        o->pre[b]     = np;
+        o->last[b]    = np;
+        o->order[np++] = b;
+        for (int c = o->child[b]; c >= 0; c = o->sibling[c])
+            o->stack[sp++] = c;
+    }
+    for (int i = np - 1; i >= 1; i--) {
+        int b = o->order[i], p = o->idom[b];
+        if (o->last[b] > o->last[p])
+            o->last[p] = o->last[b];
+    }
+    return np;
+}
+
+/* ---- fold ---- */
+
+/* int is 32 bits: what the target would compute */
+static int64_t wrapInt(int64_t x) {
+    return (int64_t)(int32_t)(uint32_t)x;
+}
+
+/*
+ * op applied to constants x (and y) whose type is 'type'; false if the
+ * result would trap or is better left to run time (x / 0, a real out
+ * of int range).
+ */
+static bool evalOp(IR_OP op, IR_TYPE type, IR_IMM x, IR_IMM y, IR_IMM *out) {
+    if (type == IR_REAL) {
+        double p = x.r, q = y.r;
+        switch (op) {
+        case IR_ADD: out->r = p + q; return true;
+        case IR_SUB: out->r = p - q; return true;
+        case IR_MUL: out->r = p * q; return true;
+        case IR_DIV:
+            if (q == 0)
+                return false;
+            out->r = p / q;
+            return true;
+        case IR_LT: out->i = p < q; return true;
+        case IR_LE: out->i = p <= q; return true;
+        case IR_EQ: out->i = p == q; return true;
+        case IR_GT: out->i = p > q; return true;
+        case IR_GE: out->i = p >= q; return true;
+        case IR_NE: out->i = p != q; return true;
+        case IR_RTOI:
+            if (!(p > -2147483649.0 && p < 2147483648.0))
+                return false;   /* NaN fails too */
+            out->i = (int64_t)p;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    int64_t p = wrapInt(x.i), q = wrapInt(y.i);
+    switch (op) {
+    case IR_ADD: out->i = wrapInt(p + q); return true;
+    case IR_SUB: out->i = wrapInt(p - q); return true;
+    case IR_MUL: out->i = wrapInt(p * q); return true;
+    case IR_DIV:
+        if (q == 0 || (p == INT32_MIN && q == -1))
+            return false;
+        out->i = p / q;
+        return true;
+    case IR_LT:   out->i = p < q; return true;
+    case IR_LE:   out->i = p <= q; return true;
+    case IR_EQ:   out->i = p == q; return true;
+    case IR_GT:   out->i = p > q; return true;
+    case IR_GE:   out->i = p >= q; return true;
+    case IR_NE:   out->i = p != q; return true;
+    case IR_AND:  out->i = p && q; return true;
+    case IR_OR:   out->i = p || q; return true;
+    case IR_NOT:  out->i = !p; return true;
+    case IR_ITOR: out->r = (double)p; return true;
+    default:      return false;
+    }
+}
+
+/* Whether an instruction computes its value from its operands alone */
+static bool isComputed(IR_OP op) {
+    switch (op) {
+    case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV:
+    case IR_LT: case IR_LE: case IR_EQ: case IR_GT: case IR_GE: case IR_NE:
+    case IR_AND: case IR_OR: case IR_NOT: case IR_ITOR: case IR_RTOI:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* An int division by anything but a constant other than 0 may fault, which is an effect */
+static bool mayFault(const IR_FUNC *f, const IR_INST *in) {
+    if (in->op != IR_DIV || in->type != IR_INT)
+        return false;
+    const IR_INST *d = &f->insts[in->b];
+    return d->op != IR_CONST || wrapInt(d->imm.i) == 0;
+}
+
+/* Sparse conditional constant propagation: lattice and flow bits */
+enum { LAT_TOP, LAT_CONST, LAT_BOTTOM };
+enum { FLOW_PRED0 = 1, FLOW_PRED1 = 2, FLOW_LIVE = 4 };
+
+static bool sameConst(const Opt *o, const IR_FUNC *f, int x, int y) {
+    return f->insts[x].type == f->insts[y].type &&
+           memcmp(&o->val[x], &o->val[y], sizeof(IR_IMM)) == 0;
+}
+
+/* Mark the edge b -> s as taken; true if it was not yet */
+static bool takeEdge(Opt *o, const IR_FUNC *f, int b, int s) {
+    const IR_BLOCK *sb = &f->blocks[s];
+    for (int slot = 0; slot < sb->nPreds; slot++) {
+        uint8_t bit = (uint8_t)(FLOW_PRED0 << slot);
+        if (sb->pred[slot] == b && !(o->flow[s] & bit)) {
+            o->flow[s] |= bit | FLOW_LIVE;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* New lattice value of v from its operands' */
+static uint8_t evalLattice(Opt *o, const IR_FUNC *f, int v, IR_IMM *out) {
+    const IR_INST *in  = &f->insts[v];
+    uint8_t       *lat = o->mark;
+
+    switch (in->op) {
+    case IR_CONST:
+        *out = in->imm;
+        return LAT_CONST;
+    case IR_PHI: {
+        uint8_t flow = o->flow[in->block], res = LAT_TOP;
+        int     from = -1;
+        for (int slot = 0; slot < 2; slot++) {
+            int x = slot ? in->b : in->a;
+            if (!(flow & (FLOW_PRED0 << slot)) || lat[x] == LAT_TOP)
+                continue;
+            if (lat[x] == LAT_BOTTOM || (from >= 0 && !sameConst(o, f, from, x)))
+                return LAT_BOTTOM;
+            from = x;
+            res  = LAT_CONST;
+        }
+        if (from >= 0)
+            *out = o->val[from];
+        return res;
+    }
+    default:
+        break;
+    }
+    if (!isComputed((IR_OP)in->op))
+        return LAT_BOTTOM;
+
+    int n  = irValueOperands((IR_OP)in->op);
+    int la = lat[in->a], lb = (n >= 2) ? lat[in->b] : LAT_CONST;
+    if (la == LAT_BOTTOM || lb == LAT_BOTTOM)
+        return LAT_BOTTOM;
+    if (la == LAT_TOP || lb == LAT_TOP)
+        return LAT_TOP;
+    IR_IMM y = (n >= 2) ? o->val[in->b] : o->val[in->a];
+    return evalOp((IR_OP)in->op, (IR_TYPE)f->insts[in->a].type, o->val[in->a], y, out)
+               ? LAT_CONST
+               : LAT_BOTTOM;
+}
+
+/* A cbr whose condition is known becomes a br; the edge not taken goes */
+static void foldBranch(Opt *o, IR_FUNC *f, int v, bool cond) {
+    IR_INST  *in    = &f->insts[v];
+    IR_BLOCK *bb    = &f->blocks[in->block];
+    int       taken = cond ? 0 : 1;
+    int       gone  = bb->succ[1 - taken];
+    IR_BLOCK *g     = &f->blocks[gone];
+
+    /* pred slots follow the order the edges were added: succ[0]'s comes first */
+    int slot = (taken == 1) ? (g->pred[0] == in->block ? 0 : 1)
+                            : (g->pred[1] == in->block ? 1 : 0);
+    removePred(o, f, gone, slot);
+    bb->succ[0] = bb->succ[taken];
+    bb->succ[1] = -1;
+    bb->nSuccs  = 1;
+    in->op      = IR_BR;
+    in->a       = -1;
+}
+
+/*
+ * Wegman and Zadeck's SCCP, iterated over the reverse postorder until
+ * nothing moves rather than driven by use lists: values start unknown
+ * and blocks unreached, so a loop whose variable never leaves its
+ * starting constant still folds.  Values found constant become consts
+ * and branches found one-way become brs.
+ */
+static void propagateConstants(Opt *o, IR_FUNC *f) {
+    uint8_t *lat = o->mark;
+    int      n   = reversePostorder(o, f);
+
+    memset(lat, LAT_TOP, f->nInsts);
+    memset(o->flow, 0, f->nBlocks);
+    o->flow[0] = FLOW_LIVE;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int i = 0; i < n; i++) {
+            int b = o->order[i];
+            if (!(o->flow[b] & FLOW_LIVE))
+                continue;
+            for (int v = f->blocks[b].first; v >= 0; v = f->insts[v].next) {
+                IR_INST *in = &f->insts[v];
+                if (in->op == IR_BR) {
+                    changed |= takeEdge(o, f, b, f->blocks[b].succ[0]);
+                } else if (in->op == IR_CBR) {
+                    const IR_BLOCK *bb = &f->blocks[b];
+                    if (lat[in->a] == LAT_BOTTOM) {
+                        changed |= takeEdge(o, f, b, bb->succ[0]);
+                        changed |= takeEdge(o, f, b, bb->succ[1]);
+                    } else if (lat[in->a] == LAT_CONST) {
+                        changed |= takeEdge(o, f, b, bb->succ[o->val[in->a].i ? 0 : 1]);
+                    }
+                } else if (in->type != IR_VOID && lat[v] != LAT_BOTTOM) {
+                    IR_IMM  x;
+                    uint8_t l = evalLattice(o, f, v, &x);
+                    if (l != lat[v]) {
+                        lat[v]    = l;
+                        o->val[v] = x;
+                        changed   = true;
+                    }
+                }
+            }
+        }
+    }
+
+    for (int b = 0; b < f->nBlocks; b++) {
+        if (!(o->flow[b] & FLOW_LIVE))
+            continue;
+        for (int v = f->blocks[b].first; v >= 0; v = f->insts[v].next) {
+            IR_INST *in = &f->insts[v];
+            if (in->op == IR_CBR && lat[in->a] == LAT_CONST) {
+                foldBranch(o, f, v, o->val[in->a].i != 0);
+            } else if (lat[v] == LAT_CONST && in->op != IR_CONST && in->type != IR_VOID) {
+                in->op  = IR_CONST;
+                in->imm = o->val[v];
+            }
+        }
+    }
+}
+
+static bool isConst(const IR_FUNC *f, int v, int64_t k) {
+    const IR_INST *in = &f->insts[v];
+    if (in->op != IR_CONST)
+        return false;
+    return (in->type == IR_REAL) ? in->imm.r == (double)k : wrapInt(in->imm.i) == k;
+}
+
+static void makeConst(IR_INST *in, int64_t i) {
+    in->op    = IR_CONST;
+    in->imm.i = i;
+}
+
+/* The value the instruction equals, -2 if it became a constant, or -1 */
+static int identity(const IR_FUNC *f, IR_INST *in) {
+    int  a = in->a, b = in->b;
+    bool isInt = (in->type == IR_INT);
+
+    if (a == b && f->insts[a].type == IR_INT) {
+        switch (in->op) {
+        case IR_SUB: makeConst(in, 0); return -2;
+        case IR_EQ: case IR_LE: case IR_GE: makeConst(in, 1); return -2;
+        case IR_LT: case IR_GT: case IR_NE: makeConst(in, 0); return -2;
+        default: break;
+        }
+    }
+    switch (in->op) {
+    case IR_ADD:
+        if (isInt && isConst(f, b, 0))
+            return a;
+        if (isInt && isConst(f, a, 0))
+            return b;
+        return -1;
+    case IR_SUB:
+        return (isInt && isConst(f, b, 0)) ? a : -1;
+    case IR_MUL:
+        if (isInt && (isConst(f, a, 0) || isConst(f, b, 0))) {
+            makeConst(in, 0);
+            return -2;
+        }
+        if (isConst(f, b, 1))
+            return a;
+        if (isConst(f, a, 1))
+            return b;
+        return -1;
+    case IR_DIV:
+        return isConst(f, b, 1) ? a : -1;
+    case IR_AND:
+    case IR_OR: {
+        int64_t unit = (in->op == IR_AND);     /* b and true, b or false: b */
+        if (a == b || isConst(f, b, unit))
+            return a;
+        if (isConst(f, a, unit))
+            return b;
+        if (isConst(f, a, !unit) || isConst(f, b, !unit)) {
+            makeConst(in, !unit);
+            return -2;
+        }
+        return -1;
+    }
+    default:
+        return -1;
+    }
+}
+
+/* Fold instruction v in place; true if anything changed, *cfg set if a branch went */
+static bool foldInst(Opt *o, IR_FUNC *f, int v, bool *cfg) {
+    IR_INST *in = &f->insts[v];
+    int      n  = irValueOperands((IR_OP)in->op);
+
+    if (n >= 1)
+        in->a = irFindValue(o->repl, in->a);
+    if (n >= 2)
+        in->b = irFindValue(o->repl, in->b);
+
+    if (in->op == IR_CBR) {
+        if (f->insts[in->a].op != IR_CONST)
+            return false;
+        foldBranch(o, f, v, f->insts[in->a].imm.i != 0);
+        *cfg = true;
+        return true;
+    }
+    if (in->op == IR_PHI) {
+        int same = (in->a == v) ? in->b : in->a;
+        if (in->b != v && in->b != same)
+            return false;
+        if (same == v) {
+            in->op = IR_UNDEF;
+        } else {
+            o->repl[v] = same;
+            in->op     = IR_NOP;
+        }
+        return true;
+    }
+    if (!isComputed((IR_OP)in->op))
+        return false;
+
+    const IR_INST *x = &f->insts[in->a], *y = (n >= 2) ? &f->insts[in->b] : x;
+    if (x->op == IR_CONST && y->op == IR_CONST &&
+        evalOp((IR_OP)in->op, (IR_TYPE)x->type, x->imm, y->imm, &in->imm)) {
+        in->op = IR_CONST;
+        return true;
+    }
+    if (n < 2)
+        return false;
+    int same = identity(f, in);
+    if (same == -2)
+        return true;
+    if (same >= 0) {
+        o->repl[v] = same;
+        in->op     = IR_NOP;
+        return true;
+    }
+    return false;
+}
+
+static void foldFunction(Opt *o, IR_FUNC *f) {
+    propagateConstants(o, f);
+    removeUnreachable(o, f);
+
+    /* what the constants expose: identities, and branches on them */
+    for (bool changed = true; changed;) {
+        bool cfg = false;
+        changed  = false;
+        for (int b = 0; b < f->nBlocks; b++)
+            for (int v = f->blocks[b].first; v >= 0; v = f->insts[v].next)
+                if (f->insts[v].op != IR_NOP && foldInst(o, f, v, &cfg))
+                    changed = true;
+        if (cfg)
+            removeUnreachable(o, f);
+    }
+    irReplaceOperands(f, o->repl);
+}
+
+/* ---- gvn ---- */
+
+static bool isPure(IR_OP op) {
+    switch (op) {
+    case IR_CONST: case IR_PHI:
+    case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV:
+    case IR_LT: case IR_LE: case IR_EQ: case IR_GT: case IR_GE: case IR_NE:
+    case IR_AND: case IR_OR: case IR_NOT: case IR_ITOR: case IR_RTOI:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool isCommutative(IR_OP op) {
+    return op == IR_ADD || op == IR_MUL || op == IR_EQ || op == IR_NE || op == IR_AND ||
+           op == IR_OR;
+}
+
+static uint32_t vnHash(const VnSlot *k) {
+    uint64_t h = k->imm * 0x9E3779B97F4A7C15ull;
+    h ^= (((uint64_t)(uint32_t)k->a << 32) | (uint32_t)k->b) * 0xC2B2AE3D27D4EB4Full;
+    h ^= (uint64_t)k->op << 8 | k->type;
+    h *= 0x9E3779B97F4A7C15ull;
+    return (uint32_t)(h >> 32);
+}
+
+static void gvnFunction(Opt *o, IR_FUNC *f) {
+    uint32_t size = 16;
+    while (size < 2 * (uint32_t)f->nInsts)
+        size *= 2;
+    if (size > o->capTable) {
+        o->capTable = size;
+        o->table    = (VnSlot *)realloc(o->table, size * sizeof(VnSlot));
+    }
+    for (uint32_t i = 0; i < size; i++)
+        o->table[i].value = -1;
+
+    int np = dominators(o, f);
+    for (int i = 0; i < np; i++) {
+        int b = o->order[i];
+        for (int v = f->blocks[b].first; v >= 0; v = f->insts[v].next) {
+            IR_INST *in = &f->insts[v];
+            if (!isPure((IR_OP)in->op))
+                continue;
+
+            /* the key: operands by their current numbers, phis tied to their block */
+            VnSlot key = { .imm = 0, .a = -1, .b = -1, .value = v, .op = in->op,
+                           .type = in->type };
+            int    n   = irValueOperands((IR_OP)in->op);
+            if (n >= 1)
+                key.a = in->a = irFindValue(o->repl, in->a);
+            if (n >= 2)
+                key.b = in->b = irFindValue(o->repl, in->b);
+            if (in->op == IR_CONST)
+                memcpy(&key.imm, &in->imm, sizeof key.imm);
+            else if (in->op == IR_PHI)
+                key.imm = (uint64_t)b;
+            if (isCommutative((IR_OP)in->op) && key.a > key.b) {
+                int32_t t = key.a;
+                key.a     = key.b;
+                key.b     = t;
+            }
+
+            uint32_t h = vnHash(&key) & (size - 1);
+            for (;; h = (h + 1) & (size - 1)) {
+                VnSlot *s = &o->table[h];
+                if (s->value < 0) {
+                    *s = key;
+                    break;
+                }
+                if (s->op != key.op || s->type != key.type || s->a != key.a ||
+                    s->b != key.b || s->imm != key.imm)
+                    continue;
+                /*
+                 * Equal.  If its block dominates this one it replaces v;
+                 * otherwise v takes the slot: the walk is in dominator
+                 * preorder, so no block left to visit is dominated by
+                 * the old one.
+                 */
+                int c = s->value, cb = f->insts[c].block;
+                if (o->pre[cb] <= o->pre[b] && o->pre[b] <= o->last[cb]) {
+                    o->repl[v] = c;
+                    in->op     = IR_NOP;
+                } else {
+                    s->value = v;
+                }
+                break;
+            }
+        }
+    }
+    irReplaceOperands(f, o->repl);
+}
+
+/* ---- dce ---- */
+
+static bool hasEffect(IR_OP op) {
+    switch (op) {
+    case IR_GSTORE: case IR_READ: case IR_WRITE: case IR_CALL:
+    case IR_BR: case IR_CBR: case IR_RET:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void markLive(Opt *o, int v, int *n) {
+    if (v >= 0 && !o->mark[v]) {
+        o->mark[v]     = 1;
+        o->work[(*n)++] = v;
+    }
+}
+
+static void dceFunction(Opt *o, IR_FUNC *f) {
+    int n = 0;
+    memset(o->mark, 0, f->nInsts);
+    for (int v = 0; v < f->nInsts; v++)
+        if (hasEffect((IR_OP)f->insts[v].op) || mayFault(f, &f->insts[v]))
+            markLive(o, v, &n);
+    while (n > 0) {
+        const IR_INST *in = &f->insts[o->work[--n]];
+        int            k  = irValueOperands((IR_OP)in->op);
+        if (k >= 1)
+            markLive(o, in->a, &n);
+        if (k >= 2)
+            markLive(o, in->b, &n);
+        if (in->op == IR_CALL || in->op == IR_RET)
+            for (int i = in->a; i < in->a + in->b; i++)
+                markLive(o, f->args[i], &n);
+    }
+    for (int v = 0; v < f->nInsts; v++)
+        if (!o->mark[v])
+            f->insts[v].op = IR_NOP;
+}
+
+/* ---- loops ---- */
+
+/*
+ * A while loop is a header block with two predecessors: the preheader,
+ * which only jumps to it, and the latch, whose edge back the header
+ * dominates.  Its body is what reaches the latch without going through
+ * the header.  Loops are visited innermost first (headers in reverse
+ * dominator preorder), so what leaves an inner loop can leave the
+ * enclosing one when that loop's turn comes.
+ */
+typedef struct {
+    int header;
+    int preheader;
+    int entrySlot;      /* header pred slot of the preheader; the latch has the other */
+    int stamp;          /* inLoop[b] == stamp for the body's blocks */
+} Loop;
+
+static bool findLoop(Opt *o, const IR_FUNC *f, int h, Loop *lp) {
+    const IR_BLOCK *hb = &f->blocks[h];
+    if (hb->nPreds != 2)
+        return false;
+    int latchSlot = -1;
+    for (int slot = 0; slot < 2; slot++) {
+        int p = hb->pred[slot];
+        if (o->idom[p] >= 0 && o->pre[h] <= o->pre[p] && o->pre[p] <= o->last[h])
+            latchSlot = slot;
+    }
+    if (latchSlot < 0)
+        return false;
+    lp->header    = h;
+    lp->entrySlot = 1 - latchSlot;
+    lp->preheader = hb->pred[lp->entrySlot];
+    if (f->blocks[lp->preheader].nSuccs != 1 || o->idom[lp->preheader] < 0)
+        return false;
+
+    lp->stamp    = ++o->loopStamp;
+    o->inLoop[h] = lp->stamp;
+    int sp = 0, latch = hb->pred[latchSlot];
+    if (o->inLoop[latch] != lp->stamp) {
+        o->inLoop[latch] = lp->stamp;
+        o->stack[sp++]   = latch;
+    }
+    while (sp > 0) {
+        const IR_BLOCK *bb = &f->blocks[o->stack[--sp]];
+        for (int j = 0; j < bb->nPreds; j++) {
+            int p = bb->pred[j];
+            if (o->inLoop[p] != lp->stamp && o->idom[p] >= 0) {
+                o->inLoop[p]   = lp->stamp;
+                o->stack[sp++] = p;
+            }
+        }
+    }
+    return true;
+}
+
+static bool isInvariant(const Opt *o, const IR_FUNC *f, const Loop *lp, int v) {
+    return o->inLoop[f->insts[v].block] != lp->stamp;
+}
+
+/* The instruction before a block's last one (its terminator), -1 if none */
+static int beforeLast(const IR_FUNC *f, int b) {
+    int prev = -1;
+    for (int v = f->blocks[b].first; v >= 0 && v != f->blocks[b].last; v = f->insts[v].next)
+        prev = v;
+    return prev;
+}
+
+/* New instruction just before the preheader's jump */
+static int addToPreheader(Opt *o, IR_FUNC *f, const Loop *lp, IR_OP op, int a, int b, int line) {
+    int v = irAddInst(f, lp->preheader, op, IR_INT, a, b, line);
+    growInsts(o, f);
+    irLinkAfter(f, lp->preheader, beforeLast(f, lp->preheader), v);
+    return v;
+}
+
+/* ---- licm ---- */
+
+/* Whether v could run in the preheader: pure, cannot trap, and its operands come from outside */
+static bool canHoist(const Opt *o, const IR_FUNC *f, const Loop *lp, int v, bool memStable) {
+    const IR_INST *in = &f->insts[v];
+    switch (in->op) {
+    case IR_CONST:
+        return true;
+    case IR_GLOAD:
+        return memStable;
+    case IR_DIV:
+        /* hoisted out of a loop that never runs it must not fault */
+        if (mayFault(f, in))
+            return false;
+        break;
+    case IR_RTOI:   /* out of range traps on some targets */
+    case IR_PHI:
+        return false;
+    default:
+        if (!isComputed((IR_OP)in->op))
+            return false;
+        break;
+    }
+    int n = irValueOperands((IR_OP)in->op);
+    return isInvariant(o, f, lp, in->a) && (n < 2 || isInvariant(o, f, lp, in->b));
+}
+
+static void licmLoop(Opt *o, IR_FUNC *f, const Loop *lp) {
+    /* global loads stay put if anything in the loop may store */
+    bool memStable = true;
+    for (int i = o->pre[lp->header]; i <= o->last[lp->header] && memStable; i++) {
+        int b = o->order[i];
+        if (o->inLoop[b] != lp->stamp)
+            continue;
+        for (int v = f->blocks[b].first; v >= 0; v = f->insts[v].next)
+            if (f->insts[v].op == IR_GSTORE || f->insts[v].op == IR_CALL)
+                memStable = false;
+    }
+
+    int at = beforeLast(f, lp->preheader);
+    for (int i = o->pre[lp->header]; i <= o->last[lp->header]; i++) {
+        int b = o->order[i];
+        if (o->inLoop[b] != lp->stamp)
+            continue;
+        IR_BLOCK *bb   = &f->blocks[b];
+        int       prev = -1;
+        for (int v = bb->first, next; v >= 0; v = next) {
+            next = f->insts[v].next;
+            if (!canHoist(o, f, lp, v, memStable)) {
+                prev = v;
+                continue;
+            }
+            if (prev >= 0)
+                f->insts[prev].next = next;
+            else
+                bb->first = next;
+            if (bb->last == v)
+                bb->last = prev;
+            irLinkAfter(f, lp->preheader, at, v);
+            at = v;
+        }
+    }
+}
+
+/* ---- iv ---- */
+
+/* A basic induction variable: phi(init, phi +/- step) in a loop header */
+typedef struct BasicIv {
+    int32_t phi;
+    int32_t init;
+    int32_t step;
+    int32_t next;       /* phi +/- step, the latch's operand */
+    uint8_t op;         /* IR_ADD or IR_SUB */
+} BasicIv;
+
+/* A product iv * k already replaced by its own induction variable */
+typedef struct ReducedIv {
+    int32_t iv;
+    int32_t k;
+    int32_t phi;
+} ReducedIv;
+
+static int headerOperand(const IR_INST *phi, int slot) {
+    return slot == 0 ? phi->a : phi->b;
+}
+
+static int findBasicIvs(Opt *o, IR_FUNC *f, const Loop *lp) {
+    int n = 0;
+    for (int v = f->blocks[lp->header].first; v >= 0; v = f->insts[v].next) {
+        IR_INST *in = &f->insts[v];
+        if (in->op != IR_PHI || in->type != IR_INT)
+            continue;
+        int init = irFindValue(o->repl, headerOperand(in, lp->entrySlot));
+        int next = irFindValue(o->repl, headerOperand(in, 1 - lp->entrySlot));
+        const IR_INST *nx = &f->insts[next];
+        int step;
+        if (nx->op == IR_ADD && nx->a == v && isInvariant(o, f, lp, nx->b))
+            step = nx->b;
+        else if (nx->op == IR_ADD && nx->b == v && isInvariant(o, f, lp, nx->a))
+            step = nx->a;
+        else if (nx->op == IR_SUB && nx->a == v && isInvariant(o, f, lp, nx->b))
+            step = nx->b;
+        else
+            continue;
+
+        /* a counter in lockstep with one already found (same start and step) is that one */
+        int same = -1;
+        for (int j = 0; j < n && same < 0; j++)
+            if (o->ivs[j].init == init && o->ivs[j].step == step && o->ivs[j].op == nx->op)
+                same = o->ivs[j].phi;
+        if (same >= 0) {
+            o->repl[v] = same;
+            in->op     = IR_NOP;
+            continue;
+        }
+        if (n == o->capIvs) {
+            o->capIvs = o->capIvs ? 2 * o->capIvs : 16;
+            o->ivs    = (BasicIv *)realloc(o->ivs, o->capIvs * sizeof(BasicIv));
+        }
+        o->ivs[n++] = (BasicIv){ v, init, step, next, nx->op };
+    }
+    return n;
+}
+
+/*
+ * Strength reduction: iv * k with k invariant becomes a phi of its own
+ * that starts at init * k and moves by step * k right where iv moves.
+ * Its value through an iteration is the product's, wraparound included.
+ */
+static void ivLoop(Opt *o, IR_FUNC *f, const Loop *lp) {
+    int nIvs = findBasicIvs(o, f, lp), nReduced = 0;
+    if (nIvs == 0)
+        return;
+
+    for (int i = o->pre[lp->header]; i <= o->last[lp->header]; i++) {
+        int b = o->order[i];
+        if (o->inLoop[b] != lp->stamp)
+            continue;
+        for (int v = f->blocks[b].first; v >= 0; v = f->insts[v].next) {
+            IR_INST *in = &f->insts[v];
+            if (in->op != IR_MUL || in->type != IR_INT)
+                continue;
+            int x = irFindValue(o->repl, in->a), y = irFindValue(o->repl, in->b);
+            int iv = -1, k = -1;
+            for (int j = 0; j < nIvs && iv < 0; j++) {
+                if (o->ivs[j].phi == x && isInvariant(o, f, lp, y))
+                    iv = j, k = y;
+                else if (o->ivs[j].phi == y && isInvariant(o, f, lp, x))
+                    iv = j, k = x;
+            }
+            if (iv < 0)
+                continue;
+
+            int phi = -1;
+            for (int j = 0; j < nReduced && phi < 0; j++)
+                if (o->reduced[j].iv == iv && o->reduced[j].k == k)
+                    phi = o->reduced[j].phi;
+            if (phi < 0) {
+                BasicIv bi    = o->ivs[iv];
+                int     line  = f->insts[v].line;
+                int     start = addToPreheader(o, f, lp, IR_MUL, bi.init, k, line);
+                int     step  = addToPreheader(o, f, lp, IR_MUL, bi.step, k, line);
+                phi = irAddInst(f, lp->header, IR_PHI, IR_INT, -1, -1, line);
+                int moved = irAddInst(f, f->insts[bi.next].block, (IR_OP)bi.op, IR_INT, phi, step,
+                                      f->insts[bi.next].line);
+                growInsts(o, f);
+                irLinkAfter(f, lp->header, -1, phi);
+                irLinkAfter(f, f->insts[bi.next].block, bi.next, moved);
+                f->insts[phi].a = lp->entrySlot == 0 ? start : moved;
+                f->insts[phi].b = lp->entrySlot == 0 ? moved : start;
+                if (nReduced == o->capReduced) {
+                    o->capReduced = o->capReduced ? 2 * o->capReduced : 16;
+                    o->reduced = (ReducedIv *)realloc(o->reduced, o->capReduced * sizeof(ReducedIv));
+                }
+                o->reduced[nReduced++] = (ReducedIv){ iv, k, phi };
+            }
+            o->repl[v]     = phi;
+            f->insts[v].op = IR_NOP;
+        }
+    }
+}
+
+/* Run 'fn' on every loop of 'f', innermost first */
+static void forEachLoop(Opt *o, IR_FUNC *f, void (*fn)(Opt *, IR_FUNC *, const Loop *)) {
+    int np = dominators(o, f);
+    for (int b = 0; b < f->nBlocks; b++)
+        o->inLoop[b] = 0;
+    o->loopStamp = 0;
+    for (int i = np - 1; i >= 0; i--) {
+        Loop lp;
+        if (findLoop(o, f, o->order[i], &lp))
+            fn(o, f, &lp);
+    }
+    irReplaceOperands(f, o->repl);
+}
+
+/* ------------------------------------------------------------------
+ * irOptimize
+ * ------------------------------------------------------------------ */
+void irOptimize(irModule m, const IR_PIPELINE *p, IR_PASS_STATS *stats) {
+    Opt o;
+    memset(&o, 0, sizeof o);
+
+    for (int i = 0; i < p->n; i++) {
+        long            before = stats ? irLiveInsts(m) : 0;
+        uint64_t        t0     = benchNow();
+        IR_INLINE_STATS inl    = { .calls = 0, .inlined = 0 };
+        if (p->pass[i] == IR_PASS_INLINE)
+            irInline(m, &inl);
+        for (int k = 0; k < m->nFuncs; k++) {
+            IR_FUNC *f = &m->funcs[k];
+            if (f->nBlocks == 0)
+                continue;
+            reserve(&o, f);
+            switch (p->pass[i]) {
+            case IR_PASS_FOLD: foldFunction(&o, f); break;
+            case IR_PASS_GVN:  gvnFunction(&o, f); break;
+            case IR_PASS_DCE:  dceFunction(&o, f); break;
+            case IR_PASS_LICM: forEachLoop(&o, f, licmLoop); break;
+            case IR_PASS_IV:   forEachLoop(&o, f, ivLoop); break;
+            case IR_PASS_INLINE: break;     /* done above; the sweep drops what it replaced */
+            }
+            sweep(f);
+        }
+        if (stats)
+            stats[i] = (IR_PASS_STATS){ benchNow() - t0, before, irLiveInsts(m), inl.calls,
+                                        inl.inlined };
+    }
+    freeOpt(&o);
+}
+
+/* ---- pipelines ---- */
+
+bool irPipelineForLevel(int level, IR_PIPELINE *p) {
+    static const char *LEVELS[IR_MAX_OPT_LEVEL + 1] = {
+        "", "fold,dce", "fold,gvn,fold,dce", "inline,fold,gvn,licm,iv,fold,gvn,dce",
+    };
+    return level >= 0 && level <= IR_MAX_OPT_LEVEL && irParsePipeline(LEVELS[level], p);
+}
+
+bool irParsePipeline(const char *spec, IR_PIPELINE *p) {
+    p->n = 0;
+    while (*spec != '\0') {
+        size_t len = strcspn(spec, ",");
+        int    k   = 0;
+        while (k < IR_PASS_COUNT &&
+               !(strlen(PASS_NAMES[k]) == len && strncmp(PASS_NAMES[k], spec, len) == 0))
+            k++;
+        if (k == IR_PASS_COUNT || p->n == IR_MAX_PIPELINE)
+            return false;
+        p->pass[p->n++] = (uint8_t)k;
+        spec += len;
+        if (*spec == ',' && *++spec == '\0')
+            return false;   /* trailing comma */
+    }
+    return true;
+}
+
+long irLiveInsts(const IR_MODULE *m) {
+    long n = 0;
+    for (int k = 0; k < m->nFuncs; k++)
+        for (int v = 0; v < m->funcs[k].nInsts; v++)
+            n += m->funcs[k].insts[v].op != IR_NOP;
+    return n;
+}
+
+void irPrintPassStats(const IR_PIPELINE *p, const IR_PASS_STATS *stats, FILE *out) {
+    uint64_t total = 0;
+    fprintf(out, "%-6s %10s %12s %12s %8s\n", "pass", "ms", "before", "after", "change");
+    for (int i = 0; i < p->n; i++) {
+        const IR_PASS_STATS *s = &stats[i];
+        total += s->ns;
+        fprintf(out, "%-6s %10.3f %12ld %12ld %+7.1f%%", irPassName((IR_PASS)p->pass[i]),
+                s->ns / 1e6, s->before, s->after,
+                s->before ? 100.0 * (s->after - s->before) / s->before : 0.0);
+        if (p->pass[i] == IR_PASS_INLINE)
+            fprintf(out, "   %d of %d calls inlined", s->inlined, s->calls);
+        fprintf(out, "\n");
+    }
+    if (p->n > 0)
+        fprintf(out, "%-6s %10.3f %12ld %12ld %+7.1f%%\n", "total", total / 1e6, stats[0].before,
+                stats[p->n - 1].after,
+                stats[0].before
+                    ? 100.0 * (stats[p->n - 1].after - stats[0].before) / stats[0].before
+                    : 0.0);
+}
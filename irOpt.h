@@ -0,0 +1,91 @@
+#ifndef IR_OPT_H
+#define IR_OPT_H
+
+#include "ir.h"
+#include "irInline.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Optimisation passes over the SSA IR, each run over every function of
+ * a module:
+ *
+ *   fold  constant folding and propagation, a few algebraic identities
+ *         (x + 0, x * 1, b and true, ...) and branches on constants;
+ *         blocks that become unreachable are emptied and their edges
+ *         taken out of the phis they fed
+ *   gvn   global value numbering: a pure instruction equal to one that
+ *         dominates it (same op, type, operands and immediate) is
+ *         replaced by it
+ *   dce   removes every instruction neither used by nor being a
+ *         store, read, write, call, branch or int division that may
+ *         fault
+ *   licm  natural loops from the dominator tree; pure instructions
+ *         whose operands come from outside a loop move to its
+ *         preheader (int division only by a constant other than 0
+ *         and -1, global loads only if the loop neither stores nor
+ *         calls)
+ *   iv    induction variables of each loop: counters that start and
+ *         step alike are merged, and iv * k with k invariant becomes
+ *         a counter of its own stepping by step * k (run licm first so
+ *         steps and factors are outside the loop)
+ *   inline  calls to small callees replaced by their bodies, callees
+ *         first (see irInline.h); best followed by fold, which then
+ *         sees the arguments
+ *
+ * A pipeline is a sequence of passes, named on the command line as a
+ * comma list ("fold,gvn,fold,dce"); -O levels pick one.
+ */
+typedef enum {
+    IR_PASS_FOLD,
+    IR_PASS_GVN,
+    IR_PASS_DCE,
+    IR_PASS_LICM,
+    IR_PASS_IV,
+    IR_PASS_INLINE,
+    IR_PASS_COUNT
+} IR_PASS;
+
+#define IR_MAX_PIPELINE 16
+#define IR_MAX_OPT_LEVEL 3
+
+typedef struct {
+    uint8_t pass[IR_MAX_PIPELINE];
+    int     n;
+} IR_PIPELINE;
+
+/*
+ * One step of a pipeline: time over the whole module, live instructions
+ * before and after, and for inline the calls seen and inlined.
+ */
+typedef struct {
+    uint64_t ns;
+    long     before;
+    long     after;
+    int      calls;
+    int      inlined;
+} IR_PASS_STATS;
+
+/*
+ * -O0: nothing; -O1: fold, dce; -O2: fold, gvn, fold, dce;
+ * -O3: inline, fold, gvn, licm, iv, fold, gvn, dce.  False for other
+ * levels.
+ */
+bool irPipelineForLevel(int level, IR_PIPELINE *p);
+
+/* "fold,gvn,dce" and the like; false on an unknown name or too many steps */
+bool irParsePipeline(const char *spec, IR_PIPELINE *p);
+
+/* Run 'p' over 'm'; 'stats' (p->n entries) may be NULL */
+void irOptimize(irModule m, const IR_PIPELINE *p, IR_PASS_STATS *stats);
+
+/* One line per step: time, instructions before / after, and the change */
+void irPrintPassStats(const IR_PIPELINE *p, const IR_PASS_STATS *stats, FILE *out);
+
+/* Instructions not removed, over every function */
+long irLiveInsts(const IR_MODULE *m);
+
+const char *irPassName(IR_PASS pass);
+
+#endif /* IR_OPT_H */
@@ -0,0 +1,174 @@
+/*
+ * irbench — cost of lowering to SSA form and optimising it, per source KB.
+ *
+ *     ./irbench [--size=N[K|M|G] | --kernels=N] [--seed=N] [--runs=N] [-ON | --passes=L]
+ *               [source_file]
+ *
+ * Without a file a program of --size bytes (default 4M) is generated as
+ * srcgen would.  The program is parsed and its symbol table built once;
+ * then lowerProgram runs N times (default 5).  srcgen programs are not
+ * type-correct, which lowering tolerates, but nearly everything in them
+ * lowers to undef and they build no phis.  --kernels=N generates N loop
+ * kernels of every kind instead (kernelGen.h), which type check, so
+ * their loops lower to real blocks and phis and the optimisation passes
+ * have something to do.  Reports the median lowering time, the IR's
+ * size in instructions, phis, blocks and bytes, and each per source KB.
+ * With -O1, -O2 or a pass list each run also optimises the module it
+ * lowered; the median time of that is reported with the last run's
+ * per-pass table.
+ */
+#include "ast.h"
+#include "bench.h"
+#include "grammarTable.h"
+#include "ir.h"
+#include "irOpt.h"
+#include "kernelGen.h"
+#include "progGen.h"
+#include "symbolTable.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [--size=N[K|M|G] | --kernels=N] [--seed=N] [--runs=N] "
+                    "[-ON | --passes=L] [source_file]\n", prog);
+}
+
+/* --kernels: the program goes to a file of its own so that loadBenchProgram can read it */
+static bool writeKernels(char *path, const KernelOptions *gen) {
+    int   fd  = mkstemp(path);
+    FILE *out = (fd >= 0) ? fdopen(fd, "w") : NULL;
+    if (out == NULL) {
+        perror(path);
+        if (fd >= 0) {
+            close(fd);
+            unlink(path);
+        }
+        return false;
+    }
+    generateKernels(out, gen);
+    if (fclose(out) != 0) {
+        perror(path);
+        unlink(path);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    GenOptions  opt     = { .size = 4 << 20, .seed = 1, .errorRate = 0, .maxDepth = 0 };
+    const char *srcPath = NULL;
+    int         runs    = 5;
+    long        kernels = 0;
+    IR_PIPELINE pipeline = { .n = 0 };
+
+    for (int i = 1; i < argc; i++) {
+        const char *a   = argv[i];
+        char       *end = NULL;
+        long        level;
+        if (strncmp(a, "--size=", 7) == 0 && (opt.size = parseSize(a + 7)) != 0)
+            ;
+        else if (strncmp(a, "--seed=", 7) == 0 &&
+                 ((opt.seed = strtoull(a + 7, &end, 10)), *end == '\0'))
+            ;
+        else if (strncmp(a, "--kernels=", 10) == 0 &&
+                 (kernels = strtol(a + 10, &end, 10)) >= 1 && kernels <= (1 << 20) &&
+                 *end == '\0')
+            ;
+        else if (strncmp(a, "--runs=", 7) == 0 &&
+                 (runs = (int)strtol(a + 7, &end, 10)) >= 1 && *end == '\0')
+            ;
+        else if (a[0] == '-' && a[1] == 'O' &&
+                 ((level = strtol(a + 2, &end, 10)), end != a + 2 && *end == '\0') &&
+                 irPipelineForLevel((int)level, &pipeline))
+            ;
+        else if (strncmp(a, "--passes=", 9) == 0 && irParsePipeline(a + 9, &pipeline))
+            ;
+        else if (a[0] != '-' && srcPath == NULL)
+            srcPath = a;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    char kernelPath[] = "/tmp/irbench.XXXXXX";
+    if (kernels > 0 && srcPath != NULL) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (kernels > 0) {
+        KernelOptions gen = { (int)kernels, 20000, opt.seed, 0 };
+        if (!writeKernels(kernelPath, &gen))
+            return 1;
+    }
+
+    BenchProgram prog;
+    bool         loaded = loadBenchProgram(kernels > 0 ? kernelPath : srcPath, &opt, &prog);
+    if (kernels > 0)
+        unlink(kernelPath);
+    if (!loaded)
+        return 1;
+
+    diagBuffer  sink = createDiagBuffer();
+    symbolTable st   = buildSymbolTable(prog.ast, sink);
+    benchReport r    = createBenchReport(kernels > 0 ? "kernels" : srcPath ? srcPath : "generated",
+                                         runs);
+    int         ph   = benchPhase(r, "lower");
+    int         phO  = benchPhase(r, "optimize");
+    irModule    ir   = NULL;
+    IR_PASS_STATS stats[IR_MAX_PIPELINE];
+    long        lowered = 0;
+    for (int run = 0; run < runs; run++) {
+        freeIrModule(ir);
+        uint64_t t0 = benchNow();
+        ir = lowerProgram(st, prog.ast);
+        uint64_t t1 = benchNow();
+        benchRecord(r, ph, t1 - t0);
+        if (pipeline.n > 0) {
+            lowered = irLiveInsts(ir);
+            irOptimize(ir, &pipeline, stats);
+            benchRecord(r, phO, benchNow() - t1);
+        }
+    }
+
+    long insts = 0, live = 0, phis = 0, blocks = 0;
+    for (int k = 0; k < ir->nFuncs; k++) {
+        const IR_FUNC *f = &ir->funcs[k];
+        insts  += f->nInsts;
+        blocks += f->nBlocks;
+        for (int v = 0; v < f->nInsts; v++) {
+            live += f->insts[v].op != IR_NOP;
+            phis += f->insts[v].op == IR_PHI;
+        }
+    }
+    double   kb  = prog.bytes / 1024.0;
+    uint64_t ns  = benchMedian(r, ph);
+    size_t   mem = irModuleBytes(ir);
+
+    printf("%s: %ld bytes, %d functions, AST %ld nodes\n", r->source, prog.bytes,
+           ir->nFuncs, prog.arena->nodes);
+    printf("IR: %ld instructions (%ld live, %ld phis), %ld blocks\n", insts, live,
+           phis, blocks);
+    printf("%-22s %12s %12s\n", "", "total", "per KB");
+    printf("%-22s %12.3f %12.2f\n", "lower (ms / us)", ns / 1e6, ns / 1e3 / kb);
+    printf("%-22s %12zu %12.0f\n", "IR memory (bytes)", mem, mem / kb);
+    printf("%-22s %12ld %12.1f\n", "instructions", live, live / kb);
+    printf("%-22s %12zu %12.0f\n", "AST memory (bytes)", prog.arena->bytes,
+           prog.arena->bytes / kb);
+    if (pipeline.n > 0) {
+        uint64_t opt = benchMedian(r, phO);
+        printf("%-22s %12.3f %12.2f\n", "optimize (ms / us)", opt / 1e6, opt / 1e3 / kb);
+        printf("%-22s %12ld %12.1f\n", "  lowered instructions", lowered, lowered / kb);
+        printf("\n");
+        irPrintPassStats(&pipeline, stats, stdout);
+    }
+
+    freeIrModule(ir);
+    freeDiagBuffer(sink);
+    freeSymbolTable(st);
+    freeBenchReport(r);
+    freeAstArena(prog.arena);
+    freeGrammarTables(prog.T);
+    return 0;
+}
@@ -0,0 +1,370 @@
+#include "json.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ---- reader ---- */
+
+/* Deeper nesting than this is rejected rather than recursed into */
+#define JSON_MAX_DEPTH 64
+
+typedef struct {
+    const char *p;
+    const char *end;
+} JsonReader;
+
+static void skipSpace(JsonReader *r) {
+    while (r->p < r->end && (*r->p == ' ' || *r->p == '\t' || *r->p == '\n' || *r->p == '\r'))
+        r->p++;
+}
+
+static bool literal(JsonReader *r, const char *word) {
+    size_t n = strlen(word);
+    if ((size_t)(r->end - r->p) < n || memcmp(r->p, word, n) != 0)
+        return false;
+    r->p += n;
+    return true;
+}
+
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool readHex4(JsonReader *r, uint32_t *cp) {
+    if (r->end - r->p < 4)
+        return false;
+    *cp = 0;
+    for (int i = 0; i < 4; i++) {
+        int d = hexDigit(*r->p++);
+        if (d < 0)
+            return false;
+        *cp = (*cp << 4) | (uint32_t)d;
+    }
+    return true;
+}
+
+static size_t putUtf8(char *out, uint32_t cp) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xc0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3f));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xe0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+        out[2] = (char)(0x80 | (cp & 0x3f));
+        return 3;
+    }
+    out[0] = (char)(0xf0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+    out[3] = (char)(0x80 | (cp & 0x3f));
+    return 4;
+}
+
+/* After the opening quote; the decoded text is never longer than the source */
+static bool readString(JsonReader *r, char **out, size_t *outLen) {
+    const char *start = r->p;
+    while (r->p < r->end && *r->p != '"')
+        r->p += (*r->p == '\\') ? 2 : 1;
+    if (r->p >= r->end)
+        return false;
+
+    char  *buf = (char *)malloc((size_t)(r->p - start) + 1);
+    size_t n   = 0;
+    const char *end = r->p;
+    r->p = start;
+
+    while (r->p < end) {
+        char c = *r->p++;
+        if ((unsigned char)c < 0x20) {
+            free(buf);
+            return false;
+        }
+        if (c != '\\') {
+            buf[n++] = c;
+            continue;
+        }
+        uint32_t cp;
+        switch (*r->p++) {
+        case '"':  buf[n++] = '"';  break;
+        case '\\': buf[n++] = '\\'; break;
+        case '/':  buf[n++] = '/';  break;
+        case 'b':  buf[n++] = '\b'; break;
+        case 'f':  buf[n++] = '\f'; break;
+        case 'n':  buf[n++] = '\n'; break;
+        case 'r':  buf[n++] = '\r'; break;
+        case 't':  buf[n++] = '\t'; break;
+        case 'u':
+            if (!readHex4(r, &cp)) {
+                free(buf);
+                return false;
+            }
+            /* a surrogate pair is two escapes but decodes to four bytes */
+            if (cp >= 0xd800 && cp < 0xdc00 && end - r->p >= 6 && r->p[0] == '\\' &&
+                r->p[1] == 'u') {
+                uint32_t lo;
+                r->p += 2;
+                if (!readHex4(r, &lo) || lo < 0xdc00 || lo >= 0xe000) {
+                    free(buf);
+                    return false;
+                }
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+            }
+            n += putUtf8(buf + n, cp);
+            break;
+        default:
+            free(buf);
+            return false;
+        }
+    }
+    r->p++;     /* closing quote */
+
+    buf[n]  = '\0';
+    *out    = buf;
+    *outLen = n;
+    return true;
+}
+
+static void clearValue(JSON_VALUE *v);
+
+static bool readValue(JsonReader *r, JSON_VALUE *v, int depth);
+
+static bool readItems(JsonReader *r, JSON_VALUE *v, bool object, int depth) {
+    char close = object ? '}' : ']';
+    int  cap   = 0;
+
+    skipSpace(r);
+    if (r->p < r->end && *r->p == close) {
+        r->p++;
+        return true;
+    }
+
+    for (;;) {
+        if (v->count == cap) {
+            cap      = cap ? cap * 2 : 4;
+            v->items = (JSON_VALUE *)realloc(v->items, cap * sizeof(JSON_VALUE));
+            if (object)
+                v->keys = (char **)realloc(v->keys, cap * sizeof(char *));
+        }
+
+        skipSpace(r);
+        if (object) {
+            size_t keyLen;
+            if (r->p >= r->end || *r->p != '"')
+                return false;
+            r->p++;
+            if (!readString(r, &v->keys[v->count], &keyLen))
+                return false;
+            skipSpace(r);
+            if (r->p >= r->end || *r->p != ':') {
+                free(v->keys[v->count]);
+                return false;
+            }
+            r->p++;
+        }
+
+        JSON_VALUE *item = &v->items[v->count];
+        memset(item, 0, sizeof(*item));
+        if (!readValue(r, item, depth + 1)) {
+            clearValue(item);
+            if (object)
+                free(v->keys[v->count]);
+            return false;
+        }
+        v->count++;
+
+        skipSpace(r);
+        if (r->p < r->end && *r->p == ',') {
+            r->p++;
+            continue;
+        }
+        if (r->p < r->end && *r->p == close) {
+            r->p++;
+            return true;
+        }
+        return false;
+    }
+}
+
+static bool readValue(JsonReader *r, JSON_VALUE *v, int depth) {
+    if (depth > JSON_MAX_DEPTH)
+        return false;
+    skipSpace(r);
+    if (r->p >= r->end)
+        return false;
+
+    switch (*r->p) {
+    case '{':
+        r->p++;
+        v->type = JSON_OBJECT;
+        return readItems(r, v, true, depth);
+    case '[':
+        r->p++;
+        v->type = JSON_ARRAY;
+        return readItems(r, v, false, depth);
+    case '"':
+        r->p++;
+        v->type = JSON_STRING;
+        return readString(r, &v->str, &v->strLen);
+    case 't':
+        v->type    = JSON_BOOL;
+        v->boolean = true;
+        return literal(r, "true");
+    case 'f':
+        v->type = JSON_BOOL;
+        return literal(r, "false");
+    case 'n':
+        v->type = JSON_NULL;
+        return literal(r, "null");
+    default: {
+        char   num[64];
+        size_t n = 0;
+        while (r->p + n < r->end && n < sizeof num - 1 &&
+               strchr("+-0123456789.eE", r->p[n]) != NULL)
+            n++;
+        if (n == 0)
+            return false;
+        memcpy(num, r->p, n);
+        num[n] = '\0';
+
+        char *end;
+        v->type   = JSON_NUMBER;
+        v->number = strtod(num, &end);
+        r->p += n;
+        return end == num + n;
+    }
+    }
+}
+
+static void clearValue(JSON_VALUE *v) {
+    free(v->str);
+    for (int i = 0; i < v->count; i++) {
+        clearValue(&v->items[i]);
+        if (v->keys != NULL)
+            free(v->keys[i]);
+    }
+    free(v->items);
+    free(v->keys);
+}
+
+jsonValue parseJson(const char *text, size_t len) {
+    JsonReader r = { text, text + len };
+    jsonValue  v = (jsonValue)calloc(1, sizeof(JSON_VALUE));
+    bool      ok = readValue(&r, v, 0);
+    skipSpace(&r);
+    if (!ok || r.p != r.end) {
+        freeJson(v);
+        return NULL;
+    }
+    return v;
+}
+
+void freeJson(jsonValue v) {
+    if (v == NULL)
+        return;
+    clearValue(v);
+    free(v);
+}
+
+/* ---- lookup ---- */
+
+const JSON_VALUE *jsonGet(const JSON_VALUE *v, const char *key) {
+    if (v == NULL || v->type != JSON_OBJECT)
+        return NULL;
+    for (int i = 0; i < v->count; i++)
+        if (strcmp(v->keys[i], key) == 0)
+            return &v->items[i];
+    return NULL;
+}
+
+const JSON_VALUE *jsonPath(const JSON_VALUE *v, const char *path) {
+    char part[64];
+    while (v != NULL && *path != '\0') {
+        size_t n = strcspn(path, ".");
+        if (n >= sizeof part)
+            return NULL;
+        memcpy(part, path, n);
+        part[n] = '\0';
+        v = jsonGet(v, part);
+        path += n + (path[n] == '.');
+    }
+    return v;
+}
+
+const char *jsonString(const JSON_VALUE *v, const char *path) {
+    v = jsonPath(v, path);
+    return (v != NULL && v->type == JSON_STRING) ? v->str : NULL;
+}
+
+long jsonInt(const JSON_VALUE *v, const char *path, long fallback) {
+    v = jsonPath(v, path);
+    return (v != NULL && v->type == JSON_NUMBER) ? (long)v->number : fallback;
+}
+
+/* ---- writer ---- */
+
+void jsonWriteString(diagBuffer out, const char *s, size_t n) {
+    diagPrintf(out, "\"");
+    size_t run = 0;     /* characters that need no escaping, written in one go */
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+        if (i > run)
+            diagPrintf(out, "%.*s", (int)(i - run), s + run);
+        switch (c) {
+        case '"':  diagPrintf(out, "\\\""); break;
+        case '\\': diagPrintf(out, "\\\\"); break;
+        case '\n': diagPrintf(out, "\\n");  break;
+        case '\r': diagPrintf(out, "\\r");  break;
+        case '\t': diagPrintf(out, "\\t");  break;
+        default:   diagPrintf(out, "\\u%04x", c); break;
+        }
+        run = i + 1;
+    }
+    if (n > run)
+        diagPrintf(out, "%.*s", (int)(n - run), s + run);
+    diagPrintf(out, "\"");
+}
+
+void jsonWriteValue(diagBuffer out, const JSON_VALUE *v) {
+    switch (v->type) {
+    case JSON_NULL:
+        diagPrintf(out, "null");
+        break;
+    case JSON_BOOL:
+        diagPrintf(out, v->boolean ? "true" : "false");
+        break;
+    case JSON_NUMBER:
+        if (v->number == (double)(long long)v->number)
+            diagPrintf(out, "%lld", (long long)v->number);
+        else
+            diagPrintf(out, "%.17g", v->number);
+        break;
+    case JSON_STRING:
+        jsonWriteString(out, v->str, v->strLen);
+        break;
+    case JSON_ARRAY:
+    case JSON_OBJECT:
+        diagPrintf(out, v->type == JSON_ARRAY ? "[" : "{");
+        for (int i = 0; i < v->count; i++) {
+            if (i > 0)
+                diagPrintf(out, ",");
+            if (v->type == JSON_OBJECT) {
+                jsonWriteString(out, v->keys[i], strlen(v->keys[i]));
+                diagPrintf(out, ":");
+            }
+            jsonWriteValue(out, &v->items[i]);
+        }
+        diagPrintf(out, v->type == JSON_ARRAY ? "]" : "}");
+        break;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include "diag.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Just enough JSON for the language server: a reader that builds a
+ * small tree of values, and helpers to write strings into a diagBuffer
+ * (which doubles as the output text buffer).
+ */
+typedef enum {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT,
+} JSON_TYPE;
+
+typedef struct JSON_VALUE {
+    JSON_TYPE           type;
+    bool                boolean;
+    double              number;
+    char               *str;        /* JSON_STRING, NUL-terminated */
+    size_t              strLen;
+    char              **keys;       /* JSON_OBJECT: keys[i] names items[i] */
+    struct JSON_VALUE  *items;      /* JSON_ARRAY / JSON_OBJECT */
+    int                 count;
+} JSON_VALUE;
+
+typedef JSON_VALUE *jsonValue;
+
+/* Parse 'len' bytes; NULL if they are not exactly one JSON value */
+jsonValue parseJson(const char *text, size_t len);
+
+void freeJson(jsonValue v);
+
+/* Member 'key' of an object (NULL if absent or 'v' is not an object) */
+const JSON_VALUE *jsonGet(const JSON_VALUE *v, const char *key);
+
+/*
+ * Typed accessors along a dotted path ("params.textDocument.uri");
+ * 'fallback' / NULL when the path is missing or of another type.
+ */
+const JSON_VALUE *jsonPath(const JSON_VALUE *v, const char *path);
+const char *jsonString(const JSON_VALUE *v, const char *path);
+long        jsonInt(const JSON_VALUE *v, const char *path, long fallback);
+
+/* Append 's' (n bytes) as a quoted JSON string */
+void jsonWriteString(diagBuffer out, const char *s, size_t n);
+
+/* Append a value exactly as it would be written back out */
+void jsonWriteValue(diagBuffer out, const JSON_VALUE *v);
+
+#endif /* JSON_H */
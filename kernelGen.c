@@ -0,0 +1,175 @@
+#include "kernelGen.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t nextRand(uint64_t *s) {
+    *s = *s * 6364136223846793005ull + 1442695040888963407ull;
+    return *s >> 33;
+}
+
+/* Record names take letters only: #ctra, #ctrb, ..., #ctrba, ... */
+static void recordName(int k, char *buf) {
+    char rev[16];
+    int  n = 0;
+    do {
+        rev[n++] = (char)('a' + k % 26);
+        k /= 26;
+    } while (k > 0);
+    strcpy(buf, "#ctr");
+    for (int i = 0; i < n; i++)
+        buf[4 + i] = rev[n - 1 - i];
+    buf[4 + n] = '\0';
+}
+
+static const char *INT_HEADER =
+    "_loop%d input parameter list [int b2, int c2]\n"
+    "output parameter list [int d2];\n";
+
+static void writeKernel(FILE *out, int k, int kind, uint64_t *rng) {
+    int  a = 2 + (int)(nextRand(rng) % 9), b = 1 + (int)(nextRand(rng) % 50);
+    int  c = 2 + (int)(nextRand(rng) % 15);
+    char rec[24];
+
+    switch (kind) {
+    case KERNEL_INVARIANT:
+        fprintf(out, INT_HEADER, k);
+        fprintf(out,
+                "\ttype int : b3;\n\ttype int : c3;\n\ttype int : d3;\n\ttype int : b4;\n"
+                "\tb3 <--- 0;\n\tc3 <--- 0;\n"
+                "\twhile (b3 < b2)\n"
+                "\t\td3 <--- c2 * %d + %d;\n"
+                "\t\tb4 <--- b3 * %d;\n"
+                "\t\tc3 <--- c3 + b4 + d3;\n"
+                "\t\tb3 <--- b3 + 1;\n"
+                "\tendwhile\n",
+                a, b, c);
+        break;
+    case KERNEL_NESTED:
+        recordName(k, rec);
+        fprintf(out, INT_HEADER, k);
+        fprintf(out,
+                "\trecord %s\n\t\ttype int : cnt;\n\t\ttype int : sum;\n\tendrecord\n"
+                "\ttype record %s : b5;\n"
+                "\ttype int : b3;\n\ttype int : c3;\n\ttype int : d3;\n\ttype int : b4;\n"
+                "\ttype int : c4;\n"
+                "\tb5.cnt <--- 0;\n\tb5.sum <--- 0;\n\tb3 <--- 0;\n"
+                "\tc4 <--- b2 / 16;\n"
+                "\twhile (b3 < c4)\n"
+                "\t\tc3 <--- 0;\n"
+                "\t\twhile (c3 < 16)\n"
+                "\t\t\td3 <--- c2 * %d + %d;\n"
+                "\t\t\tb4 <--- b3 * d3 + c3 * %d;\n"
+                "\t\t\tb5.sum <--- b5.sum + b4;\n"
+                "\t\t\tc3 <--- c3 + 1;\n"
+                "\t\tendwhile\n"
+                "\t\tb5.cnt <--- b5.cnt + 1;\n"
+                "\t\tb3 <--- b3 + 1;\n"
+                "\tendwhile\n"
+                "\tc3 <--- b5.sum + b5.cnt;\n",
+                rec, rec, a, b, c);
+        break;
+    case KERNEL_REAL:
+        fprintf(out,
+                "_loop%d input parameter list [int b2, real c2]\n"
+                "output parameter list [real d2];\n"
+                "\ttype int : b3;\n\ttype real : c3;\n\ttype real : d3;\n"
+                "\tb3 <--- 0;\n\tc3 <--- 0.00;\n"
+                "\twhile (b3 < b2)\n"
+                "\t\td3 <--- c2 * %d.25 + %d.50;\n"
+                "\t\tc3 <--- c3 + d3;\n"
+                "\t\tb3 <--- b3 + 1;\n"
+                "\tendwhile\n"
+                "\td2 <--- c3;\n"
+                "\treturn [d2];\n"
+                "end\n",
+                k, a, b);
+        return;
+    case KERNEL_COUNTDOWN:
+        fprintf(out, INT_HEADER, k);
+        fprintf(out,
+                "\ttype int : b3;\n\ttype int : c3;\n\ttype int : d3;\n\ttype int : b4;\n"
+                "\tb3 <--- b2;\n\tc3 <--- 0;\n"
+                "\twhile (b3 > 0)\n"
+                "\t\td3 <--- c2 * %d - %d;\n"
+                "\t\tb4 <--- b3 * %d + d3;\n"
+                "\t\tc3 <--- c3 + b4;\n"
+                "\t\tb3 <--- b3 - 2;\n"
+                "\tendwhile\n",
+                a, b, c);
+        break;
+    case KERNEL_CALLS:
+        fprintf(out,
+                "_sq%d input parameter list [int b2, int c2]\n"
+                "output parameter list [int d2];\n"
+                "\td2 <--- b2 * c2 + %d;\n"
+                "\treturn [d2];\n"
+                "end\n"
+                "_step%d input parameter list [int b2, int c2]\n"
+                "output parameter list [int d2];\n"
+                "\ttype int : b3;\n"
+                "\t[b3] <--- call _sq%d with parameters [b2, c2];\n"
+                "\td2 <--- b3 - b2 * %d;\n"
+                "\treturn [d2];\n"
+                "end\n",
+                k, b, k, k, c);
+        fprintf(out, INT_HEADER, k);
+        fprintf(out,
+                "\ttype int : b3;\n\ttype int : c3;\n\ttype int : d3;\n"
+                "\tb3 <--- 0;\n\tc3 <--- 0;\n"
+                "\twhile (b3 < b2)\n"
+                "\t\t[d3] <--- call _step%d with parameters [b3, c2];\n"
+                "\t\tc3 <--- c3 + d3;\n"
+                "\t\tb3 <--- b3 + 1;\n"
+                "\tendwhile\n",
+                k);
+        break;
+    default:    /* KERNEL_GLOBAL */
+        fprintf(out, INT_HEADER, k);
+        fprintf(out,
+                "\ttype int : b3;\n\ttype int : c3;\n\ttype int : d3;\n"
+                "\tb3 <--- 0;\n\tc3 <--- 0;\n"
+                "\twhile (b3 < b2)\n"
+                "\t\td3 <--- b7 * %d;\n"
+                "\t\tc3 <--- c3 + d3 + b3 * %d;\n"
+                "\t\tb3 <--- b3 + 1;\n"
+                "\tendwhile\n",
+                a, c);
+        break;
+    }
+    fprintf(out, "\td2 <--- c3;\n\treturn [d2];\nend\n");
+}
+
+/* ------------------------------------------------------------------
+ * generateKernels
+ * ------------------------------------------------------------------ */
+void generateKernels(FILE *out, const KernelOptions *opt) {
+    uint64_t rng   = opt->seed * 0x9E3779B97F4A7C15ull + 1;
+    int      n     = opt->kernels;
+    int     *kinds = (int *)malloc((n > 0 ? n : 1) * sizeof(int));
+    int      allowed[KERNEL_KINDS], nAllowed = 0;
+
+    for (int kind = 0; kind < KERNEL_KINDS; kind++)
+        if (opt->kinds == 0 || (opt->kinds & (1u << kind)))
+            allowed[nAllowed++] = kind;
+    if (nAllowed == 0)
+        allowed[nAllowed++] = KERNEL_INVARIANT;
+    for (int k = 0; k < n; k++) {
+        kinds[k] = allowed[nextRand(&rng) % nAllowed];
+        writeKernel(out, k, kinds[k], &rng);
+    }
+    fprintf(out,
+            "_main\n"
+            "\ttype int : b2;\n\ttype int : c2;\n\ttype int : c3;\n"
+            "\ttype real : d2;\n\ttype real : d3;\n"
+            "\ttype int : b7 : global;\n"
+            "\tb7 <--- %d;\n\tb2 <--- %d;\n\tc2 <--- %d;\n\td2 <--- 1.25;\n",
+            3 + (int)(nextRand(&rng) % 20), opt->iters, 1 + (int)(nextRand(&rng) % 9));
+    for (int k = 0; k < n; k++) {
+        if (kinds[k] == KERNEL_REAL)
+            fprintf(out, "\t[d3] <--- call _loop%d with parameters [b2, d2];\n\twrite(d3);\n", k);
+        else
+            fprintf(out, "\t[c3] <--- call _loop%d with parameters [b2, c2];\n\twrite(c3);\n", k);
+    }
+    fprintf(out, "\treturn;\nend\n");
+    free(kinds);
+}
@@ -0,0 +1,34 @@
+#ifndef KERNEL_GEN_H
+#define KERNEL_GEN_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Generated loop kernels for the benchmarks (loopbench, vmbench).  Each
+ * kernel is a function _loopN with an int counter and a loop, or a nest
+ * of two, that runs for the count it is passed; main calls every kernel
+ * and writes what it returns.  The programs type check and always stop,
+ * which the random grammar walks of srcgen do not promise.
+ */
+typedef enum {
+    KERNEL_INVARIANT,   /* loop-invariant expression, counter times a constant */
+    KERNEL_NESTED,      /* two loops; a record field kept in step with the counter */
+    KERNEL_REAL,        /* real accumulator */
+    KERNEL_COUNTDOWN,   /* counter stepping down by two */
+    KERNEL_GLOBAL,      /* reads a global set by main */
+    KERNEL_CALLS,       /* calls a small function that calls another */
+    KERNEL_KINDS
+} KERNEL_KIND;
+
+typedef struct {
+    int      kernels;
+    int      iters;     /* count main passes to every kernel */
+    uint64_t seed;
+    unsigned kinds;     /* mask of 1u << KERNEL_*, 0 for every kind */
+} KernelOptions;
+
+/* The source of one program */
+void generateKernels(FILE *out, const KernelOptions *opt);
+
+#endif /* KERNEL_GEN_H */
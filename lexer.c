@@ -1,18 +1,27 @@
 #include "lexer.h"
+#include "diag.h"
+#include "memTrack.h"
+#include "stats.h"
 #include "string.h"
 #include "trie.h"
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdlib.h>
 
 /* Trie that stores all language keywords */
 static trie kwTable;
 
+/* Where this thread's lexical errors go; NULL means stdout */
+static _Thread_local diagBuffer lexDiag = NULL;
+
 /*
  * transition()
  * Core DFA function: given the current state and the character just read,
  * return what to do next (new state, whether a token is complete, etc.).
  */
 static TRANS_RESULT transition(DFA_STATE cur, char ch) {
+    STAT_INC(dfaTransitions);
+
     switch (cur) {
 
     case START: {
@@ -245,9 +254,13 @@ static TRANS_RESULT transition(DFA_STATE cur, char ch) {
 /* ------------------------------------------------------------------
  * initializeLookupTable
  * Insert every language keyword into the trie so we can distinguish
- * keyword lexemes from plain field identifiers.
+ * keyword lexemes from plain field identifiers.  The trie is built on
+ * the first call only and is read-only afterwards, so any number of
+ * threads may lex at once.
  * ------------------------------------------------------------------ */
-void initializeLookupTable(void) {
+static pthread_once_t kwTableOnce = PTHREAD_ONCE_INIT;
+
+static void buildKeywordTable(void) {
     kwTable = createTrieNode();
 
     insert(kwTable, "as",         TK_AS);
@@ -279,6 +292,33 @@ void initializeLookupTable(void) {
     insert(kwTable, "write",      TK_WRITE);
 }
 
+void initializeLookupTable(void) {
+    pthread_once(&kwTableOnce, buildKeywordTable);
+}
+
+/* ------------------------------------------------------------------
+ * setLexerDiagnostics
+ * Send lexical errors raised on the calling thread to 'd' instead of
+ * stdout (NULL restores stdout).
+ * ------------------------------------------------------------------ */
+void setLexerDiagnostics(diagBuffer d) {
+    lexDiag = d;
+}
+
+/* Where this buffer's lexical errors go */
+static diagBuffer lexSink(twinBuffer tb) {
+    return (tb->diag != NULL) ? tb->diag : lexDiag;
+}
+
+/* ------------------------------------------------------------------
+ * keywordTable
+ * The shared keyword trie, built on first use.
+ * ------------------------------------------------------------------ */
+trie keywordTable(void) {
+    initializeLookupTable();
+    return kwTable;
+}
+
 /* ------------------------------------------------------------------
  * getTokenName — return a printable string for a TOKEN_TYPE value
  * ------------------------------------------------------------------ */
@@ -342,6 +382,7 @@ char *getTokenName(TOKEN_TYPE kind) {
     case TK_GE:         return "TK_GE";
     case TK_NE:         return "TK_NE";
     case EPSILLON:      return "EPSILLON";
+    case DOLLAR:        return "DOLLAR";
     default:            return "UNKNOWN";
     }
 }
@@ -364,16 +405,43 @@ void populate_buffer(twinBuffer tb, FILE *src) {
         fill_end   = 2 * CHUNK_SIZE;
     }
 
+    STAT_INC(bufferRefills);
     for (int k = fill_start; k < fill_end; k++) {
         int c = fgetc(src);
         if (c == EOF) {
             /* pad the rest of this half with null bytes */
             for (int m = k; m < fill_end; m++)
                 tb->buf[m] = '\0';
+            STAT_ADD(bytesRead, k - fill_start);
             return;
         }
         tb->buf[k] = (char)c;
     }
+    STAT_ADD(bytesRead, fill_end - fill_start);
+}
+
+/* ------------------------------------------------------------------
+ * createTwinBuffer
+ * Allocate a twin buffer and prime both halves from the source file.
+ * ------------------------------------------------------------------ */
+twinBuffer createTwinBuffer(FILE *src) {
+    twinBuffer tb = (twinBuffer)memAlloc(MEM_BUFFER, sizeof(TWIN_BUFFER));
+
+    /* Clear both halves */
+    for (int i = 0; i < 2 * CHUNK_SIZE; i++)
+        tb->buf[i] = '\0';
+
+    tb->line     = 1;
+    tb->keywords = NULL;
+    tb->diag     = NULL;
+    tb->errors   = 0;
+
+    /* Bootstrap: fill second half first, then first half */
+    tb->pos = CHUNK_SIZE;           /* pretend we're in second half */
+    populate_buffer(tb, src);       /* fills first half */
+    tb->pos = 0;                    /* now in first half */
+    populate_buffer(tb, src);       /* fills second half */
+    return tb;
 }
 
 /* ------------------------------------------------------------------
@@ -410,36 +478,39 @@ static void skip_comment_in_buffer(twinBuffer tb, FILE *src) {
  * offending characters.
  * ------------------------------------------------------------------ */
 static void report_invalid(TRANS_RESULT res, twinBuffer tb, int head, int tail) {
-    printf("Line %02d: Lexical Error: Error: ", tb->line);
+    diagBuffer diag = lexSink(tb);
+
+    tb->errors++;
+    diagPrintf(diag, "Line %02d: Lexical Error: Error: ", tb->line);
 
     if (head == tail) {
-        printf("Unknown symbol <%c>\n", tb->buf[head]);
+        diagPrintf(diag, "Unknown symbol <%c>\n", tb->buf[head]);
         tb->pos = (tail + 1) % (2 * CHUNK_SIZE);
         return;
     }
 
-    printf("Unknown pattern <");
+    diagPrintf(diag, "Unknown pattern <");
     int idx = head;
     while (idx != tail) {
-        printf("%c", tb->buf[idx]);
+        diagPrintf(diag, "%c", tb->buf[idx]);
         idx = (idx + 1) % (2 * CHUNK_SIZE);
     }
-    printf("> ");
+    diagPrintf(diag, "> ");
     tb->pos = tail;
 
     switch (res.errCode) {
-    case 1:  printf(": Expected @@@\n");                                break;
-    case 2:  printf(": Expected !=\n");                                 break;
-    case 3:  printf(": Expected &&&\n");                                break;
-    case 4:  printf(": Expected ==\n");                                 break;
-    case 5:  printf(": Expected <---\n");                               break;
-    case 6:  printf(": Expected a letter [a-z]|[A-Z] after _\n");      break;
-    case 7:  printf(": Expected a lowercase letter [a-z] after #\n");  break;
-    case 8:  printf(": Expected two digits after decimal point\n");     break;
-    case 9:  printf(": Expected a digit [0-9] or +|- after E\n");       break;
-    case 10: printf(": Expected a digit [0-9] after sign/E\n");         break;
-    case 11: printf(": Expected two digits in exponent\n");             break;
-    default: printf("\n");                                              break;
+    case 1:  diagPrintf(diag, ": Expected @@@\n");                                break;
+    case 2:  diagPrintf(diag, ": Expected !=\n");                                 break;
+    case 3:  diagPrintf(diag, ": Expected &&&\n");                                break;
+    case 4:  diagPrintf(diag, ": Expected ==\n");                                 break;
+    case 5:  diagPrintf(diag, ": Expected <---\n");                               break;
+    case 6:  diagPrintf(diag, ": Expected a letter [a-z]|[A-Z] after _\n");       break;
+    case 7:  diagPrintf(diag, ": Expected a lowercase letter [a-z] after #\n");   break;
+    case 8:  diagPrintf(diag, ": Expected two digits after decimal point\n");     break;
+    case 9:  diagPrintf(diag, ": Expected a digit [0-9] or +|- after E\n");       break;
+    case 10: diagPrintf(diag, ": Expected a digit [0-9] after sign/E\n");         break;
+    case 11: diagPrintf(diag, ": Expected two digits in exponent\n");             break;
+    default: diagPrintf(diag, "\n");                                              break;
     }
 }
 
@@ -448,21 +519,25 @@ static void report_invalid(TRANS_RESULT res, twinBuffer tb, int head, int tail)
  * Enforce maximum lexeme lengths for identifiers.
  * Returns false (and frees the token) if the limit is exceeded.
  * ------------------------------------------------------------------ */
-bool handle_valid_error(tokenInfo tok) {
+bool handle_valid_error(twinBuffer tb, tokenInfo tok) {
     if (tok->type == TK_ID && tok->lexemeSize > 20) {
-        printf("Line %02d: Lexical Error: Variable identifier \"%s\" exceeds "
-               "the maximum length of 20 characters\n",
-               tok->line, tok->lexeme);
-        free(tok->lexeme);
-        free(tok);
+        tb->errors++;
+        diagPrintf(lexSink(tb),
+                   "Line %02d: Lexical Error: Variable identifier \"%s\" exceeds "
+                   "the maximum length of 20 characters\n",
+                   tok->line, tok->lexeme);
+        memFree(tok->lexeme);
+        memFree(tok);
         return false;
     }
     if (tok->type == TK_FUNID && tok->lexemeSize > 30) {
-        printf("Line %02d: Lexical Error: Function identifier \"%s\" exceeds "
-               "the maximum length of 30 characters\n",
-               tok->line, tok->lexeme);
-        free(tok->lexeme);
-        free(tok);
+        tb->errors++;
+        diagPrintf(lexSink(tb),
+                   "Line %02d: Lexical Error: Function identifier \"%s\" exceeds "
+                   "the maximum length of 30 characters\n",
+                   tok->line, tok->lexeme);
+        memFree(tok->lexeme);
+        memFree(tok);
         return false;
     }
     return true;
@@ -478,8 +553,10 @@ tokenInfo getNextToken(twinBuffer tb, FILE *src) {
     if (tb->buf[tb->pos] == '%') {
         skip_comment_in_buffer(tb, src);
 
-        tokenInfo ct  = (tokenInfo)malloc(sizeof(TOKEN));
-        ct->lexeme    = (char *)malloc(2);
+        tokenInfo ct  = (tokenInfo)memAlloc(MEM_TOKEN, sizeof(TOKEN));
+        ct->lexeme    = (char *)memAlloc(MEM_LEXEME, 2);
+        STAT_INC(lexemesAllocated);
+        STAT_ADD(lexemeBytes, 2);
         ct->lexeme[0] = '%';
         ct->lexeme[1] = '\0';
         ct->lexemeSize = 1;
@@ -526,7 +603,9 @@ tokenInfo getNextToken(twinBuffer tb, FILE *src) {
     else
         lex_len = 2 * CHUNK_SIZE - head + lex_end + 1;
 
-    char *word = (char *)malloc(lex_len + 1);
+    char *word = (char *)memAlloc(MEM_LEXEME, lex_len + 1);
+    STAT_INC(lexemesAllocated);
+    STAT_ADD(lexemeBytes, lex_len + 1);
     int   wi   = 0;
     int   rd   = head;
     while (rd != lex_end) {
@@ -539,7 +618,7 @@ tokenInfo getNextToken(twinBuffer tb, FILE *src) {
     /* Advance buffer past the consumed lexeme */
     tb->pos = (lex_end + 1) % (2 * CHUNK_SIZE);
 
-    tokenInfo tok  = (tokenInfo)malloc(sizeof(TOKEN));
+    tokenInfo tok  = (tokenInfo)memAlloc(MEM_TOKEN, sizeof(TOKEN));
     tok->lexeme    = word;
     tok->lexemeSize = lex_len;
     tok->line       = tb->line;
@@ -547,7 +626,8 @@ tokenInfo getNextToken(twinBuffer tb, FILE *src) {
     /* Determine the precise token type */
     if (res.tokType == TK_FIELDID) {
         /* Look up in keyword trie; falls back to TK_FIELDID if not found */
-        tok->type = search(kwTable, word);
+        STAT_INC(keywordLookups);
+        tok->type = search(tb->keywords ? tb->keywords : kwTable, word);
     } else if (res.tokType == TK_FUNID) {
         tok->type = stringcmp(word, "_main") ? TK_MAIN : TK_FUNID;
     } else {
@@ -557,6 +637,20 @@ tokenInfo getNextToken(twinBuffer tb, FILE *src) {
     return tok;
 }
 
+/* ------------------------------------------------------------------
+ * makeEofToken
+ * Build the DOLLAR token handed to the parser at end of input.  All
+ * fields are set so callers may print or free it like any other token.
+ * ------------------------------------------------------------------ */
+static tokenInfo makeEofToken(twinBuffer tb) {
+    tokenInfo eofTok  = (tokenInfo)memAlloc(MEM_TOKEN, sizeof(TOKEN));
+    eofTok->type       = DOLLAR;
+    eofTok->lexeme     = NULL;
+    eofTok->lexemeSize = 0;
+    eofTok->line       = tb->line;
+    return eofTok;
+}
+
 /* ------------------------------------------------------------------
  * nextToken
  * Wrapper around getNextToken that the parser calls directly.
@@ -577,16 +671,14 @@ tokenInfo nextToken(twinBuffer tb, FILE *src) {
             if (tb->buf[tb->pos] != '\0')
                 return nextToken(tb, src);
 
-            tokenInfo eofTok = (tokenInfo)malloc(sizeof(TOKEN));
-            eofTok->type = DOLLAR;
-            return eofTok;
+            return makeEofToken(tb);
         }
 
         if (tok->type != NULL_TOKEN  &&
             tok->type != NEWLINE     &&
             tok->type != EXIT_TOKEN  &&
             tok->type != BLANK) {
-            if (handle_valid_error(tok))
+            if (handle_valid_error(tb, tok))
                 keep = true;
         }
     }
@@ -598,35 +690,89 @@ tokenInfo nextToken(twinBuffer tb, FILE *src) {
         populate_buffer(tb, src);
     }
 
-    if (keep)
+    if (keep) {
+        STAT_INC(tokens[tok->type]);
         return tok;
+    }
 
     if (tb->buf[tb->pos] != '\0')
         return nextToken(tb, src);
 
-    tokenInfo eofTok = (tokenInfo)malloc(sizeof(TOKEN));
-    eofTok->type = DOLLAR;
-    return eofTok;
+    return makeEofToken(tb);
 }
 
 /* ------------------------------------------------------------------
- * getStream
- * Tokenise the entire source file and print each token to stdout.
+ * tokenizeSource
+ * Lex the whole file up front into one contiguous token array.  The
+ * token structs are copied into the array and released; lexemes move
+ * with them and are owned by whoever ends up referencing them.
  * ------------------------------------------------------------------ */
-void getStream(FILE *src) {
-    twinBuffer tb = (twinBuffer)malloc(sizeof(TWIN_BUFFER));
+tokenStream tokenizeSource(FILE *src) {
+    return tokenizeWith(src, NULL, NULL);
+}
 
-    /* Clear both halves */
-    for (int i = 0; i < 2 * CHUNK_SIZE; i++)
-        tb->buf[i] = '\0';
+/* ------------------------------------------------------------------
+ * tokenizeWith
+ * tokenizeSource with an explicit keyword table and error sink, so
+ * nothing is looked up in thread or process state.
+ * ------------------------------------------------------------------ */
+tokenStream tokenizeWith(FILE *src, trie keywords, diagBuffer diag) {
+    return tokenizeLines(src, 1, keywords, diag);
+}
 
-    tb->line = 1;
+/* ------------------------------------------------------------------
+ * tokenizeLines
+ * tokenizeWith with line numbers counted from 'firstLine'.
+ * ------------------------------------------------------------------ */
+tokenStream tokenizeLines(FILE *src, int firstLine, trie keywords, diagBuffer diag) {
+    tokenStream ts = (tokenStream)memAlloc(MEM_BUFFER, sizeof(TOKEN_STREAM));
+    ts->cap   = 1024;
+    ts->count = 0;
+    ts->toks  = (TOKEN *)memAlloc(MEM_BUFFER, ts->cap * sizeof(TOKEN));
 
-    /* Bootstrap: fill second half first, then first half */
-    tb->pos = CHUNK_SIZE;           /* pretend we're in second half */
-    populate_buffer(tb, src);       /* fills first half */
-    tb->pos = 0;                    /* now in first half */
-    populate_buffer(tb, src);       /* fills second half */
+    twinBuffer tb = createTwinBuffer(src);
+    initializeLookupTable();
+    tb->line     = firstLine;
+    tb->keywords = keywords;
+    tb->diag     = diag;
+
+    for (;;) {
+        tokenInfo tok = nextToken(tb, src);
+
+        if (ts->count == ts->cap) {
+            ts->cap *= 2;
+            ts->toks = (TOKEN *)memRealloc(MEM_BUFFER, ts->toks, ts->cap * sizeof(TOKEN));
+        }
+        ts->toks[ts->count++] = *tok;
+
+        bool last = (tok->type == DOLLAR);
+        memFree(tok);
+        if (last)
+            break;
+    }
+
+    memFree(tb);
+    return ts;
+}
+
+/* ------------------------------------------------------------------
+ * freeTokenStream
+ * Release the array itself.  Lexemes are left alone because parse
+ * tree leaves built from the stream keep pointing at them.
+ * ------------------------------------------------------------------ */
+void freeTokenStream(tokenStream ts) {
+    if (ts == NULL)
+        return;
+    memFree(ts->toks);
+    memFree(ts);
+}
+
+/* ------------------------------------------------------------------
+ * getStream
+ * Tokenise the entire source file and print each token to stdout.
+ * ------------------------------------------------------------------ */
+void getStream(FILE *src) {
+    twinBuffer tb = createTwinBuffer(src);
 
     initializeLookupTable();
 
@@ -642,7 +788,7 @@ void getStream(FILE *src) {
                 tok->type != NEWLINE     &&
                 tok->type != EXIT_TOKEN  &&
                 tok->type != BLANK) {
-                if (handle_valid_error(tok)) {
+                if (handle_valid_error(tb, tok)) {
                     printf("Line no. %d  Lexeme %-20s  Token %s\n",
                            tok->line, tok->lexeme, getTokenName(tok->type));
                 }
@@ -659,7 +805,7 @@ void getStream(FILE *src) {
         }
     }
 
-    free(tb);
+    memFree(tb);
 }
 
 /* ------------------------------------------------------------------
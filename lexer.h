@@ -1,7 +1,9 @@
 #ifndef LEXER_HEADER
 #define LEXER_HEADER
 
+#include "diag.h"
 #include "lexerDef.h"
+#include "trie.h"
 #include <stdio.h>
 
 /* Print all tokens from the source file to stdout */
@@ -22,10 +24,41 @@ char *getTokenName(TOKEN_TYPE kind);
 /* Fill the inactive half of the twin buffer from the file */
 void populate_buffer(twinBuffer tb, FILE *src);
 
+/* Allocate a twin buffer and prime both halves from the file */
+twinBuffer createTwinBuffer(FILE *src);
+
+/* Lex the whole file into a token array ending with a DOLLAR token */
+tokenStream tokenizeSource(FILE *src);
+
+/*
+ * Same, with the keyword table and the sink for lexical errors given
+ * explicitly (NULL = shared table / this thread's default sink)
+ */
+tokenStream tokenizeWith(FILE *src, trie keywords, diagBuffer diag);
+
+/*
+ * tokenizeWith for a slice of a larger file that starts at line
+ * 'firstLine'.  No token spans a line break, so lexing whole lines on
+ * their own gives the same tokens as lexing the file.
+ */
+tokenStream tokenizeLines(FILE *src, int firstLine, trie keywords, diagBuffer diag);
+
+/* Free a token array (lexemes are not freed) */
+void freeTokenStream(tokenStream ts);
+
 /* Build the keyword trie used for identifier classification */
 void initializeLookupTable(void);
 
+/* The shared keyword trie (built on first use, read-only afterwards) */
+trie keywordTable(void);
+
+/*
+ * Route lexical errors raised on this thread into 'd' (NULL = stdout),
+ * for twin buffers that do not name a sink of their own
+ */
+void setLexerDiagnostics(diagBuffer d);
+
 /* Check identifier length constraints; free and return false if violated */
-bool handle_valid_error(tokenInfo tok);
+bool handle_valid_error(twinBuffer tb, tokenInfo tok);
 
 #endif /* LEXER_HEADER */
@@ -8,6 +8,12 @@
 #define NUM_STATES 64
 #define NUM_TOKENS 63
 
+/*
+ * Bump whenever the tokens produced for some input change (DFA, keyword
+ * set, lexeme or error text); cached token streams are keyed on it.
+ */
+#define LEXER_VERSION 1
+
 /* All characters that the language alphabet recognises */
 static const char lang_alphabet[] = {
     'a', 'b', 'c', 'd',  'e',  'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm',
@@ -120,13 +126,33 @@ typedef struct TRANS_RESULT {
     int        errCode;   /* 0 = no error */
 } TRANS_RESULT;
 
-/* The two-half circular input buffer */
+struct TrieNode;
+struct DIAG_BUFFER;
+
+/*
+ * The two-half circular input buffer, plus the per-compilation lexer
+ * state: the keyword table, where lexical errors go and how many there
+ * have been.  NULL for keywords or diag means the shared keyword table
+ * / this thread's default sink (see setLexerDiagnostics).
+ */
 typedef struct TWIN_BUFFER {
-    char buf[2 * CHUNK_SIZE];
-    int  pos;   /* current read head */
-    int  line;  /* current source line number */
+    char                buf[2 * CHUNK_SIZE];
+    int                 pos;        /* current read head */
+    int                 line;       /* current source line number */
+    struct TrieNode    *keywords;
+    struct DIAG_BUFFER *diag;
+    int                 errors;     /* lexical errors reported so far */
 } TWIN_BUFFER;
 
 typedef TWIN_BUFFER *twinBuffer;
 
+/* A whole file lexed up front; toks[count - 1] is always DOLLAR */
+typedef struct TOKEN_STREAM {
+    TOKEN *toks;
+    int    count;
+    int    cap;
+} TOKEN_STREAM;
+
+typedef TOKEN_STREAM *tokenStream;
+
 #endif /* LEXER_DEF_HEADER */
@@ -0,0 +1,78 @@
+/*
+ * ll1gen — check a grammar file and write its LL(1) tables.
+ *
+ *     ./ll1gen [grammar.bnf [grammar.ll1]]
+ *     ./ll1gen -d > grammar.bnf
+ *
+ * The first form reads the grammar file, reports every malformed rule
+ * and every LL(1) conflict (non-terminal, token and both competing
+ * rules), and writes the binary tables the driver maps at startup.
+ * The driver regenerates a stale blob by itself; this is the same step
+ * run ahead of time, and the place to see conflicts.  '-d' prints the
+ * grammar built into the binary (initializeGrammar()) in file form.
+ */
+#include "grammarTable.h"
+#include "parser.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char *argv[]) {
+    if (argc == 2 && strcmp(argv[1], "-d") == 0) {
+        Grammar G = initializeGrammar();
+        printf("# Grammar of the language, one block per non-terminal.\n"
+               "#   <name> ===> symbols...   first rule for <name>\n"
+               "#          | symbols...      further rules, in table order\n"
+               "#   TK_xxx is a token, 'eps' the empty rule, '#' starts a comment.\n"
+               "# Check with ./ll1gen; the driver rebuilds grammar.ll1 on change.\n\n");
+        printGrammarFile(&G, stdout);
+        return 0;
+    }
+    if (argc > 3 || (argc > 1 && argv[1][0] == '-')) {
+        fprintf(stderr, "Usage: %s [grammar_file [table_file]]\n"
+                        "       %s -d\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    const char *bnfPath  = (argc > 1) ? argv[1] : GRAMMAR_FILE;
+    const char *blobPath = (argc > 2) ? argv[2] : GRAMMAR_BLOB;
+
+    size_t len;
+    char  *text = readGrammarText(bnfPath, &len);
+    if (!text) { perror(bnfPath); return 1; }
+
+    diagBuffer  diag = createDiagBuffer();
+    Grammar    *G    = (Grammar *)calloc(1, sizeof(Grammar));
+    ParseTable *PT   = (ParseTable *)calloc(1, sizeof(ParseTable));
+
+    int status = 0;
+    if (!readGrammarFile(text, len, G, diag)) {
+        status = 1;
+    } else {
+        int conflicts = buildLL1Table(G, PT, diag);
+        if (conflicts > 0) {
+            diagPrintf(diag, "%d LL(1) conflict(s)\n", conflicts);
+            status = 1;
+        }
+    }
+    diagFlush(diag, stderr);
+
+    if (status == 0) {
+        if (!writeGrammarBlob(blobPath, G, PT, hashGrammarSource(text, len))) {
+            perror(blobPath);
+            status = 1;
+        } else {
+            int rules = 0;
+            for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++)
+                rules += G->prod_count[nt] + (G->has_eps[nt] ? 1 : 0);
+            printf("%s: %d non-terminals, %d rules, LL(1) — wrote %s\n",
+                   bnfPath, NON_TERMINAL_COUNT, rules, blobPath);
+        }
+    }
+
+    freeDiagBuffer(diag);
+    free(PT);
+    free(G);
+    free(text);
+    return status;
+}
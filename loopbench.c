@@ -0,0 +1,188 @@
+/*
+ * loopbench — interpreted run time of loop-heavy programs with the loop
+ * passes and the inliner on and off.
+ *
+ *     ./loopbench [--kernels=N] [--iters=N] [--seed=N] [--runs=N] [--dump] [source_file]
+ *
+ * Without a file a program of N kernels (default 32) is generated: each
+ * is a while loop over an int counter, or a nest of two, that computes
+ * a loop-invariant expression, multiplies the counter by a constant,
+ * keeps a record field in step with the counter, reads a global, or
+ * calls a small function that calls another, and main calls every
+ * kernel with --iters iterations (default 20000) and writes what it
+ * returns.  The random grammar walks srcgen produces are neither type
+ * correct nor sure to stop, so they do not serve here.
+ * --dump prints the generated program instead.
+ *
+ * The program is checked, then lowered and run through the interpreter
+ * at -O0, -O2 (no loop passes), -O3 without its inline step and -O3;
+ * each run must write the same values as -O0.  Reports, per level, the
+ * static instruction count, instructions executed, and the median run
+ * time over --runs runs (default 3), then what -O3 inlined.
+ */
+#include "ast.h"
+#include "bench.h"
+#include "grammarTable.h"
+#include "ir.h"
+#include "irInterp.h"
+#include "irOpt.h"
+#include "kernelGen.h"
+#include "pool.h"
+#include "symbolTable.h"
+#include "typeChecker.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ---- runs ---- */
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [--kernels=N] [--iters=N] [--seed=N] [--runs=N] [--dump] [source_file]\n",
+            prog);
+}
+
+static bool intOption(const char *a, const char *name, long lo, long hi, long *v) {
+    size_t n = strlen(name);
+    char  *end;
+    if (strncmp(a, name, n) != 0)
+        return false;
+    *v = strtol(a + n, &end, 10);
+    return end != a + n && *end == '\0' && *v >= lo && *v <= hi;
+}
+
+int main(int argc, char *argv[]) {
+    const char *srcPath = NULL;
+    long        kernels = 32, iters = 20000, seed = 1, runs = 3;
+    bool        dump    = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        if (intOption(a, "--kernels=", 1, 1 << 20, &kernels) ||
+            intOption(a, "--iters=", 0, 1 << 30, &iters) ||
+            intOption(a, "--seed=", 0, 1L << 62, &seed) || intOption(a, "--runs=", 1, 1000, &runs))
+            ;
+        else if (strcmp(a, "--dump") == 0)
+            dump = true;
+        else if (a[0] != '-' && srcPath == NULL)
+            srcPath = a;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    KernelOptions gen = {(int)kernels, (int)iters, (uint64_t)seed, 0};
+    if (dump) {
+        generateKernels(stdout, &gen);
+        return 0;
+    }
+
+    diagBuffer    gdiag = createDiagBuffer();
+    grammarTables T     = loadGrammarTables(GRAMMAR_FILE, GRAMMAR_BLOB, gdiag);
+    diagFlush(gdiag, stderr);
+    freeDiagBuffer(gdiag);
+    if (T == NULL)
+        return 1;
+
+    FILE *src = srcPath ? fopen(srcPath, "r") : tmpfile();
+    if (src == NULL) {
+        perror(srcPath ? srcPath : "tmpfile");
+        freeGrammarTables(T);
+        return 1;
+    }
+    if (srcPath == NULL) {
+        generateKernels(src, &gen);
+        rewind(src);
+    }
+    astArena   arena;
+    diagBuffer pdiag = createDiagBuffer();
+    AstNode   *ast   = parseSourceAST(T->pt, T->g, src, &arena, pdiag);
+    fclose(src);
+    diagFlush(pdiag, stderr);
+    freeDiagBuffer(pdiag);
+    if (ast == NULL) {
+        fprintf(stderr, "%s: no AST (syntax errors)\n", srcPath ? srcPath : "generated program");
+        freeGrammarTables(T);
+        return 1;
+    }
+
+    /* only a program the checker passes has a meaning to compare */
+    diagBuffer  diag = createDiagBuffer();
+    symbolTable st   = buildSymbolTable(ast, diag);
+    checkProgram(st, ast, poolDefaultThreads(), diag);
+    int status = 0;
+    if (diag->len > 0) {
+        diagFlush(diag, stderr);
+        status = 1;
+    }
+
+    /* -O3 less its inline step sits between -O2 and -O3 */
+    static const int   LEVELS[] = { 0, 2, 3, 3 };
+    static const char *NAMES[]  = { "-O0", "-O2", "-O3 no inline", "-O3" };
+    enum { NLEVELS = sizeof LEVELS / sizeof LEVELS[0] };
+    benchReport   r = createBenchReport(srcPath ? srcPath : "generated", (int)runs);
+    uint64_t      ns[NLEVELS], steps[NLEVELS], checksum0 = 0;
+    long          insts[NLEVELS];
+    IR_PASS_STATS stats[IR_MAX_PIPELINE];
+
+    for (int l = 0; l < NLEVELS && status == 0; l++) {
+        const char *name = NAMES[l];
+        int         ph   = benchPhase(r, name);
+        IR_PIPELINE p;
+        irModule    ir = lowerProgram(st, ast);
+        irPipelineForLevel(LEVELS[l], &p);
+        if (l == 2) {
+            int n = 0;
+            for (int i = 0; i < p.n; i++)
+                if (p.pass[i] != IR_PASS_INLINE)
+                    p.pass[n++] = p.pass[i];
+            p.n = n;
+        }
+        irOptimize(ir, &p, stats);
+        insts[l] = irLiveInsts(ir);
+
+        for (int run = 0; run < runs && status == 0; run++) {
+            IR_RUN        x  = { .seed = 1 };
+            uint64_t      t0 = benchNow();
+            IR_RUN_STATUS rs = irRun(ir, &x);
+            benchRecord(r, ph, benchNow() - t0);
+            if (rs != IR_RUN_OK) {
+                fprintf(stderr, "%s: run failed at line %d: %s\n", name, x.line,
+                        irRunStatusText(rs));
+                status = 1;
+            } else if (l > 0 && x.checksum != checksum0) {
+                fprintf(stderr, "%s: writes differ from -O0\n", name);
+                status = 1;
+            }
+            if (l == 0)
+                checksum0 = x.checksum;
+            steps[l] = x.steps;
+        }
+        ns[l] = benchMedian(r, ph);
+        freeIrModule(ir);
+    }
+
+    if (status == 0) {
+        printf("%s: %ld kernels, %ld iterations each\n", r->source, srcPath ? 0 : kernels,
+               srcPath ? 0 : iters);
+        printf("%-14s %12s %14s %12s %10s %10s\n", "level", "static", "executed", "ms",
+               "vs -O0", "vs -O2");
+        for (int l = 0; l < NLEVELS; l++)
+            printf("%-14s %12ld %14llu %12.3f %9.2fx %9.2fx\n", NAMES[l], insts[l],
+                   (unsigned long long)steps[l], ns[l] / 1e6, (double)ns[0] / ns[l],
+                   (double)ns[1] / ns[l]);
+        /* stats[] is still -O3's, whose first step inlines */
+        printf("\ninline: %d of %d calls, %ld -> %ld instructions (%+.1f%%); "
+               "%+.1f%% executed against -O3 no inline\n",
+               stats[0].inlined, stats[0].calls, stats[0].before, stats[0].after,
+               stats[0].before ? 100.0 * (stats[0].after - stats[0].before) / stats[0].before
+                               : 0.0,
+               steps[2] ? 100.0 * ((double)steps[3] - (double)steps[2]) / steps[2] : 0.0);
+    }
+
+    freeBenchReport(r);
+    freeDiagBuffer(diag);
+    freeSymbolTable(st);
+    freeAstArena(arena);
+    freeGrammarTables(T);
+    return status;
+}
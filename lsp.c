@@ -0,0 +1,882 @@
+#include "lsp.h"
+#include "diag.h"
+#include "json.h"
+#include "lexer.h"
+#include "memTrack.h"
+#include "parser.h"
+#include "pool.h"
+#include "trie.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* Fewer functions than this to parse are not worth starting the pool for */
+#define LSP_PARALLEL_MIN 8
+
+/* LSP SymbolKind.Function */
+#define SYMBOL_FUNCTION 12
+
+/* ---- documents ---- */
+
+typedef struct {
+    int   line;         /* as recorded; the region's shift is added on output */
+    int   seq;          /* arrival order, to keep sorting stable */
+    char *message;
+} LspDiag;
+
+/*
+ * A span of whole lines.  Normally it holds one or more complete
+ * functions, each with its own subtree.  A span whose tokens do not
+ * split into whole functions (a function being typed, an 'end'
+ * deleted) is kept 'loose': it is parsed as one <otherFunctions>, or
+ * as <program> when it runs to the end of the document, so its errors
+ * stay within it.  The regions of a document tile its lines in order.
+ */
+typedef struct {
+    int             firstLine;  /* 1-based, inclusive, current numbering */
+    int             lastLine;
+    int             shift;      /* lines moved since it was lexed */
+    bool            dirty;      /* lines changed; tokens and trees are gone */
+    bool            loose;
+    NON_TERMINAL    start;      /* what a loose region was parsed as */
+    tokenStream     toks;       /* owned with their lexemes, DOLLAR-terminated */
+    int            *begin;      /* function k is toks[begin[k] .. begin[k + 1]) */
+    int             nFuncs;
+    ParseTreeNode **trees;      /* one per function, or one if loose; NULL until parsed */
+    LspDiag        *diags;
+    int             nDiags;
+    int             diagCap;
+} Region;
+
+typedef struct {
+    char          *uri;
+    long           version;
+    char          *text;
+    size_t         len;
+    size_t         cap;
+    size_t        *lineStart;   /* lineStart[i] is where line i + 1 begins */
+    int            nLines;
+    int            lineCap;
+    Region        *regions;
+    int            nRegions;
+    int            regionCap;
+    bool           needFull;    /* regions no longer describe the text */
+    ParseTreeNode *program;
+    bool           joined;      /* program came from joinFunctionTrees */
+} Document;
+
+typedef struct {
+    const Grammar    *g;
+    const ParseTable *pt;
+    trie              keywords;
+    FILE             *out;
+    FILE             *record;
+    Document        **docs;
+    int               nDocs;
+    int               docCap;
+    bool              shutdown;
+} LspServer;
+
+/* Rebuild the line index from line 'from' (1-based) on; earlier lines are unchanged */
+static void indexLines(Document *d, int from) {
+    if (d->lineStart == NULL) {
+        d->lineCap   = 1024;
+        d->lineStart = (size_t *)malloc(d->lineCap * sizeof(size_t));
+    }
+    if (from < 1 || from > d->nLines)
+        from = 1;
+    d->lineStart[0] = 0;
+
+    int    n   = from;
+    size_t pos = d->lineStart[from - 1];
+    const char *nl;
+    while (pos < d->len && (nl = memchr(d->text + pos, '\n', d->len - pos)) != NULL) {
+        if (n == d->lineCap) {
+            d->lineCap  *= 2;
+            d->lineStart = (size_t *)realloc(d->lineStart, d->lineCap * sizeof(size_t));
+        }
+        pos = (size_t)(nl - d->text) + 1;
+        d->lineStart[n++] = pos;
+    }
+    d->nLines = n;
+}
+
+static size_t lineEnd(const Document *d, int line) {
+    return line < d->nLines ? d->lineStart[line] - 1 : d->len;
+}
+
+static void addDiag(Region *r, int line, const char *msg, size_t len) {
+    if (r->nDiags == r->diagCap) {
+        r->diagCap = r->diagCap ? r->diagCap * 2 : 8;
+        r->diags   = (LspDiag *)realloc(r->diags, r->diagCap * sizeof(LspDiag));
+    }
+    LspDiag *dg = &r->diags[r->nDiags];
+    dg->line    = line;
+    dg->seq     = r->nDiags++;
+    dg->message = strndup(msg, len);
+}
+
+static int cmpDiag(const void *a, const void *b) {
+    const LspDiag *x = (const LspDiag *)a, *y = (const LspDiag *)b;
+    if (x->line != y->line)
+        return x->line < y->line ? -1 : 1;
+    return x->seq - y->seq;
+}
+
+/*
+ * Hand each line of diagnostic text to the region holding the line it
+ * names ("Line 07: ..."); messages without one go to 'fallbackLine'.
+ */
+static void distributeDiags(Region *regs, int n, const char *text, int fallbackLine) {
+    while (*text != '\0') {
+        size_t len = strcspn(text, "\n");
+        int    line, skip = 0;
+        if (sscanf(text, "Line %d: %n", &line, &skip) != 1 || skip == 0 || (size_t)skip > len) {
+            line = fallbackLine;
+            skip = 0;
+        }
+
+        int k = 0;
+        while (k < n - 1 && regs[k].lastLine < line)
+            k++;
+        if (len > (size_t)skip)
+            addDiag(&regs[k], line, text + skip, len - (size_t)skip);
+
+        text += len + (text[len] == '\n');
+    }
+}
+
+static int treeCount(const Region *r) {
+    return r->loose ? 1 : r->nFuncs;
+}
+
+static void clearTrees(Region *r) {
+    if (r->trees != NULL)
+        for (int k = 0; k < treeCount(r); k++)
+            freeParseTree(r->trees[k]);
+    free(r->trees);
+    r->trees = NULL;
+}
+
+static void clearRegion(Region *r) {
+    clearTrees(r);
+    if (r->toks != NULL) {
+        for (int i = 0; i < r->toks->count; i++)
+            memFree(r->toks->toks[i].lexeme);
+        freeTokenStream(r->toks);
+    }
+    memFree(r->begin);
+    for (int i = 0; i < r->nDiags; i++)
+        free(r->diags[i].message);
+    free(r->diags);
+
+    int first = r->firstLine, last = r->lastLine;
+    memset(r, 0, sizeof(*r));
+    r->firstLine = first;
+    r->lastLine  = last;
+}
+
+/* Replace regions[i .. j] by 'n' regions from 'repl' */
+static void spliceRegions(Document *d, int i, int j, const Region *repl, int n) {
+    int total = d->nRegions - (j - i + 1) + n;
+    if (total > d->regionCap) {
+        d->regionCap = total * 2;
+        d->regions   = (Region *)realloc(d->regions, d->regionCap * sizeof(Region));
+    }
+    memmove(&d->regions[i + n], &d->regions[j + 1], (d->nRegions - j - 1) * sizeof(Region));
+    memcpy(&d->regions[i], repl, n * sizeof(Region));
+    d->nRegions = total;
+}
+
+static void unjoin(Document *d) {
+    if (d->joined)
+        freeFunctionJoin(d->program);
+    d->program = NULL;
+    d->joined  = false;
+}
+
+static void freeRegions(Document *d) {
+    unjoin(d);
+    for (int i = 0; i < d->nRegions; i++)
+        clearRegion(&d->regions[i]);
+    d->nRegions = 0;
+}
+
+/* ---- lexing and parsing ---- */
+
+/* Lex lines first .. last of the document */
+static tokenStream lexLines(LspServer *s, Document *d, int first, int last, diagBuffer diag) {
+    size_t from = d->lineStart[first - 1];
+    size_t to   = last < d->nLines ? d->lineStart[last] : d->len;
+    FILE  *src  = to > from ? fmemopen(d->text + from, to - from, "r") : fopen("/dev/null", "r");
+    if (src == NULL)
+        return NULL;
+    tokenStream ts = tokenizeLines(src, first, s->keywords, diag);
+    fclose(src);
+    return ts;
+}
+
+/*
+ * Lex lines first .. last and cut them into regions: one per function,
+ * except that functions sharing a line share a region.  The first
+ * region starts at 'first' and the last ends at 'last', so gaps of
+ * comments and blank lines belong to a neighbour.  Lines that are not
+ * a run of whole functions become a single loose region.  No region
+ * at all (*nOut == 0) means the lines hold no tokens.  Nothing is
+ * parsed yet.
+ */
+static void buildRegions(LspServer *s, Document *d, int first, int last,
+                         Region **out, int *nOut) {
+    diagBuffer  lexDiag = createDiagBuffer();
+    tokenStream ts      = lexLines(s, d, first, last, lexDiag);
+    int        *begin   = NULL;
+    int         nSegs   = splitFunctions(ts->toks, ts->count - 1, &begin);
+    bool        all     = first == 1 && last == d->nLines;
+
+    if (nSegs < 0 || (nSegs == 0 && all)) {
+        Region *r    = (Region *)calloc(1, sizeof(Region));
+        r->firstLine = first;
+        r->lastLine  = last;
+        r->loose     = true;
+        r->toks      = ts;
+        distributeDiags(r, 1, lexDiag->text, last);
+        if (nSegs == 0)
+            memFree(begin);
+        freeDiagBuffer(lexDiag);
+        *out  = r;
+        *nOut = 1;
+        return;
+    }
+
+    Region *regs  = (Region *)calloc(nSegs > 0 ? nSegs : 1, sizeof(Region));
+    int     n     = 0;
+    int     start = first;
+    for (int k = 0; k < nSegs;) {
+        int k0      = k;
+        int endLine = ts->toks[begin[k + 1] - 1].line;
+        while (k + 1 < nSegs && ts->toks[begin[k + 1]].line <= endLine) {
+            k++;
+            endLine = ts->toks[begin[k + 1] - 1].line;
+        }
+        k++;
+
+        Region *r    = &regs[n++];
+        r->firstLine = start;
+        r->lastLine  = (k == nSegs) ? last : endLine;
+        r->nFuncs    = k - k0;
+        start        = r->lastLine + 1;
+
+        int count      = begin[k] - begin[k0];
+        r->toks        = (tokenStream)memAlloc(MEM_BUFFER, sizeof(TOKEN_STREAM));
+        r->toks->count = count + 1;
+        r->toks->cap   = count + 1;
+        r->toks->toks  = (TOKEN *)memAlloc(MEM_BUFFER, (count + 1) * sizeof(TOKEN));
+        memcpy(r->toks->toks, &ts->toks[begin[k0]], count * sizeof(TOKEN));
+        r->toks->toks[count] = (TOKEN){ .type = DOLLAR, .lexeme = NULL, .lexemeSize = 0,
+                                        .line = endLine };
+
+        r->begin = (int *)memAlloc(MEM_PARSER, (r->nFuncs + 1) * sizeof(int));
+        for (int f = 0; f <= r->nFuncs; f++)
+            r->begin[f] = begin[k0 + f] - begin[k0];
+    }
+    if (n > 0)
+        distributeDiags(regs, n, lexDiag->text, last);
+
+    /* the lexemes now belong to the regions; the DOLLAR has none */
+    freeTokenStream(ts);
+    memFree(begin);
+    freeDiagBuffer(lexDiag);
+    *out  = regs;
+    *nOut = n;
+}
+
+static bool hasMain(const Region *r) {
+    if (r->loose) {
+        for (int i = 0; i < r->toks->count; i++)
+            if (r->toks->toks[i].type == TK_MAIN)
+                return true;
+        return false;
+    }
+    for (int k = 0; k < r->nFuncs; k++)
+        if (r->toks->toks[r->begin[k]].type == TK_MAIN)
+            return true;
+    return false;
+}
+
+/*
+ * _main only in the last region, and there as the last function unless
+ * that region is loose (it is then parsed as <program>, which reports
+ * a missing or misplaced _main as a plain compile would).
+ */
+static bool programShape(const Document *d) {
+    if (d->nRegions == 0)
+        return false;
+    for (int i = 0; i < d->nRegions - 1; i++)
+        if (hasMain(&d->regions[i]))
+            return false;
+
+    const Region *r = &d->regions[d->nRegions - 1];
+    return r->loose ||
+           (r->nFuncs > 0 && r->toks->toks[r->begin[r->nFuncs - 1]].type == TK_MAIN);
+}
+
+typedef struct {
+    Region      *r;
+    int          tree;
+    int          begin;
+    int          end;
+    NON_TERMINAL start;
+    diagBuffer   diag;
+    bool         hadError;
+} ParseJob;
+
+typedef struct {
+    LspServer *s;
+    ParseJob  *jobs;
+} ParseJobs;
+
+static void parseJobTask(int i, void *arg) {
+    ParseJobs *pj  = (ParseJobs *)arg;
+    ParseJob  *job = &pj->jobs[i];
+
+    job->diag = createDiagBuffer();
+    job->r->trees[job->tree] = parseTokenRange(pj->s->pt, pj->s->g, job->r->toks->toks,
+                                               job->begin, job->end, job->start, job->diag,
+                                               &job->hadError);
+}
+
+/*
+ * Parse every region that has no trees yet: each function on its own,
+ * a loose region as a whole.  A loose region that has become, or
+ * stopped being, the last one is parsed again as the other symbol.
+ */
+static void parsePending(LspServer *s, Document *d) {
+    for (int i = 0; i < d->nRegions; i++) {
+        Region      *r     = &d->regions[i];
+        NON_TERMINAL start = (i == d->nRegions - 1) ? NT_PROGRAM : NT_OTHERFUNCTIONS;
+        if (r->loose && r->trees != NULL && r->start != start) {
+            clearTrees(r);
+            /* keep the lexical errors, drop those of the old parse */
+            int keep = 0;
+            for (int k = 0; k < r->nDiags; k++) {
+                if (r->diags[k].seq < 0)
+                    r->diags[keep++] = r->diags[k];
+                else
+                    free(r->diags[k].message);
+            }
+            r->nDiags = keep;
+        }
+        r->start = start;
+    }
+
+    int nJobs = 0;
+    for (int i = 0; i < d->nRegions; i++)
+        if (d->regions[i].trees == NULL)
+            nJobs += treeCount(&d->regions[i]);
+
+    ParseJob *jobs = (ParseJob *)calloc(nJobs > 0 ? nJobs : 1, sizeof(ParseJob));
+    int       n    = 0;
+    for (int i = 0; i < d->nRegions; i++) {
+        Region *r = &d->regions[i];
+        if (r->trees != NULL)
+            continue;
+
+        /* lexical errors are marked so a loose region can keep them */
+        for (int k = 0; k < r->nDiags; k++)
+            r->diags[k].seq = k - r->nDiags;
+        r->trees = (ParseTreeNode **)calloc(treeCount(r), sizeof(ParseTreeNode *));
+        if (r->loose) {
+            jobs[n++] = (ParseJob){ r, 0, 0, r->toks->count - 1, r->start, NULL, false };
+            continue;
+        }
+        for (int k = 0; k < r->nFuncs; k++) {
+            bool isMain = r->toks->toks[r->begin[k]].type == TK_MAIN;
+            jobs[n++] = (ParseJob){ r, k, r->begin[k], r->begin[k + 1],
+                                    isMain ? NT_MAINFUNCTION : NT_FUNCTION, NULL, false };
+        }
+    }
+
+    ParseJobs pj = { s, jobs };
+    if (nJobs >= LSP_PARALLEL_MIN)
+        runPool(nJobs, poolDefaultThreads(), parseJobTask, &pj);
+    else
+        for (int i = 0; i < nJobs; i++)
+            parseJobTask(i, &pj);
+
+    /* errors without a line number belong to the end of what was parsed */
+    for (int i = 0; i < nJobs; i++) {
+        Region *r    = jobs[i].r;
+        int     last = jobs[i].end > 0 ? r->toks->toks[jobs[i].end - 1].line : r->lastLine;
+        distributeDiags(r, 1, jobs[i].diag->text, last);
+        freeDiagBuffer(jobs[i].diag);
+        if (jobs[i].tree == treeCount(r) - 1)
+            qsort(r->diags, r->nDiags, sizeof(LspDiag), cmpDiag);
+    }
+    free(jobs);
+}
+
+/*
+ * The program tree: joined from the function subtrees when every region
+ * is whole functions, the loose region's own tree when it is the only
+ * region, and none otherwise.
+ */
+static void joinProgram(Document *d) {
+    int n = 0;
+    for (int i = 0; i < d->nRegions; i++) {
+        if (d->regions[i].loose) {
+            if (d->nRegions == 1)
+                d->program = d->regions[0].trees[0];
+            return;
+        }
+        n += d->regions[i].nFuncs;
+    }
+
+    ParseTreeNode **roots = (ParseTreeNode **)malloc(n * sizeof(ParseTreeNode *));
+    n = 0;
+    for (int i = 0; i < d->nRegions; i++)
+        for (int k = 0; k < d->regions[i].nFuncs; k++)
+            roots[n++] = d->regions[i].trees[k];
+    d->program = joinFunctionTrees(roots, n);
+    d->joined  = true;
+    free(roots);
+}
+
+/* Lex the whole text again and split it afresh */
+static void rebuildAll(LspServer *s, Document *d) {
+    freeRegions(d);
+    d->needFull = false;
+
+    Region *regs;
+    int     n;
+    buildRegions(s, d, 1, d->nLines, &regs, &n);
+    spliceRegions(d, 0, -1, regs, n);
+    free(regs);
+
+    if (!programShape(d)) {
+        /* _main missing or misplaced: one loose region, parsed as a plain compile would */
+        freeRegions(d);
+        Region whole = { .firstLine = 1, .lastLine = d->nLines, .dirty = true };
+        spliceRegions(d, 0, -1, &whole, 1);
+        diagBuffer lexDiag = createDiagBuffer();
+        Region *r = &d->regions[0];
+        r->dirty  = false;
+        r->loose  = true;
+        r->toks   = lexLines(s, d, 1, d->nLines, lexDiag);
+        distributeDiags(r, 1, lexDiag->text, d->nLines);
+        freeDiagBuffer(lexDiag);
+    }
+    parsePending(s, d);
+    joinProgram(d);
+}
+
+/*
+ * Bring the regions up to date with the text: lex the dirty spans
+ * again and parse only what is in them.
+ */
+static void updateDocument(LspServer *s, Document *d) {
+    if (d->needFull || d->nRegions == 0) {
+        rebuildAll(s, d);
+        return;
+    }
+    unjoin(d);
+
+    for (int i = 0; i < d->nRegions; i++) {
+        if (!d->regions[i].dirty)
+            continue;
+        int j = i;
+        while (j + 1 < d->nRegions && d->regions[j + 1].dirty)
+            j++;
+
+        Region *regs;
+        int     n;
+        buildRegions(s, d, d->regions[i].firstLine, d->regions[j].lastLine, &regs, &n);
+        if (n == 0) {
+            /* only comments and blank lines left: take in a neighbour and retry */
+            free(regs);
+            int nb = (i > 0) ? i - 1 : j + 1;
+            clearRegion(&d->regions[nb]);
+            d->regions[nb].dirty = true;
+            i = ((nb < i) ? nb : i) - 1;
+            continue;
+        }
+        spliceRegions(d, i, j, regs, n);
+        free(regs);
+        i += n - 1;
+    }
+
+    if (!programShape(d)) {
+        rebuildAll(s, d);
+        return;
+    }
+    parsePending(s, d);
+    joinProgram(d);
+}
+
+/*
+ * Replace old lines startLine0 .. endLine0 (0-based, as the protocol
+ * counts) from the given columns with 'text', and mark the regions
+ * covering them dirty; regions below move by the change in line count.
+ */
+static void applyEdit(Document *d, long startLine0, long startCh, long endLine0, long endCh,
+                      const char *text, size_t n) {
+    if (startLine0 < 0) startLine0 = 0;
+    if (endLine0 < 0)   endLine0   = 0;
+
+    /* positions past the end of a line or of the text are clamped to it */
+    int    a    = (int)(startLine0 < d->nLines ? startLine0 + 1 : d->nLines);
+    int    b    = (int)(endLine0 < d->nLines ? endLine0 + 1 : d->nLines);
+    size_t from = (startLine0 < d->nLines) ? d->lineStart[a - 1] : d->len;
+    size_t to   = (endLine0 < d->nLines) ? d->lineStart[b - 1] : d->len;
+    if (startLine0 < d->nLines && startCh > 0)
+        from += (size_t)startCh < lineEnd(d, a) - from ? (size_t)startCh : lineEnd(d, a) - from;
+    if (endLine0 < d->nLines && endCh > 0)
+        to += (size_t)endCh < lineEnd(d, b) - to ? (size_t)endCh : lineEnd(d, b) - to;
+    if (to < from) {
+        size_t t = from; from = to; to = t;
+        int    l = a;    a = b;       b = l;
+    }
+
+    int added = 0;
+    for (size_t i = 0; i < n; i++)
+        added += text[i] == '\n';
+    int delta = added - (b - a);
+
+    size_t newLen = d->len - (to - from) + n;
+    if (newLen + 1 > d->cap) {
+        d->cap  = (newLen + 1) * 2;
+        d->text = (char *)realloc(d->text, d->cap);
+    }
+    memmove(d->text + from + n, d->text + to, d->len - to);
+    memcpy(d->text + from, text, n);
+    d->len = newLen;
+    d->text[d->len] = '\0';
+    indexLines(d, a);
+
+    if (d->needFull || d->nRegions == 0)
+        return;
+
+    int i = 0;
+    while (i < d->nRegions - 1 && d->regions[i].lastLine < a)
+        i++;
+    int j = i;
+    while (j + 1 < d->nRegions && d->regions[j + 1].firstLine <= b)
+        j++;
+
+    Region merged = { 0 };
+    merged.firstLine = d->regions[i].firstLine;
+    merged.lastLine  = d->regions[j].lastLine + delta;
+    merged.dirty     = true;
+    for (int k = i; k <= j; k++)
+        clearRegion(&d->regions[k]);
+    spliceRegions(d, i, j, &merged, 1);
+
+    for (int k = i + 1; k < d->nRegions; k++) {
+        d->regions[k].firstLine += delta;
+        d->regions[k].lastLine  += delta;
+        d->regions[k].shift     += delta;
+    }
+    if (d->regions[d->nRegions - 1].lastLine != d->nLines || merged.lastLine < merged.firstLine)
+        d->needFull = true;
+}
+
+static void freeDocument(Document *d) {
+    freeRegions(d);
+    free(d->regions);
+    free(d->lineStart);
+    free(d->text);
+    free(d->uri);
+    free(d);
+}
+
+static Document *findDocument(LspServer *s, const char *uri) {
+    for (int i = 0; uri != NULL && i < s->nDocs; i++)
+        if (strcmp(s->docs[i]->uri, uri) == 0)
+            return s->docs[i];
+    return NULL;
+}
+
+/* ---- protocol ---- */
+
+static void sendMessage(LspServer *s, diagBuffer body) {
+    fprintf(s->out, "Content-Length: %d\r\n\r\n", body->len);
+    fwrite(body->text, 1, body->len, s->out);
+    fflush(s->out);
+}
+
+static void writeRange(diagBuffer b, int line0, int startCh, int endLine0, int endCh) {
+    diagPrintf(b, "{\"start\":{\"line\":%d,\"character\":%d},"
+                  "\"end\":{\"line\":%d,\"character\":%d}}",
+               line0, startCh, endLine0, endCh);
+}
+
+static void publishDiagnostics(LspServer *s, const char *uri, Document *d) {
+    diagBuffer b = createDiagBuffer();
+    diagPrintf(b, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\","
+                  "\"params\":{\"uri\":");
+    jsonWriteString(b, uri, strlen(uri));
+    if (d != NULL)
+        diagPrintf(b, ",\"version\":%ld", d->version);
+    diagPrintf(b, ",\"diagnostics\":[");
+
+    bool first = true;
+    for (int i = 0; d != NULL && i < d->nRegions; i++) {
+        const Region *r = &d->regions[i];
+        for (int k = 0; k < r->nDiags; k++) {
+            int line = r->diags[k].line + r->shift;
+            if (line < 1)
+                line = 1;
+            if (line > d->nLines)
+                line = d->nLines;
+            int width = (int)(lineEnd(d, line) - d->lineStart[line - 1]);
+
+            diagPrintf(b, "%s{\"range\":", first ? "" : ",");
+            writeRange(b, line - 1, 0, line - 1, width);
+            diagPrintf(b, ",\"severity\":1,\"source\":\"stage1\",\"message\":");
+            jsonWriteString(b, r->diags[k].message, strlen(r->diags[k].message));
+            diagPrintf(b, "}");
+            first = false;
+        }
+    }
+    diagPrintf(b, "]}}");
+    sendMessage(s, b);
+    freeDiagBuffer(b);
+}
+
+static void replyStart(diagBuffer b, const JSON_VALUE *id) {
+    diagPrintf(b, "{\"jsonrpc\":\"2.0\",\"id\":");
+    if (id != NULL)
+        jsonWriteValue(b, id);
+    else
+        diagPrintf(b, "null");
+}
+
+static void replyError(LspServer *s, const JSON_VALUE *id, int code, const char *msg) {
+    diagBuffer b = createDiagBuffer();
+    replyStart(b, id);
+    diagPrintf(b, ",\"error\":{\"code\":%d,\"message\":", code);
+    jsonWriteString(b, msg, strlen(msg));
+    diagPrintf(b, "}}");
+    sendMessage(s, b);
+    freeDiagBuffer(b);
+}
+
+static void replyResult(LspServer *s, const JSON_VALUE *id, const char *result) {
+    diagBuffer b = createDiagBuffer();
+    replyStart(b, id);
+    diagPrintf(b, ",\"result\":%s}", result);
+    sendMessage(s, b);
+    freeDiagBuffer(b);
+}
+
+static void didOpen(LspServer *s, const JSON_VALUE *params) {
+    const char       *uri  = jsonString(params, "textDocument.uri");
+    const JSON_VALUE *text = jsonPath(params, "textDocument.text");
+    if (uri == NULL || text == NULL || text->type != JSON_STRING)
+        return;
+
+    Document *d = findDocument(s, uri);
+    if (d == NULL) {
+        if (s->nDocs == s->docCap) {
+            s->docCap = s->docCap ? s->docCap * 2 : 8;
+            s->docs   = (Document **)realloc(s->docs, s->docCap * sizeof(Document *));
+        }
+        d = (Document *)calloc(1, sizeof(Document));
+        d->uri = strdup(uri);
+        s->docs[s->nDocs++] = d;
+    }
+    d->version = jsonInt(params, "textDocument.version", 0);
+    d->cap     = text->strLen + 1;
+    d->text    = (char *)realloc(d->text, d->cap);
+    memcpy(d->text, text->str, text->strLen + 1);
+    d->len      = text->strLen;
+    d->needFull = true;
+    indexLines(d, 1);
+
+    updateDocument(s, d);
+    publishDiagnostics(s, uri, d);
+}
+
+static void didChange(LspServer *s, const JSON_VALUE *params) {
+    const char *uri = jsonString(params, "textDocument.uri");
+    Document   *d   = findDocument(s, uri);
+    const JSON_VALUE *changes = jsonGet(params, "contentChanges");
+    if (d == NULL || changes == NULL || changes->type != JSON_ARRAY)
+        return;
+
+    for (int i = 0; i < changes->count; i++) {
+        const JSON_VALUE *c     = &changes->items[i];
+        const JSON_VALUE *text  = jsonGet(c, "text");
+        const JSON_VALUE *range = jsonGet(c, "range");
+        if (text == NULL || text->type != JSON_STRING)
+            continue;
+        if (range == NULL) {
+            applyEdit(d, 0, 0, d->nLines, 0, text->str, text->strLen);
+            d->needFull = true;
+        } else {
+            applyEdit(d, jsonInt(range, "start.line", 0), jsonInt(range, "start.character", 0),
+                      jsonInt(range, "end.line", 0), jsonInt(range, "end.character", 0),
+                      text->str, text->strLen);
+        }
+    }
+    d->version = jsonInt(params, "textDocument.version", d->version + 1);
+
+    updateDocument(s, d);
+    publishDiagnostics(s, uri, d);
+}
+
+static void didClose(LspServer *s, const JSON_VALUE *params) {
+    const char *uri = jsonString(params, "textDocument.uri");
+    for (int i = 0; uri != NULL && i < s->nDocs; i++) {
+        if (strcmp(s->docs[i]->uri, uri) != 0)
+            continue;
+        freeDocument(s->docs[i]);
+        s->docs[i] = s->docs[--s->nDocs];
+        publishDiagnostics(s, uri, NULL);
+        return;
+    }
+}
+
+static void documentSymbols(LspServer *s, const JSON_VALUE *id, const JSON_VALUE *params) {
+    Document *d = findDocument(s, jsonString(params, "textDocument.uri"));
+    diagBuffer b = createDiagBuffer();
+    diagPrintf(b, "[");
+
+    bool first = true;
+    for (int i = 0; d != NULL && i < d->nRegions; i++) {
+        const Region *r = &d->regions[i];
+        for (int k = 0; k < r->nFuncs; k++) {
+            const TOKEN *head = &r->toks->toks[r->begin[k]];
+            const TOKEN *tail = &r->toks->toks[r->begin[k + 1] - 1];
+            int          l0   = head->line + r->shift - 1;
+            int          l1   = tail->line + r->shift - 1;
+
+            diagPrintf(b, "%s{\"name\":", first ? "" : ",");
+            jsonWriteString(b, head->lexeme, strlen(head->lexeme));
+            diagPrintf(b, ",\"kind\":%d,\"range\":", SYMBOL_FUNCTION);
+            writeRange(b, l0, 0, l1, (int)(lineEnd(d, l1 + 1) - d->lineStart[l1]));
+            diagPrintf(b, ",\"selectionRange\":");
+            writeRange(b, l0, 0, l0, (int)(lineEnd(d, l0 + 1) - d->lineStart[l0]));
+            diagPrintf(b, "}");
+            first = false;
+        }
+    }
+    diagPrintf(b, "]");
+    replyResult(s, id, b->text);
+    freeDiagBuffer(b);
+}
+
+/* Returns the exit status once 'exit' arrives, -1 to go on */
+static int handleMessage(LspServer *s, const JSON_VALUE *msg) {
+    const char       *method = jsonString(msg, "method");
+    const JSON_VALUE *id     = jsonGet(msg, "id");
+    const JSON_VALUE *params = jsonGet(msg, "params");
+
+    if (method == NULL) {
+        if (id != NULL)
+            replyError(s, id, -32600, "Invalid request");
+        return -1;
+    }
+
+    if (strcmp(method, "initialize") == 0)
+        replyResult(s, id, "{\"capabilities\":{\"textDocumentSync\":"
+                           "{\"openClose\":true,\"change\":2},"
+                           "\"documentSymbolProvider\":true},"
+                           "\"serverInfo\":{\"name\":\"stage1exe\"}}");
+    else if (strcmp(method, "shutdown") == 0) {
+        s->shutdown = true;
+        replyResult(s, id, "null");
+    } else if (strcmp(method, "exit") == 0)
+        return s->shutdown ? 0 : 1;
+    else if (strcmp(method, "textDocument/didOpen") == 0)
+        didOpen(s, params);
+    else if (strcmp(method, "textDocument/didChange") == 0)
+        didChange(s, params);
+    else if (strcmp(method, "textDocument/didClose") == 0)
+        didClose(s, params);
+    else if (strcmp(method, "textDocument/documentSymbol") == 0 && id != NULL)
+        documentSymbols(s, id, params);
+    else if (id != NULL)
+        replyError(s, id, -32601, "Method not found");
+    return -1;
+}
+
+/* One framed message body (malloc'd), or NULL at end of input */
+static char *readMessage(FILE *in, size_t *len) {
+    char line[1024];
+    for (;;) {
+        long length = -1;
+        bool any    = false;
+        while (fgets(line, sizeof line, in) != NULL) {
+            if (line[0] == '\r' || line[0] == '\n') {
+                if (any)
+                    break;
+                continue;
+            }
+            any = true;
+            if (strncasecmp(line, "Content-Length:", 15) == 0)
+                length = strtol(line + 15, NULL, 10);
+        }
+        if (!any)
+            return NULL;
+        if (length < 0)
+            continue;
+
+        char *body = (char *)malloc((size_t)length + 1);
+        if (fread(body, 1, (size_t)length, in) != (size_t)length) {
+            free(body);
+            return NULL;
+        }
+        body[length] = '\0';
+        *len = (size_t)length;
+        return body;
+    }
+}
+
+/* ------------------------------------------------------------------
+ * runLanguageServer
+ * ------------------------------------------------------------------ */
+int runLanguageServer(FILE *in, FILE *out, const Grammar *g, const ParseTable *pt,
+                      const char *recordPath) {
+    LspServer s = { 0 };
+    s.g        = g;
+    s.pt       = pt;
+    s.keywords = keywordTable();
+    s.out      = out;
+    if (recordPath != NULL && (s.record = fopen(recordPath, "w")) == NULL) {
+        perror(recordPath);
+        return 1;
+    }
+
+    int    status = 1;      /* end of input without 'exit' */
+    size_t len;
+    char  *body;
+    while ((body = readMessage(in, &len)) != NULL) {
+        jsonValue msg = parseJson(body, len);
+        free(body);
+        if (msg == NULL) {
+            replyError(&s, NULL, -32700, "Parse error");
+            continue;
+        }
+        if (s.record != NULL) {
+            diagBuffer line = createDiagBuffer();
+            jsonWriteValue(line, msg);
+            fprintf(s.record, "%s\n", line->text);
+            fflush(s.record);
+            freeDiagBuffer(line);
+        }
+
+        int done = handleMessage(&s, msg);
+        freeJson(msg);
+        if (done >= 0) {
+            status = done;
+            break;
+        }
+    }
+
+    for (int i = 0; i < s.nDocs; i++)
+        freeDocument(s.docs[i]);
+    free(s.docs);
+    if (s.record != NULL)
+        fclose(s.record);
+    return status;
+}
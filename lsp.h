@@ -0,0 +1,37 @@
+#ifndef LSP_H
+#define LSP_H
+
+#include "parserDef.h"
+#include <stdio.h>
+
+/*
+ * Language server over stdio (Language Server Protocol, JSON-RPC with
+ * Content-Length framing).  Supports opening, changing (full or
+ * incremental) and closing documents, publishes lexical and syntax
+ * errors after every change, and lists a document's functions.
+ *
+ * A document is kept as a run of regions, each a span of whole lines
+ * holding one or more complete function definitions.  An edit marks
+ * the regions it touches; only those lines are lexed again and only
+ * their functions parsed again, while every other region keeps its
+ * tokens, subtrees and diagnostics and is just renumbered.  The
+ * program tree is then rejoined from the function subtrees under
+ * <otherFunctions>.  Lines that are not whole functions (one being
+ * typed, say) form a loose region parsed as a single <otherFunctions>,
+ * so their errors stay local; when _main is missing or misplaced the
+ * whole document is parsed as one piece, as a compile would.
+ *
+ * Positions are taken as byte offsets within a line: the language is
+ * ASCII, where those equal the protocol's UTF-16 units.
+ */
+
+/*
+ * Serve requests from 'in' until 'exit'.  Every message received is
+ * also appended, one JSON object per line, to 'recordPath' if given;
+ * lspreplay can play such a file back.  Returns the exit status (0 if
+ * 'shutdown' came before 'exit').
+ */
+int runLanguageServer(FILE *in, FILE *out, const Grammar *g, const ParseTable *pt,
+                      const char *recordPath);
+
+#endif /* LSP_H */
@@ -0,0 +1,608 @@
+/*
+ * lspreplay — play a recorded editing session against the language
+ * server (stage1exe --lsp) and time it.
+ *
+ *     ./lspreplay [--exe=PATH] [--budget=MS] [--verify] [--json] SESSION
+ *     ./lspreplay --synth=SOURCE [--edits=N] [--seed=N] SESSION
+ *
+ * A session is what --lsp --record=FILE writes: one JSON-RPC message
+ * per line.  Each is sent in turn; a request waits for its response,
+ * didOpen / didChange for the diagnostics published for that version.
+ * The time from sending to that answer is the latency, reported per
+ * kind (open, change, request) as min / median / p99 / max.  The exit
+ * status is 1 if any change took longer than --budget (default 50 ms)
+ * or the server misbehaved.
+ *
+ * --verify also follows the edits here, opens the final text once more
+ * under a new uri before the session shuts down, and checks that a
+ * parse from scratch reports exactly what the edits led to.  That holds
+ * whenever the final text is a run of whole functions; where it is not,
+ * the edited document keeps errors local to the broken lines and may
+ * legitimately report less or more than a whole-file parse.
+ *
+ * --synth writes a session instead: SOURCE is opened and then edited
+ * the way someone typing would, one character per change — a comment
+ * typed at the end of a line and rubbed out, a line broken in two and
+ * joined again, a statement typed at the start of a line and deleted —
+ * until at least N changes (default 500) have been made.  Each edit is
+ * undone before the next begins, so the session ends on SOURCE.
+ */
+#include "bench.h"
+#include "diag.h"
+#include "json.h"
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+#define DEFAULT_BUDGET_MS 50
+#define DEFAULT_EDITS     500
+
+static char *readFile(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return NULL;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    char *buf = (char *)malloc((size > 0 ? (size_t)size : 0) + 1);
+    *len = fread(buf, 1, (size_t)(size > 0 ? size : 0), fp);
+    buf[*len] = '\0';
+    fclose(fp);
+    return buf;
+}
+
+/* ---- documents as the client sees them ---- */
+
+typedef struct {
+    char  *uri;
+    char  *text;
+    size_t len;
+    char  *diags;       /* last "diagnostics" array published, as JSON */
+} ClientDoc;
+
+typedef struct {
+    ClientDoc *docs;
+    int        n;
+    int        cap;
+} DocTable;
+
+static ClientDoc *findDoc(DocTable *t, const char *uri, bool create) {
+    for (int i = 0; i < t->n; i++)
+        if (strcmp(t->docs[i].uri, uri) == 0)
+            return &t->docs[i];
+    if (!create)
+        return NULL;
+    if (t->n == t->cap) {
+        t->cap  = t->cap ? t->cap * 2 : 4;
+        t->docs = (ClientDoc *)realloc(t->docs, t->cap * sizeof(ClientDoc));
+    }
+    ClientDoc *d = &t->docs[t->n++];
+    memset(d, 0, sizeof(*d));
+    d->uri = strdup(uri);
+    return d;
+}
+
+static void freeDocs(DocTable *t) {
+    for (int i = 0; i < t->n; i++) {
+        free(t->docs[i].uri);
+        free(t->docs[i].text);
+        free(t->docs[i].diags);
+    }
+    free(t->docs);
+}
+
+/* Byte offset of (line, character), clamped as the server clamps it */
+static size_t textOffset(const char *text, size_t len, long line, long ch) {
+    size_t pos = 0;
+    for (long l = 0; l < line; l++) {
+        const char *nl = memchr(text + pos, '\n', len - pos);
+        if (nl == NULL)
+            return len;
+        pos = (size_t)(nl - text) + 1;
+    }
+    const char *nl  = memchr(text + pos, '\n', len - pos);
+    size_t      eol = nl ? (size_t)(nl - text) : len;
+    return (ch > 0 && (size_t)ch < eol - pos) ? pos + (size_t)ch : (ch > 0 ? eol : pos);
+}
+
+/* Replace text[from .. to) by 's' */
+static void spliceText(char **text, size_t *len, size_t from, size_t to, const char *s,
+                       size_t n) {
+    if (to < from) {
+        size_t t = from; from = to; to = t;
+    }
+    size_t newLen = *len - (to - from) + n;
+    char  *buf    = (char *)malloc(newLen + 1);
+    memcpy(buf, *text, from);
+    memcpy(buf + from, s, n);
+    memcpy(buf + from + n, *text + to, *len - to);
+    buf[newLen] = '\0';
+    free(*text);
+    *text = buf;
+    *len  = newLen;
+}
+
+static void applyChanges(ClientDoc *d, const JSON_VALUE *changes) {
+    for (int i = 0; changes != NULL && i < changes->count; i++) {
+        const JSON_VALUE *c     = &changes->items[i];
+        const JSON_VALUE *text  = jsonGet(c, "text");
+        const JSON_VALUE *range = jsonGet(c, "range");
+        if (text == NULL || text->type != JSON_STRING)
+            continue;
+        size_t from = 0, to = d->len;
+        if (range != NULL) {
+            from = textOffset(d->text, d->len, jsonInt(range, "start.line", 0),
+                              jsonInt(range, "start.character", 0));
+            to   = textOffset(d->text, d->len, jsonInt(range, "end.line", 0),
+                              jsonInt(range, "end.character", 0));
+        }
+        spliceText(&d->text, &d->len, from, to, text->str, text->strLen);
+    }
+}
+
+/* ---- talking to the server ---- */
+
+typedef struct {
+    pid_t pid;
+    FILE *in;       /* the server's stdin */
+    FILE *out;      /* the server's stdout */
+} Server;
+
+static bool startServer(Server *s, const char *exe) {
+    int toSrv[2], fromSrv[2];
+    if (pipe(toSrv) != 0)
+        return false;
+    if (pipe(fromSrv) != 0) {
+        close(toSrv[0]);
+        close(toSrv[1]);
+        return false;
+    }
+
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_adddup2(&fa, toSrv[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&fa, fromSrv[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&fa, toSrv[1]);
+    posix_spawn_file_actions_addclose(&fa, fromSrv[0]);
+
+    char *argv[] = { (char *)exe, (char *)"--lsp", NULL };
+    int   rc     = posix_spawn(&s->pid, exe, &fa, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    close(toSrv[0]);
+    close(fromSrv[1]);
+    if (rc != 0) {
+        close(toSrv[1]);
+        close(fromSrv[0]);
+        return false;
+    }
+    s->in  = fdopen(toSrv[1], "w");
+    s->out = fdopen(fromSrv[0], "r");
+    return true;
+}
+
+/* Close the server's input and collect its exit status */
+static int stopServer(Server *s) {
+    fclose(s->in);
+    fclose(s->out);
+    int status;
+    if (waitpid(s->pid, &status, 0) != s->pid || !WIFEXITED(status))
+        return -1;
+    return WEXITSTATUS(status);
+}
+
+static bool sendMessage(Server *s, const char *body, size_t len) {
+    fprintf(s->in, "Content-Length: %zu\r\n\r\n", len);
+    fwrite(body, 1, len, s->in);
+    return fflush(s->in) == 0;
+}
+
+/* Next framed message from the server, or NULL if it has gone */
+static jsonValue readMessage(Server *s) {
+    char line[1024];
+    long length = -1;
+    bool any    = false;
+    while (fgets(line, sizeof line, s->out) != NULL) {
+        if (line[0] == '\r' || line[0] == '\n') {
+            if (any)
+                break;
+            continue;
+        }
+        any = true;
+        if (strncasecmp(line, "Content-Length:", 15) == 0)
+            length = strtol(line + 15, NULL, 10);
+    }
+    if (length < 0)
+        return NULL;
+
+    char *body = (char *)malloc((size_t)length + 1);
+    if (fread(body, 1, (size_t)length, s->out) != (size_t)length) {
+        free(body);
+        return NULL;
+    }
+    jsonValue v = parseJson(body, (size_t)length);
+    free(body);
+    return v;
+}
+
+static char *valueText(const JSON_VALUE *v) {
+    diagBuffer b = createDiagBuffer();
+    jsonWriteValue(b, v);
+    char *s = strdup(b->text);
+    freeDiagBuffer(b);
+    return s;
+}
+
+/*
+ * Read until the response to request 'id' arrives ('id' as JSON text),
+ * or with id NULL until diagnostics for 'uri' at 'version' do.  Every
+ * publication on the way is kept in 'docs'.
+ */
+static bool awaitAnswer(Server *s, DocTable *docs, const char *id, const char *uri,
+                        long version) {
+    for (;;) {
+        jsonValue msg = readMessage(s);
+        if (msg == NULL)
+            return false;
+
+        bool done = false;
+        const JSON_VALUE *msgId  = jsonGet(msg, "id");
+        const char       *method = jsonString(msg, "method");
+        if (id != NULL && msgId != NULL && method == NULL) {
+            char *text = valueText(msgId);
+            done = strcmp(text, id) == 0;
+            free(text);
+        } else if (method != NULL && strcmp(method, "textDocument/publishDiagnostics") == 0) {
+            const char *from = jsonString(msg, "params.uri");
+            ClientDoc  *d    = from ? findDoc(docs, from, true) : NULL;
+            if (d != NULL) {
+                free(d->diags);
+                d->diags = valueText(jsonPath(msg, "params.diagnostics"));
+            }
+            done = id == NULL && from != NULL && strcmp(from, uri) == 0 &&
+                   jsonInt(msg, "params.version", -1) == version;
+        }
+        freeJson(msg);
+        if (done)
+            return true;
+    }
+}
+
+/* ---- replay ---- */
+
+/* Open every document once more as it now stands and compare */
+static int verifyDocs(Server *s, DocTable *docs) {
+    int mismatches = 0;
+    for (int i = 0, n = docs->n; i < n; i++) {
+        if (docs->docs[i].text == NULL)
+            continue;
+        diagBuffer uri = createDiagBuffer();
+        diagPrintf(uri, "%s#verify", docs->docs[i].uri);
+
+        diagBuffer b = createDiagBuffer();
+        diagPrintf(b, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didOpen\","
+                      "\"params\":{\"textDocument\":{\"uri\":");
+        jsonWriteString(b, uri->text, (size_t)uri->len);
+        diagPrintf(b, ",\"languageId\":\"stage1\",\"version\":0,\"text\":");
+        jsonWriteString(b, docs->docs[i].text, docs->docs[i].len);
+        diagPrintf(b, "}}}");
+
+        bool ok = sendMessage(s, b->text, (size_t)b->len) &&
+                  awaitAnswer(s, docs, NULL, uri->text, 0);
+        ClientDoc *fresh = ok ? findDoc(docs, uri->text, false) : NULL;
+        ClientDoc *d     = &docs->docs[i];   /* the table may have moved */
+        if (fresh == NULL || d->diags == NULL || strcmp(fresh->diags, d->diags) != 0) {
+            fprintf(stderr, "verify: %s: diagnostics after the edits differ from a fresh "
+                            "parse\n  edited: %s\n  fresh:  %s\n",
+                    d->uri, d->diags ? d->diags : "(none)",
+                    fresh && fresh->diags ? fresh->diags : "(none)");
+            mismatches++;
+        } else {
+            printf("verify: %s: ok\n", d->uri);
+        }
+        freeDiagBuffer(b);
+        freeDiagBuffer(uri);
+        if (!ok)
+            return mismatches + 1;
+    }
+    return mismatches;
+}
+
+static int replay(const char *exe, const char *sessionPath, double budgetMs, bool verify,
+                  bool json) {
+    size_t len;
+    char  *session = readFile(sessionPath, &len);
+    if (session == NULL) { perror(sessionPath); return 1; }
+
+    int nLines = 0;
+    for (size_t i = 0; i < len; i++)
+        nLines += session[i] == '\n';
+
+    Server srv;
+    if (!startServer(&srv, exe)) {
+        fprintf(stderr, "%s: could not run\n", exe);
+        free(session);
+        return 1;
+    }
+
+    benchReport rep      = createBenchReport(sessionPath, nLines + 1);
+    int         phOpen   = benchPhase(rep, "open");
+    int         phChange = benchPhase(rep, "change");
+    int         phReq    = benchPhase(rep, "request");
+    DocTable    docs     = { 0 };
+    uint64_t    worst    = 0, budget = (uint64_t)(budgetMs * 1e6);
+    int         over     = 0, failed = 0;
+    bool        verified = !verify;
+
+    for (char *line = session, *next; *line != '\0' && !failed; line = next) {
+        next = line + strcspn(line, "\n");
+        if (*next == '\n')
+            *next++ = '\0';
+        jsonValue msg = parseJson(line, strlen(line));
+        if (msg == NULL)
+            continue;
+
+        const char       *method = jsonString(msg, "method");
+        const JSON_VALUE *id     = jsonGet(msg, "id");
+        const char       *uri    = jsonString(msg, "params.textDocument.uri");
+        long              ver    = jsonInt(msg, "params.textDocument.version", 0);
+        bool isOpen   = method && strcmp(method, "textDocument/didOpen") == 0;
+        bool isChange = method && strcmp(method, "textDocument/didChange") == 0;
+
+        if (!verified && method &&
+            (strcmp(method, "shutdown") == 0 || strcmp(method, "exit") == 0)) {
+            failed  |= verifyDocs(&srv, &docs) != 0;
+            verified = true;
+        }
+        if (verify && uri != NULL && (isOpen || isChange)) {
+            ClientDoc *d = findDoc(&docs, uri, true);
+            if (isOpen) {
+                const JSON_VALUE *text = jsonPath(msg, "params.textDocument.text");
+                free(d->text);
+                d->text = text && text->type == JSON_STRING ? strndup(text->str, text->strLen)
+                                                            : strdup("");
+                d->len  = strlen(d->text);
+            } else if (d->text != NULL) {
+                applyChanges(d, jsonGet(jsonGet(msg, "params"), "contentChanges"));
+            }
+        }
+
+        uint64_t t0 = benchNow();
+        bool     ok = sendMessage(&srv, line, strlen(line));
+        if (ok && id != NULL && method != NULL) {
+            char *idText = valueText(id);
+            ok = awaitAnswer(&srv, &docs, idText, NULL, 0);
+            free(idText);
+            benchRecord(rep, phReq, benchNow() - t0);
+        } else if (ok && uri != NULL && (isOpen || isChange)) {
+            ok = awaitAnswer(&srv, &docs, NULL, uri, ver);
+            uint64_t ns = benchNow() - t0;
+            benchRecord(rep, isOpen ? phOpen : phChange, ns);
+            if (isChange) {
+                worst = ns > worst ? ns : worst;
+                over += ns > budget;
+            }
+        }
+        if (!ok) {
+            fprintf(stderr, "%s: server stopped answering at '%.60s'\n", sessionPath, line);
+            failed = 1;
+        }
+        bool exitNow = method && strcmp(method, "exit") == 0;
+        freeJson(msg);
+        if (exitNow)
+            break;
+    }
+    if (!verified && !failed)
+        failed |= verifyDocs(&srv, &docs) != 0;
+
+    int status = stopServer(&srv);
+    if (status != 0 && !failed) {
+        fprintf(stderr, "%s: server exited with status %d\n", exe, status);
+        failed = 1;
+    }
+
+    printLatencyReport(rep, json, stdout);
+    if (!json)
+        printf("change: max %.3f ms, budget %.3f ms, %d over\n", worst / 1e6, budgetMs, over);
+
+    freeDocs(&docs);
+    freeBenchReport(rep);
+    free(session);
+    return failed || over > 0;
+}
+
+/* ---- synthetic sessions ---- */
+
+typedef struct {
+    FILE    *out;
+    char    *uri;
+    char    *text;
+    size_t   len;
+    long     version;
+    int      edits;
+    uint64_t rng;
+} Synth;
+
+static uint64_t nextRandom(Synth *s) {
+    s->rng ^= s->rng << 13;
+    s->rng ^= s->rng >> 7;
+    s->rng ^= s->rng << 17;
+    return s->rng;
+}
+
+static void emit(Synth *s, diagBuffer b) {
+    fprintf(s->out, "%s\n", b->text);
+    freeDiagBuffer(b);
+}
+
+/* One didChange replacing (line, from .. to) by 'text' (at most a few bytes) */
+static void change(Synth *s, long l0, long c0, long l1, long c1, const char *text) {
+    s->edits++;
+    s->version++;
+
+    diagBuffer b = createDiagBuffer();
+    diagPrintf(b, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didChange\","
+                  "\"params\":{\"textDocument\":{\"uri\":");
+    jsonWriteString(b, s->uri, strlen(s->uri));
+    diagPrintf(b, ",\"version\":%ld},\"contentChanges\":[{\"range\":"
+                  "{\"start\":{\"line\":%ld,\"character\":%ld},"
+                  "\"end\":{\"line\":%ld,\"character\":%ld}},\"text\":",
+               s->version, l0, c0, l1, c1);
+    jsonWriteString(b, text, strlen(text));
+    diagPrintf(b, "}]}}");
+    emit(s, b);
+
+    spliceText(&s->text, &s->len, textOffset(s->text, s->len, l0, c0),
+               textOffset(s->text, s->len, l1, c1), text, strlen(text));
+}
+
+/* Type 'word' one character at a time at (line, col), then delete it backwards */
+static void typeAndErase(Synth *s, long line, long col, const char *word) {
+    long n = (long)strlen(word);
+    for (long i = 0; i < n; i++) {
+        char c[2] = { word[i], '\0' };
+        change(s, line, col + i, line, col + i, c);
+    }
+    for (long i = n; i > 0; i--)
+        change(s, line, col + i - 1, line, col + i, "");
+}
+
+static int synthesize(const char *srcPath, const char *outPath, int edits, uint64_t seed) {
+    Synth s = { 0 };
+    s.text = readFile(srcPath, &s.len);
+    if (s.text == NULL) { perror(srcPath); return 1; }
+    s.out = fopen(outPath, "w");
+    if (s.out == NULL) { perror(outPath); free(s.text); return 1; }
+    s.rng   = seed * 0x9e3779b97f4a7c15ULL + 1;
+
+    diagBuffer uri = createDiagBuffer();
+    diagPrintf(uri, "file://%s", srcPath);
+    s.uri = uri->text;
+
+    diagBuffer b = createDiagBuffer();
+    diagPrintf(b, "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"initialize\","
+                  "\"params\":{\"processId\":null,\"capabilities\":{}}}");
+    emit(&s, b);
+    b = createDiagBuffer();
+    diagPrintf(b, "{\"jsonrpc\":\"2.0\",\"method\":\"initialized\",\"params\":{}}");
+    emit(&s, b);
+    b = createDiagBuffer();
+    diagPrintf(b, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didOpen\","
+                  "\"params\":{\"textDocument\":{\"uri\":");
+    jsonWriteString(b, s.uri, strlen(s.uri));
+    diagPrintf(b, ",\"languageId\":\"stage1\",\"version\":0,\"text\":");
+    jsonWriteString(b, s.text, s.len);
+    diagPrintf(b, "}}}");
+    emit(&s, b);
+
+    long nLines = 1;
+    for (size_t i = 0; i < s.len; i++)
+        nLines += s.text[i] == '\n';
+
+    /* every edit is undone before the next, so the session ends on SOURCE */
+    while (s.edits < edits) {
+        long   line = (long)(nextRandom(&s) % (uint64_t)nLines);
+        size_t bol  = textOffset(s.text, s.len, line, 0);
+        size_t eol  = textOffset(s.text, s.len, line, 1L << 30);
+        long   width = (long)(eol - bol);
+
+        switch (nextRandom(&s) % 3) {
+        case 0:
+            typeAndErase(&s, line, width, " % checking this");
+            break;
+        case 1: {
+            /* break at the first blank after the indentation, join it back */
+            long col = 0;
+            while (col < width && (s.text[bol + col] == ' ' || s.text[bol + col] == '\t'))
+                col++;
+            while (col < width && s.text[bol + col] != ' ' && s.text[bol + col] != '\t')
+                col++;
+            change(&s, line, col, line, col, "\n");
+            change(&s, line, col, line + 1, 0, "");
+            break;
+        }
+        default:
+            typeAndErase(&s, line, 0, "write(b2); ");
+            break;
+        }
+    }
+
+    b = createDiagBuffer();
+    diagPrintf(b, "{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"textDocument/documentSymbol\","
+                  "\"params\":{\"textDocument\":{\"uri\":");
+    jsonWriteString(b, s.uri, strlen(s.uri));
+    diagPrintf(b, "}}}");
+    emit(&s, b);
+    b = createDiagBuffer();
+    diagPrintf(b, "{\"jsonrpc\":\"2.0\",\"id\":3,\"method\":\"shutdown\"}");
+    emit(&s, b);
+    b = createDiagBuffer();
+    diagPrintf(b, "{\"jsonrpc\":\"2.0\",\"method\":\"exit\"}");
+    emit(&s, b);
+
+    printf("%s: %d change(s) to %s, %ld line(s)\n", outPath, s.edits, srcPath, nLines);
+    fclose(s.out);
+    freeDiagBuffer(uri);
+    free(s.text);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [--exe=PATH] [--budget=MS] [--verify] [--json] SESSION\n"
+            "       %s --synth=SOURCE [--edits=N] [--seed=N] SESSION\n", prog, prog);
+}
+
+int main(int argc, char *argv[]) {
+    const char *exe      = "./stage1exe";
+    const char *synthSrc = NULL;
+    const char *session  = NULL;
+    double      budgetMs = DEFAULT_BUDGET_MS;
+    int         edits    = DEFAULT_EDITS;
+    uint64_t    seed     = 1;
+    bool        verify   = false, json = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        char       *end = NULL;
+
+        if (strncmp(a, "--exe=", 6) == 0)
+            exe = a + 6;
+        else if (strncmp(a, "--budget=", 9) == 0) {
+            budgetMs = strtod(a + 9, &end);
+            if (*end != '\0' || budgetMs <= 0) { usage(argv[0]); return 1; }
+        } else if (strcmp(a, "--verify") == 0)
+            verify = true;
+        else if (strcmp(a, "--json") == 0)
+            json = true;
+        else if (strncmp(a, "--synth=", 8) == 0 && a[8] != '\0')
+            synthSrc = a + 8;
+        else if (strncmp(a, "--edits=", 8) == 0) {
+            edits = (int)strtol(a + 8, &end, 10);
+            if (*end != '\0' || edits < 0) { usage(argv[0]); return 1; }
+        } else if (strncmp(a, "--seed=", 7) == 0) {
+            seed = strtoull(a + 7, &end, 10);
+            if (*end != '\0') { usage(argv[0]); return 1; }
+        } else if (a[0] != '-' && session == NULL)
+            session = a;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (session == NULL) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (synthSrc != NULL)
+        return synthesize(synthSrc, session, edits, seed);
+    return replay(exe, session, budgetMs, verify, json);
+}
@@ -0,0 +1,151 @@
+#include "memTrack.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef MEM_ACCOUNTING
+
+static const char *const tagNames[MEM_TAG_COUNT] = {
+    "tokens", "lexemes", "symbols", "tree nodes", "trie", "buffers", "parser",
+};
+
+/* Sits in front of every block; the union keeps the payload aligned */
+typedef union {
+    struct {
+        size_t  size;
+        MEM_TAG tag;
+    } h;
+    max_align_t align;
+} MemHeader;
+
+typedef struct {
+    atomic_long allocs;
+    atomic_long frees;
+    atomic_long live;
+    atomic_long peak;
+} TagCounters;
+
+/* Zero-initialised statics are valid atomics */
+static TagCounters counters[MEM_TAG_COUNT];
+static TagCounters total;
+
+static void raisePeak(atomic_long *peak, long now) {
+    long old = atomic_load_explicit(peak, memory_order_relaxed);
+    while (now > old &&
+           !atomic_compare_exchange_weak_explicit(peak, &old, now, memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
+}
+
+static void charge(TagCounters *c, long delta) {
+    long now = atomic_fetch_add_explicit(&c->live, delta, memory_order_relaxed) + delta;
+    if (delta > 0)
+        raisePeak(&c->peak, now);
+}
+
+static void account(MEM_TAG tag, long delta) {
+    charge(&counters[tag], delta);
+    charge(&total, delta);
+}
+
+static void bump(MEM_TAG tag, bool isAlloc) {
+    if (isAlloc) {
+        atomic_fetch_add_explicit(&counters[tag].allocs, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&total.allocs, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&counters[tag].frees, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&total.frees, 1, memory_order_relaxed);
+    }
+}
+
+void *memAlloc(MEM_TAG tag, size_t size) {
+    MemHeader *hd = (MemHeader *)malloc(sizeof(MemHeader) + size);
+    if (hd == NULL)
+        return NULL;
+    hd->h.size = size;
+    hd->h.tag  = tag;
+    bump(tag, true);
+    account(tag, (long)size);
+    return hd + 1;
+}
+
+void *memCalloc(MEM_TAG tag, size_t n, size_t size) {
+    if (size != 0 && n > ((size_t)-1 - sizeof(MemHeader)) / size)
+        return NULL;
+    MemHeader *hd = (MemHeader *)calloc(1, sizeof(MemHeader) + n * size);
+    if (hd == NULL)
+        return NULL;
+    hd->h.size = n * size;
+    hd->h.tag  = tag;
+    bump(tag, true);
+    account(tag, (long)(n * size));
+    return hd + 1;
+}
+
+/* The block keeps the tag it was first allocated under */
+void *memRealloc(MEM_TAG tag, void *p, size_t size) {
+    if (p == NULL)
+        return memAlloc(tag, size);
+
+    MemHeader *old    = (MemHeader *)p - 1;
+    size_t     before = old->h.size;
+    MEM_TAG    owner  = old->h.tag;
+    MemHeader *hd     = (MemHeader *)realloc(old, sizeof(MemHeader) + size);
+    if (hd == NULL)
+        return NULL;
+    hd->h.size = size;
+    account(owner, (long)size - (long)before);
+    return hd + 1;
+}
+
+void memFree(void *p) {
+    if (p == NULL)
+        return;
+    MemHeader *hd = (MemHeader *)p - 1;
+    bump(hd->h.tag, false);
+    account(hd->h.tag, -(long)hd->h.size);
+    free(hd);
+}
+
+static MemTagStats snapshot(TagCounters *c) {
+    MemTagStats s;
+    s.allocs    = atomic_load_explicit(&c->allocs, memory_order_relaxed);
+    s.frees     = atomic_load_explicit(&c->frees, memory_order_relaxed);
+    s.liveBytes = atomic_load_explicit(&c->live, memory_order_relaxed);
+    s.peakBytes = atomic_load_explicit(&c->peak, memory_order_relaxed);
+    return s;
+}
+
+MemTagStats memTagStats(MEM_TAG tag) {
+    return snapshot(&counters[tag]);
+}
+
+void printMemReport(FILE *out) {
+    fprintf(out, "%-12s %10s %10s %12s %12s\n", "Memory", "allocs", "frees", "live bytes",
+            "peak bytes");
+    for (int t = 0; t < MEM_TAG_COUNT; t++) {
+        MemTagStats s = snapshot(&counters[t]);
+        fprintf(out, "%-12s %10ld %10ld %12ld %12ld\n", tagNames[t], s.allocs, s.frees,
+                s.liveBytes, s.peakBytes);
+    }
+    MemTagStats s = snapshot(&total);
+    fprintf(out, "%-12s %10ld %10ld %12ld %12ld\n", "total", s.allocs, s.frees, s.liveBytes,
+            s.peakBytes);
+}
+
+#else /* !MEM_ACCOUNTING */
+
+MemTagStats memTagStats(MEM_TAG tag) {
+    (void)tag;
+    return (MemTagStats){ 0, 0, 0, 0 };
+}
+
+void printMemReport(FILE *out) {
+    fprintf(out, "Memory accounting not compiled in (make MEMSTATS=1)\n");
+}
+
+#endif
+
+void memReportAtExit(void) {
+    printMemReport(stderr);
+}
@@ -0,0 +1,59 @@
+#ifndef MEM_TRACK_H
+#define MEM_TRACK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Tagged allocation layer for the lexer, trie and parser.  Every block
+ * is charged to the subsystem that asked for it.  With -DMEM_ACCOUNTING
+ * (`make MEMSTATS=1`) each block carries a small header that records
+ * its size and tag, and live bytes, peak bytes and allocation counts
+ * are kept per tag; otherwise the calls are plain malloc / free.
+ *
+ * A block from memAlloc / memCalloc / memRealloc must be released with
+ * memFree, never free.
+ */
+typedef enum {
+    MEM_TOKEN,      /* TOKEN structs handed out by the lexer */
+    MEM_LEXEME,     /* lexeme strings */
+    MEM_SYMBOL,     /* grammar symbols on the parse stack */
+    MEM_TREE,       /* parse tree nodes */
+    MEM_TRIE,       /* keyword trie nodes */
+    MEM_BUFFER,     /* twin buffers and token stream arrays */
+    MEM_PARSER,     /* parser stacks, segment tables, FIRST/FOLLOW scratch */
+    MEM_TAG_COUNT
+} MEM_TAG;
+
+typedef struct {
+    long allocs;
+    long frees;
+    long liveBytes;     /* requested bytes, header not included */
+    long peakBytes;
+} MemTagStats;
+
+#ifdef MEM_ACCOUNTING
+void *memAlloc(MEM_TAG tag, size_t size);
+void *memCalloc(MEM_TAG tag, size_t n, size_t size);
+void *memRealloc(MEM_TAG tag, void *p, size_t size);
+void  memFree(void *p);
+#else
+#define memAlloc(tag, size)      malloc(size)
+#define memCalloc(tag, n, size)  calloc(n, size)
+#define memRealloc(tag, p, size) realloc(p, size)
+#define memFree(p)               free(p)
+#endif
+
+/* Snapshot of one tag's counters (all zero when compiled out) */
+MemTagStats memTagStats(MEM_TAG tag);
+
+/*
+ * Table of every tag: allocations, frees, live and peak bytes, plus a
+ * total row.  Called at exit, the live column is what was never freed.
+ */
+void printMemReport(FILE *out);
+
+/* printMemReport(stderr), in the shape atexit() wants */
+void memReportAtExit(void);
+
+#endif /* MEM_TRACK_H */
@@ -1,10 +1,31 @@
 #include "lexer.h"
 #include "lexerDef.h"
 #include "parserDef.h"
+#include "diag.h"
+#include "memTrack.h"
+#include "pool.h"
+#include "stats.h"
+#include "tokenRing.h"
 #include "utils.h"
 #include <stdio.h>
 #include <stdlib.h>
 
+/* ------------------------------------------------------------------
+ * computeRecoverySets
+ *
+ * Fill pt->start and pt->recover from the finished table cells and
+ * each non-terminal's FOLLOW set.
+ * ------------------------------------------------------------------ */
+void computeRecoverySets(ParseTable *pt, const uint64_t follow[NON_TERMINAL_COUNT]) {
+    for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++) {
+        pt->start[nt] = 0;
+        for (int col = 0; col < NUM_TOKENS; col++)
+            if (pt->cell[nt][col] >= 0)
+                pt->start[nt] |= TOKEN_BIT(col);
+        pt->recover[nt] = pt->start[nt] | follow[nt] | TOKEN_BIT(DOLLAR);
+    }
+}
+
 /* ------------------------------------------------------------------
  * buildParseTable
  *
@@ -12,8 +33,11 @@
  *   -1  → error (no rule applies)
  *   -2  → synchronisation point (token is in FOLLOW but not FIRST)
  *   ≥0  → rule index to expand
+ * Also derive each non-terminal's panic-mode recovery set.
  * ------------------------------------------------------------------ */
 void buildParseTable(FirstFollow ff, ParseTable *pt) {
+    uint64_t follow[NON_TERMINAL_COUNT];
+
     /* Default all entries to error */
     for (int row = 0; row < NON_TERMINAL_COUNT; row++)
         for (int col = 0; col < NUM_TOKENS; col++)
@@ -36,7 +60,13 @@ void buildParseTable(FirstFollow ff, ParseTable *pt) {
                     pt->cell[nt][ff.follow[nt][k]] = -2;
             }
         }
+
+        follow[nt] = 0;
+        for (int k = 0; k < ff.follow_count[nt]; k++)
+            follow[nt] |= TOKEN_BIT(ff.follow[nt][k]);
     }
+
+    computeRecoverySets(pt, follow);
 }
 
 /* ------------------------------------------------------------------
@@ -59,7 +89,7 @@ FirstFollow computeFirstFollow(Grammar g) {
         ff.follow_rule[i]   = -1;
         firstDone[i]        = false;
         depLen[i]           = 0;
-        depList[i] = (NON_TERMINAL *)calloc(MAX_RHS_LEN, sizeof(NON_TERMINAL));
+        depList[i] = (NON_TERMINAL *)memCalloc(MEM_PARSER, MAX_RHS_LEN, sizeof(NON_TERMINAL));
     }
 
     /* Phase 1: FIRST sets */
@@ -81,7 +111,7 @@ FirstFollow computeFirstFollow(Grammar g) {
             clearDependency(i, depList, depLen, &ff);
 
     for (int i = 0; i < NON_TERMINAL_COUNT; i++)
-        free(depList[i]);
+        memFree(depList[i]);
 
     return ff;
 }
@@ -93,7 +123,8 @@ FirstFollow computeFirstFollow(Grammar g) {
  * grammar symbol and attach it to the given parent.
  * ------------------------------------------------------------------ */
 static ParseTreeNode *makeSymNode(GrammarSymbol sym, ParseTreeNode *par) {
-    ParseTreeNode *nd  = (ParseTreeNode *)malloc(sizeof(ParseTreeNode));
+    ParseTreeNode *nd  = (ParseTreeNode *)memAlloc(MEM_TREE, sizeof(ParseTreeNode));
+    STAT_INC(treeNodes);
     nd->data.sym       = sym;
     nd->data.line      = -1;
     nd->data.lexeme    = NULL;
@@ -103,38 +134,155 @@ static ParseTreeNode *makeSymNode(GrammarSymbol sym, ParseTreeNode *par) {
     return nd;
 }
 
+/*
+ * Where the driver loop pulls its lookahead from.  In streaming mode
+ * (toks == NULL, ring == NULL) tokens are lexed on demand and are
+ * heap-allocated; in array mode toks[pos .. end) are handed out in
+ * place; in pipelined mode tokens come in batches from a lexer thread.
+ * Array and pipelined modes return 'eof' once the input is exhausted,
+ * for as long as the parser keeps asking.  A streaming cursor with
+ * ownsLexemes set frees each token's lexeme along with the token, for
+ * consumers that keep nothing once a token has been reported.
+ */
+typedef struct {
+    twinBuffer  tb;
+    FILE       *src;
+    TOKEN      *toks;
+    int         pos;
+    int         end;
+    tokenRing   ring;
+    TokenBatch *batch;
+    bool        atEof;
+    TOKEN       eof;
+    bool        ownsLexemes;
+} TokenCursor;
+
+static tokenInfo cursorNext(TokenCursor *cur) {
+    if (cur->ring != NULL) {
+        if (cur->batch == NULL || cur->pos == cur->batch->count) {
+            if (cur->atEof)
+                return &cur->eof;
+            if (cur->batch != NULL)
+                ringRelease(cur->ring);
+            cur->batch = ringAcquire(cur->ring);
+            cur->pos   = 0;
+        }
+
+        int i = cur->pos++;
+        if (cur->batch->notes[i] != NULL) {
+            /* lexical errors raised while lexing this token */
+            fputs(cur->batch->notes[i], stdout);
+            free(cur->batch->notes[i]);
+            cur->batch->notes[i] = NULL;
+        }
+
+        tokenInfo tok = &cur->batch->toks[i];
+        if (tok->type == DOLLAR) {
+            cur->eof   = *tok;
+            cur->atEof = true;
+        }
+        return tok;
+    }
+
+    if (cur->toks == NULL)
+        return nextToken(cur->tb, cur->src);
+    if (cur->pos < cur->end)
+        return &cur->toks[cur->pos++];
+    return &cur->eof;
+}
+
+/* Drop a token the parser is done with; its lexeme goes too only if the cursor owns it */
+static void cursorRelease(TokenCursor *cur, tokenInfo tok) {
+    if (cur->toks == NULL && cur->ring == NULL) {
+        if (cur->ownsLexemes)
+            memFree(tok->lexeme);
+        memFree(tok);
+    }
+}
+
+/* Tokens that can be matched by, or start, grammar symbol 's' */
+static uint64_t symAccepts(const ParseTable *pt, GrammarSymbol s) {
+    return s.isTerminal ? TOKEN_BIT(s.sym.t) : pt->start[s.sym.nt];
+}
+
 /* ------------------------------------------------------------------
- * parseSourceCode
+ * skipUntil  (internal helper)
+ *
+ * Panic-mode scan: discard lookahead tokens until one is in 'stop'.
+ * Every stop set contains DOLLAR, so the scan always terminates, and
+ * each token costs one bit test — no table lookups while skipping.
+ * ------------------------------------------------------------------ */
+static tokenInfo skipUntil(TokenCursor *tc, tokenInfo la, uint64_t stop) {
+    while (!(stop & TOKEN_BIT(la->type))) {
+        STAT_INC(recoverySkips);
+        cursorRelease(tc, la);
+        la = cursorNext(tc);
+    }
+    return la;
+}
+
+static void reportMismatch(diagBuffer diag, tokenInfo la, TOKEN_TYPE expected) {
+    diagPrintf(diag,
+               "Line %02d: Syntax Error : Token %s (lexeme \"%s\") "
+               "does not match expected token %s\n",
+               la->line, getTokenName(la->type), la->lexeme,
+               getTokenName(expected));
+}
+
+static void reportUnexpected(diagBuffer diag, tokenInfo la, NON_TERMINAL nt, bool popping) {
+    diagPrintf(diag,
+               "Line %02d: Syntax Error : Unexpected token %s "
+               "(lexeme \"%s\") while expanding %s%s\n",
+               la->line, getTokenName(la->type), la->lexeme,
+               getNonTerminal(nt), popping ? " — popping" : "");
+}
+
+/* ------------------------------------------------------------------
+ * runParser  (internal helper)
  *
  * LL(1) table-driven parser.  Maintains a symbol stack and a parallel
  * tree-node stack so that the parse tree is built in one pass.
+ * Parsing starts from 'start' and stops when that symbol has been
+ * fully matched and only $ remains.  Errors are written to 'diag'.
+ *
+ * Error recovery is panic mode over precomputed token sets.  At most
+ * one error is reported per line; then the parser skips ahead, one bit
+ * test per token, to a stop token:
+ *   - for a non-terminal, anything in pt->recover[nt] (its start
+ *     tokens, FOLLOW and $) — it is expanded if the stop token starts
+ *     it and popped otherwise;
+ *   - for a terminal, the terminal itself or $ — it is matched, or
+ *     popped as missing.
+ * A statement delimiter (STMT_SYNC_SET) is also a stop token, and pops
+ * the symbol, when something lower on the stack can accept it; a stray
+ * delimiter nothing can use is skipped instead of unwinding the stack.
+ *
+ * Cost on adversarial input stays linear: each skipped token is
+ * consumed, each recovery ends in a pop or an expansion, pops never
+ * exceed pushes, and on one lookahead the number of expansions is
+ * bounded by the grammar (LL(1), no left recursion).
  * ------------------------------------------------------------------ */
-ParseTreeNode *parseSourceCode(ParseTable pt, FirstFollow ff, Grammar g, FILE *src) {
-    /* Parallel stacks: grammar symbols and their matching tree nodes */
+static ParseTreeNode *runParser(const ParseTable *pt, const Grammar *g,
+                                NON_TERMINAL start, TokenCursor *tc,
+                                diagBuffer diag, bool *hadErrorOut) {
+    /*
+     * Parallel stacks: grammar symbols and their matching tree nodes.
+     * accStack[i] is every token some symbol in symStack[0..i] accepts.
+     */
     GrammarSymbol *symStack[200];
     ParseTreeNode *nodeStack[200];
+    uint64_t       accStack[200];
 
     int symTop  = 0;
     int ndTop   = 0;
     bool hadError = false;
     int  lastErrLine = -1;
 
-    /* ----- Initialise twin buffer ----- */
-    twinBuffer tb = (twinBuffer)malloc(sizeof(TWIN_BUFFER));
-    for (int i = 0; i < 2 * CHUNK_SIZE; i++)
-        tb->buf[i] = '\0';
-    tb->pos  = CHUNK_SIZE;   /* pretend we're in second half so first fills */
-    tb->line = 1;
-    populate_buffer(tb, src);
-    tb->pos  = 0;
-    populate_buffer(tb, src);
-
-    initializeLookupTable();
-
-    /* ----- Build the root node ($program) ----- */
-    ParseTreeNode *root = (ParseTreeNode *)malloc(sizeof(ParseTreeNode));
+    /* ----- Build the root node ----- */
+    ParseTreeNode *root = (ParseTreeNode *)memAlloc(MEM_TREE, sizeof(ParseTreeNode));
+    STAT_INC(treeNodes);
     root->data.sym.isTerminal    = false;
-    root->data.sym.sym.nt        = NT_PROGRAM;
+    root->data.sym.sym.nt        = start;
     root->data.line              = -1;
     root->data.lexeme            = NULL;
     root->data.lexemeSize        = 0;
@@ -143,30 +291,32 @@ ParseTreeNode *parseSourceCode(ParseTable pt, FirstFollow ff, Grammar g, FILE *s
 
     nodeStack[ndTop] = root;
 
-    /* ----- Push $ then <program> onto the symbol stack ----- */
-    GrammarSymbol *dollarSym = (GrammarSymbol *)malloc(sizeof(GrammarSymbol));
+    /* ----- Push $ then the start symbol onto the symbol stack ----- */
+    GrammarSymbol *dollarSym = (GrammarSymbol *)memAlloc(MEM_SYMBOL, sizeof(GrammarSymbol));
     dollarSym->isTerminal    = true;
     dollarSym->sym.t         = DOLLAR;
 
-    GrammarSymbol *startSym  = (GrammarSymbol *)malloc(sizeof(GrammarSymbol));
+    GrammarSymbol *startSym  = (GrammarSymbol *)memAlloc(MEM_SYMBOL, sizeof(GrammarSymbol));
     startSym->isTerminal     = false;
-    startSym->sym.nt         = NT_PROGRAM;
+    startSym->sym.nt         = start;
 
     symStack[symTop] = dollarSym;
+    accStack[symTop] = TOKEN_BIT(DOLLAR);
     symTop++;
     symStack[symTop] = startSym;
+    accStack[symTop] = accStack[symTop - 1] | pt->start[start];
 
     /* ----- Fetch the first lookahead token ----- */
-    tokenInfo lookahead = nextToken(tb, src);
+    tokenInfo lookahead = cursorNext(tc);
 
     /* ----- Main parsing loop ----- */
-    while (tb->buf[tb->pos] != '\0' && symTop >= 0) {
+    while (symTop >= 0) {
         GrammarSymbol *top = symStack[symTop];
 
         if (top->isTerminal) {
             /* ---- Terminal on top of stack ---- */
-            if (top->sym.t == DOLLAR && lookahead->type == DOLLAR) {
-                break;  /* successful parse */
+            if (top->sym.t == DOLLAR) {
+                break;  /* done, or trailing input — checked below */
             }
 
             if (top->sym.t == lookahead->type) {
@@ -178,91 +328,75 @@ ParseTreeNode *parseSourceCode(ParseTable pt, FirstFollow ff, Grammar g, FILE *s
                 cur->data.lexeme         = lookahead->lexeme;
                 cur->data.lexemeSize     = lookahead->lexemeSize;
 
-                free(top);
+                memFree(top);
                 symStack[symTop] = NULL;
                 symTop--;
                 ndTop--;
 
-                free(lookahead);
-                lookahead = nextToken(tb, src);
+                cursorRelease(tc, lookahead);
+                lookahead = cursorNext(tc);
             } else {
-                /* Mismatch: skip this token and report once per line */
+                /* Mismatch: report once per line, then resynchronise */
                 hadError = true;
-                if (lastErrLine == lookahead->line) {
-                    free(lookahead);
-                    lookahead = nextToken(tb, src);
-                    continue;
+                if (lookahead->type == DOLLAR)
+                    break;      /* nothing left to skip */
+                if (lastErrLine != lookahead->line) {
+                    lastErrLine = lookahead->line;
+                    reportMismatch(diag, lookahead, top->sym.t);
+                }
+
+                lookahead = skipUntil(tc, lookahead,
+                                      TOKEN_BIT(top->sym.t) | TOKEN_BIT(DOLLAR) |
+                                      (STMT_SYNC_SET & accStack[symTop - 1]));
+                if (lookahead->type != top->sym.t) {
+                    /* Stopped at a delimiter the stack below can use — treat as missing */
+                    memFree(top);
+                    symStack[symTop] = NULL;
+                    symTop--;
+                    ndTop--;
                 }
-                lastErrLine = lookahead->line;
-                printf("Line %02d: Syntax Error : Token %s (lexeme \"%s\") "
-                       "does not match expected token %s\n",
-                       lookahead->line,
-                       getTokenName(lookahead->type),
-                       lookahead->lexeme,
-                       getTokenName(top->sym.t));
-
-                free(top);
-                symStack[symTop] = NULL;
-                symTop--;
-                ndTop--;
             }
 
         } else {
             /* ---- Non-terminal on top of stack ---- */
             NON_TERMINAL nt = top->sym.nt;
-            int ruleIdx = pt.cell[nt][lookahead->type];
+            int ruleIdx = pt->cell[nt][lookahead->type];
+            STAT_INC(tableLookups);
 
-            if (ruleIdx == -1) {
-                /* Error cell — discard the lookahead and keep going */
+            if (ruleIdx < 0) {
+                /* Error or sync cell — report once per line, then recover */
                 hadError = true;
-                if (lastErrLine == lookahead->line) {
-                    free(lookahead);
-                    lookahead = nextToken(tb, src);
-                    continue;
+                if (lookahead->type == DOLLAR)
+                    break;
+                if (lastErrLine != lookahead->line) {
+                    lastErrLine = lookahead->line;
+                    reportUnexpected(diag, lookahead, nt, ruleIdx == -2);
                 }
-                lastErrLine = lookahead->line;
-                printf("Line %02d: Syntax Error : Unexpected token %s "
-                       "(lexeme \"%s\") while expanding %s\n",
-                       lookahead->line,
-                       getTokenName(lookahead->type),
-                       lookahead->lexeme,
-                       getNonTerminal(nt));
-
-                free(lookahead);
-                lookahead = nextToken(tb, src);
-
-            } else if (ruleIdx == -2) {
-                /* Sync cell — pop the non-terminal and try to resynchronise */
-                hadError = true;
-                if (lastErrLine == lookahead->line) {
-                    free(lookahead);
-                    lookahead = nextToken(tb, src);
-                    continue;
+
+                lookahead = skipUntil(tc, lookahead,
+                                      pt->recover[nt] |
+                                      (STMT_SYNC_SET & accStack[symTop - 1]));
+                if (pt->cell[nt][lookahead->type] < 0) {
+                    /* Sync token — abandon this non-terminal */
+                    memFree(top);
+                    symStack[symTop] = NULL;
+                    symTop--;
+                    ndTop--;
                 }
-                lastErrLine = lookahead->line;
-                printf("Line %02d: Syntax Error : Unexpected token %s "
-                       "(lexeme \"%s\") while expanding %s — popping\n",
-                       lookahead->line,
-                       getTokenName(lookahead->type),
-                       lookahead->lexeme,
-                       getNonTerminal(nt));
-
-                free(top);
-                symStack[symTop] = NULL;
-                symTop--;
-                ndTop--;
+                /* otherwise the lookahead now starts 'nt' — expand it next */
 
             } else {
                 /* Valid rule — expand the non-terminal */
-                ProductionRule rule = g.prods[nt][ruleIdx];
+                const ProductionRule *rule = &g->prods[nt][ruleIdx];
+                STAT_INC(ruleExpansions[nt]);
                 ParseTreeNode *cur  = nodeStack[ndTop];
                 ndTop--;
 
-                free(top);
+                memFree(top);
                 symStack[symTop] = NULL;
                 symTop--;
 
-                if (g.has_eps[nt] && ruleIdx == g.prod_count[nt]) {
+                if (g->has_eps[nt] && ruleIdx == g->prod_count[nt]) {
                     /* ε-rule: add a single epsilon leaf */
                     cur->child_count  = 1;
                     ParseTreeNode *epsNode = makeSymNode(
@@ -272,24 +406,21 @@ ParseTreeNode *parseSourceCode(ParseTable pt, FirstFollow ff, Grammar g, FILE *s
                     cur->children[0] = epsNode;
                 } else {
                     /* Normal rule: create a child for each RHS symbol */
-                    cur->child_count = rule.rhs_len;
+                    cur->child_count = rule->rhs_len;
 
                     /* Push in reverse so leftmost child is processed first */
-                    for (int k = rule.rhs_len - 1; k >= 0; k--) {
-                        GrammarSymbol rhsSym;
-                        rhsSym.isTerminal = rule.rhs[k].isTerminal;
-                        rhsSym.sym        = rule.rhs[k].sym;
-
-                        ParseTreeNode *child = makeSymNode(rhsSym, cur);
+                    for (int k = rule->rhs_len - 1; k >= 0; k--) {
+                        ParseTreeNode *child = makeSymNode(rule->rhs[k], cur);
                         cur->children[k] = child;
 
                         nodeStack[++ndTop] = child;
 
-                        GrammarSymbol *pushed = (GrammarSymbol *)malloc(sizeof(GrammarSymbol));
-                        pushed->isTerminal = rule.rhs[k].isTerminal;
-                        pushed->sym        = rule.rhs[k].sym;
+                        GrammarSymbol *pushed = (GrammarSymbol *)memAlloc(MEM_SYMBOL, sizeof(GrammarSymbol));
+                        *pushed = rule->rhs[k];
                         symStack[++symTop] = pushed;
+                        accStack[symTop] = accStack[symTop - 1] | symAccepts(pt, *pushed);
                     }
+                    STAT_MAX(peakStackDepth, symTop + 1);
                 }
             }
         }
@@ -300,56 +431,531 @@ ParseTreeNode *parseSourceCode(ParseTable pt, FirstFollow ff, Grammar g, FILE *s
           symStack[symTop]->isTerminal &&
           symStack[symTop]->sym.t == DOLLAR)) {
         hadError = true;
-        printf("Syntax Error : Input consumed but symbol stack is not empty\n");
+        diagPrintf(diag, "Syntax Error : Input consumed but symbol stack is not empty\n");
     } else if (lookahead->type != DOLLAR) {
         hadError = true;
-        printf("Syntax Error : Symbol stack empty but input not fully consumed\n");
+        diagPrintf(diag, "Syntax Error : Symbol stack empty but input not fully consumed\n");
     }
 
-    free(tb);
-
-    if (!hadError)
-        printf("COMPILATION SUCCESS!\n");
-    else
-        printf("COMPILATION FAILED\n");
+    cursorRelease(tc, lookahead);
 
     /* Clean up remaining stack entries */
     while (symTop >= 0) {
         if (symStack[symTop] != NULL)
-            free(symStack[symTop]);
+            memFree(symStack[symTop]);
         symTop--;
     }
 
+    *hadErrorOut = hadError;
     return root;
 }
 
 /* ------------------------------------------------------------------
- * printParseTree
+ * parseSourceCode
  *
- * In-order traversal of the parse tree; prints each node as one
- * fixed-width row in the output file.
+ * Lex and parse a whole file in one pass, reporting errors to stdout.
  * ------------------------------------------------------------------ */
-void printParseTree(ParseTreeNode *root, FILE *out) {
+ParseTreeNode *parseSourceCode(const ParseTable *pt, const Grammar *g, FILE *src) {
+    TokenCursor tc = { 0 };
+    tc.tb  = createTwinBuffer(src);
+    tc.src = src;
+
+    initializeLookupTable();
+
+    bool hadError;
+    ParseTreeNode *root = runParser(pt, g, NT_PROGRAM, &tc, NULL, &hadError);
+
+    memFree(tc.tb);
+
+    if (!hadError)
+        printf("COMPILATION SUCCESS!\n");
+    else
+        printf("COMPILATION FAILED\n");
+
+    return root;
+}
+
+/* ------------------------------------------------------------------
+ * parseSourcePipelined
+ *
+ * Lex on a separate thread and parse on this one.  The two meet at a
+ * lock-free ring of token batches (tokenRing.c); lexical errors travel
+ * with the tokens, so diagnostics appear in the same order as with
+ * parseSourceCode.  If parsing stops before DOLLAR, the lexer thread
+ * is told to stop and is joined before returning.
+ * ------------------------------------------------------------------ */
+ParseTreeNode *parseSourcePipelined(const ParseTable *pt, const Grammar *g, FILE *src) {
+    initializeLookupTable();   /* before the lexer thread reads it */
+
+    TokenCursor tc = { 0 };
+    tc.ring = startLexerThread(src);
+
+    bool hadError;
+    ParseTreeNode *root = runParser(pt, g, NT_PROGRAM, &tc, NULL, &hadError);
+
+    stopLexerThread(tc.ring);
+
+    if (!hadError)
+        printf("COMPILATION SUCCESS!\n");
+    else
+        printf("COMPILATION FAILED\n");
+
+    return root;
+}
+
+/* ------------------------------------------------------------------
+ * parseTokenStream
+ *
+ * Parse an already-lexed file with the table-driven loop.  Errors go
+ * to 'diag' (stdout if NULL); nothing else is printed.
+ * ------------------------------------------------------------------ */
+ParseTreeNode *parseTokenStream(const ParseTable *pt, const Grammar *g,
+                                tokenStream ts, diagBuffer diag, bool *hadError) {
+    TokenCursor tc = { 0 };
+    tc.toks = ts->toks;
+    tc.end  = ts->count - 1;
+    tc.eof  = ts->toks[ts->count - 1];
+    return runParser(pt, g, NT_PROGRAM, &tc, diag, hadError);
+}
+
+/* ------------------------------------------------------------------
+ * splitFunctions
+ *
+ * Split toks[0 .. n) into function definitions.  Functions cannot nest
+ * and TK_END only ever closes a function, so segment k is
+ * toks[begin[k] .. begin[k+1]), begin[nSegs] == n.  _main may only
+ * be the last segment.  Returns the number of segments (0 for no
+ * tokens), or -1 if the tokens do not split cleanly.
+ * ------------------------------------------------------------------ */
+int splitFunctions(const TOKEN *toks, int n, int **beginOut) {
+    int  cap   = 16;
+    int  nSegs = 0;
+    int *begin = (int *)memAlloc(MEM_PARSER, (cap + 1) * sizeof(int));
+    int  i     = 0;
+
+    while (i < n) {
+        if (toks[i].type != TK_FUNID && toks[i].type != TK_MAIN) {
+            memFree(begin);
+            return -1;
+        }
+
+        if (nSegs == cap) {
+            cap  *= 2;
+            begin = (int *)memRealloc(MEM_PARSER, begin, (cap + 1) * sizeof(int));
+        }
+        begin[nSegs++] = i;
+
+        bool isMain = (toks[i].type == TK_MAIN);
+        int  j      = i + 1;
+        while (j < n && toks[j].type != TK_END)
+            j++;
+        if (j == n || (isMain && j != n - 1)) {
+            memFree(begin);
+            return -1;
+        }
+        i = j + 1;
+    }
+
+    begin[nSegs] = n;
+    *beginOut = begin;
+    return nSegs;
+}
+
+/*
+ * findFunctionBounds  (internal helper)
+ * splitFunctions over a whole program: at least one segment, the last
+ * one being _main.  -1 otherwise (the caller then parses it as a whole).
+ */
+static int findFunctionBounds(tokenStream ts, int **beginOut) {
+    int *begin = NULL;
+    int  nSegs = splitFunctions(ts->toks, ts->count - 1, &begin);
+    if (nSegs <= 0)
+        return -1;
+    if (ts->toks[begin[nSegs - 1]].type != TK_MAIN) {
+        memFree(begin);
+        return -1;
+    }
+    *beginOut = begin;
+    return nSegs;
+}
+
+/* ------------------------------------------------------------------
+ * parseTokenRange
+ *
+ * Parse toks[begin .. end) as one 'start' (e.g. a single <function>)
+ * with end of input right after it.
+ * ------------------------------------------------------------------ */
+ParseTreeNode *parseTokenRange(const ParseTable *pt, const Grammar *g, TOKEN *toks,
+                               int begin, int end, NON_TERMINAL start, diagBuffer diag,
+                               bool *hadError) {
+    TokenCursor tc = { 0 };
+    tc.toks       = toks;
+    tc.pos        = begin;
+    tc.end        = end;
+    tc.eof.type   = DOLLAR;
+    tc.eof.lexeme = NULL;
+    tc.eof.line   = (end > 0) ? toks[end - 1].line : 1;
+
+    return runParser(pt, g, start, &tc, diag, hadError);
+}
+
+/* ------------------------------------------------------------------
+ * joinFunctionTrees / freeFunctionJoin
+ *
+ * <program> ==> <otherFunctions> <mainFunction>, with
+ * <otherFunctions> ==> <function> <otherFunctions> | eps, built around
+ * existing subtrees (roots[n - 1] is _main).  freeFunctionJoin undoes
+ * it, releasing only the nodes joinFunctionTrees created.
+ * ------------------------------------------------------------------ */
+ParseTreeNode *joinFunctionTrees(ParseTreeNode **roots, int n) {
+    ParseTreeNode *root = makeSymNode((GrammarSymbol){ .isTerminal = false,
+                                                       .sym.nt     = NT_PROGRAM }, NULL);
+    GrammarSymbol ofSym = { .isTerminal = false, .sym.nt = NT_OTHERFUNCTIONS };
+    ParseTreeNode *chain = makeSymNode(ofSym, root);
+
+    root->child_count = 2;
+    root->children[0] = chain;
+
+    for (int k = 0; k < n - 1; k++) {
+        ParseTreeNode *next = makeSymNode(ofSym, chain);
+        chain->child_count = 2;
+        chain->children[0] = roots[k];
+        chain->children[1] = next;
+        roots[k]->parent   = chain;
+        chain = next;
+    }
+    chain->child_count = 1;
+    chain->children[0] = makeSymNode((GrammarSymbol){ .isTerminal = true,
+                                                      .sym.t      = EPSILLON },
+                                     chain);
+
+    root->children[1]     = roots[n - 1];
+    roots[n - 1]->parent  = root;
+    return root;
+}
+
+void freeFunctionJoin(ParseTreeNode *root) {
     if (root == NULL)
         return;
+    ParseTreeNode *chain = root->children[0];
+    while (chain != NULL) {
+        ParseTreeNode *next = NULL;
+        if (chain->child_count == 2)
+            next = chain->children[1];
+        else
+            memFree(chain->children[0]);    /* the eps leaf */
+        memFree(chain);
+        chain = next;
+    }
+    memFree(root);
+}
+
+/* Shared, read-only state for the per-function parse tasks */
+typedef struct {
+    const ParseTable *pt;
+    const Grammar    *g;
+    tokenStream       ts;
+    const int        *begin;
+    int               nSegs;
+    ParseTreeNode   **roots;
+    diagBuffer       *diags;
+    bool             *errs;
+} FunctionJobs;
+
+static void parseFunctionTask(int k, void *arg) {
+    FunctionJobs *fj = (FunctionJobs *)arg;
+
+    fj->diags[k] = createDiagBuffer();
+    fj->roots[k] = parseTokenRange(fj->pt, fj->g, fj->ts->toks, fj->begin[k], fj->begin[k + 1],
+                                   (k == fj->nSegs - 1) ? NT_MAINFUNCTION : NT_FUNCTION,
+                                   fj->diags[k], &fj->errs[k]);
+}
+
+/* ------------------------------------------------------------------
+ * parseSourceParallel
+ *
+ * Lex the file into a token array, cut it at function boundaries and
+ * parse every <function> (and the final <mainFunction>) concurrently
+ * with the shared read-only table.  The subtrees are then chained
+ * under <otherFunctions> exactly as the sequential parser would have
+ * built them.  Lexical errors are reported while lexing; syntax errors
+ * are buffered per function and printed in source order afterwards.
+ * ------------------------------------------------------------------ */
+ParseTreeNode *parseSourceParallel(const ParseTable *pt, const Grammar *g,
+                                   FILE *src, int nThreads) {
+    tokenStream ts    = tokenizeSource(src);
+    int        *begin = NULL;
+    int         nSegs = findFunctionBounds(ts, &begin);
+    bool        hadError = false;
+    ParseTreeNode *root;
+
+    if (nSegs < 0) {
+        /* Not a clean <function>* <mainFunction> split — parse it whole */
+        root = parseTokenStream(pt, g, ts, NULL, &hadError);
+    } else {
+        FunctionJobs fj;
+        fj.pt    = pt;
+        fj.g     = g;
+        fj.ts    = ts;
+        fj.begin = begin;
+        fj.nSegs = nSegs;
+        fj.roots = (ParseTreeNode **)memAlloc(MEM_PARSER, nSegs * sizeof(ParseTreeNode *));
+        fj.diags = (diagBuffer *)memAlloc(MEM_PARSER, nSegs * sizeof(diagBuffer));
+        fj.errs  = (bool *)memAlloc(MEM_PARSER, nSegs * sizeof(bool));
+
+        runPool(nSegs, nThreads, parseFunctionTask, &fj);
+
+        root = joinFunctionTrees(fj.roots, nSegs);
+
+        /* Diagnostics in source order, whatever order the tasks ran in */
+        for (int k = 0; k < nSegs; k++) {
+            diagFlush(fj.diags[k], stdout);
+            freeDiagBuffer(fj.diags[k]);
+            hadError = hadError || fj.errs[k];
+        }
 
-    /* Print column headers exactly once */
-    static int headerPrinted = 0;
-    if (!headerPrinted) {
-        headerPrinted = 1;
-        fprintf(out,
-                "%-30s%-30s%-30s%-30s%-30s%-30s%-30s\n\n",
-                "lexeme", "lineno", "token",
-                "valueIfNumber", "parentNodeSymbol",
-                "isLeafNode(yes/no)", "NodeSymbol");
+        memFree(fj.roots);
+        memFree(fj.diags);
+        memFree(fj.errs);
+        memFree(begin);
     }
 
-    /* Visit first child before printing this node (in-order) */
-    if (root->child_count > 0 && root->children[0] != NULL)
-        printParseTree(root->children[0], out);
+    freeTokenStream(ts);
 
-    if (out == NULL)
+    if (!hadError)
+        printf("COMPILATION SUCCESS!\n");
+    else
+        printf("COMPILATION FAILED\n");
+
+    return root;
+}
+
+/*
+ * One entry on the event-mode stack.  'exits' > 0 marks a run of pending
+ * exit events for the non-terminal in 'sym' rather than a symbol still to
+ * be matched.  Right-recursive lists such as <otherStmts> push the same
+ * marker on every expansion, so consecutive markers are merged and the
+ * stack grows with nesting depth, not with list length.  'acc' is every
+ * token this frame or one below it accepts (see runParser's accStack).
+ */
+typedef struct {
+    GrammarSymbol sym;
+    int           exits;
+    uint64_t      acc;
+} EventFrame;
+
+typedef struct {
+    EventFrame *frames;
+    int         top;
+    int         cap;
+} EventStack;
+
+static void pushFrame(EventStack *st, GrammarSymbol sym, int exits, uint64_t accepts) {
+    if (st->top + 1 == st->cap) {
+        st->cap   *= 2;
+        st->frames = (EventFrame *)memRealloc(MEM_PARSER, st->frames, st->cap * sizeof(EventFrame));
+    }
+    uint64_t below = (st->top >= 0) ? st->frames[st->top].acc : 0;
+    st->top++;
+    st->frames[st->top].sym   = sym;
+    st->frames[st->top].exits = exits;
+    st->frames[st->top].acc   = below | accepts;
+}
+
+/* Queue an exit event for 'nt', folding it into a marker already on top */
+static void pushExit(EventStack *st, NON_TERMINAL nt) {
+    if (st->top >= 0) {
+        EventFrame *fr = &st->frames[st->top];
+        if (fr->exits > 0 && fr->sym.sym.nt == nt) {
+            fr->exits++;
+            return;
+        }
+    }
+    pushFrame(st, (GrammarSymbol){ .isTerminal = false, .sym.nt = nt }, 1, 0);
+}
+
+/* ------------------------------------------------------------------
+ * parseSourceEvents
+ *
+ * Same LL(1) driver loop and error recovery as parseSourceCode, but
+ * instead of building nodes it reports each expansion, match and pop
+ * through the callbacks in 'ev'.  Tokens are released as soon as they
+ * have been reported.  If parsing stops early, exit events are still
+ * delivered for every non-terminal that was entered, so consumers
+ * always see balanced enter/exit pairs.  Lexical and syntax errors go
+ * to 'diag' (stdout if NULL).  No verdict is printed: the consumer may
+ * have phases of its own still to run.
+ * ------------------------------------------------------------------ */
+bool parseSourceEvents(const ParseTable *pt, const Grammar *g, FILE *src,
+                       const ParseEvents *ev, diagBuffer diag) {
+    EventStack st;
+    st.cap    = 64;
+    st.top    = -1;
+    st.frames = (EventFrame *)memAlloc(MEM_PARSER, st.cap * sizeof(EventFrame));
+
+    bool hadError    = false;
+    int  lastErrLine = -1;
+
+    TokenCursor tc = { 0 };
+    tc.tb          = createTwinBuffer(src);
+    tc.src         = src;
+    tc.ownsLexemes = true;
+    tc.tb->diag    = diag;
+    initializeLookupTable();
+
+    pushFrame(&st, (GrammarSymbol){ .isTerminal = true,  .sym.t  = DOLLAR },     0,
+              TOKEN_BIT(DOLLAR));
+    pushFrame(&st, (GrammarSymbol){ .isTerminal = false, .sym.nt = NT_PROGRAM }, 0,
+              pt->start[NT_PROGRAM]);
+
+    tokenInfo lookahead = cursorNext(&tc);
+
+    while (st.top >= 0) {
+        EventFrame *top = &st.frames[st.top];
+
+        if (top->exits > 0) {
+            /* ---- Pending exit events ---- */
+            if (ev->exitNonTerminal)
+                for (int k = 0; k < top->exits; k++)
+                    ev->exitNonTerminal(top->sym.sym.nt, ev->user);
+            st.top--;
+
+        } else if (top->sym.isTerminal) {
+            /* ---- Terminal on top of stack ---- */
+            if (top->sym.sym.t == DOLLAR)
+                break;  /* done, or trailing input — checked below */
+
+            if (top->sym.sym.t == lookahead->type) {
+                if (ev->matchToken)
+                    ev->matchToken(lookahead, ev->user);
+                st.top--;
+
+                cursorRelease(&tc, lookahead);
+                lookahead = cursorNext(&tc);
+            } else {
+                /* Mismatch: report once per line, then resynchronise */
+                hadError = true;
+                if (lookahead->type == DOLLAR)
+                    break;
+                if (lastErrLine != lookahead->line) {
+                    lastErrLine = lookahead->line;
+                    reportMismatch(diag, lookahead, top->sym.sym.t);
+                }
+
+                lookahead = skipUntil(&tc, lookahead,
+                                      TOKEN_BIT(top->sym.sym.t) | TOKEN_BIT(DOLLAR) |
+                                      (STMT_SYNC_SET & st.frames[st.top - 1].acc));
+                if (lookahead->type != top->sym.sym.t)
+                    st.top--;   /* treat the terminal as missing */
+            }
+
+        } else {
+            /* ---- Non-terminal on top of stack ---- */
+            NON_TERMINAL nt = top->sym.sym.nt;
+            int ruleIdx = pt->cell[nt][lookahead->type];
+            STAT_INC(tableLookups);
+
+            if (ruleIdx < 0) {
+                /* Same panic-mode recovery as runParser */
+                hadError = true;
+                if (lookahead->type == DOLLAR)
+                    break;
+                if (lastErrLine != lookahead->line) {
+                    lastErrLine = lookahead->line;
+                    reportUnexpected(diag, lookahead, nt, ruleIdx == -2);
+                }
+
+                lookahead = skipUntil(&tc, lookahead,
+                                      pt->recover[nt] |
+                                      (STMT_SYNC_SET & st.frames[st.top - 1].acc));
+                if (pt->cell[nt][lookahead->type] < 0)
+                    st.top--;   /* sync token — abandon this non-terminal */
+
+            } else {
+                /* Valid rule — report it, then queue its exit and body */
+                st.top--;
+                STAT_INC(ruleExpansions[nt]);
+                if (ev->enterNonTerminal)
+                    ev->enterNonTerminal(nt, ruleIdx, ev->user);
+                pushExit(&st, nt);
+
+                if (!(g->has_eps[nt] && ruleIdx == g->prod_count[nt])) {
+                    const ProductionRule *rule = &g->prods[nt][ruleIdx];
+                    for (int k = rule->rhs_len - 1; k >= 0; k--)
+                        pushFrame(&st, rule->rhs[k], 0, symAccepts(pt, rule->rhs[k]));
+                }
+                STAT_MAX(peakStackDepth, st.top + 1);
+            }
+        }
+    } /* end main loop */
+
+    /* ----- Post-parse checks ----- */
+    if (!(st.top == 0 && st.frames[0].sym.isTerminal)) {
+        hadError = true;
+        diagPrintf(diag, "Syntax Error : Input consumed but symbol stack is not empty\n");
+    } else if (lookahead->type != DOLLAR) {
+        hadError = true;
+        diagPrintf(diag, "Syntax Error : Symbol stack empty but input not fully consumed\n");
+    }
+
+    /* Close every non-terminal that is still open */
+    for (; st.top >= 0; st.top--) {
+        EventFrame *fr = &st.frames[st.top];
+        if (fr->exits > 0 && ev->exitNonTerminal)
+            for (int k = 0; k < fr->exits; k++)
+                ev->exitNonTerminal(fr->sym.sym.nt, ev->user);
+    }
+
+    /* a token the lexer rejected is missing from the events, so that fails too */
+    hadError = hadError || tc.tb->errors > 0;
+
+    cursorRelease(&tc, lookahead);
+    memFree(st.frames);
+    memFree(tc.tb);
+    return !hadError;
+}
+
+/* ------------------------------------------------------------------
+ * freeParseTree
+ *
+ * Release every node of a tree.  Lexemes belong to the token stream or
+ * lexer that produced them and are left alone.
+ * ------------------------------------------------------------------ */
+void freeParseTree(ParseTreeNode *root) {
+    if (root == NULL)
+        return;
+    for (int c = 0; c < root->child_count; c++)
+        freeParseTree(root->children[c]);
+    memFree(root);
+}
+
+/* ------------------------------------------------------------------
+ * parseTreeStats
+ *
+ * Count the nodes of a tree and the bytes they take: one node struct
+ * each, plus the lexeme text hanging off the leaves.
+ * ------------------------------------------------------------------ */
+void parseTreeStats(const ParseTreeNode *root, long *nodes, size_t *bytes) {
+    if (root == NULL)
         return;
+    *nodes += 1;
+    *bytes += sizeof(ParseTreeNode);
+    if (root->data.lexeme != NULL)
+        *bytes += (size_t)root->data.lexemeSize + 1;
+    for (int c = 0; c < root->child_count; c++)
+        parseTreeStats(root->children[c], nodes, bytes);
+}
+
+/* ------------------------------------------------------------------
+ * printParseTree
+ *
+ * In-order traversal of the parse tree; prints each node as one
+ * fixed-width row in the output file, below a header row.
+ * ------------------------------------------------------------------ */
+static void printTreeRows(ParseTreeNode *root, FILE *out) {
+    /* Visit first child before printing this node (in-order) */
+    if (root->child_count > 0 && root->children[0] != NULL)
+        printTreeRows(root->children[0], out);
 
     /* --- Lexeme column --- */
     fprintf(out, "%-30s", (root->data.lexeme != NULL) ? root->data.lexeme : "----");
@@ -383,5 +989,17 @@ void printParseTree(ParseTreeNode *root, FILE *out) {
     /* Visit remaining children */
     for (int c = 1; c < root->child_count; c++)
         if (root->children[c] != NULL)
-            printParseTree(root->children[c], out);
+            printTreeRows(root->children[c], out);
+}
+
+void printParseTree(ParseTreeNode *root, FILE *out) {
+    if (root == NULL || out == NULL)
+        return;
+
+    fprintf(out,
+            "%-30s%-30s%-30s%-30s%-30s%-30s%-30s\n\n",
+            "lexeme", "lineno", "token",
+            "valueIfNumber", "parentNodeSymbol",
+            "isLeafNode(yes/no)", "NodeSymbol");
+    printTreeRows(root, out);
 }
@@ -1,6 +1,7 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include "diag.h"
 #include "parserDef.h"
 #include <stdio.h>
 
@@ -10,6 +11,12 @@
  */
 void buildParseTable(FirstFollow ff, ParseTable *pt);
 
+/*
+ * Derive pt->start and pt->recover (panic-mode sets) from a filled
+ * table and the FOLLOW set of every non-terminal.
+ */
+void computeRecoverySets(ParseTable *pt, const uint64_t follow[NON_TERMINAL_COUNT]);
+
 /*
  * Compute FIRST and FOLLOW sets for every non-terminal in the grammar.
  */
@@ -19,7 +26,67 @@ FirstFollow computeFirstFollow(Grammar g);
  * Run the LL(1) parser on the source file, using the provided table
  * and grammar. Returns the root of the resulting parse tree.
  */
-ParseTreeNode *parseSourceCode(ParseTable pt, FirstFollow ff, Grammar g, FILE *src);
+ParseTreeNode *parseSourceCode(const ParseTable *pt, const Grammar *g, FILE *src);
+
+/*
+ * Parse with the lexer running on its own thread, feeding the parser
+ * through a bounded ring of token batches.  Same tree and diagnostics
+ * as parseSourceCode.
+ */
+ParseTreeNode *parseSourcePipelined(const ParseTable *pt, const Grammar *g, FILE *src);
+
+/*
+ * Parse an already-lexed token stream with the table-driven loop.
+ * Syntax errors are written to 'diag' (stdout if NULL) and *hadError
+ * is set; no success/failure banner is printed.
+ */
+ParseTreeNode *parseTokenStream(const ParseTable *pt, const Grammar *g,
+                                tokenStream ts, diagBuffer diag, bool *hadError);
+
+/*
+ * Lex the whole file first, then parse each function definition on its
+ * own worker (nThreads in total) and join the subtrees under
+ * <otherFunctions>.  Produces the same tree as parseSourceCode; syntax
+ * errors are printed per function in source order.
+ */
+ParseTreeNode *parseSourceParallel(const ParseTable *pt, const Grammar *g,
+                                   FILE *src, int nThreads);
+
+/*
+ * Cut toks[0 .. n) into function definitions: *beginOut (memFree it)
+ * gets the start of each and n at the end.  Returns how many there
+ * are, or -1 if the tokens are not a sequence of whole functions with
+ * _main, if present, last.
+ */
+int splitFunctions(const TOKEN *toks, int n, int **beginOut);
+
+/*
+ * Parse toks[begin .. end) as 'start' followed by end of input: one
+ * segment from splitFunctions as <function> or <mainFunction>, a run
+ * of them as <otherFunctions>, and so on.  Errors go to 'diag'.
+ */
+ParseTreeNode *parseTokenRange(const ParseTable *pt, const Grammar *g, TOKEN *toks,
+                               int begin, int end, NON_TERMINAL start, diagBuffer diag,
+                               bool *hadError);
+
+/*
+ * Build <program> over function subtrees roots[0 .. n), the last being
+ * <mainFunction>, as parseSourceParallel does.  freeFunctionJoin frees
+ * the joining nodes again and leaves the subtrees alone.
+ */
+ParseTreeNode *joinFunctionTrees(ParseTreeNode **roots, int n);
+void freeFunctionJoin(ParseTreeNode *root);
+
+/*
+ * Run the same LL(1) parser in event-streaming mode: callbacks in 'ev'
+ * fire as the stack is expanded and popped and no tree nodes are
+ * allocated, so memory stays bounded by the parse stack depth.
+ * Returns true if the source had no lexical or syntax errors; unlike the
+ * other parse modes it prints no COMPILATION verdict.  Errors are
+ * written to 'diag' (stdout if NULL).
+ */
+bool parseSourceEvents(const ParseTable *pt, const Grammar *g, FILE *src,
+                       const ParseEvents *ev, diagBuffer diag);
 
 /*
  * Write a formatted parse tree listing to 'out'.
@@ -27,4 +94,15 @@ ParseTreeNode *parseSourceCode(ParseTable pt, FirstFollow ff, Grammar g, FILE *s
  */
 void printParseTree(ParseTreeNode *root, FILE *out);
 
+/*
+ * Free all nodes of a parse tree (lexemes are not owned by the tree).
+ */
+void freeParseTree(ParseTreeNode *root);
+
+/*
+ * Add the node count and memory footprint (nodes plus lexemes) of a
+ * tree to *nodes and *bytes.
+ */
+void parseTreeStats(const ParseTreeNode *root, long *nodes, size_t *bytes);
+
 #endif /* PARSER_H */
@@ -2,6 +2,7 @@
 #define PARSER_DEF_H
 
 #include "lexerDef.h"
+#include <stdint.h>
 
 /* Total number of non-terminals in the grammar */
 #define NON_TERMINAL_COUNT 53
@@ -112,9 +113,30 @@ typedef struct {
     int        follow_rule[NON_TERMINAL_COUNT];  /* -1 = no ε rule */
 } FirstFollow;
 
-/* LL(1) parse table: row = non-terminal, column = terminal token */
+/* Bit for token 't' in a 64-bit token set (NUM_TOKENS fits in 64) */
+#define TOKEN_BIT(t) (1ULL << (t))
+
+/*
+ * Tokens that open, close or separate statements and blocks.  Panic-mode
+ * recovery stops at one of these if a symbol still on the parse stack
+ * can accept it; otherwise it is skipped like any other token.
+ */
+#define STMT_SYNC_SET                                                                                           \
+    (TOKEN_BIT(TK_SEM)        | TOKEN_BIT(TK_END)        | TOKEN_BIT(TK_ENDWHILE)   | TOKEN_BIT(TK_ENDIF) |     \
+     TOKEN_BIT(TK_ELSE)       | TOKEN_BIT(TK_ENDRECORD)  | TOKEN_BIT(TK_ENDUNION)   | TOKEN_BIT(TK_WHILE) |     \
+     TOKEN_BIT(TK_IF)         | TOKEN_BIT(TK_READ)       | TOKEN_BIT(TK_WRITE)      | TOKEN_BIT(TK_RETURN) |    \
+     TOKEN_BIT(TK_CALL)       | TOKEN_BIT(TK_TYPE)       | TOKEN_BIT(TK_DEFINETYPE) | TOKEN_BIT(TK_MAIN))
+
+/*
+ * LL(1) parse table: row = non-terminal, column = terminal token.
+ * start[nt] holds the tokens that have a rule in row 'nt'; recover[nt]
+ * is where error recovery for 'nt' stops skipping: start[nt],
+ * FOLLOW(nt) and end of input.
+ */
 typedef struct {
-    int cell[NON_TERMINAL_COUNT][NUM_TOKENS];
+    int      cell[NON_TERMINAL_COUNT][NUM_TOKENS];
+    uint64_t start[NON_TERMINAL_COUNT];
+    uint64_t recover[NON_TERMINAL_COUNT];
 } ParseTable;
 
 /* Data attached to a single node in the parse tree */
@@ -135,4 +157,20 @@ struct ParseTreeNode {
     ParseTreeNode  *children[MAX_RHS_LEN];
 };
 
+/*
+ * Callbacks for the event-streaming parse mode (no tree is built).
+ *   enterNonTerminal — a non-terminal is expanded with rule 'ruleIdx'
+ *                      (ruleIdx == prod_count[nt] for the ε-rule)
+ *   matchToken       — a terminal on the stack matched 'tok'; the token
+ *                      and its lexeme are freed once the callback returns
+ *   exitNonTerminal  — every symbol of the expanded rule has been popped
+ * Any callback may be NULL.  'user' is passed back unchanged.
+ */
+typedef struct {
+    void (*enterNonTerminal)(NON_TERMINAL nt, int ruleIdx, void *user);
+    void (*matchToken)(tokenInfo tok, void *user);
+    void (*exitNonTerminal)(NON_TERMINAL nt, void *user);
+    void  *user;
+} ParseEvents;
+
 #endif /* PARSER_DEF_H */
@@ -0,0 +1,149 @@
+#include "pool.h"
+#include "stats.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * Per-worker deque.  Tasks are plain indices and are never spawned at
+ * run time, so a worker's deque is always a contiguous range
+ * [head, tail): the owner pops from the head, thieves split off the tail.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    int             head;
+    int             tail;
+} WorkDeque;
+
+typedef struct {
+    WorkDeque *deques;
+    int        nWorkers;
+    poolTask   fn;
+    void      *arg;
+} PoolShared;
+
+typedef struct {
+    PoolShared   *shared;
+    int           self;
+#ifdef FRONTEND_STATS
+    FrontendStats stats;    /* the worker thread's counters, for the caller */
+#endif
+} WorkerArg;
+
+/* Take the next task from our own deque; -1 if it is empty */
+static int popOwn(WorkDeque *dq) {
+    int idx = -1;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->head < dq->tail)
+        idx = dq->head++;
+    pthread_mutex_unlock(&dq->lock);
+    return idx;
+}
+
+/*
+ * Steal the back half of some other worker's range into our own deque.
+ * Only one deque lock is ever held at a time, so thieves cannot deadlock.
+ * Returns false once every other deque is empty.
+ */
+static bool stealWork(PoolShared *ps, int self) {
+    for (int k = 1; k < ps->nWorkers; k++) {
+        WorkDeque *victim = &ps->deques[(self + k) % ps->nWorkers];
+        int lo = 0, hi = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        int left = victim->tail - victim->head;
+        if (left > 0) {
+            hi = victim->tail;
+            lo = hi - (left + 1) / 2;
+            victim->tail = lo;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (hi > lo) {
+            WorkDeque *own = &ps->deques[self];
+            pthread_mutex_lock(&own->lock);
+            own->head = lo;
+            own->tail = hi;
+            pthread_mutex_unlock(&own->lock);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void *workerMain(void *p) {
+    WorkerArg  *wa = (WorkerArg *)p;
+    PoolShared *ps = wa->shared;
+
+    for (;;) {
+        int idx = popOwn(&ps->deques[wa->self]);
+        if (idx >= 0) {
+            ps->fn(idx, ps->arg);
+            continue;
+        }
+        if (!stealWork(ps, wa->self))
+            break;
+    }
+#ifdef FRONTEND_STATS
+    if (wa->self > 0)
+        wa->stats = *frontendStats();
+#endif
+    return NULL;
+}
+
+/* ------------------------------------------------------------------
+ * runPool
+ * ------------------------------------------------------------------ */
+void runPool(int nTasks, int nThreads, poolTask fn, void *arg) {
+    if (nThreads > nTasks)
+        nThreads = nTasks;
+
+    if (nThreads <= 1) {
+        for (int i = 0; i < nTasks; i++)
+            fn(i, arg);
+        return;
+    }
+
+    PoolShared ps;
+    ps.deques   = (WorkDeque *)malloc(nThreads * sizeof(WorkDeque));
+    ps.nWorkers = nThreads;
+    ps.fn       = fn;
+    ps.arg      = arg;
+
+    for (int w = 0; w < nThreads; w++) {
+        pthread_mutex_init(&ps.deques[w].lock, NULL);
+        ps.deques[w].head = (int)((long)nTasks * w / nThreads);
+        ps.deques[w].tail = (int)((long)nTasks * (w + 1) / nThreads);
+    }
+
+    pthread_t *tids = (pthread_t *)malloc(nThreads * sizeof(pthread_t));
+    WorkerArg *args = (WorkerArg *)malloc(nThreads * sizeof(WorkerArg));
+
+    for (int w = 0; w < nThreads; w++) {
+        args[w].shared = &ps;
+        args[w].self   = w;
+    }
+
+    /* Worker 0 is the calling thread */
+    for (int w = 1; w < nThreads; w++)
+        pthread_create(&tids[w], NULL, workerMain, &args[w]);
+    workerMain(&args[0]);
+    for (int w = 1; w < nThreads; w++) {
+        pthread_join(tids[w], NULL);
+#ifdef FRONTEND_STATS
+        mergeFrontendStats(&args[w].stats);
+#endif
+    }
+
+    for (int w = 0; w < nThreads; w++)
+        pthread_mutex_destroy(&ps.deques[w].lock);
+    free(ps.deques);
+    free(tids);
+    free(args);
+}
+
+int poolDefaultThreads(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n < 1) ? 1 : (int)n;
+}
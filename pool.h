@@ -0,0 +1,21 @@
+#ifndef POOL_H
+#define POOL_H
+
+/* Body of one task; 'taskIdx' runs from 0 to nTasks-1 */
+typedef void (*poolTask)(int taskIdx, void *arg);
+
+/*
+ * Run fn(0..nTasks-1, arg) on nThreads workers (the caller is one of
+ * them) and return once every task has finished.  Each worker starts
+ * with a contiguous slice of the task range; a worker that runs dry
+ * steals the back half of another worker's remaining slice.
+ * Task completion order is unspecified — callers that need ordered
+ * output should store per-task results and emit them afterwards.
+ * With FRONTEND_STATS the workers' counters are added to the caller's.
+ */
+void runPool(int nTasks, int nThreads, poolTask fn, void *arg);
+
+/* Number of online CPUs (at least 1) */
+int poolDefaultThreads(void);
+
+#endif /* POOL_H */
@@ -0,0 +1,453 @@
+#include "progGen.h"
+#include <ctype.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COST_INF (INT_MAX / 4)
+
+/* Chance that a nested list (statements, fields, ...) gets another item
+ * at the top level; it falls off linearly towards maxDepth */
+#define LIST_CONTINUE 0.85
+
+typedef struct {
+    const Grammar *g;
+    FILE          *out;
+    uint64_t       rng;
+    uint64_t       size;
+    double         errorRate;
+    int            maxDepth;
+    int            cost[NON_TERMINAL_COUNT];    /* tokens in the smallest derivation */
+    int            height[NON_TERMINAL_COUNT];  /* depth of the shallowest derivation */
+    int            rcost[NON_TERMINAL_COUNT][MAX_RHS_LEN + 1];
+    int            tail[NON_TERMINAL_COUNT];    /* the <list> ===> ... <list> rule, or -1 */
+    int            shallow[NON_TERMINAL_COUNT];
+    int            spine;                       /* list grown up to 'size', -1 until met */
+    bool           lineStart;
+    GenResult      res;
+    size_t         outLen;
+    char           outBuf[1 << 16];             /* written to 'out' when full */
+} GenState;
+
+/* ---- random numbers (xorshift64*, seeded through splitmix64) ---- */
+
+static uint64_t nextRand(GenState *s) {
+    uint64_t x = s->rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    s->rng = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static int randBelow(GenState *s, int n) {
+    return (int)(nextRand(s) % (uint64_t)n);
+}
+
+static double randUnit(GenState *s) {
+    return (double)(nextRand(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static uint64_t seedState(uint64_t seed) {
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return z ? z : 1;
+}
+
+/* ---- rules, counting the ε-rule (index prod_count[nt]) ---- */
+
+static const ProductionRule epsRule = { .rhs_len = 0 };
+
+static int ruleCount(const Grammar *g, int nt) {
+    return g->prod_count[nt] + (g->has_eps[nt] ? 1 : 0);
+}
+
+static const ProductionRule *ruleAt(const Grammar *g, int nt, int r) {
+    return (r < g->prod_count[nt]) ? &g->prods[nt][r] : &epsRule;
+}
+
+/* <list> ===> ... <list>: expanded as a loop, not by recursion */
+static bool isTailRule(const ProductionRule *rule, int nt) {
+    if (rule->rhs_len == 0)
+        return false;
+    GrammarSymbol last = rule->rhs[rule->rhs_len - 1];
+    return !last.isTerminal && (int)last.sym.nt == nt;
+}
+
+static int ruleCost(const GenState *s, const ProductionRule *rule) {
+    int c = 0;
+    for (int k = 0; k < rule->rhs_len; k++) {
+        GrammarSymbol sym = rule->rhs[k];
+        int part = sym.isTerminal ? 1 : s->cost[sym.sym.nt];
+        if (part >= COST_INF)
+            return COST_INF;
+        c += part;
+    }
+    return c;
+}
+
+static int ruleHeight(const GenState *s, const ProductionRule *rule) {
+    int h = 1;
+    for (int k = 0; k < rule->rhs_len; k++) {
+        GrammarSymbol sym = rule->rhs[k];
+        if (sym.isTerminal)
+            continue;
+        if (s->height[sym.sym.nt] >= COST_INF)
+            return COST_INF;
+        if (s->height[sym.sym.nt] + 1 > h)
+            h = s->height[sym.sym.nt] + 1;
+    }
+    return h;
+}
+
+/* Least fixed point of cost[] and height[] over all rules */
+static void computeCosts(GenState *s) {
+    for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++)
+        s->cost[nt] = s->height[nt] = COST_INF;
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++) {
+            for (int r = 0; r < ruleCount(s->g, nt); r++) {
+                const ProductionRule *rule = ruleAt(s->g, nt, r);
+                int c = ruleCost(s, rule);
+                int h = ruleHeight(s, rule);
+                if (c < s->cost[nt])   { s->cost[nt]   = c; changed = true; }
+                if (h < s->height[nt]) { s->height[nt] = h; changed = true; }
+            }
+        }
+    }
+}
+
+static int shallowestRule(const GenState *s, int nt);
+
+/* Per-rule facts that chooseRule needs on every expansion */
+static void cacheRules(GenState *s) {
+    for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++) {
+        s->tail[nt] = -1;
+        for (int r = 0; r < ruleCount(s->g, nt); r++) {
+            const ProductionRule *rule = ruleAt(s->g, nt, r);
+            s->rcost[nt][r] = ruleCost(s, rule);
+            if (s->tail[nt] < 0 && isTailRule(rule, nt))
+                s->tail[nt] = r;
+        }
+        s->shallow[nt] = shallowestRule(s, nt);
+    }
+}
+
+/* The rule with the shallowest derivation; its non-terminals all have
+ * smaller heights, so always taking it terminates */
+static int shallowestRule(const GenState *s, int nt) {
+    int best = 0, bestH = COST_INF, bestC = COST_INF;
+    for (int r = 0; r < ruleCount(s->g, nt); r++) {
+        const ProductionRule *rule = ruleAt(s->g, nt, r);
+        int h = ruleHeight(s, rule), c = ruleCost(s, rule);
+        if (h < bestH || (h == bestH && c < bestC)) {
+            best  = r;
+            bestH = h;
+            bestC = c;
+        }
+    }
+    return best;
+}
+
+/*
+ * Rule weight 1 / (1 + cost)^k with k growing from 0 at the top to 3
+ * near maxDepth, so deep expansions lean towards short rules.
+ */
+static int weightedRule(GenState *s, int nt, int depth, int skip) {
+    double w[MAX_RHS_LEN + 1], sum = 0;
+    int    steps = 3 * depth / s->maxDepth;
+    int    n     = ruleCount(s->g, nt);
+
+    for (int r = 0; r < n; r++) {
+        int c = s->rcost[nt][r];
+        w[r] = 0;
+        if (r == skip || c >= COST_INF)
+            continue;
+        w[r] = 1.0;
+        for (int i = 0; i < steps; i++)
+            w[r] /= 1.0 + c;
+        sum += w[r];
+    }
+    if (sum <= 0)
+        return s->shallow[nt];
+
+    double pick = randUnit(s) * sum;
+    for (int r = 0; r < n; r++) {
+        if (w[r] == 0)
+            continue;
+        if (pick < w[r])
+            return r;
+        pick -= w[r];
+    }
+    return n - 1;
+}
+
+static int chooseRule(GenState *s, int nt, int depth) {
+    int n = ruleCount(s->g, nt);
+    if (n == 1)
+        return 0;
+    if (depth >= s->maxDepth)
+        return s->shallow[nt];
+
+    int tail = s->tail[nt];
+    if (tail < 0)
+        return weightedRule(s, nt, depth, -1);
+
+    if (s->spine < 0)
+        s->spine = nt;
+    bool more = (nt == s->spine)
+                    ? s->res.bytes < s->size
+                    : randUnit(s) < LIST_CONTINUE * (1.0 - (double)depth / s->maxDepth);
+    return more ? tail : weightedRule(s, nt, depth, tail);
+}
+
+/* ---- spelling ---- */
+
+static const char *const fixedText[NUM_TOKENS] = {
+    [TK_ASSIGNOP] = "<---",       [TK_WITH] = "with",         [TK_PARAMETERS] = "parameters",
+    [TK_END] = "end",             [TK_WHILE] = "while",       [TK_UNION] = "union",
+    [TK_ENDUNION] = "endunion",   [TK_DEFINETYPE] = "definetype", [TK_AS] = "as",
+    [TK_TYPE] = "type",           [TK_MAIN] = "_main",        [TK_GLOBAL] = "global",
+    [TK_PARAMETER] = "parameter", [TK_LIST] = "list",         [TK_SQL] = "[",
+    [TK_SQR] = "]",               [TK_INPUT] = "input",       [TK_OUTPUT] = "output",
+    [TK_INT] = "int",             [TK_REAL] = "real",         [TK_COMMA] = ",",
+    [TK_SEM] = ";",               [TK_COLON] = ":",           [TK_DOT] = ".",
+    [TK_ENDWHILE] = "endwhile",   [TK_OP] = "(",              [TK_CL] = ")",
+    [TK_IF] = "if",               [TK_THEN] = "then",         [TK_ENDIF] = "endif",
+    [TK_READ] = "read",           [TK_WRITE] = "write",       [TK_RETURN] = "return",
+    [TK_PLUS] = "+",              [TK_MINUS] = "-",           [TK_MUL] = "*",
+    [TK_DIV] = "/",               [TK_CALL] = "call",         [TK_RECORD] = "record",
+    [TK_ENDRECORD] = "endrecord", [TK_ELSE] = "else",         [TK_AND] = "&&&",
+    [TK_OR] = "@@@",              [TK_NOT] = "~",             [TK_LT] = "<",
+    [TK_LE] = "<=",               [TK_EQ] = "==",             [TK_GT] = ">",
+    [TK_GE] = ">=",               [TK_NE] = "!=",
+};
+
+/* Lowercase names that are not keywords (field ids, record names, ...) */
+static const char *const words[] = {
+    "age", "balance", "count", "depth", "flag", "height", "key", "marks",
+    "name", "next", "price", "rate", "score", "size", "total", "value",
+};
+#define WORD_COUNT ((int)(sizeof words / sizeof words[0]))
+
+/* Text that the lexer rejects */
+static const char *const badText[] = { "$", "?", "12.5", "_", "#", "&&", "!", "@" };
+#define BAD_COUNT ((int)(sizeof badText / sizeof badText[0]))
+
+/* Text for one token: a constant, or formatted into 'buf' */
+static const char *spell(GenState *s, TOKEN_TYPE t, char *buf, size_t cap) {
+    switch (t) {
+    case TK_ID: {
+        /* [b-d][2-7][b-d]*[2-7]* */
+        int n = 0;
+        buf[n++] = (char)('b' + randBelow(s, 3));
+        buf[n++] = (char)('2' + randBelow(s, 6));
+        for (int i = randBelow(s, 4); i > 0; i--)
+            buf[n++] = (char)('b' + randBelow(s, 3));
+        for (int i = randBelow(s, 3); i > 0; i--)
+            buf[n++] = (char)('2' + randBelow(s, 6));
+        buf[n] = '\0';
+        return buf;
+    }
+    case TK_FIELDID:
+        return words[randBelow(s, WORD_COUNT)];
+    case TK_RUID:
+        snprintf(buf, cap, "#%s", words[randBelow(s, WORD_COUNT)]);
+        return buf;
+    case TK_FUNID: {
+        const char *w = words[randBelow(s, WORD_COUNT)];
+        snprintf(buf, cap, "_%s%d", w, randBelow(s, 100));
+        return buf;
+    }
+    case TK_NUM:
+        snprintf(buf, cap, "%d", randBelow(s, 10000));
+        return buf;
+    case TK_RNUM: {
+        /* one draw per statement, so the text does not depend on
+         * argument evaluation order */
+        int whole = randBelow(s, 1000);
+        int frac  = randBelow(s, 100);
+        if (randBelow(s, 4) == 0) {
+            const char *sign = (const char *[]){ "", "+", "-" }[randBelow(s, 3)];
+            snprintf(buf, cap, "%d.%02dE%s%02d", whole, frac, sign, randBelow(s, 40));
+        } else {
+            snprintf(buf, cap, "%d.%02d", whole, frac);
+        }
+        return buf;
+    }
+    default:
+        return fixedText[t] ? fixedText[t] : "";
+    }
+}
+
+/* Tokens that end a line in the generated text */
+static bool endsLine(TOKEN_TYPE t) {
+    return t == TK_SEM || t == TK_ENDRECORD || t == TK_ENDUNION || t == TK_ENDWHILE ||
+           t == TK_ENDIF || t == TK_ELSE || t == TK_THEN || t == TK_END;
+}
+
+static void flushOut(GenState *s) {
+    fwrite(s->outBuf, 1, s->outLen, s->out);
+    s->outLen = 0;
+}
+
+static void writeText(GenState *s, const char *text, bool lineEnd) {
+    size_t len = strlen(text);
+    if (s->outLen + len + 2 > sizeof s->outBuf)
+        flushOut(s);
+
+    char *p = s->outBuf + s->outLen;
+    if (!s->lineStart)
+        *p++ = ' ';
+    memcpy(p, text, len);
+    p += len;
+    if (lineEnd)
+        *p++ = '\n';
+
+    s->res.bytes += (uint64_t)(p - (s->outBuf + s->outLen));
+    s->res.tokens++;
+    s->outLen    = (size_t)(p - s->outBuf);
+    s->lineStart = lineEnd;
+}
+
+static void writeToken(GenState *s, TOKEN_TYPE t) {
+    char buf[64];
+    writeText(s, spell(s, t, buf, sizeof buf), endsLine(t));
+}
+
+static void emitToken(GenState *s, TOKEN_TYPE t) {
+    if (t == EPSILLON)
+        return;
+    if (s->errorRate <= 0 || randUnit(s) >= s->errorRate) {
+        writeToken(s, t);
+        return;
+    }
+
+    s->res.errors++;
+    switch (randBelow(s, 4)) {
+    case 0:     /* lexical: malformed text in place of the token */
+        writeText(s, badText[randBelow(s, BAD_COUNT)], endsLine(t));
+        break;
+    case 1:     /* syntax: token missing */
+        break;
+    case 2:     /* syntax: token doubled */
+        writeToken(s, t);
+        writeToken(s, t);
+        break;
+    default:    /* syntax: stray punctuation before the token */
+        writeToken(s, (TOKEN_TYPE[]){ TK_SEM, TK_CL, TK_COMMA, TK_ASSIGNOP }[randBelow(s, 4)]);
+        writeToken(s, t);
+        break;
+    }
+}
+
+static void expand(GenState *s, int nt, int depth) {
+    for (;;) {
+        const ProductionRule *rule = ruleAt(s->g, nt, chooseRule(s, nt, depth));
+        bool tail = isTailRule(rule, nt);
+        int  n    = tail ? rule->rhs_len - 1 : rule->rhs_len;
+
+        for (int k = 0; k < n; k++) {
+            GrammarSymbol sym = rule->rhs[k];
+            if (sym.isTerminal)
+                emitToken(s, sym.sym.t);
+            else
+                expand(s, sym.sym.nt, depth + 1);
+        }
+        if (!tail)
+            return;
+    }
+}
+
+/* ------------------------------------------------------------------
+ * generateProgram
+ * ------------------------------------------------------------------ */
+GenResult generateProgram(const Grammar *g, const GenOptions *opt, FILE *out) {
+    GenState *s  = (GenState *)malloc(sizeof(GenState));
+    s->g         = g;
+    s->out       = out;
+    s->rng       = seedState(opt->seed);
+    s->size      = opt->size;
+    s->errorRate = opt->errorRate;
+    s->maxDepth  = opt->maxDepth > 0 ? opt->maxDepth : GEN_DEFAULT_DEPTH;
+    s->spine     = -1;
+    s->lineStart = true;
+    s->res       = (GenResult){ 0, 0, 0 };
+    s->outLen    = 0;
+
+    computeCosts(s);
+    cacheRules(s);
+    expand(s, NT_PROGRAM, 0);
+    if (!s->lineStart) {
+        s->outBuf[s->outLen++] = '\n';
+        s->res.bytes++;
+    }
+    flushOut(s);
+
+    GenResult res = s->res;
+    free(s);
+    return res;
+}
+
+/* ------------------------------------------------------------------
+ * loadBenchProgram
+ * ------------------------------------------------------------------ */
+bool loadBenchProgram(const char *srcPath, const GenOptions *opt, BenchProgram *p) {
+    diagBuffer gdiag = createDiagBuffer();
+    p->T = loadGrammarTables(GRAMMAR_FILE, GRAMMAR_BLOB, gdiag);
+    diagFlush(gdiag, stderr);
+    freeDiagBuffer(gdiag);
+    if (p->T == NULL)
+        return false;
+
+    FILE *src = srcPath ? fopen(srcPath, "r") : tmpfile();
+    if (src == NULL) {
+        perror(srcPath ? srcPath : "tmpfile");
+        freeGrammarTables(p->T);
+        return false;
+    }
+    if (srcPath == NULL) {
+        generateProgram(p->T->g, opt, src);
+        rewind(src);
+    }
+    fseek(src, 0, SEEK_END);
+    p->bytes = ftell(src);
+    rewind(src);
+
+    diagBuffer pdiag = createDiagBuffer();
+    p->ast = parseSourceAST(p->T->pt, p->T->g, src, &p->arena, pdiag);
+    fclose(src);
+    diagFlush(pdiag, stderr);
+    freeDiagBuffer(pdiag);
+    if (p->ast == NULL) {
+        fprintf(stderr, "%s: no AST (syntax errors)\n", srcPath ? srcPath : "generated program");
+        freeGrammarTables(p->T);
+        return false;
+    }
+    return true;
+}
+
+uint64_t parseSize(const char *str) {
+    char              *end;
+    unsigned long long n = strtoull(str, &end, 10);
+    if (end == str)
+        return 0;
+
+    uint64_t unit = 1;
+    switch (toupper((unsigned char)*end)) {
+    case 'K': unit = 1ULL << 10; end++; break;
+    case 'M': unit = 1ULL << 20; end++; break;
+    case 'G': unit = 1ULL << 30; end++; break;
+    default:  break;
+    }
+    if (toupper((unsigned char)*end) == 'B')
+        end++;
+    if (*end != '\0' || n > UINT64_MAX / unit)
+        return 0;
+    return (uint64_t)n * unit;
+}
@@ -0,0 +1,65 @@
+#ifndef PROG_GEN_H
+#define PROG_GEN_H
+
+#include "ast.h"
+#include "grammarTable.h"
+#include "parserDef.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Synthetic source programs drawn from the grammar.  The generator
+ * walks the productions from <program>, choosing among a non-terminal's
+ * rules at random with weights that favour short rules more and more
+ * as the nesting gets deeper; from 'maxDepth' on it always takes the
+ * rule with the shallowest derivation, so every walk ends.  The
+ * outermost list (<otherFunctions>) keeps growing until 'size' bytes
+ * have been written, which gives programs from a few hundred bytes to
+ * many gigabytes in constant memory.
+ *
+ * With 'errorRate' > 0 each token is, with that probability, replaced
+ * by malformed text (a lexical error) or dropped / doubled (a syntax
+ * error).  The same options and seed always give the same program.
+ */
+typedef struct {
+    uint64_t size;          /* target size in bytes */
+    uint64_t seed;
+    double   errorRate;     /* per token, 0 for a valid program */
+    int      maxDepth;      /* 0 = default (GEN_DEFAULT_DEPTH) */
+} GenOptions;
+
+#define GEN_DEFAULT_DEPTH 24
+
+typedef struct {
+    uint64_t bytes;
+    uint64_t tokens;        /* tokens written, including injected ones */
+    uint64_t errors;        /* injected errors */
+} GenResult;
+
+/* Write one program for 'g' to 'out' */
+GenResult generateProgram(const Grammar *g, const GenOptions *opt, FILE *out);
+
+/* A benchmark's input, parsed once */
+typedef struct {
+    grammarTables T;
+    AstNode      *ast;
+    astArena      arena;
+    long          bytes;        /* source size */
+} BenchProgram;
+
+/*
+ * Load the tables, open 'srcPath' (or, if it is NULL, generate a program
+ * with 'opt') and parse it into an AST.  Returns false, with a message
+ * on stderr and nothing kept, if a step fails; otherwise the caller
+ * frees p->arena and p->T.
+ */
+bool loadBenchProgram(const char *srcPath, const GenOptions *opt, BenchProgram *p);
+
+/*
+ * Parse a size such as "4096", "64K", "16M" or "2G" (powers of 1024);
+ * returns 0 if it is malformed.
+ */
+uint64_t parseSize(const char *s);
+
+#endif /* PROG_GEN_H */
@@ -0,0 +1,21 @@
+#include "protocol.h"
+
+/*
+ * Headers are short and read one byte at a time, so nothing past the
+ * newline is consumed and the payload can follow with readFull().
+ */
+bool readHeader(int fd, char *line, size_t cap) {
+    size_t len = 0;
+    for (;;) {
+        char c;
+        if (!readFull(fd, &c, 1))
+            return false;
+        if (c == '\n')
+            break;
+        if (len + 1 >= cap)
+            return false;
+        line[len++] = c;
+    }
+    line[len] = '\0';
+    return true;
+}
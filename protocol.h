@@ -0,0 +1,35 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "fileIO.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Compile-server wire format (Unix-domain stream socket).  A connection
+ * carries any number of request / response pairs.
+ *
+ *   request:   "<command> <kind> <length>\n" then <length> payload bytes
+ *              command  lex | parse | check | quit
+ *              kind     path   — payload is a file name on the server
+ *                       source — payload is the source text itself
+ *   response:  "<status> <diagLength> <outputLength>\n" then the
+ *              diagnostics and the output, back to back
+ *              status   ok   — no lexical or syntax errors
+ *                       fail — errors; they are in the diagnostics
+ *                       bad  — malformed request or unreadable file
+ *
+ * 'lex' returns the token listing, 'parse' the parse tree listing and
+ * 'check' no output.  'quit' stops the server once it has replied.
+ */
+
+/* Longest header line, newline included */
+#define PROTO_MAX_HEADER  128
+
+/* Largest payload or response part accepted */
+#define PROTO_MAX_PAYLOAD (64u << 20)
+
+/* Read one header line into 'line' (newline stripped); false on EOF/error */
+bool readHeader(int fd, char *line, size_t cap);
+
+#endif /* PROTOCOL_H */
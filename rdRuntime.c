@@ -0,0 +1,114 @@
+#include "rdRuntime.h"
+#include "lexer.h"
+#include "utils.h"
+
+/* ------------------------------------------------------------------
+ * rdMismatch
+ *
+ * Terminal in the rule body does not match the lookahead.  Report
+ * (once per line), then skip to the expected token, end of input or a
+ * statement delimiter a caller can accept; unless the expected token
+ * was found, the terminal is treated as missing.
+ * ------------------------------------------------------------------ */
+void rdMismatch(RDState *st, ParseTreeNode *nd, TOKEN_TYPE expected, uint64_t below) {
+    st->hadError = true;
+    if (st->la->type == DOLLAR) {
+        st->halted = true;
+        return;
+    }
+    if (st->lastErrLine != st->la->line) {
+        st->lastErrLine = st->la->line;
+        diagPrintf(st->diag,
+                   "Line %02d: Syntax Error : Token %s (lexeme \"%s\") "
+                   "does not match expected token %s\n",
+                   st->la->line,
+                   getTokenName(st->la->type),
+                   st->la->lexeme,
+                   getTokenName(expected));
+    }
+
+    uint64_t stop = TOKEN_BIT(expected) | TOKEN_BIT(DOLLAR) | (STMT_SYNC_SET & below);
+    while (!(stop & TOKEN_BIT(st->la->type)))
+        rdAdvance(st);
+    if (st->la->type == expected)
+        rdFill(st, nd);
+}
+
+/* ------------------------------------------------------------------
+ * rdRecover
+ *
+ * Error or sync cell for 'nt'.  Report (once per line), then skip to
+ * the first token in rdRecoverSet[nt] or a statement delimiter a caller
+ * can accept.  Returns true if that token starts 'nt' (the caller
+ * retries the switch), false if 'nt' should be abandoned — including
+ * at end of input.
+ * ------------------------------------------------------------------ */
+bool rdRecover(RDState *st, NON_TERMINAL nt, bool syncCell, uint64_t below) {
+    st->hadError = true;
+    if (st->la->type == DOLLAR) {
+        st->halted = true;
+        return false;
+    }
+    if (st->lastErrLine != st->la->line) {
+        st->lastErrLine = st->la->line;
+        diagPrintf(st->diag,
+                   "Line %02d: Syntax Error : Unexpected token %s "
+                   "(lexeme \"%s\") while expanding %s%s\n",
+                   st->la->line,
+                   getTokenName(st->la->type),
+                   st->la->lexeme,
+                   getNonTerminal(nt),
+                   syncCell ? " — popping" : "");
+    }
+
+    uint64_t stop = rdRecoverSet[nt] | (STMT_SYNC_SET & below);
+    while (!(stop & TOKEN_BIT(st->la->type)))
+        rdAdvance(st);
+    return (rdStartSet[nt] & TOKEN_BIT(st->la->type)) != 0;
+}
+
+/* ------------------------------------------------------------------
+ * parseTokensRD
+ * ------------------------------------------------------------------ */
+ParseTreeNode *parseTokensRD(tokenStream ts, diagBuffer diag, bool *hadError) {
+    RDState st;
+    st.la          = &ts->toks[0];
+    st.last        = &ts->toks[ts->count - 1];
+    st.lastErrLine = -1;
+    st.hadError    = false;
+    st.halted      = false;
+    st.diag        = diag;
+
+    ParseTreeNode *root = rdNode(NULL, false, NT_PROGRAM);
+    rdParse(&st, NT_PROGRAM, root);
+
+    /* Same post-parse checks as the table-driven loop */
+    if (st.halted) {
+        st.hadError = true;
+        diagPrintf(diag, "Syntax Error : Input consumed but symbol stack is not empty\n");
+    } else if (st.la->type != DOLLAR) {
+        st.hadError = true;
+        diagPrintf(diag, "Syntax Error : Symbol stack empty but input not fully consumed\n");
+    }
+
+    *hadError = st.hadError;
+    return root;
+}
+
+/* ------------------------------------------------------------------
+ * parseSourceRD
+ * ------------------------------------------------------------------ */
+ParseTreeNode *parseSourceRD(FILE *src) {
+    tokenStream ts = tokenizeSource(src);
+
+    bool hadError;
+    ParseTreeNode *root = parseTokensRD(ts, NULL, &hadError);
+    freeTokenStream(ts);
+
+    if (!hadError)
+        printf("COMPILATION SUCCESS!\n");
+    else
+        printf("COMPILATION FAILED\n");
+
+    return root;
+}
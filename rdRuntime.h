@@ -0,0 +1,99 @@
+#ifndef RD_RUNTIME_H
+#define RD_RUNTIME_H
+
+#include "diag.h"
+#include "lexerDef.h"
+#include "memTrack.h"
+#include "parserDef.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Support code for the recursive-descent parser that rdgen generates
+ * from the grammar (parserRD.c).  The generated functions build exactly
+ * the tree the table-driven parser builds and follow the same error
+ * recovery: panic mode over the table's precomputed recovery sets, and
+ * stop as soon as an error is hit at end of input.
+ */
+
+/* Parser state shared by all generated functions */
+typedef struct {
+    TOKEN      *la;           /* current lookahead (inside the token array) */
+    TOKEN      *last;         /* the trailing DOLLAR entry */
+    int         lastErrLine;
+    bool        hadError;
+    bool        halted;       /* error at end of input — unwind everything */
+    diagBuffer  diag;
+} RDState;
+
+/* Generated: parse 'start' into the (already allocated) node 'nd' */
+void rdParse(RDState *st, NON_TERMINAL start, ParseTreeNode *nd);
+
+/* Generated: copies of ParseTable.start and ParseTable.recover */
+extern const uint64_t rdStartSet[NON_TERMINAL_COUNT];
+extern const uint64_t rdRecoverSet[NON_TERMINAL_COUNT];
+
+/*
+ * Error paths, kept out of line.  'below' is every token the callers up
+ * the chain can still accept — the table parser's accStack entry.
+ */
+void rdMismatch(RDState *st, ParseTreeNode *nd, TOKEN_TYPE expected, uint64_t below);
+bool rdRecover(RDState *st, NON_TERMINAL nt, bool syncCell, uint64_t below);
+
+/*
+ * Parse a lexed file with the generated parser.  Errors go to 'diag'
+ * (stdout if NULL); no banner is printed.
+ */
+ParseTreeNode *parseTokensRD(tokenStream ts, diagBuffer diag, bool *hadError);
+
+/* Lex and parse a whole file, printing COMPILATION SUCCESS/FAILED */
+ParseTreeNode *parseSourceRD(FILE *src);
+
+/* ---- Hot helpers used by every generated function ---- */
+
+static inline void rdAdvance(RDState *st) {
+    if (st->la != st->last)
+        st->la++;
+}
+
+static inline ParseTreeNode *rdNode(ParseTreeNode *par, bool isTerminal, int sym) {
+    ParseTreeNode *nd   = (ParseTreeNode *)memAlloc(MEM_TREE, sizeof(ParseTreeNode));
+    nd->data.sym.isTerminal = isTerminal;
+    if (isTerminal)
+        nd->data.sym.sym.t  = (TOKEN_TYPE)sym;
+    else
+        nd->data.sym.sym.nt = (NON_TERMINAL)sym;
+    nd->data.line       = -1;
+    nd->data.lexeme     = NULL;
+    nd->data.lexemeSize = 0;
+    nd->parent          = par;
+    nd->child_count     = 0;
+    return nd;
+}
+
+/* Copy the lookahead into a terminal leaf and consume it */
+static inline void rdFill(RDState *st, ParseTreeNode *nd) {
+    nd->data.sym.isTerminal = true;
+    nd->data.sym.sym.t      = st->la->type;
+    nd->data.line           = st->la->line;
+    nd->data.lexeme         = st->la->lexeme;
+    nd->data.lexemeSize     = st->la->lexemeSize;
+    rdAdvance(st);
+}
+
+static inline void rdMatch(RDState *st, ParseTreeNode *nd, TOKEN_TYPE t, uint64_t below) {
+    if (st->halted)
+        return;
+    if (st->la->type == t)
+        rdFill(st, nd);
+    else
+        rdMismatch(st, nd, t, below);
+}
+
+/* ε-rule: a single EPSILLON leaf */
+static inline void rdEpsilon(ParseTreeNode *nd) {
+    nd->child_count = 1;
+    nd->children[0] = rdNode(nd, true, EPSILLON);
+}
+
+#endif /* RD_RUNTIME_H */
@@ -0,0 +1,122 @@
+/*
+ * rdbench — compare the table-driven parser with the generated
+ * recursive-descent parser on the same token array.
+ *
+ *     ./rdbench <source_file> [runs]
+ *
+ * The file is lexed once; each parser then builds (and frees) the full
+ * tree 'runs' times.  Reports the best tokens/sec of each and, where
+ * the kernel allows perf counters, retired instructions per token.
+ */
+#define _DEFAULT_SOURCE     /* syscall() */
+#include "grammarTable.h"
+#include "lexer.h"
+#include "parser.h"
+#include "rdRuntime.h"
+#include "utils.h"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Open a user-space instruction counter; -1 if unavailable */
+static int openInstrCounter(void) {
+    struct perf_event_attr pe = { 0 };
+    pe.type           = PERF_TYPE_HARDWARE;
+    pe.size           = sizeof(pe);
+    pe.config         = PERF_COUNT_HW_INSTRUCTIONS;
+    pe.disabled       = 1;
+    pe.exclude_kernel = 1;
+    pe.exclude_hv     = 1;
+    return (int)syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0);
+}
+
+static double nowSec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    double    bestSec;
+    long long instr;      /* from the best run, -1 if not measured */
+} BenchResult;
+
+static BenchResult benchParser(bool useRD, const ParseTable *pt, const Grammar *g,
+                               tokenStream ts, int runs, int counterFd) {
+    BenchResult br = { 1e30, -1 };
+    diagBuffer  sink = createDiagBuffer();
+
+    for (int r = 0; r < runs; r++) {
+        bool hadError;
+        if (counterFd >= 0) {
+            ioctl(counterFd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(counterFd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        double t0 = nowSec();
+        ParseTreeNode *root = useRD ? parseTokensRD(ts, sink, &hadError)
+                                    : parseTokenStream(pt, g, ts, sink, &hadError);
+        double t1 = nowSec();
+        long long count = -1;
+        if (counterFd >= 0) {
+            ioctl(counterFd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(counterFd, &count, sizeof(count)) != sizeof(count))
+                count = -1;
+        }
+
+        if (t1 - t0 < br.bestSec) {
+            br.bestSec = t1 - t0;
+            br.instr   = count;
+        }
+        freeParseTree(root);
+        diagFlush(sink, stderr);
+    }
+
+    freeDiagBuffer(sink);
+    return br;
+}
+
+static void report(const char *name, BenchResult br, int nTokens) {
+    printf("%-14s %12.0f tokens/sec", name, nTokens / br.bestSec);
+    if (br.instr >= 0)
+        printf("   %8.1f instr/token\n", (double)br.instr / nTokens);
+    else
+        printf("   instr/token n/a\n");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s <source_file> [runs]\n", argv[0]);
+        return 1;
+    }
+    int runs = (argc == 3) ? atoi(argv[2]) : 20;
+    if (runs < 1)
+        runs = 1;
+
+    FILE *src = fopen(argv[1], "r");
+    if (!src) { perror(argv[1]); return 1; }
+
+    grammarTables T = loadGrammarTables(GRAMMAR_FILE, GRAMMAR_BLOB, NULL);
+    if (T == NULL)
+        return 1;
+
+    tokenStream ts = tokenizeSource(src);
+    fclose(src);
+    int nTokens = ts->count;
+
+    int fd = openInstrCounter();
+    BenchResult table = benchParser(false, T->pt, T->g, ts, runs, fd);
+    BenchResult rd    = benchParser(true,  T->pt, T->g, ts, runs, fd);
+    if (fd >= 0)
+        close(fd);
+
+    printf("%d tokens, best of %d runs\n", nTokens, runs);
+    report("table-driven", table, nTokens);
+    report("generated RD", rd, nTokens);
+    printf("speedup        %12.2fx\n", table.bestSec / rd.bestSec);
+
+    freeTokenStream(ts);
+    freeGrammarTables(T);
+    return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * rdgen — emit a recursive-descent parser specialised to the grammar.
+ *
+ * Reads the grammar file (grammar.bnf by default), builds the LL(1)
+ * table the same way the driver does, and writes C source to stdout
+ * with one function per non-terminal.  Each function switches on the
+ * lookahead and calls the functions for the rule body directly; self
+ * right recursion (<otherStmts> ==> <stmt> <otherStmts> etc.) becomes
+ * a loop.
+ *
+ *     ./rdgen [grammar_file] > parserRD.c
+ */
+#include "grammarTable.h"
+#include "lexer.h"
+#include "parser.h"
+#include "utils.h"
+#include <stdio.h>
+
+/* True for columns that can actually show up as a lookahead */
+static bool isLookahead(int col) {
+    return col < NULL_TOKEN || col == DOLLAR;
+}
+
+/* Emit "case A: case B: ..." for every column holding 'value' */
+static bool emitCases(const ParseTable *pt, int nt, int value) {
+    bool any = false;
+    for (int col = 0; col < NUM_TOKENS; col++) {
+        if (!isLookahead(col) || pt->cell[nt][col] != value)
+            continue;
+        printf("        case %s:\n", getTokenName((TOKEN_TYPE)col));
+        any = true;
+    }
+    return any;
+}
+
+/*
+ * Argument for the 'below' parameter of rule symbol k: what the caller's
+ * stack accepts plus what the rest of the rule body (k+1 ..) accepts,
+ * i.e. the accStack entry runParser would have under that symbol.
+ */
+static void emitBelow(const ParseTable *pt, const ProductionRule *rule, int k) {
+    uint64_t rest = 0;
+    for (int j = k + 1; j < rule->rhs_len; j++) {
+        GrammarSymbol s = rule->rhs[j];
+        rest |= s.isTerminal ? TOKEN_BIT(s.sym.t) : pt->start[s.sym.nt];
+    }
+    if (rest)
+        printf("below | 0x%016llxULL", (unsigned long long)rest);
+    else
+        printf("below");
+}
+
+static void emitRule(const Grammar *g, const ParseTable *pt, int nt, int r) {
+    const ProductionRule *rule = &g->prods[nt][r];
+
+    printf("        {\n");
+    for (int k = 0; k < rule->rhs_len; k++) {
+        GrammarSymbol s = rule->rhs[k];
+        if (s.isTerminal)
+            printf("            ParseTreeNode *c%d = rdNode(nd, true, %s);\n",
+                   k, getTokenName(s.sym.t));
+        else
+            printf("            ParseTreeNode *c%d = rdNode(nd, false, %d);\n",
+                   k, (int)s.sym.nt);
+    }
+    printf("            nd->child_count = %d;\n", rule->rhs_len);
+    for (int k = 0; k < rule->rhs_len; k++)
+        printf("            nd->children[%d] = c%d;\n", k, k);
+
+    bool tailLoop = false;
+    for (int k = 0; k < rule->rhs_len; k++) {
+        GrammarSymbol s = rule->rhs[k];
+        if (s.isTerminal) {
+            printf("            rdMatch(st, c%d, %s, ", k, getTokenName(s.sym.t));
+            emitBelow(pt, rule, k);
+            printf(");\n");
+        } else if (k == rule->rhs_len - 1 && (int)s.sym.nt == nt) {
+            /* nothing follows it, so 'below' carries over unchanged */
+            printf("            nd = c%d;\n", k);
+            tailLoop = true;
+        } else {
+            printf("            rd_nt%d(st, c%d, ", (int)s.sym.nt, k);
+            emitBelow(pt, rule, k);
+            printf(");\n");
+        }
+    }
+    printf(tailLoop ? "            continue;\n" : "            return;\n");
+    printf("        }\n");
+}
+
+static void emitNonTerminal(const Grammar *g, const ParseTable *pt, int nt) {
+    printf("\n/* <%s> */\n", getNonTerminal((NON_TERMINAL)nt));
+    printf("static void rd_nt%d(RDState *st, ParseTreeNode *nd, uint64_t below) {\n", nt);
+    printf("    for (;;) {\n");
+    printf("        if (st->halted)\n");
+    printf("            return;\n");
+    printf("        switch (st->la->type) {\n");
+
+    int rules = g->prod_count[nt] + (g->has_eps[nt] ? 1 : 0);
+    for (int r = 0; r < rules; r++) {
+        if (!emitCases(pt, nt, r))
+            continue;
+        if (g->has_eps[nt] && r == g->prod_count[nt]) {
+            printf("            rdEpsilon(nd);\n");
+            printf("            return;\n");
+        } else {
+            emitRule(g, pt, nt, r);
+        }
+    }
+
+    if (emitCases(pt, nt, -2)) {
+        printf("            if (rdRecover(st, %d, true, below))\n", nt);
+        printf("                continue;\n");
+        printf("            return;\n");
+    }
+
+    printf("        default:\n");
+    printf("            if (rdRecover(st, %d, false, below))\n", nt);
+    printf("                continue;\n");
+    printf("            return;\n");
+    printf("        }\n");
+    printf("    }\n");
+    printf("}\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *bnfPath = (argc > 1) ? argv[1] : GRAMMAR_FILE;
+
+    diagBuffer    diag = createDiagBuffer();
+    grammarTables T    = loadGrammarTables(bnfPath, NULL, diag);
+    diagFlush(diag, stderr);
+    freeDiagBuffer(diag);
+    if (T == NULL)
+        return 1;
+    const Grammar    *G  = T->g;
+    const ParseTable *PT = T->pt;
+
+    printf("/*\n"
+           " * parserRD.c — GENERATED by rdgen from %s.\n"
+           " * Do not edit; rerun `make parserRD.c` after grammar changes.\n"
+           " */\n"
+           "#include \"rdRuntime.h\"\n\n", bnfPath);
+
+    printf("const uint64_t rdStartSet[NON_TERMINAL_COUNT] = {\n");
+    for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++)
+        printf("    0x%016llxULL,\n", (unsigned long long)PT->start[nt]);
+    printf("};\n\n");
+
+    printf("const uint64_t rdRecoverSet[NON_TERMINAL_COUNT] = {\n");
+    for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++)
+        printf("    0x%016llxULL,\n", (unsigned long long)PT->recover[nt]);
+    printf("};\n\n");
+
+    for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++)
+        printf("static void rd_nt%d(RDState *st, ParseTreeNode *nd, uint64_t below);\n", nt);
+
+    for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++)
+        emitNonTerminal(G, PT, nt);
+
+    printf("\nvoid rdParse(RDState *st, NON_TERMINAL start, ParseTreeNode *nd) {\n");
+    printf("    switch (start) {\n");
+    for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++)
+        printf("    case %d: rd_nt%d(st, nd, TOKEN_BIT(DOLLAR)); break;\n", nt, nt);
+    printf("    }\n");
+    printf("}\n");
+
+    freeGrammarTables(T);
+    return 0;
+}
@@ -0,0 +1,262 @@
+#include "server.h"
+#include "compilerCtx.h"
+#include "lexer.h"
+#include "protocol.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+typedef struct Connection Connection;
+
+typedef struct {
+    const Grammar    *g;
+    const ParseTable *pt;
+    int               listenFd;
+    atomic_bool       quit;
+    pthread_mutex_t   lock;
+    pthread_cond_t    idle;
+    int               active;   /* connections still being served */
+    Connection       *live;     /* those connections, under 'lock' */
+} ServerShared;
+
+struct Connection {
+    ServerShared *sh;
+    int           fd;
+    Connection   *prev, *next;
+};
+
+/*
+ * Stop the server: no more accepts, and every live connection sees end
+ * of input at its next read, so an idle client cannot hold up shutdown.
+ * A request already being served still gets its response.
+ */
+static void stopServer(ServerShared *sh) {
+    pthread_mutex_lock(&sh->lock);
+    atomic_store(&sh->quit, true);
+    shutdown(sh->listenFd, SHUT_RDWR);   /* wakes accept() */
+    for (Connection *c = sh->live; c != NULL; c = c->next)
+        shutdown(c->fd, SHUT_RD);
+    pthread_mutex_unlock(&sh->lock);
+}
+
+/* Token listing in the format of getStream() */
+static void writeTokens(tokenStream ts, FILE *out) {
+    for (int i = 0; i < ts->count; i++) {
+        const TOKEN *t = &ts->toks[i];
+        if (t->type == DOLLAR)
+            break;
+        fprintf(out, "Line no. %d  Lexeme %-20s  Token %s\n",
+                t->line, t->lexeme, getTokenName(t->type));
+    }
+}
+
+static bool sendResponse(int fd, const char *status,
+                         const char *diag, size_t diagLen,
+                         const char *out, size_t outLen) {
+    char head[PROTO_MAX_HEADER];
+    int  n = snprintf(head, sizeof head, "%s %zu %zu\n", status, diagLen, outLen);
+    return writeFull(fd, head, (size_t)n) &&
+           writeFull(fd, diag, diagLen) &&
+           writeFull(fd, out, outLen);
+}
+
+static bool sendBad(int fd, const char *why) {
+    return sendResponse(fd, "bad", why, strlen(why), "", 0);
+}
+
+/*
+ * Serve one request whose payload is already in memory.  Returns false
+ * if the connection should be dropped.
+ */
+static bool handleRequest(ServerShared *sh, int fd, const char *cmd,
+                          const char *kind, char *payload, size_t len) {
+    bool isLex   = strcmp(cmd, "lex") == 0;
+    bool isParse = strcmp(cmd, "parse") == 0;
+    bool isCheck = strcmp(cmd, "check") == 0;
+    if (!isLex && !isParse && !isCheck)
+        return sendBad(fd, "unknown command\n");
+
+    FILE *src;
+    if (strcmp(kind, "path") == 0)
+        src = fopen(payload, "r");
+    else if (strcmp(kind, "source") == 0)
+        src = (len > 0) ? fmemopen(payload, len, "r") : fopen("/dev/null", "r");
+    else
+        return sendBad(fd, "unknown payload kind\n");
+    if (src == NULL)
+        return sendBad(fd, "cannot open source\n");
+
+    char  *outBuf = NULL;
+    size_t outLen = 0;
+    FILE  *out    = isCheck ? NULL : open_memstream(&outBuf, &outLen);
+
+    compilerCtx ctx = createCompilerCtx(sh->g, sh->pt, out);
+    if (isLex) {
+        compileTokenize(ctx, src);
+        writeTokens(ctx->tokens, out);
+    } else {
+        compileSource(ctx, src);
+        compileWriteTree(ctx);
+    }
+    fclose(src);
+    if (out != NULL)
+        fclose(out);
+
+    bool ok = sendResponse(fd, ctx->hadError ? "fail" : "ok",
+                           ctx->diag->text, (size_t)ctx->diag->len,
+                           outBuf ? outBuf : "", outLen);
+    freeCompilerCtx(ctx);
+    free(outBuf);
+    return ok;
+}
+
+static void *serveConnection(void *arg) {
+    Connection   *c  = (Connection *)arg;
+    ServerShared *sh = c->sh;
+    char          head[PROTO_MAX_HEADER];
+
+    while (readHeader(c->fd, head, sizeof head)) {
+        char   cmd[16], kind[16];
+        size_t len;
+        if (sscanf(head, "%15s %15s %zu", cmd, kind, &len) != 3 ||
+            len > PROTO_MAX_PAYLOAD) {
+            sendBad(c->fd, "malformed header\n");
+            break;
+        }
+
+        char *payload = (char *)malloc(len + 1);
+        if (!readFull(c->fd, payload, len)) {
+            free(payload);
+            break;
+        }
+        payload[len] = '\0';
+
+        if (strcmp(cmd, "quit") == 0) {
+            free(payload);
+            sendResponse(c->fd, "ok", "", 0, "", 0);
+            stopServer(sh);
+            break;
+        }
+
+        bool keep = handleRequest(sh, c->fd, cmd, kind, payload, len);
+        free(payload);
+        if (!keep)
+            break;
+    }
+
+    /* Unlink before closing, so stopServer never shuts down a reused fd */
+    pthread_mutex_lock(&sh->lock);
+    if (c->prev != NULL)
+        c->prev->next = c->next;
+    else
+        sh->live = c->next;
+    if (c->next != NULL)
+        c->next->prev = c->prev;
+    if (--sh->active == 0)
+        pthread_cond_signal(&sh->idle);
+    pthread_mutex_unlock(&sh->lock);
+
+    close(c->fd);
+    free(c);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------
+ * runServer
+ * ------------------------------------------------------------------ */
+int runServer(const char *sockPath, const Grammar *g, const ParseTable *pt) {
+    struct sockaddr_un addr;
+    if (strlen(sockPath) >= sizeof addr.sun_path) {
+        fprintf(stderr, "%s: socket path too long\n", sockPath);
+        return 1;
+    }
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, sockPath);
+
+    /* A client that hangs up mid-response must not kill the server */
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) { perror("socket"); return 1; }
+    unlink(sockPath);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof addr) != 0 || listen(fd, 64) != 0) {
+        perror(sockPath);
+        close(fd);
+        return 1;
+    }
+
+    ServerShared sh;
+    sh.g        = g;
+    sh.pt       = pt;
+    sh.listenFd = fd;
+    sh.active   = 0;
+    sh.live     = NULL;
+    atomic_init(&sh.quit, false);
+    pthread_mutex_init(&sh.lock, NULL);
+    pthread_cond_init(&sh.idle, NULL);
+    keywordTable();     /* build the shared trie before any worker lexes */
+    fprintf(stderr, "Serving on %s\n", sockPath);
+
+    while (!atomic_load(&sh.quit)) {
+        int cfd = accept(fd, NULL, NULL);
+        if (cfd < 0) {
+            if (atomic_load(&sh.quit))
+                break;
+            continue;
+        }
+
+        Connection *c = (Connection *)malloc(sizeof(Connection));
+        c->sh   = &sh;
+        c->fd   = cfd;
+        c->prev = NULL;
+
+        /* Accepted just as another client quit: let it see end of input */
+        pthread_mutex_lock(&sh.lock);
+        if (atomic_load(&sh.quit))
+            shutdown(cfd, SHUT_RD);
+        c->next = sh.live;
+        if (sh.live != NULL)
+            sh.live->prev = c;
+        sh.live = c;
+        sh.active++;
+        pthread_mutex_unlock(&sh.lock);
+
+        pthread_t      th;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&th, &attr, serveConnection, c) != 0) {
+            pthread_mutex_lock(&sh.lock);
+            sh.live = c->next;
+            if (c->next != NULL)
+                c->next->prev = NULL;
+            sh.active--;
+            pthread_mutex_unlock(&sh.lock);
+            close(cfd);
+            free(c);
+        }
+        pthread_attr_destroy(&attr);
+    }
+
+    /* The tables are freed by the caller: let open connections finish */
+    pthread_mutex_lock(&sh.lock);
+    while (sh.active > 0)
+        pthread_cond_wait(&sh.idle, &sh.lock);
+    pthread_mutex_unlock(&sh.lock);
+    pthread_mutex_destroy(&sh.lock);
+    pthread_cond_destroy(&sh.idle);
+
+    close(fd);
+    unlink(sockPath);
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "parserDef.h"
+
+/*
+ * Persistent compile server.  Listens on the Unix-domain socket
+ * 'sockPath' (a stale socket file is replaced) and answers requests in
+ * the format of protocol.h using the already-loaded grammar and table.
+ * Each connection is served on its own thread with its own compiler
+ * context.  Returns once a 'quit' request has been answered and the
+ * other connections have finished the request in hand, if any (their
+ * next read sees end of input); the return value is the exit status
+ * (non-zero if the socket could not be set up).
+ */
+int runServer(const char *sockPath, const Grammar *g, const ParseTable *pt);
+
+#endif /* SERVER_H */
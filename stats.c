@@ -0,0 +1,88 @@
+#include "stats.h"
+#include "lexer.h"
+#include "utils.h"
+#include <string.h>
+
+#ifdef FRONTEND_STATS
+_Thread_local FrontendStats feStats;
+#else
+static const FrontendStats noStats;
+#endif
+
+void resetFrontendStats(void) {
+#ifdef FRONTEND_STATS
+    memset(&feStats, 0, sizeof feStats);
+#endif
+}
+
+const FrontendStats *frontendStats(void) {
+#ifdef FRONTEND_STATS
+    return &feStats;
+#else
+    return &noStats;
+#endif
+}
+
+void mergeFrontendStats(const FrontendStats *from) {
+#ifdef FRONTEND_STATS
+    feStats.bytesRead        += from->bytesRead;
+    feStats.bufferRefills    += from->bufferRefills;
+    feStats.dfaTransitions   += from->dfaTransitions;
+    feStats.keywordLookups   += from->keywordLookups;
+    feStats.lexemesAllocated += from->lexemesAllocated;
+    feStats.lexemeBytes      += from->lexemeBytes;
+    for (int t = 0; t < NUM_TOKENS; t++)
+        feStats.tokens[t] += from->tokens[t];
+
+    feStats.tableLookups += from->tableLookups;
+    for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++)
+        feStats.ruleExpansions[nt] += from->ruleExpansions[nt];
+    feStats.recoverySkips += from->recoverySkips;
+    STAT_MAX(peakStackDepth, from->peakStackDepth);
+    feStats.treeNodes += from->treeNodes;
+#else
+    (void)from;
+#endif
+}
+
+void printStatsJson(const FrontendStats *st, FILE *out) {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"enabled\": %s,\n",
+#ifdef FRONTEND_STATS
+            "true"
+#else
+            "false"
+#endif
+    );
+    fprintf(out, "  \"bytes_read\": %ld,\n",        st->bytesRead);
+    fprintf(out, "  \"buffer_refills\": %ld,\n",    st->bufferRefills);
+    fprintf(out, "  \"dfa_transitions\": %ld,\n",   st->dfaTransitions);
+    fprintf(out, "  \"keyword_lookups\": %ld,\n",   st->keywordLookups);
+    fprintf(out, "  \"lexemes_allocated\": %ld,\n", st->lexemesAllocated);
+    fprintf(out, "  \"lexeme_bytes\": %ld,\n",      st->lexemeBytes);
+    fprintf(out, "  \"table_lookups\": %ld,\n",     st->tableLookups);
+    fprintf(out, "  \"recovery_skips\": %ld,\n",    st->recoverySkips);
+    fprintf(out, "  \"peak_stack_depth\": %ld,\n",  st->peakStackDepth);
+    fprintf(out, "  \"tree_nodes\": %ld,\n",        st->treeNodes);
+
+    fprintf(out, "  \"tokens\": {");
+    const char *sep = "";
+    for (int t = 0; t < NUM_TOKENS; t++) {
+        if (st->tokens[t] == 0)
+            continue;
+        fprintf(out, "%s\n    \"%s\": %ld", sep, getTokenName((TOKEN_TYPE)t), st->tokens[t]);
+        sep = ",";
+    }
+    fprintf(out, "%s},\n", *sep ? "\n  " : "");
+
+    fprintf(out, "  \"rules\": {");
+    sep = "";
+    for (int nt = 0; nt < NON_TERMINAL_COUNT; nt++) {
+        if (st->ruleExpansions[nt] == 0)
+            continue;
+        fprintf(out, "%s\n    \"%s\": %ld", sep, getNonTerminal((NON_TERMINAL)nt),
+                st->ruleExpansions[nt]);
+        sep = ",";
+    }
+    fprintf(out, "%s}\n}\n", *sep ? "\n  " : "");
+}
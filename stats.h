@@ -0,0 +1,60 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "lexerDef.h"
+#include "parserDef.h"
+#include <stdio.h>
+
+/*
+ * Front-end work counters.  They are compiled in only with
+ * -DFRONTEND_STATS (`make STATS=1`); otherwise every STAT_* macro is
+ * empty and the hot paths are unchanged.  Counters are per thread; the
+ * worker pool and the pipelined lexer add their threads' counters to
+ * the joining thread's, so after a batch, parallel or pipelined run the
+ * caller's block covers all of the work.
+ */
+typedef struct {
+    /* lexer */
+    long bytesRead;                         /* source bytes pulled into the twin buffer */
+    long bufferRefills;                     /* populate_buffer calls */
+    long dfaTransitions;
+    long keywordLookups;                    /* trie searches */
+    long lexemesAllocated;
+    long lexemeBytes;
+    long tokens[NUM_TOKENS];                /* tokens handed to the parser, by type */
+
+    /* parser */
+    long tableLookups;                      /* parse table cells read */
+    long ruleExpansions[NON_TERMINAL_COUNT];
+    long recoverySkips;                     /* tokens discarded by panic mode */
+    long peakStackDepth;
+    long treeNodes;
+} FrontendStats;
+
+#ifdef FRONTEND_STATS
+extern _Thread_local FrontendStats feStats;
+#define STAT_ADD(field, n)  (feStats.field += (n))
+#define STAT_INC(field)     (feStats.field++)
+#define STAT_MAX(field, v)  do { if ((long)(v) > feStats.field) feStats.field = (long)(v); } while (0)
+#else
+#define STAT_ADD(field, n)  ((void)0)
+#define STAT_INC(field)     ((void)0)
+#define STAT_MAX(field, v)  ((void)0)
+#endif
+
+/* Zero the calling thread's counters */
+void resetFrontendStats(void);
+
+/* The calling thread's counters (all zero when compiled out) */
+const FrontendStats *frontendStats(void);
+
+/* Add another thread's counters to the calling thread's (peaks: the larger) */
+void mergeFrontendStats(const FrontendStats *from);
+
+/*
+ * One JSON object: scalar counters, then "tokens" and "rules" objects
+ * keyed by token / non-terminal name (zero entries left out).
+ */
+void printStatsJson(const FrontendStats *st, FILE *out);
+
+#endif /* STATS_H */
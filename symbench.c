@@ -0,0 +1,161 @@
+/*
+ * symbench — symbol table build and lookup throughput.
+ *
+ *     ./symbench [--size=N[K|M|G]] [--seed=N] [--runs=N] [source_file]
+ *
+ * Without a file a valid program of --size bytes (default 4M, which
+ * has tens of thousands of distinct identifiers) is generated as srcgen
+ * would.  The program is parsed into an AST once; then, N times
+ * (default 5), the symbol table is built from it and every identifier
+ * use in a function body is resolved in that function's scope, first
+ * by interned id and then by text (hashing the name each time).  Every
+ * field of every record is looked up as well.  Reports the median time
+ * and operations per second of each phase (the build per AST node),
+ * and the table's memory against the AST's.
+ */
+#include "ast.h"
+#include "bench.h"
+#include "grammarTable.h"
+#include "progGen.h"
+#include "symbolTable.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    int         scope;
+    uint32_t    name;
+    const char *text;
+} Use;
+
+typedef struct {
+    Use *uses;
+    int  n;
+    int  cap;
+} UseList;
+
+/* Names of variables read or written in an expression or statement list */
+static void collectUses(const AstNode *n, int scope, UseList *u) {
+    for (; n != NULL; n = n->next) {
+        if (n->kind == AST_ID) {
+            if (u->n == u->cap) {
+                u->cap  = u->cap ? u->cap * 2 : 4096;
+                u->uses = (Use *)realloc(u->uses, u->cap * sizeof(Use));
+            }
+            u->uses[u->n++] = (Use){ scope, n->nameId, n->name };
+        }
+        if (n->kind != AST_TYPEDEF && n->kind != AST_DEFINETYPE && n->kind != AST_DECL) {
+            collectUses(n->a, scope, u);
+            collectUses(n->b, scope, u);
+            collectUses(n->c, scope, u);
+        }
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [--size=N[K|M|G]] [--seed=N] [--runs=N] [source_file]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    GenOptions  opt     = { .size = 4 << 20, .seed = 1, .errorRate = 0, .maxDepth = 0 };
+    const char *srcPath = NULL;
+    int         runs    = 5;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a   = argv[i];
+        char       *end = NULL;
+        if (strncmp(a, "--size=", 7) == 0 && (opt.size = parseSize(a + 7)) != 0)
+            ;
+        else if (strncmp(a, "--seed=", 7) == 0 &&
+                 ((opt.seed = strtoull(a + 7, &end, 10)), *end == '\0'))
+            ;
+        else if (strncmp(a, "--runs=", 7) == 0 &&
+                 (runs = (int)strtol(a + 7, &end, 10)) >= 1 && *end == '\0')
+            ;
+        else if (a[0] != '-' && srcPath == NULL)
+            srcPath = a;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    BenchProgram prog;
+    if (!loadBenchProgram(srcPath, &opt, &prog))
+        return 1;
+
+    benchReport r       = createBenchReport(srcPath ? srcPath : "generated", runs);
+    int         phBuild = benchPhase(r, "build");
+    int         phId    = benchPhase(r, "lookup-id");
+    int         phText  = benchPhase(r, "lookup-text");
+    int         phField = benchPhase(r, "field");
+    diagBuffer  sink    = createDiagBuffer();
+    UseList     uses    = { 0 };
+    long        found   = 0, fieldOps = 0;
+    size_t      tableBytes = 0;
+    symbolTable st      = NULL;
+
+    for (int run = 0; run < runs; run++) {
+        freeSymbolTable(st);
+        sink->len = 0;
+        uint64_t t0 = benchNow();
+        st = buildSymbolTable(prog.ast, sink);
+        benchRecord(r, phBuild, benchNow() - t0);
+
+        if (uses.n == 0) {
+            int k = 0;
+            for (const AstNode *fn = prog.ast->a; fn != NULL; fn = fn->next, k++)
+                collectUses(fn->c, st->funcs[k].scope, &uses);
+            if (prog.ast->b != NULL)
+                collectUses(prog.ast->b->c, st->funcs[k].scope, &uses);
+        }
+
+        found = 0;
+        t0 = benchNow();
+        for (int i = 0; i < uses.n; i++)
+            found += lookupSymbol(st, uses.uses[i].scope, uses.uses[i].name) >= 0;
+        benchRecord(r, phId, benchNow() - t0);
+
+        long foundText = 0;
+        t0 = benchNow();
+        for (int i = 0; i < uses.n; i++)
+            foundText += lookupSymbolText(st, uses.uses[i].scope, uses.uses[i].text) >= 0;
+        benchRecord(r, phText, benchNow() - t0);
+        if (foundText != found) {
+            fprintf(stderr, "%s: lookups by id and by text disagree\n", argv[0]);
+            return 1;
+        }
+
+        fieldOps = 0;
+        t0 = benchNow();
+        for (int t = TYPE_REAL + 1; t < st->nTypes; t++)
+            for (int f = 0; f < st->types[t].nFields; f++)
+                fieldOps += lookupField(st, t, st->fields[st->types[t].firstField + f].name) != NULL;
+        benchRecord(r, phField, benchNow() - t0);
+        tableBytes = symbolTableBytes(st);
+    }
+
+    printf("%s: %ld bytes, %u names, %d symbols, %d scopes, %d types, %d fields\n",
+           r->source, prog.bytes, st->names->count, st->nSyms, st->nScopes, st->nTypes,
+           st->nFields);
+    printf("uses: %d (%ld resolved), semantic errors: %s\n", uses.n, found,
+           sink->len > 0 ? "yes (expected for generated programs)" : "none");
+    printf("memory: table %zu bytes (%.1f per symbol), AST %zu bytes\n", tableBytes,
+           st->nSyms ? (double)tableBytes / st->nSyms : 0.0, prog.arena->bytes);
+    printf("%-12s %12s %12s %12s\n", "phase", "median ms", "ops", "Mops/s");
+
+    /* the build interns every name in the tree, so it is counted per node */
+    const long ops[4] = { prog.arena->nodes, uses.n, uses.n, fieldOps };
+    for (int p = 0; p < r->nPhases; p++) {
+        uint64_t ns = benchMedian(r, p);
+        printf("%-12s %12.3f %12ld %12.1f\n", r->phases[p].name, ns / 1e6, ops[p],
+               ns > 0 ? ops[p] * 1e3 / (double)ns : 0.0);
+    }
+
+    free(uses.uses);
+    freeDiagBuffer(sink);
+    freeSymbolTable(st);
+    freeBenchReport(r);
+    freeAstArena(prog.arena);
+    freeGrammarTables(prog.T);
+    return 0;
+}
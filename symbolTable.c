@@ -0,0 +1,529 @@
+#include "symbolTable.h"
+#include "typeLayout.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Slots a new scope starts with (a power of two) */
+#define SCOPE_INITIAL_SLOTS 16
+
+/* ---- scopes ---- */
+
+/* Fibonacci hashing: ids are dense, the multiply spreads them over the top bits */
+static uint32_t slotOf(const SCOPE *sc, uint32_t key) {
+    return (key * 2654435769u) >> sc->shift;
+}
+
+static uint32_t slotCount(const SCOPE *sc) {
+    return 1u << (32 - sc->shift);
+}
+
+/* The slot holding 'key', or the empty one where it would go */
+static uint32_t findSlot(const SCOPE *sc, uint32_t key) {
+    uint32_t mask = slotCount(sc) - 1;
+    uint32_t i    = slotOf(sc, key);
+    while (sc->slots[i].key != key && sc->slots[i].key != INTERN_NONE)
+        i = (i + 1) & mask;
+    return i;
+}
+
+static int newScope(symbolTable st) {
+    st->scopes = (SCOPE *)realloc(st->scopes, (st->nScopes + 1) * sizeof(SCOPE));
+    SCOPE *sc  = &st->scopes[st->nScopes];
+    sc->slots  = (ScopeSlot *)calloc(SCOPE_INITIAL_SLOTS, sizeof(ScopeSlot));
+    sc->shift  = 32 - 4;
+    sc->count  = 0;
+    return st->nScopes++;
+}
+
+static void growScope(SCOPE *sc) {
+    ScopeSlot *old = sc->slots;
+    uint32_t   n   = slotCount(sc);
+    sc->shift--;
+    sc->slots = (ScopeSlot *)calloc(2 * n, sizeof(ScopeSlot));
+    for (uint32_t i = 0; i < n; i++)
+        if (old[i].key != INTERN_NONE)
+            sc->slots[findSlot(sc, old[i].key)] = old[i];
+    free(old);
+}
+
+static void scopeInsert(SCOPE *sc, uint32_t key, int sym) {
+    if (2 * (uint32_t)(sc->count + 1) > slotCount(sc))
+        growScope(sc);
+    uint32_t i = findSlot(sc, key);
+    sc->slots[i].key = key;
+    sc->slots[i].sym = sym;
+    sc->count++;
+}
+
+int lookupInScope(const SYMBOL_TABLE *st, int scope, uint32_t name) {
+    const SCOPE *sc = &st->scopes[scope];
+    uint32_t     i  = findSlot(sc, name);
+    return sc->slots[i].key == name && name != INTERN_NONE ? sc->slots[i].sym : -1;
+}
+
+int lookupSymbol(const SYMBOL_TABLE *st, int scope, uint32_t name) {
+    int sym = (scope > 0) ? lookupInScope(st, scope, name) : -1;
+    return sym >= 0 ? sym : lookupInScope(st, 0, name);
+}
+
+int lookupSymbolText(const SYMBOL_TABLE *st, int scope, const char *text) {
+    uint32_t name = findInterned(st->names, text, strlen(text));
+    return name == INTERN_NONE ? -1 : lookupSymbol(st, scope, name);
+}
+
+int lookupFunction(const SYMBOL_TABLE *st, uint32_t name) {
+    int sym = lookupInScope(st, 0, name);
+    return (sym >= 0 && st->syms[sym].kind == SYM_FUNCTION) ? st->syms[sym].type : -1;
+}
+
+int lookupType(const SYMBOL_TABLE *st, uint32_t name) {
+    int sym = lookupInScope(st, 0, name);
+    return (sym >= 0 && st->syms[sym].kind == SYM_TYPE) ? st->syms[sym].type : TYPE_NONE;
+}
+
+const FIELD_INFO *lookupField(const SYMBOL_TABLE *st, int type, uint32_t name) {
+    if (type < 0 || type >= st->nTypes)
+        return NULL;
+    const FIELD_INFO *f   = &st->fields[st->types[type].firstField];
+    const FIELD_INFO *end = f + st->types[type].nFields;
+    for (; f < end; f++)
+        if (f->name == name)
+            return f;
+    return NULL;
+}
+
+/* ---- building ---- */
+
+typedef struct {
+    symbolTable st;
+    diagBuffer  diag;
+    uint8_t    *localSeen;  /* by name id: declared in some function's scope */
+    uint32_t    seenCap;
+} Builder;
+
+/* Ids left by an earlier table are overwritten, so a tree can be built again */
+static uint32_t intern(Builder *b, AstNode *n) {
+    n->nameId = n->name ? internString(b->st->names, n->name, strlen(n->name)) : INTERN_NONE;
+    return n->nameId;
+}
+
+static uint32_t internName(Builder *b, const char *s) {
+    return s ? internString(b->st->names, s, strlen(s)) : INTERN_NONE;
+}
+
+static const char *nameOf(const SYMBOL_TABLE *st, uint32_t name) {
+    return st->names->text[name];
+}
+
+static int addSymbol(symbolTable st, uint32_t name, SYM_KIND kind, int type, int line,
+                     int pos) {
+    if (st->nSyms == st->capSyms) {
+        st->capSyms = st->capSyms ? st->capSyms * 2 : 256;
+        st->syms    = (SYMBOL *)realloc(st->syms, st->capSyms * sizeof(SYMBOL));
+    }
+    st->syms[st->nSyms] = (SYMBOL){ .name = name, .kind = (uint8_t)kind, .flags = 0,
+                                    .pos = (uint16_t)pos, .type = type, .line = line };
+    return st->nSyms++;
+}
+
+static int addType(symbolTable st, uint32_t name, TYPE_KIND kind, int line) {
+    if (st->nTypes == st->capTypes) {
+        st->capTypes = st->capTypes ? st->capTypes * 2 : 64;
+        st->types    = (TYPE_INFO *)realloc(st->types, st->capTypes * sizeof(TYPE_INFO));
+    }
+    st->types[st->nTypes] = (TYPE_INFO){ .name = name, .kind = (uint8_t)kind, .defined = 0,
+                                         .alias = TYPE_NONE, .firstField = st->nFields,
+                                         .nFields = 0, .line = line };
+    return st->nTypes++;
+}
+
+static uint8_t *markLocal(Builder *b, uint32_t name) {
+    if (name >= b->seenCap) {
+        uint32_t cap = b->seenCap ? b->seenCap : 1024;
+        while (cap <= name)
+            cap *= 2;
+        b->localSeen = (uint8_t *)realloc(b->localSeen, cap);
+        memset(b->localSeen + b->seenCap, 0, cap - b->seenCap);
+        b->seenCap = cap;
+    }
+    return &b->localSeen[name];
+}
+
+static const char *typeKindName(int kind) {
+    return kind == TYPE_UNION ? "union" : kind == TYPE_RECORD ? "record" : "type";
+}
+
+/*
+ * The type written as op / text (TK_INT, TK_REAL, or TK_RECORD /
+ * TK_UNION / TK_RUID with a #name).  A #name seen for the first time
+ * gets a type that is filled in when its definition comes.
+ */
+static int typeRef(Builder *b, TOKEN_TYPE op, const char *text, int line) {
+    symbolTable st = b->st;
+    if (op == TK_INT)
+        return TYPE_INT;
+    if (op == TK_REAL)
+        return TYPE_REAL;
+    if (text == NULL)
+        return TYPE_NONE;
+
+    uint32_t  name = internName(b, text);
+    TYPE_KIND want = op == TK_RECORD ? TYPE_RECORD : op == TK_UNION ? TYPE_UNION : TYPE_UNKNOWN;
+    int       sym  = lookupInScope(st, 0, name);
+    if (sym < 0) {
+        int t = addType(st, name, want, line);
+        scopeInsert(&st->scopes[0], name, addSymbol(st, name, SYM_TYPE, t, line, 0));
+        return t;
+    }
+    if (st->syms[sym].kind != SYM_TYPE) {
+        diagPrintf(b->diag, "Line %02d: Semantic Error : %s is not a type\n", line, text);
+        return TYPE_NONE;
+    }
+
+    int        t  = st->syms[sym].type;
+    TYPE_INFO *ti = &st->types[t];
+    for (int steps = 0; ti->alias != TYPE_NONE && steps < st->nTypes; steps++)
+        ti = &st->types[t = ti->alias];
+    if (want != TYPE_UNKNOWN && ti->kind == TYPE_UNKNOWN)
+        ti->kind = (uint8_t)want;
+    else if (want != TYPE_UNKNOWN && ti->kind != want)
+        diagPrintf(b->diag, "Line %02d: Semantic Error : %s is a %s, not a %s\n", line, text,
+                   typeKindName(ti->kind), typeKindName(want));
+    return t;
+}
+
+/* A parameter, local or global of the given type */
+static void declare(Builder *b, int scope, AstNode *n, SYM_KIND kind, int pos, int type) {
+    symbolTable st   = b->st;
+    uint32_t    name = intern(b, n);
+    int         home = (kind == SYM_GLOBAL) ? 0 : scope;
+    int         prev = lookupInScope(st, home, name);
+    int         glob = lookupInScope(st, 0, name);
+    int         sym  = addSymbol(st, name, kind, type, n->line, pos);
+
+    if (prev >= 0) {
+        diagPrintf(b->diag, "Line %02d: Semantic Error : %s is already declared on line %d\n",
+                   n->line, n->name, st->syms[prev].line);
+        return;
+    }
+    if (kind != SYM_GLOBAL && glob >= 0 && st->syms[glob].kind == SYM_GLOBAL) {
+        diagPrintf(b->diag, "Line %02d: Semantic Error : %s is already declared global on "
+                            "line %d\n", n->line, n->name, st->syms[glob].line);
+        return;
+    }
+    if (kind == SYM_GLOBAL && *markLocal(b, name))
+        diagPrintf(b->diag, "Line %02d: Semantic Error : global %s is also declared in an "
+                            "earlier function\n", n->line, n->name);
+    if (kind != SYM_GLOBAL)
+        *markLocal(b, name) = 1;
+    scopeInsert(&st->scopes[home], name, sym);
+}
+
+static void defineRecord(Builder *b, AstNode *n) {
+    symbolTable st   = b->st;
+    TYPE_KIND   kind = n->op == TK_UNION ? TYPE_UNION : TYPE_RECORD;
+    int         sym  = lookupInScope(st, 0, intern(b, n));
+    if (sym >= 0 && (st->syms[sym].flags & SYM_ALIAS)) {
+        diagPrintf(b->diag, "Line %02d: Semantic Error : %s is already defined on line %d\n",
+                   n->line, n->name, st->syms[sym].line);
+        return;
+    }
+    int t = typeRef(b, n->op, n->name, n->line);
+    if (t == TYPE_NONE)
+        return;
+    if (st->types[t].defined) {
+        diagPrintf(b->diag, "Line %02d: Semantic Error : %s is already defined on line %d\n",
+                   n->line, n->name, st->types[t].line);
+        return;
+    }
+
+    /* the fields go in one run at the end of 'fields' */
+    int first = st->nFields;
+    for (AstNode *f = n->a; f != NULL; f = f->next) {
+        uint32_t fname = intern(b, f);
+        int      ftype = typeRef(b, f->op, f->aux, f->line);
+        bool     dup   = false;
+        for (int k = first; k < st->nFields && !dup; k++)
+            dup = st->fields[k].name == fname;
+        if (dup) {
+            diagPrintf(b->diag, "Line %02d: Semantic Error : field %s is repeated in %s\n",
+                       f->line, f->name, n->name);
+            continue;
+        }
+        if (st->nFields == st->capFields) {
+            st->capFields = st->capFields ? st->capFields * 2 : 256;
+            st->fields    = (FIELD_INFO *)realloc(st->fields, st->capFields * sizeof(FIELD_INFO));
+        }
+        st->fields[st->nFields++] = (FIELD_INFO){ fname, ftype, f->line, 0 };
+    }
+
+    TYPE_INFO *ti  = &st->types[t];
+    ti->kind       = (uint8_t)kind;
+    ti->defined    = 1;
+    ti->firstField = first;
+    ti->nFields    = st->nFields - first;
+    ti->line       = n->line;
+}
+
+/* definetype record|union #aux as #name */
+static void defineAlias(Builder *b, AstNode *n) {
+    symbolTable st     = b->st;
+    int         target = typeRef(b, n->op, n->aux, n->line);
+    uint32_t    name   = intern(b, n);
+    int         sym    = lookupInScope(st, 0, name);
+
+    if (sym < 0) {
+        sym = addSymbol(st, name, SYM_TYPE, target, n->line, 0);
+        st->syms[sym].flags |= SYM_ALIAS;
+        scopeInsert(&st->scopes[0], name, sym);
+        return;
+    }
+    /* used before this line: the type made for it stands for the target from now on */
+    SYMBOL *s = &st->syms[sym];
+    if (s->kind == SYM_TYPE && !(s->flags & SYM_ALIAS) && !st->types[s->type].defined &&
+        target != TYPE_NONE) {
+        TYPE_INFO *ti = &st->types[s->type];
+        ti->alias     = target;
+        ti->defined   = 1;
+        ti->line      = n->line;
+        s->flags     |= SYM_ALIAS;
+        return;
+    }
+    diagPrintf(b->diag, "Line %02d: Semantic Error : %s is already defined on line %d\n",
+               n->line, n->name, s->line);
+}
+
+/* Intern the names used in an expression, id list or statement list */
+static void internUses(Builder *b, AstNode *n) {
+    for (; n != NULL; n = n->next) {
+        switch (n->kind) {
+        case AST_ID:
+        case AST_RECORD_ACCESS:
+        case AST_CALL:
+            intern(b, n);
+            break;
+        default:
+            break;
+        }
+        internUses(b, n->a);
+        internUses(b, n->b);
+        internUses(b, n->c);
+    }
+}
+
+static void addFunction(Builder *b, AstNode *fn) {
+    symbolTable st   = b->st;
+    uint32_t    name = intern(b, fn);
+    int         prev = lookupInScope(st, 0, name);
+
+    if (st->nFuncs == st->capFuncs) {
+        st->capFuncs = st->capFuncs ? st->capFuncs * 2 : 64;
+        st->funcs    = (FUNC_INFO *)realloc(st->funcs, st->capFuncs * sizeof(FUNC_INFO));
+    }
+    int k     = st->nFuncs++;
+    int scope = newScope(st);
+    st->funcs[k] = (FUNC_INFO){ .name = name, .scope = scope, .firstParam = 0,
+                                .nIn = 0, .nOut = 0, .line = fn->line };
+
+    int sym = addSymbol(st, name, SYM_FUNCTION, k, fn->line, 0);
+    if (prev >= 0)
+        diagPrintf(b->diag, "Line %02d: Semantic Error : %s is already defined on line %d\n",
+                   fn->line, fn->name, st->syms[prev].line);
+    else
+        scopeInsert(&st->scopes[0], name, sym);
+
+    /*
+     * Parameters are consecutive symbols, inputs first, so their types
+     * (which may add symbols for new #names) are looked up beforehand.
+     */
+    int nParams = 0;
+    for (AstNode *p = fn->a; p != NULL; p = p->next)
+        nParams++;
+    for (AstNode *p = fn->b; p != NULL; p = p->next)
+        nParams++;
+    int *types = (int *)malloc((nParams > 0 ? nParams : 1) * sizeof(int));
+    int  n     = 0;
+    for (AstNode *p = fn->a; p != NULL; p = p->next)
+        types[n++] = typeRef(b, p->op, p->aux, p->line);
+    for (AstNode *p = fn->b; p != NULL; p = p->next)
+        types[n++] = typeRef(b, p->op, p->aux, p->line);
+
+    st->funcs[k].firstParam = st->nSyms;
+    int pos = 0;
+    n = 0;
+    for (AstNode *p = fn->a; p != NULL; p = p->next, pos++)
+        declare(b, scope, p, SYM_INPUT_PAR, pos, types[n++]);
+    st->funcs[k].nIn = (int16_t)pos;
+    pos = 0;
+    for (AstNode *p = fn->b; p != NULL; p = p->next, pos++)
+        declare(b, scope, p, SYM_OUTPUT_PAR, pos, types[n++]);
+    st->funcs[k].nOut = (int16_t)pos;
+    free(types);
+
+    for (AstNode *s = fn->c; s != NULL; s = s->next) {
+        switch (s->kind) {
+        case AST_TYPEDEF:
+            defineRecord(b, s);
+            break;
+        case AST_DEFINETYPE:
+            defineAlias(b, s);
+            break;
+        case AST_DECL:
+            declare(b, scope, s, (s->flags & AST_GLOBAL) ? SYM_GLOBAL : SYM_LOCAL, 0,
+                    typeRef(b, s->op, s->aux, s->line));
+            break;
+        default:
+            intern(b, s);
+            internUses(b, s->a);
+            internUses(b, s->b);
+            internUses(b, s->c);
+            break;
+        }
+    }
+}
+
+/*
+ * Point every alias at the type it finally stands for, so that later
+ * passes see one id per type, and report types never defined.
+ */
+static void resolveTypes(Builder *b) {
+    symbolTable st  = b->st;
+    int        *map = (int *)malloc((st->nTypes > 0 ? st->nTypes : 1) * sizeof(int));
+
+    for (int t = 0; t < st->nTypes; t++) {
+        int r = t, steps = 0;
+        while (st->types[r].alias != TYPE_NONE && steps++ <= st->nTypes)
+            r = st->types[r].alias;
+        map[t] = (steps > st->nTypes) ? TYPE_NONE : r;
+    }
+    for (int t = 0; t < st->nTypes; t++) {
+        TYPE_INFO *ti = &st->types[t];
+        if (map[t] == TYPE_NONE)
+            diagPrintf(b->diag, "Line %02d: Semantic Error : %s is defined in terms of itself\n",
+                       ti->line, nameOf(st, ti->name));
+        else if (ti->alias == TYPE_NONE && !ti->defined && t > TYPE_REAL)
+            diagPrintf(b->diag, "Line %02d: Semantic Error : %s is never defined\n",
+                       ti->line, nameOf(st, ti->name));
+    }
+
+    for (int i = 0; i < st->nSyms; i++)
+        if (st->syms[i].kind != SYM_FUNCTION && st->syms[i].type > TYPE_REAL)
+            st->syms[i].type = map[st->syms[i].type];
+    for (int i = 0; i < st->nFields; i++)
+        if (st->fields[i].type > TYPE_REAL)
+            st->fields[i].type = map[st->fields[i].type];
+    free(map);
+}
+
+/* ------------------------------------------------------------------
+ * buildSymbolTable
+ * ------------------------------------------------------------------ */
+symbolTable buildSymbolTable(AstNode *program, diagBuffer diag) {
+    symbolTable st = (symbolTable)calloc(1, sizeof(SYMBOL_TABLE));
+    st->names = createInternPool();
+    newScope(st);
+    addType(st, INTERN_NONE, TYPE_PRIMITIVE, 0);
+    addType(st, INTERN_NONE, TYPE_PRIMITIVE, 0);
+    st->types[TYPE_INT].defined  = 1;
+    st->types[TYPE_REAL].defined = 1;
+
+    Builder b = { st, diag, NULL, 0 };
+    if (program != NULL) {
+        for (AstNode *fn = program->a; fn != NULL; fn = fn->next)
+            addFunction(&b, fn);
+        if (program->b != NULL)
+            addFunction(&b, program->b);
+    }
+    resolveTypes(&b);
+    layoutTypes(st, diag);
+    free(b.localSeen);
+    return st;
+}
+
+void freeSymbolTable(symbolTable st) {
+    if (st == NULL)
+        return;
+    for (int i = 0; i < st->nScopes; i++)
+        free(st->scopes[i].slots);
+    free(st->scopes);
+    free(st->syms);
+    free(st->funcs);
+    free(st->types);
+    free(st->fields);
+    freeInternPool(st->names);
+    free(st);
+}
+
+size_t symbolTableBytes(const SYMBOL_TABLE *st) {
+    size_t n = sizeof(SYMBOL_TABLE) + st->names->bytes +
+               (size_t)st->capSyms * sizeof(SYMBOL) + (size_t)st->nScopes * sizeof(SCOPE) +
+               (size_t)st->capFuncs * sizeof(FUNC_INFO) + (size_t)st->capTypes * sizeof(TYPE_INFO) +
+               (size_t)st->capFields * sizeof(FIELD_INFO);
+    for (int i = 0; i < st->nScopes; i++)
+        n += slotCount(&st->scopes[i]) * sizeof(ScopeSlot);
+    return n;
+}
+
+/* ---- listing ---- */
+
+static void printTypeName(const SYMBOL_TABLE *st, int type, FILE *out) {
+    if (type == TYPE_INT)
+        fprintf(out, "int");
+    else if (type == TYPE_REAL)
+        fprintf(out, "real");
+    else if (type == TYPE_NONE)
+        fprintf(out, "?");
+    else
+        fprintf(out, "%s %s", typeKindName(st->types[type].kind),
+                nameOf(st, st->types[type].name));
+}
+
+static int cmpInt(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+static void printScope(const SYMBOL_TABLE *st, int scope, FILE *out) {
+    static const char *kindNames[] = { "local", "global", "input", "output", "function",
+                                       "type" };
+    const SCOPE *sc   = &st->scopes[scope];
+    int         *syms = (int *)malloc((sc->count > 0 ? sc->count : 1) * sizeof(int));
+    int          n    = 0;
+    for (uint32_t i = 0; i < slotCount(sc); i++)
+        if (sc->slots[i].key != INTERN_NONE)
+            syms[n++] = sc->slots[i].sym;
+    qsort(syms, n, sizeof(int), cmpInt);
+
+    for (int i = 0; i < n; i++) {
+        const SYMBOL *s = &st->syms[syms[i]];
+        fprintf(out, "  %-20s %-8s ", nameOf(st, s->name), kindNames[s->kind]);
+        if (s->kind == SYM_FUNCTION)
+            fprintf(out, "%d in, %d out", st->funcs[s->type].nIn, st->funcs[s->type].nOut);
+        else
+            printTypeName(st, s->type, out);
+        fprintf(out, "%s  (line %d)\n", (s->flags & SYM_ALIAS) ? " (alias)" : "", s->line);
+    }
+    free(syms);
+}
+
+void printSymbolTable(const SYMBOL_TABLE *st, FILE *out) {
+    fprintf(out, "global scope\n");
+    printScope(st, 0, out);
+    for (int k = 0; k < st->nFuncs; k++) {
+        fprintf(out, "scope %s\n", nameOf(st, st->funcs[k].name));
+        printScope(st, st->funcs[k].scope, out);
+    }
+
+    fprintf(out, "types\n");
+    for (int t = TYPE_REAL + 1; t < st->nTypes; t++) {
+        const TYPE_INFO *ti = &st->types[t];
+        if (ti->alias != TYPE_NONE || !ti->defined)
+            continue;
+        fprintf(out, "  %s %s  size %d, align %d  (line %d)\n", typeKindName(ti->kind),
+                nameOf(st, ti->name), ti->size, ti->align, ti->line);
+        for (int f = ti->firstField; f < ti->firstField + ti->nFields; f++) {
+            fprintf(out, "    %-18s +%-4d ", nameOf(st, st->fields[f].name), st->fields[f].offset);
+            printTypeName(st, st->fields[f].type, out);
+            fprintf(out, "\n");
+        }
+    }
+}
@@ -0,0 +1,152 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include "ast.h"
+#include "diag.h"
+#include "intern.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Symbol table for the names of a program: variables (TK_ID), functions
+ * (TK_FUNID / _main), record and union types and their definetype
+ * aliases (TK_RUID), and record fields (TK_FIELDID).
+ *
+ * Names are interned, and every table is keyed by the interned id.
+ * Scope 0 is global and holds functions, types, aliases and variables
+ * declared ': global'; scope k + 1 holds the parameters and locals of
+ * function k.  A scope is an open-addressing array of (id, symbol)
+ * pairs, eight bytes each, probed linearly and kept at most half full.
+ * Symbols, functions, types and fields are flat arrays indexed by int:
+ * a function's parameters are consecutive symbols, and a record's
+ * fields one contiguous run, so a field lookup scans a few adjacent
+ * 16-byte entries.
+ */
+
+/* Type ids: the two primitives, then records and unions in order of first mention */
+#define TYPE_NONE (-1)
+#define TYPE_INT    0
+#define TYPE_REAL   1
+
+typedef enum {
+    SYM_LOCAL,
+    SYM_GLOBAL,
+    SYM_INPUT_PAR,
+    SYM_OUTPUT_PAR,
+    SYM_FUNCTION,
+    SYM_TYPE,           /* a record / union name or a definetype alias */
+} SYM_KIND;
+
+/* SYMBOL flag: a SYM_TYPE introduced by definetype */
+#define SYM_ALIAS 1
+
+typedef struct {
+    uint32_t name;      /* interned */
+    uint8_t  kind;      /* SYM_KIND */
+    uint8_t  flags;
+    uint16_t pos;       /* position in its parameter list */
+    int32_t  type;      /* type id; for SYM_FUNCTION the function index */
+    int32_t  line;
+} SYMBOL;
+
+typedef struct {
+    uint32_t name;
+    int32_t  scope;     /* its parameters and locals */
+    int32_t  firstParam;    /* input parameters, then output parameters */
+    int16_t  nIn;
+    int16_t  nOut;
+    int32_t  line;
+} FUNC_INFO;
+
+typedef enum {
+    TYPE_PRIMITIVE,
+    TYPE_RECORD,
+    TYPE_UNION,
+    TYPE_UNKNOWN,       /* named only as a bare #name so far */
+} TYPE_KIND;
+
+typedef struct {
+    uint32_t name;      /* INTERN_NONE for int and real */
+    uint8_t  kind;      /* TYPE_KIND */
+    uint8_t  defined;
+    int32_t  alias;     /* during the build: the type this name stands for, or TYPE_NONE */
+    int32_t  firstField;
+    int32_t  nFields;
+    int32_t  line;      /* definition, or first mention while undefined */
+    int32_t  size;      /* bytes, from layoutTypes */
+    int32_t  align;
+} TYPE_INFO;
+
+typedef struct {
+    uint32_t name;
+    int32_t  type;
+    int32_t  line;
+    int32_t  offset;    /* bytes from the start of the record, from layoutTypes */
+} FIELD_INFO;
+
+typedef struct {
+    uint32_t key;       /* INTERN_NONE if empty */
+    int32_t  sym;
+} ScopeSlot;
+
+typedef struct {
+    ScopeSlot *slots;
+    uint32_t   shift;   /* 32 - log2(slots) */
+    int32_t    count;
+} SCOPE;
+
+typedef struct SYMBOL_TABLE {
+    internPool  names;
+    SYMBOL     *syms;
+    int         nSyms;
+    int         capSyms;
+    SCOPE      *scopes;
+    int         nScopes;
+    FUNC_INFO  *funcs;
+    int         nFuncs;
+    int         capFuncs;
+    TYPE_INFO  *types;
+    int         nTypes;
+    int         capTypes;
+    FIELD_INFO *fields;
+    int         nFields;
+    int         capFields;
+} SYMBOL_TABLE;
+
+typedef SYMBOL_TABLE *symbolTable;
+
+/*
+ * Fill a table from the AST in one walk.  Every name in the tree is
+ * interned and its node's nameId set; declarations become symbols.
+ * Aliases are resolved and every type laid out (see typeLayout.h).
+ * Redeclarations, record / union mix-ups and types that are never
+ * defined are reported to 'diag' as "Line NN: Semantic Error : ...";
+ * the table is returned either way.
+ */
+symbolTable buildSymbolTable(AstNode *program, diagBuffer diag);
+
+void freeSymbolTable(symbolTable st);
+
+/* Symbol 'name' in 'scope', or in the global scope; -1 if neither has it */
+int lookupSymbol(const SYMBOL_TABLE *st, int scope, uint32_t name);
+
+/* Only in 'scope' itself */
+int lookupInScope(const SYMBOL_TABLE *st, int scope, uint32_t name);
+
+/* The same by text, for names that have not been interned (-1 if unknown) */
+int lookupSymbolText(const SYMBOL_TABLE *st, int scope, const char *text);
+
+/* Function index or type id of a name; -1 / TYPE_NONE if there is none */
+int lookupFunction(const SYMBOL_TABLE *st, uint32_t name);
+int lookupType(const SYMBOL_TABLE *st, uint32_t name);
+
+/* Field 'name' of record or union 'type'; NULL if it has none */
+const FIELD_INFO *lookupField(const SYMBOL_TABLE *st, int type, uint32_t name);
+
+/* Bytes held by the table, its scopes and its intern pool */
+size_t symbolTableBytes(const SYMBOL_TABLE *st);
+
+/* Every scope with its symbols, then every type with its fields */
+void printSymbolTable(const SYMBOL_TABLE *st, FILE *out);
+
+#endif /* SYMBOL_TABLE_H */
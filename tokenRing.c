@@ -0,0 +1,127 @@
+#include "tokenRing.h"
+#include "diag.h"
+#include "lexer.h"
+#include "memTrack.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Spin briefly, then give the core away; used while the peer catches up */
+static void backoff(int *spins) {
+    if (++*spins > 64)
+        sched_yield();
+}
+
+/* Move any lexical errors collected so far into a heap string */
+static char *takeNotes(diagBuffer d) {
+    if (d->len == 0)
+        return NULL;
+    char *txt = (char *)malloc(d->len + 1);
+    memcpy(txt, d->text, d->len + 1);
+    d->len     = 0;
+    d->text[0] = '\0';
+    return txt;
+}
+
+/* ------------------------------------------------------------------
+ * lexerMain
+ *
+ * Producer: lex tokens into the next free slot and publish it.  Batch
+ * size starts at 16 and doubles up to BATCH_TOKENS, so the parser gets
+ * its first tokens quickly and later batches amortise the handoff.
+ * ------------------------------------------------------------------ */
+static void *lexerMain(void *arg) {
+    tokenRing  r     = (tokenRing)arg;
+    twinBuffer tb    = createTwinBuffer(r->src);
+    diagBuffer notes = createDiagBuffer();
+    long       head  = 0;
+    int        batch = 16;
+    bool       done  = false;
+
+    setLexerDiagnostics(notes);
+
+    while (!done) {
+        int spins = 0;
+        while (head - atomic_load_explicit(&r->tail, memory_order_acquire) == RING_SLOTS) {
+            if (atomic_load_explicit(&r->stop, memory_order_relaxed))
+                goto out;
+            backoff(&spins);
+        }
+
+        TokenBatch *b = &r->slots[head % RING_SLOTS];
+        b->count = 0;
+        while (b->count < batch) {
+            tokenInfo tok = nextToken(tb, r->src);
+            b->notes[b->count]  = takeNotes(notes);
+            b->toks[b->count++] = *tok;
+            done = (tok->type == DOLLAR);
+            memFree(tok);
+            if (done)
+                break;
+        }
+
+        atomic_store_explicit(&r->head, ++head, memory_order_release);
+        if (batch < BATCH_TOKENS)
+            batch *= 2;
+    }
+
+out:
+#ifdef FRONTEND_STATS
+    r->lexStats = *frontendStats();
+#endif
+    setLexerDiagnostics(NULL);
+    freeDiagBuffer(notes);
+    memFree(tb);
+    return NULL;
+}
+
+tokenRing startLexerThread(FILE *src) {
+    /* the counters are cache-line aligned, so the ring must be too */
+    tokenRing r = (tokenRing)aligned_alloc(64, sizeof(TOKEN_RING));
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->stop, false);
+    r->src = src;
+    pthread_create(&r->lexer, NULL, lexerMain, r);
+    return r;
+}
+
+/* ------------------------------------------------------------------
+ * ringAcquire / ringRelease — consumer side
+ * ------------------------------------------------------------------ */
+TokenBatch *ringAcquire(tokenRing r) {
+    long tail  = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    int  spins = 0;
+    while (atomic_load_explicit(&r->head, memory_order_acquire) == tail)
+        backoff(&spins);
+    return &r->slots[tail % RING_SLOTS];
+}
+
+void ringRelease(tokenRing r) {
+    long tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+}
+
+/* ------------------------------------------------------------------
+ * stopLexerThread
+ *
+ * Safe whether or not the parser read up to DOLLAR: the stop flag
+ * releases a lexer blocked on a full ring.  Notes in batches that were
+ * never consumed are dropped.
+ * ------------------------------------------------------------------ */
+void stopLexerThread(tokenRing r) {
+    atomic_store_explicit(&r->stop, true, memory_order_relaxed);
+    pthread_join(r->lexer, NULL);
+#ifdef FRONTEND_STATS
+    mergeFrontendStats(&r->lexStats);
+#endif
+
+    long head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    long tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    for (long k = tail; k < head; k++) {
+        TokenBatch *b = &r->slots[k % RING_SLOTS];
+        for (int i = 0; i < b->count; i++)
+            free(b->notes[i]);
+    }
+    free(r);
+}
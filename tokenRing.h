@@ -0,0 +1,63 @@
+#ifndef TOKEN_RING_H
+#define TOKEN_RING_H
+
+#include "lexerDef.h"
+#include "stats.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+/* Number of batches in flight between the lexer and parser threads */
+#define RING_SLOTS   8
+
+/* Largest batch; the first batches are smaller so parsing starts early */
+#define BATCH_TOKENS 256
+
+/*
+ * One batch of lexed tokens.  notes[i], if not NULL, holds the lexical
+ * errors raised while toks[i] was being lexed; the parser prints them
+ * when it takes toks[i], so output order matches the sequential lexer.
+ */
+typedef struct {
+    TOKEN  toks[BATCH_TOKENS];
+    char  *notes[BATCH_TOKENS];
+    int    count;
+} TokenBatch;
+
+/*
+ * Single-producer / single-consumer ring of token batches.  'head' is
+ * only written by the lexer thread and 'tail' only by the parser thread,
+ * so publishing and releasing a batch is one release-store each; the
+ * two counters sit on separate cache lines.  The lexer blocks (spin,
+ * then yield) while all slots are full, which bounds memory use.
+ */
+typedef struct TOKEN_RING {
+    TokenBatch          slots[RING_SLOTS];
+    _Alignas(64) atomic_long head;   /* batches published */
+    _Alignas(64) atomic_long tail;   /* batches released */
+    atomic_bool         stop;        /* consumer quit early */
+    FILE               *src;
+    pthread_t           lexer;
+#ifdef FRONTEND_STATS
+    FrontendStats       lexStats;    /* the lexer thread's counters, for the parser's */
+#endif
+} TOKEN_RING;
+
+typedef TOKEN_RING *tokenRing;
+
+/* Start a lexer thread on 'src'; the keyword table must already exist */
+tokenRing startLexerThread(FILE *src);
+
+/* Wait for the next published batch (the last one ends with DOLLAR) */
+TokenBatch *ringAcquire(tokenRing r);
+
+/* Hand the batch returned by the last ringAcquire back to the lexer */
+void ringRelease(tokenRing r);
+
+/*
+ * Stop the lexer thread if it is still running, join it, add its
+ * counters to the caller's and free the ring
+ */
+void stopLexerThread(tokenRing r);
+
+#endif /* TOKEN_RING_H */
@@ -1,4 +1,5 @@
 #include "trie.h"
+#include "memTrack.h"
 #include <stdlib.h>
 
 /*
@@ -7,7 +8,7 @@
  * match a keyword still returns a sensible value.
  */
 trie createTrieNode(void) {
-    trie nd = (trie)malloc(sizeof(TrieNode));
+    trie nd = (trie)memAlloc(MEM_TRIE, sizeof(TrieNode));
 
     for (int ch = 0; ch < TRIE_ALPHA_SZ; ch++)
         nd->kids[ch] = NULL;
@@ -46,7 +47,8 @@ TOKEN_TYPE search(trie root, char *key) {
     for (int pos = 0; key[pos] != '\0'; pos++) {
         int idx = key[pos] - 'a';
 
-        if (cur->kids[idx] == NULL)
+        /* keywords are all lower case; anything else cannot match */
+        if (idx < 0 || idx >= TRIE_ALPHA_SZ || cur->kids[idx] == NULL)
             return TK_FIELDID;
 
         cur = cur->kids[idx];
@@ -0,0 +1,435 @@
+#include "typeChecker.h"
+#include "pool.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Type of a boolean expression; TYPE_NONE marks an operand already reported */
+#define TYPE_BOOL (-2)
+
+/* Condition variables a while loop keeps on the stack before allocating */
+#define WHILE_VARS_INLINE 16
+
+typedef struct {
+    const SYMBOL_TABLE *st;
+    const FUNC_INFO    *fn;
+    int                 k;          /* index of the function being checked */
+    diagBuffer          diag;
+    int                 errors;
+    uint8_t            *outSet;     /* per output parameter: assigned somewhere */
+} Checker;
+
+/* Generated programs get hundreds of thousands of these, so each is formatted once */
+static void report(Checker *c, int line, const char *fmt, ...) {
+    va_list ap;
+    diagPrintf(c->diag, "Line %02d: Semantic Error : ", line);
+    va_start(ap, fmt);
+    diagVPrintf(c->diag, fmt, ap);
+    va_end(ap);
+    diagPrintf(c->diag, "\n");
+    c->errors++;
+}
+
+static const char *nameOf(const Checker *c, uint32_t name) {
+    return internText(c->st->names, name);
+}
+
+static bool isStruct(int t) {
+    return t > TYPE_REAL;
+}
+
+static const char *typeText(const SYMBOL_TABLE *st, int t, char *buf, size_t size) {
+    if (t == TYPE_INT)
+        return "int";
+    if (t == TYPE_REAL)
+        return "real";
+    if (t == TYPE_BOOL)
+        return "boolean";
+    snprintf(buf, size, "%s %s", st->types[t].kind == TYPE_UNION ? "union" : "record",
+             internText(st->names, st->types[t].name));
+    return buf;
+}
+
+static const char *opText(TOKEN_TYPE op) {
+    switch (op) {
+    case TK_PLUS:  return "+";
+    case TK_MINUS: return "-";
+    case TK_MUL:   return "*";
+    case TK_DIV:   return "/";
+    case TK_AND:   return "&&&";
+    case TK_OR:    return "@@@";
+    case TK_LT:    return "<";
+    case TK_LE:    return "<=";
+    case TK_EQ:    return "==";
+    case TK_GT:    return ">";
+    case TK_GE:    return ">=";
+    case TK_NE:    return "!=";
+    default:       return "?";
+    }
+}
+
+/* The variable an AST_ID names, or -1 (reported) */
+static int variable(Checker *c, const AstNode *id) {
+    int sym = lookupSymbol(c->st, c->fn->scope, id->nameId);
+    if (sym < 0 || c->st->syms[sym].kind == SYM_FUNCTION || c->st->syms[sym].kind == SYM_TYPE) {
+        report(c, id->line, "variable %s is not declared", id->name);
+        return -1;
+    }
+    return sym;
+}
+
+/* ---- expressions ---- */
+
+static int exprType(Checker *c, const AstNode *e);
+
+static int arithType(Checker *c, const AstNode *e, int l, int r) {
+    const SYMBOL_TABLE *st = c->st;
+    char                lb[64], rb[64];
+
+    if (l == TYPE_NONE || r == TYPE_NONE)
+        return TYPE_NONE;
+    if ((isStruct(l) && st->types[l].kind == TYPE_UNION) ||
+        (isStruct(r) && st->types[r].kind == TYPE_UNION)) {
+        report(c, e->line, "a union cannot be an operand of %s", opText(e->op));
+        return TYPE_NONE;
+    }
+    if (!isStruct(l) && !isStruct(r) && l == r && l != TYPE_BOOL)
+        return l;
+    if (isStruct(l) && l == r && (e->op == TK_PLUS || e->op == TK_MINUS))
+        return l;
+    /* record * scalar, scalar * record, record / scalar */
+    if (isStruct(l) && (r == TYPE_INT || r == TYPE_REAL) && (e->op == TK_MUL || e->op == TK_DIV))
+        return l;
+    if (isStruct(r) && (l == TYPE_INT || l == TYPE_REAL) && e->op == TK_MUL)
+        return r;
+    report(c, e->line, "operands of %s are %s and %s", opText(e->op),
+           typeText(st, l, lb, sizeof lb), typeText(st, r, rb, sizeof rb));
+    return TYPE_NONE;
+}
+
+static int binopType(Checker *c, const AstNode *e) {
+    int  l = exprType(c, e->a);
+    int  r = exprType(c, e->b);
+    char lb[64], rb[64];
+
+    switch (e->op) {
+    case TK_PLUS: case TK_MINUS: case TK_MUL: case TK_DIV:
+        return arithType(c, e, l, r);
+    case TK_AND: case TK_OR:
+        if (l == TYPE_NONE || r == TYPE_NONE)
+            return TYPE_BOOL;
+        if (l != TYPE_BOOL || r != TYPE_BOOL)
+            report(c, e->line, "operands of %s must be boolean", opText(e->op));
+        return TYPE_BOOL;
+    default:
+        /* relational: two ints or two reals */
+        if (l != TYPE_NONE && r != TYPE_NONE &&
+            (l != r || (l != TYPE_INT && l != TYPE_REAL)))
+            report(c, e->line, "operands of %s are %s and %s", opText(e->op),
+                   typeText(c->st, l, lb, sizeof lb), typeText(c->st, r, rb, sizeof rb));
+        return TYPE_BOOL;
+    }
+}
+
+static int exprType(Checker *c, const AstNode *e) {
+    const SYMBOL_TABLE *st = c->st;
+    char                buf[64];
+
+    switch (e->kind) {
+    case AST_NUM:
+        return TYPE_INT;
+    case AST_RNUM:
+        return TYPE_REAL;
+    case AST_ID: {
+        int sym = variable(c, e);
+        return sym < 0 ? TYPE_NONE : st->syms[sym].type;
+    }
+    case AST_RECORD_ACCESS: {
+        int t = exprType(c, e->a);
+        if (t == TYPE_NONE)
+            return TYPE_NONE;
+        const FIELD_INFO *f = isStruct(t) ? lookupField(st, t, e->nameId) : NULL;
+        if (f == NULL) {
+            report(c, e->line, "%s has no field %s", typeText(st, t, buf, sizeof buf), e->name);
+            return TYPE_NONE;
+        }
+        return f->type;
+    }
+    case AST_BINOP:
+        return binopType(c, e);
+    case AST_NOT: {
+        int t = exprType(c, e->a);
+        if (t != TYPE_NONE && t != TYPE_BOOL)
+            report(c, e->line, "operand of ~ must be boolean");
+        return TYPE_BOOL;
+    }
+    default:
+        return TYPE_NONE;
+    }
+}
+
+/* ---- statements ---- */
+
+/* The AST_ID at the root of a (possibly dotted) variable */
+static const AstNode *baseOf(const AstNode *v) {
+    while (v->kind == AST_RECORD_ACCESS)
+        v = v->a;
+    return v;
+}
+
+/* A variable being written: its type, noting output parameters that get a value */
+static int target(Checker *c, const AstNode *v) {
+    const AstNode *id  = baseOf(v);
+    int            sym = (id->kind == AST_ID)
+                             ? lookupSymbol(c->st, c->fn->scope, id->nameId) : -1;
+    int            out = sym - (c->fn->firstParam + c->fn->nIn);
+    if (sym >= 0 && out >= 0 && out < c->fn->nOut)
+        c->outSet[out] = 1;
+    return exprType(c, v);
+}
+
+/* Match an id list against consecutive parameter symbols */
+static void matchList(Checker *c, const AstNode *ids, int first, int n, const char *what,
+                      const char *callee, int line, bool written) {
+    const SYMBOL_TABLE *st = c->st;
+    char                pb[64], ab[64];
+    int                 given = 0;
+
+    for (const AstNode *a = ids; a != NULL; a = a->next, given++) {
+        int t = written ? target(c, a) : exprType(c, a);
+        if (given >= n || t == TYPE_NONE)
+            continue;
+        int want = st->syms[first + given].type;
+        if (want != TYPE_NONE && t != want)
+            report(c, a->line, "%s parameter %s of %s is %s, not %s", what,
+                   nameOf(c, st->syms[first + given].name), callee,
+                   typeText(st, want, pb, sizeof pb), typeText(st, t, ab, sizeof ab));
+    }
+    if (given != n)
+        report(c, line, "%s takes %d %s parameter%s, not %d", callee, n, what,
+               n == 1 ? "" : "s", given);
+}
+
+static void checkCall(Checker *c, const AstNode *s) {
+    const SYMBOL_TABLE *st = c->st;
+    int                 k  = lookupFunction(st, s->nameId);
+
+    if (k < 0) {
+        report(c, s->line, "function %s is not defined", s->name);
+        return;
+    }
+    if (k == c->k) {
+        report(c, s->line, "function %s calls itself", s->name);
+        return;
+    }
+    if (k > c->k) {
+        report(c, s->line, "function %s is called before its definition on line %d", s->name,
+               st->funcs[k].line);
+        return;
+    }
+    const FUNC_INFO *f = &st->funcs[k];
+    matchList(c, s->b, f->firstParam, f->nIn, "input", s->name, s->line, false);
+    matchList(c, s->a, f->firstParam + f->nIn, f->nOut, "output", s->name, s->line, true);
+}
+
+static void checkStmts(Checker *c, const AstNode *s);
+
+/* Does any statement in 's' write one of the symbols 'syms'? */
+static bool writesAny(const Checker *c, const AstNode *s, const int *syms, int n) {
+    for (; s != NULL; s = s->next) {
+        const AstNode *written = NULL;
+        switch (s->kind) {
+        case AST_ASSIGN:
+        case AST_READ:
+            written = s->a;
+            break;
+        case AST_CALL:
+            for (const AstNode *a = s->a; a != NULL; a = a->next)
+                for (int i = 0; i < n; i++)
+                    if (lookupSymbol(c->st, c->fn->scope, a->nameId) == syms[i])
+                        return true;
+            break;
+        case AST_WHILE:
+            if (writesAny(c, s->b, syms, n))
+                return true;
+            break;
+        case AST_IF:
+            if (writesAny(c, s->b, syms, n) || writesAny(c, s->c, syms, n))
+                return true;
+            break;
+        default:
+            break;
+        }
+        if (written != NULL) {
+            int sym = lookupSymbol(c->st, c->fn->scope, baseOf(written)->nameId);
+            for (int i = 0; i < n; i++)
+                if (sym == syms[i])
+                    return true;
+        }
+    }
+    return false;
+}
+
+/* Symbols of the variables in a condition, appended to *syms (grown as needed) */
+static void conditionVars(const Checker *c, const AstNode *e, int **syms, int *n, int *cap,
+                          int *inlineBuf) {
+    if (e == NULL)
+        return;
+    if (e->kind == AST_ID) {
+        int sym = lookupSymbol(c->st, c->fn->scope, e->nameId);
+        if (sym < 0)
+            return;
+        if (*n == *cap) {
+            int *grown = (int *)malloc(2 * *cap * sizeof(int));
+            memcpy(grown, *syms, *n * sizeof(int));
+            if (*syms != inlineBuf)
+                free(*syms);
+            *syms = grown;
+            *cap *= 2;
+        }
+        (*syms)[(*n)++] = sym;
+        return;
+    }
+    conditionVars(c, e->a, syms, n, cap, inlineBuf);
+    conditionVars(c, e->b, syms, n, cap, inlineBuf);
+}
+
+static void checkWhile(Checker *c, const AstNode *s) {
+    int  inlineBuf[WHILE_VARS_INLINE];
+    int *syms = inlineBuf;
+    int  n = 0, cap = WHILE_VARS_INLINE;
+
+    if (exprType(c, s->a) != TYPE_BOOL)
+        report(c, s->line, "the condition of while is not a boolean expression");
+    checkStmts(c, s->b);
+    conditionVars(c, s->a, &syms, &n, &cap, inlineBuf);
+    if (!writesAny(c, s->b, syms, n))
+        report(c, s->line, "no variable of the while condition changes in the loop");
+    if (syms != inlineBuf)
+        free(syms);
+}
+
+static void checkReturn(Checker *c, const AstNode *s) {
+    const SYMBOL_TABLE *st    = c->st;
+    const FUNC_INFO    *fn    = c->fn;
+    int                 first = fn->firstParam + fn->nIn;
+    int                 given = 0;
+    char                pb[64], ab[64];
+
+    for (const AstNode *a = s->a; a != NULL; a = a->next, given++) {
+        int t = exprType(c, a);
+        if (given >= fn->nOut || t == TYPE_NONE)
+            continue;
+        int want = st->syms[first + given].type;
+        if (want != TYPE_NONE && t != want)
+            report(c, a->line, "returned %s is %s, but output parameter %s is %s", a->name,
+                   typeText(st, t, ab, sizeof ab), nameOf(c, st->syms[first + given].name),
+                   typeText(st, want, pb, sizeof pb));
+    }
+    if (given != fn->nOut)
+        report(c, s->line, "%s returns %d value%s, not %d", nameOf(c, fn->name), fn->nOut,
+               fn->nOut == 1 ? "" : "s", given);
+}
+
+static void checkStmts(Checker *c, const AstNode *s) {
+    const SYMBOL_TABLE *st = c->st;
+    char                lb[64], rb[64];
+
+    for (; s != NULL; s = s->next) {
+        switch (s->kind) {
+        case AST_ASSIGN: {
+            int l = target(c, s->a);
+            int r = exprType(c, s->b);
+            if (l != TYPE_NONE && r != TYPE_NONE && l != r)
+                report(c, s->line, "cannot assign %s to %s", typeText(st, r, rb, sizeof rb),
+                       typeText(st, l, lb, sizeof lb));
+            break;
+        }
+        case AST_CALL:
+            checkCall(c, s);
+            break;
+        case AST_WHILE:
+            checkWhile(c, s);
+            break;
+        case AST_IF:
+            if (exprType(c, s->a) != TYPE_BOOL)
+                report(c, s->line, "the condition of if is not a boolean expression");
+            checkStmts(c, s->b);
+            checkStmts(c, s->c);
+            break;
+        case AST_READ:
+            target(c, s->a);
+            break;
+        case AST_WRITE:
+            exprType(c, s->a);
+            break;
+        case AST_RETURN:
+            checkReturn(c, s);
+            break;
+        default:    /* declarations and type definitions are the symbol table's */
+            break;
+        }
+    }
+}
+
+/* ---- per function, in parallel ---- */
+
+typedef struct {
+    const SYMBOL_TABLE *st;
+    const AstNode     **fns;    /* fns[k] is function k of the table */
+    diagBuffer         *diags;
+    int                *errors;
+} CheckShared;
+
+static void checkFunctionTask(int k, void *arg) {
+    CheckShared *sh  = (CheckShared *)arg;
+    const FUNC_INFO *fn = &sh->st->funcs[k];
+    Checker      c   = { sh->st, fn, k, createDiagBuffer(), 0,
+                         (uint8_t *)calloc(fn->nOut > 0 ? fn->nOut : 1, 1) };
+
+    checkStmts(&c, sh->fns[k]->c);
+    for (int i = 0; i < fn->nOut; i++)
+        if (!c.outSet[i]) {
+            const SYMBOL *p = &sh->st->syms[fn->firstParam + fn->nIn + i];
+            report(&c, p->line, "output parameter %s of %s is never assigned",
+                   nameOf(&c, p->name), nameOf(&c, fn->name));
+        }
+
+    free(c.outSet);
+    sh->diags[k]  = c.diag;
+    sh->errors[k] = c.errors;
+}
+
+/* ------------------------------------------------------------------
+ * checkProgram
+ * ------------------------------------------------------------------ */
+int checkProgram(const SYMBOL_TABLE *st, const AstNode *program, int nThreads,
+                 diagBuffer diag) {
+    int n = st->nFuncs;
+    if (program == NULL || n == 0)
+        return 0;
+
+    CheckShared sh = { st, (const AstNode **)malloc(n * sizeof(AstNode *)),
+                       (diagBuffer *)malloc(n * sizeof(diagBuffer)),
+                       (int *)malloc(n * sizeof(int)) };
+    int k = 0;
+    for (const AstNode *fn = program->a; fn != NULL && k < n; fn = fn->next)
+        sh.fns[k++] = fn;
+    if (program->b != NULL && k < n)
+        sh.fns[k++] = program->b;
+
+    runPool(k, nThreads < 1 ? 1 : nThreads > k ? k : nThreads, checkFunctionTask, &sh);
+
+    /* function order, whatever order the tasks finished in */
+    int errors = 0;
+    for (int i = 0; i < k; i++) {
+        if (sh.diags[i]->len > 0)
+            diagPrintf(diag, "%s", sh.diags[i]->text);
+        errors += sh.errors[i];
+        freeDiagBuffer(sh.diags[i]);
+    }
+    free(sh.fns);
+    free(sh.diags);
+    free(sh.errors);
+    return errors;
+}
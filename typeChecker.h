@@ -0,0 +1,32 @@
+#ifndef TYPE_CHECKER_H
+#define TYPE_CHECKER_H
+
+#include "ast.h"
+#include "diag.h"
+#include "symbolTable.h"
+
+/*
+ * Semantic analysis of function bodies: every name used must be
+ * declared, assignments, arithmetic and relational operators must get
+ * operands of matching types, calls must match the callee's parameter
+ * lists (and callees must be defined earlier, recursion is not
+ * allowed), returns must match the output parameters, every output
+ * parameter must be assigned, and some variable of a while condition
+ * must change in the loop.
+ *
+ * Arithmetic never converts between int and real.  Records of one type
+ * may be added and subtracted, and multiplied or divided by a scalar
+ * (scalar * record too); unions take no part in arithmetic.
+ *
+ * The symbol table is the whole global environment and is only read,
+ * as is the tree, so functions are checked concurrently, one pool task
+ * each.  Each task collects its own diagnostics; they are appended to
+ * 'diag' in function order, so the output does not depend on
+ * 'nThreads' (which is capped at the number of functions).
+ */
+
+/* Check every function of 'program' (as given to buildSymbolTable); returns the error count */
+int checkProgram(const SYMBOL_TABLE *st, const AstNode *program, int nThreads,
+                 diagBuffer diag);
+
+#endif /* TYPE_CHECKER_H */
@@ -0,0 +1,129 @@
+#include "typeLayout.h"
+#include <stdlib.h>
+
+/* Per-type state while laying out: nested records are done first */
+enum { LAYOUT_TODO, LAYOUT_BUSY, LAYOUT_DONE };
+
+static int32_t roundUp(int32_t n, int32_t align) {
+    return (n + align - 1) / align * align;
+}
+
+static void layoutOne(symbolTable st, int t, uint8_t *state, diagBuffer diag) {
+    TYPE_INFO *ti = &st->types[t];
+
+    if (state[t] == LAYOUT_DONE)
+        return;
+    if (state[t] == LAYOUT_BUSY) {
+        /* reached again through its own fields: it would be infinitely large */
+        diagPrintf(diag, "Line %02d: Semantic Error : %s contains itself\n", ti->line,
+                   internText(st->names, ti->name));
+        return;
+    }
+    state[t]  = LAYOUT_BUSY;
+    ti->size  = 0;      /* what a field sees if it leads back here */
+    ti->align = 1;
+
+    int32_t size = 0, align = 1;
+    for (int f = ti->firstField; f < ti->firstField + ti->nFields; f++) {
+        FIELD_INFO *fi = &st->fields[f];
+        int32_t     fs = 0, fa = 1;
+        if (fi->type != TYPE_NONE) {
+            layoutOne(st, fi->type, state, diag);
+            fs = st->types[fi->type].size;
+            fa = st->types[fi->type].align;
+        }
+        if (fa > align)
+            align = fa;
+        if (ti->kind == TYPE_UNION) {
+            fi->offset = 0;
+            if (fs > size)
+                size = fs;
+        } else {
+            fi->offset = roundUp(size, fa);
+            size       = fi->offset + fs;
+        }
+    }
+
+    ti->size  = roundUp(size, align);
+    ti->align = align;
+    state[t]  = LAYOUT_DONE;
+}
+
+/* ------------------------------------------------------------------
+ * layoutTypes
+ * ------------------------------------------------------------------ */
+void layoutTypes(symbolTable st, diagBuffer diag) {
+    uint8_t *state = (uint8_t *)calloc(st->nTypes > 0 ? st->nTypes : 1, 1);
+
+    st->types[TYPE_INT].size   = st->types[TYPE_INT].align  = INT_SIZE;
+    st->types[TYPE_REAL].size  = st->types[TYPE_REAL].align = REAL_SIZE;
+    state[TYPE_INT] = state[TYPE_REAL] = LAYOUT_DONE;
+
+    /* aliases were resolved onto their targets, which are laid out in their own right */
+    for (int t = TYPE_REAL + 1; t < st->nTypes; t++)
+        if (st->types[t].alias == TYPE_NONE)
+            layoutOne(st, t, state, diag);
+    for (int t = TYPE_REAL + 1; t < st->nTypes; t++) {
+        TYPE_INFO *ti = &st->types[t];
+        int        r  = t;
+        for (int steps = 0; st->types[r].alias != TYPE_NONE && steps < st->nTypes; steps++)
+            r = st->types[r].alias;
+        if (r != t) {
+            ti->size  = st->types[r].size;
+            ti->align = st->types[r].align;
+        }
+    }
+    free(state);
+}
+
+/* ---- access chains ---- */
+
+/* Type of the variable or field 'v' names; its chain's nodes get their offsets on the way */
+static int accessType(const SYMBOL_TABLE *st, int scope, AstNode *v) {
+    if (v->kind == AST_ID) {
+        int sym = lookupSymbol(st, scope, v->nameId);
+        if (sym < 0 || st->syms[sym].kind == SYM_FUNCTION || st->syms[sym].kind == SYM_TYPE)
+            return TYPE_NONE;
+        return st->syms[sym].type;
+    }
+
+    v->offset = -1;
+    v->typeId = -1;
+    int base = accessType(st, scope, v->a);
+    if (base <= TYPE_REAL)
+        return TYPE_NONE;
+    const FIELD_INFO *f = lookupField(st, base, v->nameId);
+    if (f == NULL)
+        return TYPE_NONE;
+    int32_t start = (v->a->kind == AST_RECORD_ACCESS) ? v->a->offset : 0;
+    if (start < 0)
+        return TYPE_NONE;
+    v->offset = start + f->offset;
+    v->typeId = f->type;
+    return f->type;
+}
+
+static void layoutUses(const SYMBOL_TABLE *st, int scope, AstNode *n) {
+    for (; n != NULL; n = n->next) {
+        if (n->kind == AST_RECORD_ACCESS) {
+            accessType(st, scope, n);
+            continue;   /* the chain is done in one go */
+        }
+        layoutUses(st, scope, n->a);
+        layoutUses(st, scope, n->b);
+        layoutUses(st, scope, n->c);
+    }
+}
+
+/* ------------------------------------------------------------------
+ * layoutAccesses
+ * ------------------------------------------------------------------ */
+void layoutAccesses(const SYMBOL_TABLE *st, AstNode *program) {
+    if (program == NULL)
+        return;
+    int k = 0;
+    for (AstNode *fn = program->a; fn != NULL && k < st->nFuncs; fn = fn->next, k++)
+        layoutUses(st, st->funcs[k].scope, fn->c);
+    if (program->b != NULL && k < st->nFuncs)
+        layoutUses(st, st->funcs[k].scope, program->b->c);
+}
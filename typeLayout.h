@@ -0,0 +1,35 @@
+#ifndef TYPE_LAYOUT_H
+#define TYPE_LAYOUT_H
+
+#include "ast.h"
+#include "diag.h"
+#include "symbolTable.h"
+
+/*
+ * Storage layout of types.  int is a 32-bit integer and real a double;
+ * a record lays its fields out in declaration order, each at the next
+ * multiple of its alignment, and is padded to a multiple of the largest
+ * one; a union puts every field at offset 0 and is as large as its
+ * largest field.  Records nested by value are laid out first, and a
+ * record that contains itself is an error.
+ *
+ * buildSymbolTable runs layoutTypes once aliases are resolved, so every
+ * TYPE_INFO has its size and alignment and every FIELD_INFO its offset.
+ * layoutAccesses then folds each dotted access chain into one offset
+ * from its base variable, stored in the AST_RECORD_ACCESS nodes.
+ */
+#define INT_SIZE  4
+#define REAL_SIZE 8
+
+/* Size, alignment and field offsets of every type; self-containing records go to 'diag' */
+void layoutTypes(symbolTable st, diagBuffer diag);
+
+/*
+ * Set offset and typeId on every AST_RECORD_ACCESS of 'program'.  The
+ * outermost node of a chain such as b.x.y gets the byte offset of y
+ * within b, so the chain compiles to one load or store.  Accesses that
+ * do not resolve (reported by the type checker) keep offset -1.
+ */
+void layoutAccesses(const SYMBOL_TABLE *st, AstNode *program);
+
+#endif /* TYPE_LAYOUT_H */
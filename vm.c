@@ -0,0 +1,401 @@
+#include "vm.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *STATUS_TEXT[] = {
+    [VM_OK]       = "ok",
+    [VM_NO_MAIN]  = "no main function",
+    [VM_DIV_ZERO] = "division by zero",
+    [VM_DEPTH]    = "calls nested too deeply",
+};
+
+const char *vmStatusText(VM_STATUS status) {
+    return (status <= VM_DEPTH) ? STATUS_TEXT[status] : "?";
+}
+
+/* Labels as values where the compiler has them */
+#if defined(__GNUC__)
+#define VM_THREADED 1
+#endif
+
+#define VM_IO_BYTES    65536
+#define VM_CHUNK_SLOTS 65536
+
+/* ---- buffered input and output ---- */
+
+typedef struct {
+    FILE  *fp;
+    char  *buf;
+    size_t len;
+    size_t pos;
+} InBuf;
+
+typedef struct {
+    FILE  *fp;
+    char  *buf;
+    size_t len;
+} OutBuf;
+
+/* Keep what is unread and top the buffer up; false once nothing is left */
+static bool refill(InBuf *in) {
+    memmove(in->buf, in->buf + in->pos, in->len - in->pos);
+    in->len -= in->pos;
+    in->pos  = 0;
+    in->len += fread(in->buf + in->len, 1, VM_IO_BYTES - in->len, in->fp);
+    return in->len > 0;
+}
+
+/* Next whitespace-separated token, cut at cap - 1 bytes; false at end of input */
+static bool nextToken(InBuf *in, char *tok, size_t cap) {
+    size_t n = 0;
+    for (;;) {
+        if (in->pos == in->len && !refill(in))
+            return false;
+        char ch = in->buf[in->pos];
+        if (ch != ' ' && ch != '\t' && ch != '\n' && ch != '\r')
+            break;
+        in->pos++;
+    }
+    for (;;) {
+        if (in->pos == in->len && !refill(in))
+            break;
+        char ch = in->buf[in->pos];
+        if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r')
+            break;
+        if (n + 1 < cap)
+            tok[n++] = ch;
+        in->pos++;
+    }
+    tok[n] = '\0';
+    return true;
+}
+
+static void flushOut(OutBuf *out) {
+    if (out->len > 0)
+        fwrite(out->buf, 1, out->len, out->fp);
+    out->len = 0;
+}
+
+/* ---- frames ---- */
+
+/* Register windows: chunks are only added, so a window never moves */
+typedef struct {
+    BC_VALUE *slots;
+    size_t    cap;
+    size_t    used;
+} Chunk;
+
+typedef struct {
+    Chunk *chunks;
+    int    nChunks;
+    int    cur;
+} Arena;
+
+/* A call in progress: where its results go and what to give back on return */
+typedef struct {
+    const uint32_t *ret;    /* the CALL's result list */
+    BC_VALUE       *regs;   /* the caller's registers */
+    int32_t         chunk;  /* the arena before the callee's window */
+    size_t          used;
+} Frame;
+
+static Chunk newChunk(size_t n) {
+    size_t cap = n > VM_CHUNK_SLOTS ? n : VM_CHUNK_SLOTS;
+    return (Chunk){ (BC_VALUE *)malloc(cap * sizeof(BC_VALUE)), cap, 0 };
+}
+
+/* n registers past the last window; a chunk left behind is kept for the next deep call */
+static BC_VALUE *arenaAlloc(Arena *a, size_t n) {
+    Chunk *c = &a->chunks[a->cur];
+    if (c->used + n > c->cap) {
+        if (++a->cur == a->nChunks) {
+            a->chunks = (Chunk *)realloc(a->chunks, (a->nChunks + 1) * sizeof(Chunk));
+            a->chunks[a->nChunks++] = newChunk(n);
+        } else if (a->chunks[a->cur].cap < n) {
+            free(a->chunks[a->cur].slots);
+            a->chunks[a->cur] = newChunk(n);
+        }
+        c       = &a->chunks[a->cur];
+        c->used = 0;
+    }
+    BC_VALUE *p = c->slots + c->used;
+    c->used += n;
+    return p;
+}
+
+/* ---- values ---- */
+
+typedef struct {
+    const BC_MODULE *b;
+    VM_RUN          *run;
+    InBuf            in;
+    OutBuf           out;
+    uint64_t         rng;
+} Vm;
+
+static BC_VALUE readValue(Vm *V, bool real) {
+    BC_VALUE x = { .i = 0 };
+    if (V->run->in != NULL) {
+        char tok[64];
+        if (!nextToken(&V->in, tok, sizeof tok))
+            return x;
+        if (real)
+            x.r = strtod(tok, NULL);
+        else
+            x.i = (int64_t)(int32_t)(uint32_t)strtoll(tok, NULL, 10);
+        return x;
+    }
+    V->rng = V->rng * 6364136223846793005ull + 1442695040888963407ull;
+    uint32_t r = (uint32_t)(V->rng >> 33);
+    if (real)
+        x.r = (r % 10000) / 100.0;
+    else
+        x.i = r % 100;
+    return x;
+}
+
+static void writeValue(Vm *V, bool real, BC_VALUE x) {
+    VM_RUN  *run  = V->run;
+    uint64_t bits = (uint64_t)x.i;
+    if (real)
+        memcpy(&bits, &x.r, sizeof bits);
+    run->checksum = (run->checksum ^ bits) * 0x100000001B3ull;
+    run->writes++;
+    if (run->out == NULL)
+        return;
+    if (V->out.len + 64 > VM_IO_BYTES)
+        flushOut(&V->out);
+    int n = real ? snprintf(V->out.buf + V->out.len, 64, "%.2f\n", x.r)
+                 : snprintf(V->out.buf + V->out.len, 64, "%lld\n", (long long)x.i);
+    if (n >= 64) {      /* a real too wide for the slot */
+        flushOut(&V->out);
+        fprintf(run->out, "%.2f\n", x.r);
+    } else {
+        V->out.len += n;
+    }
+}
+
+static int64_t realToInt(double r) {
+    if (r != r)
+        return 0;
+    if (r >= 2147483647.0)
+        return INT32_MAX;
+    if (r <= -2147483648.0)
+        return INT32_MIN;
+    return (int64_t)r;
+}
+
+#define I32(x) ((int64_t)(int32_t)(uint32_t)(x))
+
+/* ---- the loop ---- */
+
+static VM_STATUS execute(Vm *V, Arena *arena, Frame *frames) {
+    const BC_MODULE *b      = V->b;
+    const uint32_t  *code   = b->code;
+    const BC_VALUE  *K      = b->consts;
+    const BC_FUNC   *entry  = &b->funcs[b->nFuncs - 1];
+    uint64_t        *counts = V->run->counts;
+    uint8_t         *G      = (uint8_t *)calloc(b->globalBytes > 0 ? b->globalBytes : 1, 1);
+    int              depth  = 0;
+    VM_STATUS        status = VM_OK;
+
+    BC_VALUE       *R  = arenaAlloc(arena, entry->nRegs);
+    const uint32_t *pc = code + entry->entry;
+    memset(R, 0, entry->nRegs * sizeof(BC_VALUE));
+
+#ifdef VM_THREADED
+    static void *const LABELS[BC_OP_COUNT] = {
+        [BC_LOADK] = &&op_LOADK,     [BC_MOV] = &&op_MOV,
+        [BC_ADDI] = &&op_ADDI,       [BC_SUBI] = &&op_SUBI,       [BC_MULI] = &&op_MULI,
+        [BC_DIVI] = &&op_DIVI,       [BC_ADDR] = &&op_ADDR,       [BC_SUBR] = &&op_SUBR,
+        [BC_MULR] = &&op_MULR,       [BC_DIVR] = &&op_DIVR,
+        [BC_LTI] = &&op_LTI,         [BC_LEI] = &&op_LEI,         [BC_EQI] = &&op_EQI,
+        [BC_GTI] = &&op_GTI,         [BC_GEI] = &&op_GEI,         [BC_NEI] = &&op_NEI,
+        [BC_LTR] = &&op_LTR,         [BC_LER] = &&op_LER,         [BC_EQR] = &&op_EQR,
+        [BC_GTR] = &&op_GTR,         [BC_GER] = &&op_GER,         [BC_NER] = &&op_NER,
+        [BC_AND] = &&op_AND,         [BC_OR] = &&op_OR,           [BC_NOT] = &&op_NOT,
+        [BC_ITOR] = &&op_ITOR,       [BC_RTOI] = &&op_RTOI,
+        [BC_GLOADI] = &&op_GLOADI,   [BC_GLOADR] = &&op_GLOADR,
+        [BC_GSTOREI] = &&op_GSTOREI, [BC_GSTORER] = &&op_GSTORER,
+        [BC_READI] = &&op_READI,     [BC_READR] = &&op_READR,
+        [BC_WRITEI] = &&op_WRITEI,   [BC_WRITER] = &&op_WRITER,
+        [BC_JMP] = &&op_JMP,         [BC_JT] = &&op_JT,           [BC_JF] = &&op_JF,
+        [BC_CALL] = &&op_CALL,       [BC_RET] = &&op_RET,
+    };
+#define OP(name) op_##name:
+#define NEXT()   do { counts[*pc]++; goto *LABELS[*pc]; } while (0)
+    NEXT();
+#else
+#define OP(name) case BC_##name:
+#define NEXT()   continue
+    for (;;) {
+        counts[*pc]++;
+        switch ((BC_OP)*pc) {
+#endif
+
+    OP(LOADK)   R[pc[1]] = K[pc[2]];                                    pc += 3; NEXT();
+    OP(MOV)     R[pc[1]] = R[pc[2]];                                    pc += 3; NEXT();
+    OP(ADDI)    R[pc[1]].i = I32(R[pc[2]].i + R[pc[3]].i);              pc += 4; NEXT();
+    OP(SUBI)    R[pc[1]].i = I32(R[pc[2]].i - R[pc[3]].i);              pc += 4; NEXT();
+    OP(MULI)    R[pc[1]].i = I32(R[pc[2]].i * R[pc[3]].i);              pc += 4; NEXT();
+    OP(DIVI)
+        if (R[pc[3]].i == 0) {
+            status = VM_DIV_ZERO;
+            goto stop;
+        }
+        R[pc[1]].i = I32(R[pc[2]].i / R[pc[3]].i);
+        pc += 4;
+        NEXT();
+    OP(ADDR)    R[pc[1]].r = R[pc[2]].r + R[pc[3]].r;                   pc += 4; NEXT();
+    OP(SUBR)    R[pc[1]].r = R[pc[2]].r - R[pc[3]].r;                   pc += 4; NEXT();
+    OP(MULR)    R[pc[1]].r = R[pc[2]].r * R[pc[3]].r;                   pc += 4; NEXT();
+    OP(DIVR)    R[pc[1]].r = R[pc[2]].r / R[pc[3]].r;                   pc += 4; NEXT();
+    OP(LTI)     R[pc[1]].i = R[pc[2]].i < R[pc[3]].i;                   pc += 4; NEXT();
+    OP(LEI)     R[pc[1]].i = R[pc[2]].i <= R[pc[3]].i;                  pc += 4; NEXT();
+    OP(EQI)     R[pc[1]].i = R[pc[2]].i == R[pc[3]].i;                  pc += 4; NEXT();
+    OP(GTI)     R[pc[1]].i = R[pc[2]].i > R[pc[3]].i;                   pc += 4; NEXT();
+    OP(GEI)     R[pc[1]].i = R[pc[2]].i >= R[pc[3]].i;                  pc += 4; NEXT();
+    OP(NEI)     R[pc[1]].i = R[pc[2]].i != R[pc[3]].i;                  pc += 4; NEXT();
+    OP(LTR)     R[pc[1]].i = R[pc[2]].r < R[pc[3]].r;                   pc += 4; NEXT();
+    OP(LER)     R[pc[1]].i = R[pc[2]].r <= R[pc[3]].r;                  pc += 4; NEXT();
+    OP(EQR)     R[pc[1]].i = R[pc[2]].r == R[pc[3]].r;                  pc += 4; NEXT();
+    OP(GTR)     R[pc[1]].i = R[pc[2]].r > R[pc[3]].r;                   pc += 4; NEXT();
+    OP(GER)     R[pc[1]].i = R[pc[2]].r >= R[pc[3]].r;                  pc += 4; NEXT();
+    OP(NER)     R[pc[1]].i = R[pc[2]].r != R[pc[3]].r;                  pc += 4; NEXT();
+    OP(AND)     R[pc[1]].i = R[pc[2]].i && R[pc[3]].i;                  pc += 4; NEXT();
+    OP(OR)      R[pc[1]].i = R[pc[2]].i || R[pc[3]].i;                  pc += 4; NEXT();
+    OP(NOT)     R[pc[1]].i = !R[pc[2]].i;                               pc += 3; NEXT();
+    OP(ITOR)    R[pc[1]].r = (double)R[pc[2]].i;                        pc += 3; NEXT();
+    OP(RTOI)    R[pc[1]].i = realToInt(R[pc[2]].r);                     pc += 3; NEXT();
+    OP(GLOADI) {
+        int32_t x;
+        memcpy(&x, G + pc[2], sizeof x);
+        R[pc[1]].i = x;
+        pc += 3;
+        NEXT();
+    }
+    OP(GLOADR)  memcpy(&R[pc[1]].r, G + pc[2], sizeof(double));         pc += 3; NEXT();
+    OP(GSTOREI) {
+        int32_t x = (int32_t)R[pc[1]].i;
+        memcpy(G + pc[2], &x, sizeof x);
+        pc += 3;
+        NEXT();
+    }
+    OP(GSTORER) memcpy(G + pc[2], &R[pc[1]].r, sizeof(double));         pc += 3; NEXT();
+    OP(READI)   R[pc[1]] = readValue(V, false);                         pc += 2; NEXT();
+    OP(READR)   R[pc[1]] = readValue(V, true);                          pc += 2; NEXT();
+    OP(WRITEI)  writeValue(V, false, R[pc[1]]);                         pc += 2; NEXT();
+    OP(WRITER)  writeValue(V, true, R[pc[1]]);                          pc += 2; NEXT();
+    OP(JMP)     pc = code + pc[1];                                               NEXT();
+    OP(JT)      pc = R[pc[1]].i ? code + pc[2] : pc + 3;                         NEXT();
+    OP(JF)      pc = R[pc[1]].i ? pc + 3 : code + pc[2];                         NEXT();
+    OP(CALL) {
+        const BC_FUNC  *g   = &b->funcs[pc[1]];
+        uint32_t        n   = pc[2];
+        const uint32_t *res = pc + 3 + n;
+        if (g->codeLen == 0) {  /* no body: its results are 0 */
+            for (uint32_t i = 0; i < res[0]; i++)
+                R[res[1 + i]].i = 0;
+            pc = res + 1 + res[0];
+            NEXT();
+        }
+        if (depth == VM_MAX_CALL_DEPTH) {
+            status = VM_DEPTH;
+            goto stop;
+        }
+        Frame *fr = &frames[depth++];
+        fr->ret   = res;
+        fr->regs  = R;
+        fr->chunk = arena->cur;
+        fr->used  = arena->chunks[arena->cur].used;
+        BC_VALUE *callee = arenaAlloc(arena, g->nRegs);
+        memset(callee, 0, g->nRegs * sizeof(BC_VALUE));
+        for (uint32_t i = 0; i < n; i++)
+            callee[i] = R[pc[3 + i]];
+        R  = callee;
+        pc = code + g->entry;
+        NEXT();
+    }
+    OP(RET) {
+        if (depth == 0)
+            goto stop;
+        Frame          *fr  = &frames[--depth];
+        const uint32_t *res = fr->ret;
+        uint32_t        m   = res[0] < pc[1] ? res[0] : pc[1];
+        for (uint32_t i = 0; i < m; i++)
+            fr->regs[res[1 + i]] = R[pc[2 + i]];
+        arena->cur = fr->chunk;
+        arena->chunks[arena->cur].used = fr->used;
+        R  = fr->regs;
+        pc = res + 1 + res[0];
+        NEXT();
+    }
+
+#ifndef VM_THREADED
+        default:
+            goto stop;
+        }
+    }
+#endif
+#undef OP
+#undef NEXT
+
+stop:
+    if (status != VM_OK)
+        V->run->line = bcLineAt(b, (uint32_t)(pc - code));
+    free(G);
+    return status;
+}
+
+/* ------------------------------------------------------------------
+ * vmRun
+ * ------------------------------------------------------------------ */
+VM_STATUS vmRun(const BC_MODULE *b, VM_RUN *run) {
+    memset(run->counts, 0, sizeof run->counts);
+    run->steps = run->writes = run->checksum = 0;
+    run->line  = 0;
+    if (b->nFuncs == 0 || b->funcs[b->nFuncs - 1].codeLen == 0)
+        return VM_NO_MAIN;
+
+    Vm V = { .b = b, .run = run, .rng = run->seed };
+    V.in.fp   = run->in;
+    V.in.buf  = run->in ? (char *)malloc(VM_IO_BYTES) : NULL;
+    V.out.fp  = run->out;
+    V.out.buf = run->out ? (char *)malloc(VM_IO_BYTES) : NULL;
+
+    Arena arena = { .chunks = (Chunk *)malloc(sizeof(Chunk)), .nChunks = 1, .cur = 0 };
+    arena.chunks[0] = newChunk(0);
+    Frame *frames = (Frame *)malloc(VM_MAX_CALL_DEPTH * sizeof(Frame));
+
+    VM_STATUS status = execute(&V, &arena, frames);
+    for (int op = 0; op < BC_OP_COUNT; op++)
+        run->steps += run->counts[op];
+    if (run->out != NULL)
+        flushOut(&V.out);
+
+    for (int i = 0; i < arena.nChunks; i++)
+        free(arena.chunks[i].slots);
+    free(arena.chunks);
+    free(frames);
+    free(V.in.buf);
+    free(V.out.buf);
+    return status;
+}
+
+void vmPrintCounts(const VM_RUN *run, FILE *out) {
+    int order[BC_OP_COUNT], n = 0;
+    for (int op = 0; op < BC_OP_COUNT; op++) {
+        if (run->counts[op] == 0)
+            continue;
+        int i = n++;
+        for (; i > 0 && run->counts[order[i - 1]] < run->counts[op]; i--)
+            order[i] = order[i - 1];
+        order[i] = op;
+    }
+    fprintf(out, "%-8s %16s %8s\n", "opcode", "executed", "share");
+    for (int i = 0; i < n; i++)
+        fprintf(out, "%-8s %16llu %7.2f%%\n", bcOpName((BC_OP)order[i]),
+                (unsigned long long)run->counts[order[i]],
+                run->steps ? 100.0 * run->counts[order[i]] / run->steps : 0.0);
+}
@@ -0,0 +1,51 @@
+#ifndef VM_H
+#define VM_H
+
+#include "bytecode.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Bytecode interpreter.  Dispatch is a computed goto per instruction
+ * where the compiler has labels as values (GCC, Clang), a switch
+ * elsewhere.  Call frames are register windows cut from a chunked
+ * arena that never moves, so a call costs a bump of its pointer; read
+ * and write go through buffers of their own rather than stdio per
+ * value.
+ *
+ * Values are those of irRun (irInterp.h): the same 32-bit int and
+ * real semantics, the same read stream for a seed and the same
+ * checksum of what is written, so one can check the other.  Every
+ * executed instruction is counted by opcode.
+ */
+typedef enum {
+    VM_OK,
+    VM_NO_MAIN,
+    VM_DIV_ZERO,    /* int division by zero */
+    VM_DEPTH,       /* calls nested deeper than VM_MAX_CALL_DEPTH */
+} VM_STATUS;
+
+#define VM_MAX_CALL_DEPTH 4096
+
+typedef struct {
+    FILE    *in;
+    FILE    *out;
+    uint64_t seed;
+
+    /* results */
+    uint64_t counts[BC_OP_COUNT];   /* instructions executed, by opcode */
+    uint64_t steps;                 /* their sum */
+    uint64_t writes;
+    uint64_t checksum;
+    int      line;                  /* of the instruction that stopped a failed run */
+} VM_RUN;
+
+/* Run main; the counters in 'run' are reset first */
+VM_STATUS vmRun(const BC_MODULE *b, VM_RUN *run);
+
+const char *vmStatusText(VM_STATUS status);
+
+/* One line per opcode executed: count and share, most frequent first */
+void vmPrintCounts(const VM_RUN *run, FILE *out);
+
+#endif /* VM_H */
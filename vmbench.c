@@ -0,0 +1,451 @@
+/*
+ * vmbench — bytecode VM against the IR interpreter on a suite of
+ * generated programs.
+ *
+ *     ./vmbench [--kernels=N] [--iters=N] [--seed=N] [--runs=N] [--level=N] [--counts]
+ *     ./vmbench --images=N [--damage=N] [--seed=N] [--level=N]
+ *
+ * Each program of the suite is N kernels (default 16, see kernelGen.h)
+ * of one kind, or of every kind for "mixed", called with --iters
+ * iterations (default 20000).  A program is checked, lowered, optimised
+ * at --level (default 3), run by irRun, then compiled to bytecode and
+ * run by vmRun; both must write the same values.  Reports, per program,
+ * the bytecode size, the instructions each executed, the median run
+ * time over --runs runs (default 3), VM instructions per second and
+ * the VM's speedup.  --counts adds the opcodes the suite executed.
+ *
+ * A second table gives each program's time to the first instruction:
+ * from source (load the tables, parse, check, lower, optimise and
+ * compile, as the driver's --run does) and from a bytecode image
+ * written by writeBcImage (map it).  The run from the image must write
+ * the same values too.
+ *
+ * --images=N times nothing: it checks the image loader instead.  N small
+ * programs of every kernel kind (seeds --seed, --seed + 1, ...) are
+ * compiled at --level and written as images; each must map and write
+ * what the module it came from wrote.  Each image is then damaged
+ * --damage times (default 16) by flipping 1-3 bytes of its code,
+ * constant and function sections.  mapBcImage must refuse the copy, or
+ * the module it accepts must run in a child process without dying of
+ * anything but a one-second alarm (damaged code may loop).  Reports how
+ * many copies were refused, by reason, and how many were accepted.
+ */
+#include "ast.h"
+#include "bench.h"
+#include "bytecode.h"
+#include "fileIO.h"
+#include "grammarTable.h"
+#include "ir.h"
+#include "irInterp.h"
+#include "irOpt.h"
+#include "kernelGen.h"
+#include "pool.h"
+#include "symbolTable.h"
+#include "typeChecker.h"
+#include "vm.h"
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+typedef struct {
+    const char *name;
+    unsigned    kinds;
+} SuiteEntry;
+
+static const SuiteEntry SUITE[] = {
+    { "counted", 1u << KERNEL_INVARIANT | 1u << KERNEL_COUNTDOWN },
+    { "nested", 1u << KERNEL_NESTED },
+    { "real", 1u << KERNEL_REAL },
+    { "globals", 1u << KERNEL_GLOBAL },
+    { "calls", 1u << KERNEL_CALLS },
+    { "mixed", 0 },
+};
+
+enum { NSUITE = sizeof SUITE / sizeof SUITE[0] };
+
+/* One program's results */
+typedef struct {
+    size_t   bytes;         /* bytecode */
+    uint64_t irSteps;
+    uint64_t vmSteps;
+    uint64_t irNs;          /* medians */
+    uint64_t vmNs;
+    uint64_t compileNs;
+    uint64_t sourceNs;      /* to the first instruction */
+    uint64_t imageNs;
+    size_t   imageBytes;
+} Result;
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [--kernels=N] [--iters=N] [--seed=N] [--runs=N] [--level=N] [--counts]\n"
+            "       %s --images=N [--damage=N] [--seed=N] [--level=N]\n",
+            prog, prog);
+}
+
+static bool intOption(const char *a, const char *name, long lo, long hi, long *v) {
+    size_t n = strlen(name);
+    if (strncmp(a, name, n) != 0)
+        return false;
+    char *end;
+    *v = strtol(a + n, &end, 10);
+    return end != a + n && *end == '\0' && *v >= lo && *v <= hi;
+}
+
+/* ---- one program ---- */
+
+/* What a run from source does before its first instruction; NULL if the program is not clean */
+static bcModule compileSource(FILE *src, int level) {
+    diagBuffer    gdiag = createDiagBuffer();
+    grammarTables T     = loadGrammarTables(GRAMMAR_FILE, GRAMMAR_BLOB, gdiag);
+    diagBuffer    diag  = createDiagBuffer();
+    bcModule      bc    = NULL;
+    freeDiagBuffer(gdiag);
+    if (T != NULL) {
+        astArena arena;
+        rewind(src);
+        AstNode *ast = parseSourceAST(T->pt, T->g, src, &arena, diag);
+        if (ast != NULL) {
+            symbolTable st = buildSymbolTable(ast, diag);
+            checkProgram(st, ast, poolDefaultThreads(), diag);
+            if (diag->len == 0) {
+                IR_PIPELINE p;
+                irModule    ir = lowerProgram(st, ast);
+                irPipelineForLevel(level, &p);
+                irOptimize(ir, &p, NULL);
+                bc = compileBytecode(ir);
+                freeIrModule(ir);
+            }
+            freeSymbolTable(st);
+            freeAstArena(arena);
+        }
+        freeGrammarTables(T);
+    }
+    freeDiagBuffer(diag);
+    return bc;
+}
+
+/* 0 on success; the VM's opcode counts are added to 'total' */
+static int benchProgram(grammarTables T, const SuiteEntry *e, const KernelOptions *gen, int level,
+                        int runs, Result *res, VM_RUN *total) {
+    FILE *src = tmpfile();
+    if (src == NULL) {
+        perror("tmpfile");
+        return 1;
+    }
+    generateKernels(src, gen);
+    rewind(src);
+    astArena   arena;
+    diagBuffer diag = createDiagBuffer();
+    AstNode   *ast  = parseSourceAST(T->pt, T->g, src, &arena, diag);
+    if (ast == NULL) {
+        diagFlush(diag, stderr);
+        fprintf(stderr, "%s: no AST (syntax errors)\n", e->name);
+        freeDiagBuffer(diag);
+        fclose(src);
+        return 1;
+    }
+
+    symbolTable st     = buildSymbolTable(ast, diag);
+    int         status = 0;
+    checkProgram(st, ast, poolDefaultThreads(), diag);
+    if (diag->len > 0) {
+        diagFlush(diag, stderr);
+        status = 1;
+    }
+
+    irModule    ir        = NULL;
+    bcModule    bc        = NULL;
+    benchReport r         = createBenchReport(e->name, runs);
+    int         phIr      = benchPhase(r, "ir");
+    int         phCompile = benchPhase(r, "compile");
+    int         phVm      = benchPhase(r, "vm");
+    int         phSource  = benchPhase(r, "from source");
+    int         phImage   = benchPhase(r, "from image");
+    IR_PIPELINE p;
+    IR_RUN      x = { .seed = 1 };
+    VM_RUN      y = { .seed = 1 };
+    if (status == 0) {
+        ir = lowerProgram(st, ast);
+        irPipelineForLevel(level, &p);
+        irOptimize(ir, &p, NULL);
+    }
+
+    for (int run = 0; run < runs && status == 0; run++) {
+        uint64_t      t0 = benchNow();
+        IR_RUN_STATUS rs = irRun(ir, &x);
+        benchRecord(r, phIr, benchNow() - t0);
+        if (rs != IR_RUN_OK) {
+            fprintf(stderr, "%s: irRun failed at line %d: %s\n", e->name, x.line,
+                    irRunStatusText(rs));
+            status = 1;
+        }
+    }
+    for (int run = 0; run < runs && status == 0; run++) {
+        uint64_t t0 = benchNow();
+        freeBcModule(bc);
+        bc = compileBytecode(ir);
+        benchRecord(r, phCompile, benchNow() - t0);
+
+        t0           = benchNow();
+        VM_STATUS vs = vmRun(bc, &y);
+        benchRecord(r, phVm, benchNow() - t0);
+        if (vs != VM_OK) {
+            fprintf(stderr, "%s: vmRun failed at line %d: %s\n", e->name, y.line,
+                    vmStatusText(vs));
+            status = 1;
+        } else if (y.checksum != x.checksum || y.writes != x.writes) {
+            fprintf(stderr, "%s: VM writes differ from irRun\n", e->name);
+            status = 1;
+        }
+    }
+
+    /* the clock stops where vmRun would start; mapping counts, the page faults it defers do not */
+    for (int run = 0; run < runs && status == 0; run++) {
+        uint64_t t0 = benchNow();
+        bcModule s  = compileSource(src, level);
+        benchRecord(r, phSource, benchNow() - t0);
+        status = s == NULL;
+        freeBcModule(s);
+    }
+    char imagePath[] = "/tmp/vmbench.XXXXXX";
+    int  fd          = status == 0 ? mkstemp(imagePath) : -1;
+    if (fd >= 0) {
+        close(fd);
+        status = !writeBcImage(imagePath, bc);
+    } else {
+        status = 1;
+    }
+    for (int run = 0; run < runs && status == 0; run++) {
+        uint64_t t0 = benchNow();
+        bcModule im = mapBcImage(imagePath, NULL);
+        benchRecord(r, phImage, benchNow() - t0);
+        VM_RUN z = { .seed = 1 };
+        if (im == NULL || vmRun(im, &z) != VM_OK || z.checksum != x.checksum) {
+            fprintf(stderr, "%s: the image does not run as the module did\n", e->name);
+            status = 1;
+        } else if (run == 0) {
+            res->imageBytes = im->mapLen;
+        }
+        freeBcModule(im);
+    }
+    if (fd >= 0)
+        unlink(imagePath);
+    fclose(src);
+
+    if (status == 0) {
+        res->bytes     = bcModuleBytes(bc);
+        res->irSteps   = x.steps;
+        res->vmSteps   = y.steps;
+        res->irNs      = benchMedian(r, phIr);
+        res->vmNs      = benchMedian(r, phVm);
+        res->compileNs = benchMedian(r, phCompile);
+        res->sourceNs  = benchMedian(r, phSource);
+        res->imageNs   = benchMedian(r, phImage);
+        for (int op = 0; op < BC_OP_COUNT; op++)
+            total->counts[op] += y.counts[op];
+        total->steps += y.steps;
+    }
+
+    freeBenchReport(r);
+    freeBcModule(bc);
+    if (ir != NULL)
+        freeIrModule(ir);
+    freeDiagBuffer(diag);
+    freeSymbolTable(st);
+    freeAstArena(arena);
+    return status;
+}
+
+/* ---- --images: the loader on good and damaged images ---- */
+
+static uint64_t nextRandom(uint64_t *s) {
+    uint64_t z = (*s += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/* Run an accepted module in a child: false unless it exits cleanly or is stopped by the alarm */
+static bool runsSafely(const BC_MODULE *b) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        alarm(1);
+        VM_RUN run = { .seed = 1 };
+        vmRun(b, &run);
+        _exit(0);
+    }
+    int st;
+    if (pid < 0 || waitpid(pid, &st, 0) != pid)
+        return false;
+    return (WIFEXITED(st) && WEXITSTATUS(st) == 0) ||
+           (WIFSIGNALED(st) && WTERMSIG(st) == SIGALRM);
+}
+
+/* 'copies' copies of 'im', 1-3 bytes flipped between its code and line table, mapped from 'path' */
+static void damageImage(const BC_MODULE *im, const char *path, long copies, uint64_t *rng,
+                        long refused[], long *accepted, long *crashed) {
+    const BC_IMAGE_HEADER *hdr = (const BC_IMAGE_HEADER *)im->map;
+    uint64_t               lo  = hdr->sections[BC_SEC_CODE].offset;
+    uint64_t               hi  = hdr->sections[BC_SEC_LINES].offset;
+    char                  *buf = (char *)malloc(im->mapLen);
+    for (long c = 0; c < copies && hi > lo; c++) {
+        memcpy(buf, im->map, im->mapLen);
+        int flips = 1 + (int)(nextRandom(rng) % 3);
+        for (int k = 0; k < flips; k++)
+            buf[lo + nextRandom(rng) % (hi - lo)] ^= (char)(1u << (nextRandom(rng) % 8));
+        if (!writeFileAtomic(path, buf, im->mapLen)) {
+            perror(path);
+            break;
+        }
+
+        BC_IMAGE_STATUS why;
+        bcModule        d = mapBcImage(path, &why);
+        if (d == NULL) {
+            refused[why]++;
+        } else {
+            (*accepted)++;
+            if (!runsSafely(d))
+                (*crashed)++;
+            freeBcModule(d);
+        }
+    }
+    free(buf);
+}
+
+static int checkImages(long n, long damage, long seed, int level) {
+    long     refused[BC_IMAGE_BAD_CODE + 1] = { 0 };
+    long     accepted = 0, crashed = 0, mapped = 0;
+    int      status   = 0;
+    uint64_t rng      = (uint64_t)seed;
+
+    char imagePath[] = "/tmp/vmbench.XXXXXX";
+    int  fd          = mkstemp(imagePath);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    for (long i = 0; i < n && status == 0; i++) {
+        KernelOptions gen = { 4, 50, (uint64_t)(seed + i), 0 };
+        FILE         *src = tmpfile();
+        if (src == NULL) {
+            perror("tmpfile");
+            status = 1;
+            break;
+        }
+        generateKernels(src, &gen);
+        bcModule bc = compileSource(src, level);
+        fclose(src);
+        if (bc == NULL) {
+            fprintf(stderr, "seed %ld: the generated program does not compile\n", seed + i);
+            status = 1;
+            break;
+        }
+
+        VM_RUN          y  = { .seed = 1 }, z = { .seed = 1 };
+        VM_STATUS       ys = vmRun(bc, &y);
+        BC_IMAGE_STATUS why = BC_IMAGE_UNREADABLE;
+        bcModule        im  = writeBcImage(imagePath, bc) ? mapBcImage(imagePath, &why) : NULL;
+        if (im == NULL) {
+            fprintf(stderr, "seed %ld: image refused: %s\n", seed + i, bcImageStatusText(why));
+            status = 1;
+        } else if (vmRun(im, &z) != ys || z.checksum != y.checksum || z.writes != y.writes) {
+            fprintf(stderr, "seed %ld: the image does not run as the module did\n", seed + i);
+            status = 1;
+        } else {
+            mapped++;
+            damageImage(im, imagePath, damage, &rng, refused, &accepted, &crashed);
+        }
+        freeBcModule(im);
+        freeBcModule(bc);
+    }
+    unlink(imagePath);
+
+    printf("images: %ld of %ld programs at -O%d mapped and ran as compiled\n", mapped, n, level);
+    printf("damaged: %ld copies, %ld accepted, %ld of them crashed\n", mapped * damage, accepted,
+           crashed);
+    for (int k = BC_IMAGE_TRUNCATED; k <= BC_IMAGE_BAD_CODE; k++)
+        if (refused[k] > 0)
+            printf("  refused %8ld  %s\n", refused[k], bcImageStatusText((BC_IMAGE_STATUS)k));
+    return status != 0 || crashed > 0;
+}
+
+int main(int argc, char *argv[]) {
+    long kernels = 16, iters = 20000, seed = 1, runs = 3, level = 3, images = 0, damage = 16;
+    bool counts  = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        if (intOption(a, "--kernels=", 1, 1 << 20, &kernels) ||
+            intOption(a, "--iters=", 0, 1 << 30, &iters) ||
+            intOption(a, "--seed=", 0, 1L << 62, &seed) ||
+            intOption(a, "--runs=", 1, 1000, &runs) || intOption(a, "--level=", 0, 3, &level) ||
+            intOption(a, "--images=", 1, 1 << 20, &images) ||
+            intOption(a, "--damage=", 0, 1 << 20, &damage))
+            ;
+        else if (strcmp(a, "--counts") == 0)
+            counts = true;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (images > 0)
+        return checkImages(images, damage, seed, (int)level);
+
+    diagBuffer    gdiag = createDiagBuffer();
+    grammarTables T     = loadGrammarTables(GRAMMAR_FILE, GRAMMAR_BLOB, gdiag);
+    diagFlush(gdiag, stderr);
+    freeDiagBuffer(gdiag);
+    if (T == NULL)
+        return 1;
+
+    Result res[NSUITE];
+    VM_RUN total  = { 0 };
+    int    status = 0;
+    for (int s = 0; s < NSUITE && status == 0; s++) {
+        KernelOptions gen = { (int)kernels, (int)iters, (uint64_t)seed, SUITE[s].kinds };
+        status = benchProgram(T, &SUITE[s], &gen, (int)level, (int)runs, &res[s], &total);
+    }
+
+    if (status == 0) {
+        printf("suite: %ld kernels a program, %ld iterations each, -O%ld\n", kernels, iters,
+               level);
+        printf("%-8s %10s %10s %14s %14s %10s %10s %10s %8s\n", "program", "bytecode",
+               "compile", "ir executed", "vm executed", "ir ms", "vm ms", "M inst/s", "speedup");
+        uint64_t irNs = 0, vmNs = 0, vmSteps = 0;
+        for (int s = 0; s < NSUITE; s++) {
+            const Result *q = &res[s];
+            printf("%-8s %9.1fK %8.3fms %14llu %14llu %10.3f %10.3f %10.1f %7.2fx\n",
+                   SUITE[s].name, q->bytes / 1024.0, q->compileNs / 1e6,
+                   (unsigned long long)q->irSteps, (unsigned long long)q->vmSteps, q->irNs / 1e6,
+                   q->vmNs / 1e6, q->vmNs ? q->vmSteps * 1e3 / q->vmNs : 0.0,
+                   q->vmNs ? (double)q->irNs / q->vmNs : 0.0);
+            irNs += q->irNs;
+            vmNs += q->vmNs;
+            vmSteps += q->vmSteps;
+        }
+        printf("%-8s %10s %10s %14s %14llu %10.3f %10.3f %10.1f %7.2fx\n", "total", "", "", "",
+               (unsigned long long)vmSteps, irNs / 1e6, vmNs / 1e6,
+               vmNs ? vmSteps * 1e3 / vmNs : 0.0, vmNs ? (double)irNs / vmNs : 0.0);
+
+        printf("\n%-8s %14s %14s %10s %10s\n", "start", "source ms", "image ms", "image", "faster");
+        for (int s = 0; s < NSUITE; s++) {
+            const Result *q = &res[s];
+            printf("%-8s %14.3f %14.3f %9.1fK %9.0fx\n", SUITE[s].name, q->sourceNs / 1e6,
+                   q->imageNs / 1e6, q->imageBytes / 1024.0,
+                   q->imageNs ? (double)q->sourceNs / q->imageNs : 0.0);
+        }
+        if (counts) {
+            printf("\n");
+            vmPrintCounts(&total, stdout);
+        }
+    }
+
+    freeGrammarTables(T);
+    return status;
+}